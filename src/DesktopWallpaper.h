@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include "WallpaperSession.h"
+
 // Expose the IDesktopWallpaper shell interface, with some enhancements.
 class CDesktopWallpaper
 {
@@ -290,3 +292,175 @@ class CDesktopWallpaper
 
         CComPtr<IDesktopWallpaper> m_pDesktopWallpaper;
 };
+
+// CWallpaperBackend for the shell's IDesktopWallpaper. Unlike
+// CDesktopWallpaper, failing to connect isn't fatal (see CWallpaperSession).
+class CDesktopWallpaperBackend : public CWallpaperBackend
+{
+    public:
+
+        bool
+        Connect() override
+        {
+            m_pDesktopWallpaper.Release();
+
+            HRESULT hr = ::CoCreateInstance(CLSID_DesktopWallpaper,
+                                            nullptr,
+                                            CLSCTX_LOCAL_SERVER,
+                                            IID_PPV_ARGS(&m_pDesktopWallpaper));
+            if (FAILED(hr))
+                DebugPrint(L"CDesktopWallpaperBackend::Connect: 0x%08X\n", hr);
+
+            return SUCCEEDED(hr);
+        }
+
+        void
+        Disconnect() override
+        {
+            m_pDesktopWallpaper.Release();
+        }
+
+        bool
+        GetWallpaper(
+            std::wstring* pWallpaperFile
+        ) override
+        {
+            // Returns S_FALSE if all monitors don't have the same wallpaper.
+            return GetWallpaper(nullptr, pWallpaperFile);
+        }
+
+        bool
+        SetWallpaper(
+            const std::wstring& wallpaperFile
+        ) override
+        {
+            return m_pDesktopWallpaper && SUCCEEDED(m_pDesktopWallpaper->SetWallpaper(nullptr, wallpaperFile.c_str()));
+        }
+
+        bool
+        GetMonitorWallpaper(
+            const std::wstring& monitorID,
+            std::wstring* pWallpaperFile
+        ) override
+        {
+            return GetWallpaper(monitorID.c_str(), pWallpaperFile);
+        }
+
+        bool
+        SetMonitorWallpaper(
+            const std::wstring& monitorID,
+            const std::wstring& wallpaperFile
+        ) override
+        {
+            return m_pDesktopWallpaper && SUCCEEDED(m_pDesktopWallpaper->SetWallpaper(monitorID.c_str(), wallpaperFile.c_str()));
+        }
+
+        bool
+        GetBackgroundColor(
+            COLORREF* pColor
+        ) override
+        {
+            return m_pDesktopWallpaper && SUCCEEDED(m_pDesktopWallpaper->GetBackgroundColor(pColor));
+        }
+
+        bool
+        SetBackgroundColor(
+            COLORREF color
+        ) override
+        {
+            return m_pDesktopWallpaper && SUCCEEDED(m_pDesktopWallpaper->SetBackgroundColor(color));
+        }
+
+        bool
+        GetPosition(
+            WallpaperResizeMode* pPosition
+        ) override
+        {
+            // WallpaperResizeMode values are the DESKTOP_WALLPAPER_POSITION values.
+            DESKTOP_WALLPAPER_POSITION position = DWPOS_CENTER;
+
+            if (!m_pDesktopWallpaper || FAILED(m_pDesktopWallpaper->GetPosition(&position)))
+                return false;
+
+            *pPosition = (WallpaperResizeMode) position;
+            return true;
+        }
+
+        bool
+        SetPosition(
+            WallpaperResizeMode position
+        ) override
+        {
+            return m_pDesktopWallpaper && SUCCEEDED(m_pDesktopWallpaper->SetPosition((DESKTOP_WALLPAPER_POSITION) position));
+        }
+
+        bool
+        Enable(
+            bool enable
+        ) override
+        {
+            return m_pDesktopWallpaper && SUCCEEDED(m_pDesktopWallpaper->Enable(enable ? TRUE : FALSE));
+        }
+
+        bool
+        GetMonitors(
+            std::vector<CWallpaperMonitor>* pMonitors
+        ) override
+        {
+            pMonitors->clear();
+
+            UINT count = 0;
+
+            if (!m_pDesktopWallpaper || FAILED(m_pDesktopWallpaper->GetMonitorDevicePathCount(&count)))
+                return false;
+
+            for (UINT monitorIndex = 0; monitorIndex < count; monitorIndex++)
+            {
+                LPWSTR pwszMonitorID = nullptr;
+
+                if (FAILED(m_pDesktopWallpaper->GetMonitorDevicePathAt(monitorIndex, &pwszMonitorID)))
+                    return false;
+
+                CWallpaperMonitor monitor = {};
+                monitor.m_MonitorID.assign(pwszMonitorID);
+                CoTaskMemFree(pwszMonitorID);
+
+                // The list includes monitors that aren't part of the
+                // desktop, which have no rectangle.
+                HRESULT hr = m_pDesktopWallpaper->GetMonitorRECT(monitor.m_MonitorID.c_str(), &monitor.m_Rect);
+
+                if (hr == S_OK && !::IsRectEmpty(&monitor.m_Rect))
+                    pMonitors->push_back(monitor);
+            }
+
+            return true;
+        }
+
+    private:
+
+        bool
+        GetWallpaper(
+            LPCWSTR pwszMonitorID,
+            std::wstring* pWallpaperFile
+        )
+        {
+            pWallpaperFile->clear();
+
+            if (!m_pDesktopWallpaper)
+                return false;
+
+            LPWSTR pwszWallpaperFile = nullptr;
+
+            HRESULT hr = m_pDesktopWallpaper->GetWallpaper(pwszMonitorID, &pwszWallpaperFile);
+
+            if (SUCCEEDED(hr) && pwszWallpaperFile != nullptr)
+            {
+                pWallpaperFile->assign(pwszWallpaperFile);
+                CoTaskMemFree(pwszWallpaperFile);
+            }
+
+            return SUCCEEDED(hr);
+        }
+
+        CComPtr<IDesktopWallpaper> m_pDesktopWallpaper;
+};
@@ -0,0 +1,206 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryImport.cpp
+//
+//  CDirectoryImport class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "DirectoryImport.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryImport::CDirectoryImport
+//  CDirectoryImport::~CDirectoryImport
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CDirectoryImport::CDirectoryImport(
+    NotifyFunction notify,
+    unsigned concurrency /*= 0*/
+)
+    :
+    m_Notify(std::move(notify)),
+    m_Concurrency(concurrency),
+    m_Mutex(),
+    m_WorkAvailable(),
+    m_Directories(),
+    m_Results(),
+    m_pScanner(nullptr),
+    m_Generation(0),
+    m_Stop(false),
+    m_Thread()
+{
+    m_Thread = std::thread(&CDirectoryImport::ImportThread, this);
+}
+
+CDirectoryImport::~CDirectoryImport()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+
+    Cancel();
+
+    m_Thread.join();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryImport::Add
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryImport::Add(
+    const fs::path& dirPath,
+    bool recurseIntoSubdirs
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Directories.emplace_back(dirPath, recurseIntoSubdirs);
+    }
+
+    m_WorkAvailable.notify_one();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryImport::Cancel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryImport::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_Directories.clear();
+        m_Results.clear();
+        m_Generation++;
+
+        // The thread clears the pointer (under the lock)
+        // before the scanner goes away.
+        if (m_pScanner)
+            m_pScanner->Cancel();
+    }
+
+    m_WorkAvailable.notify_one();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryImport::TakeResults
+//  CDirectoryImport::IsBusy
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CDirectoryImport::TakeResults(
+    std::vector<fs::path>& files
+)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (files.empty())
+        files.swap(m_Results);
+    else
+        files.insert(files.end(), std::make_move_iterator(m_Results.begin()), std::make_move_iterator(m_Results.end()));
+
+    m_Results.clear();
+
+    return m_pScanner != nullptr || !m_Directories.empty();
+}
+
+bool
+CDirectoryImport::IsBusy() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_pScanner != nullptr || !m_Directories.empty() || !m_Results.empty();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryImport::ImportThread
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryImport::ImportThread()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    for (;;)
+    {
+        while (m_Directories.empty() && !m_Stop)
+            m_WorkAvailable.wait(lock);
+
+        if (m_Stop)
+            break;
+
+        std::pair<fs::path, bool> directory = std::move(m_Directories.front());
+        m_Directories.pop_front();
+
+        uint32_t generation = m_Generation;
+
+        CDirectoryScanner scanner(m_Concurrency, true);
+        scanner.SetFileFilter([] (const fs::path& filePath) { return IsValidImageFile(filePath); });
+
+        // Published before the scan starts, so Cancel() can always stop it
+        // (a cancelled scanner returns from Scan() straight away).
+        m_pScanner = &scanner;
+
+        lock.unlock();
+
+        scanner.Scan(directory.first,
+                     directory.second,
+                     /*LAMBDA*/ [this, generation] (CDirectoryScanner::FileBatch& batch)
+                     {
+                         bool wasEmpty;
+
+                         {
+                             std::lock_guard<std::mutex> batchLock(m_Mutex);
+
+                             if (generation != m_Generation)
+                                 return false;
+
+                             wasEmpty = m_Results.empty();
+                             m_Results.insert(m_Results.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+                         }
+
+                         // One notification until the files are collected.
+                         if (wasEmpty)
+                             m_Notify();
+
+                         return true;
+                     });
+
+        lock.lock();
+
+        m_pScanner = nullptr;
+
+        // Finished: let the UI thread know, so it can collect
+        // the last files and see that there are no more.
+        if (m_Directories.empty() && generation == m_Generation)
+        {
+            lock.unlock();
+            m_Notify();
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,119 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryImport.h
+//
+//  CDirectoryImport class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DirectoryScanner.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryImport
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Finds the image files in directories on a background thread, for adding
+// them to a playlist without blocking the UI (CFileList::Add() scans on
+// the calling thread).
+//
+// The UI thread calls Add() for each directory (e.g. dropped on the
+// window). Directories are scanned one at a time, in the order they were
+// added, with a CDirectoryScanner in deterministic order, so adding the
+// same tree twice gives the same list. The notify function is called when
+// files go from none to some waiting to be collected, and when the last
+// directory is finished. The UI thread then calls TakeResults().
+class CDirectoryImport
+{
+    public:
+
+        // Called on the import thread when there are files to collect, or
+        // the import has finished (e.g. posts a message to the UI thread).
+        // Must be thread-safe.
+        using NotifyFunction = std::function<void ()>;
+
+        CDirectoryImport(
+            NotifyFunction notify,
+            unsigned concurrency = 0    // Number of scanner threads (0 = default).
+        );
+
+        // Cancels the import and waits for the thread to exit.
+        ~CDirectoryImport();
+
+        // No copy ctor.
+        CDirectoryImport(const CDirectoryImport&) = delete;
+
+        // No copy assignment.
+        CDirectoryImport& operator=(const CDirectoryImport&) = delete;
+
+        // Queue a directory to be scanned.
+        void
+        Add(
+            const fs::path& dirPath,
+            bool recurseIntoSubdirs
+        );
+
+        // Stop scanning, and forget the directories waiting to be scanned
+        // and the files not collected yet (e.g. another playlist is being
+        // loaded). Doesn't wait for the scan to stop.
+        void
+        Cancel();
+
+        // Collect the files found so far (appended to files, in scan
+        // order). Returns false once the import has finished, and
+        // everything has been collected.
+        bool
+        TakeResults(
+            std::vector<fs::path>& files
+        );
+
+        // Are directories being scanned, or files waiting to be collected?
+        bool
+        IsBusy() const;
+
+    private:
+
+        // Import thread main loop.
+        void
+        ImportThread();
+
+        NotifyFunction m_Notify;
+
+        unsigned m_Concurrency;
+
+        // Guards everything below, except m_Thread.
+        mutable std::mutex m_Mutex;
+
+        // Signalled when a directory is added, or the thread should exit.
+        std::condition_variable m_WorkAvailable;
+
+        // Directories waiting to be scanned (and whether to recurse).
+        std::deque<std::pair<fs::path, bool>> m_Directories;
+
+        // Files found, but not collected yet.
+        std::vector<fs::path> m_Results;
+
+        // Scanner of the directory being scanned, or nullptr.
+        CDirectoryScanner* m_pScanner;
+
+        // Incremented by Cancel(). Files found by a scan
+        // that started before then are thrown away.
+        uint32_t m_Generation;
+
+        // Set when the thread should exit.
+        bool m_Stop;
+
+        std::thread m_Thread;
+};
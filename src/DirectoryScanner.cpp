@@ -0,0 +1,471 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryScanner.cpp
+//
+//  CDirectoryScanner class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "DirectoryScanner.h"
+
+// How long the Scan() thread and idle workers wait before checking
+// for cancellation (or new work) again.
+static const std::chrono::milliseconds PollInterval(20);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::DirectoryNode
+//  CDirectoryScanner::WorkerQueue
+//  CDirectoryScanner::ScanState
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Directory in the tree being scanned.
+// Nodes are kept until the scan completes, so workers and the
+// Scan() thread can refer to them without worrying about lifetime.
+struct CDirectoryScanner::DirectoryNode
+{
+    explicit DirectoryNode(fs::path path)
+        :
+        m_Path(std::move(path)),
+        m_Files(),
+        m_Subdirs(),
+        m_Done(false)
+    {
+    }
+
+    // Directory path.
+    fs::path m_Path;
+
+    // Files in the directory (deterministic mode only).
+    FileBatch m_Files;
+
+    // Subdirectories, sorted by name in deterministic mode.
+    std::vector<std::unique_ptr<DirectoryNode>> m_Subdirs;
+
+    // Set when the directory has been scanned.
+    // Protected by ScanState::m_ResultLock.
+    bool m_Done;
+};
+
+// Per-worker queue of directories waiting to be scanned.
+struct CDirectoryScanner::WorkerQueue
+{
+    std::mutex m_Lock;
+    std::deque<DirectoryNode*> m_Directories;
+};
+
+// State shared by the workers and the Scan() thread.
+struct CDirectoryScanner::ScanState
+{
+    ScanState(
+        const fs::path& rootPath,
+        bool recurseIntoSubdirs,
+        size_t workerCount
+    )
+        :
+        m_Root(rootPath),
+        m_RecurseIntoSubdirs(recurseIntoSubdirs),
+        m_Queues(),
+        m_PendingDirectories(0),
+        m_WorkLock(),
+        m_WorkAvailable(),
+        m_ResultLock(),
+        m_ResultReady(),
+        m_Results()
+    {
+        for (size_t idx = 0; idx < workerCount; idx++)
+            m_Queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    // Root of the directory tree.
+    DirectoryNode m_Root;
+
+    // Scan subdirectories?
+    bool m_RecurseIntoSubdirs;
+
+    // Work queues, one per worker.
+    std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+
+    // Number of directories queued or being scanned.
+    // The scan is complete when this drops to zero.
+    std::atomic<size_t> m_PendingDirectories;
+
+    // Idle workers wait here for new work.
+    std::mutex m_WorkLock;
+    std::condition_variable m_WorkAvailable;
+
+    // Scan() thread waits here for results.
+    std::mutex m_ResultLock;
+    std::condition_variable m_ResultReady;
+
+    // Batches waiting to be delivered (non-deterministic mode only).
+    // Protected by m_ResultLock.
+    std::deque<FileBatch> m_Results;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::CDirectoryScanner
+//  CDirectoryScanner::~CDirectoryScanner
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CDirectoryScanner::CDirectoryScanner(
+    unsigned concurrency /*= 0*/,
+    bool deterministicOrder /*= false*/
+)
+    :
+    m_Concurrency(concurrency),
+    m_DeterministicOrder(deterministicOrder),
+    m_BatchSize(256),
+    m_Filter(),
+    m_Cancelled(false)
+{
+    // Default to one thread per processor, but at least a few, because
+    // scanning is mostly waiting on the file system (especially over
+    // the network), not using CPU.
+    if (m_Concurrency == 0)
+        m_Concurrency = std::max(std::thread::hardware_concurrency(), 4U);
+}
+
+CDirectoryScanner::~CDirectoryScanner()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::Scan
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CDirectoryScanner::Scan(
+    const fs::path& rootPath,
+    bool recurseIntoSubdirs,
+    const BatchCallback& onBatch
+)
+{
+    ScanState state(rootPath, recurseIntoSubdirs, m_Concurrency);
+
+    // Seed the first worker's queue with the root directory.
+    state.m_PendingDirectories = 1;
+    state.m_Queues[0]->m_Directories.push_back(&state.m_Root);
+
+    std::vector<std::thread> workers;
+    workers.reserve(m_Concurrency);
+
+    for (size_t idx = 0; idx < m_Concurrency; idx++)
+        workers.emplace_back(&CDirectoryScanner::WorkerThread, this, std::ref(state), idx);
+
+    if (m_DeterministicOrder)
+        DeliverInOrder(state, onBatch);
+    else
+        DeliverAsFound(state, onBatch);
+
+    // Workers exit when the tree has been scanned, or when cancelled.
+    for (std::thread& worker: workers)
+        worker.join();
+
+    return !m_Cancelled;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::DeliverInOrder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryScanner::DeliverInOrder(
+    ScanState& state,
+    const BatchCallback& onBatch
+)
+{
+    // Walk the tree depth first, waiting for each directory to be scanned
+    // before delivering its files. Workers are usually well ahead of us.
+
+    std::vector<DirectoryNode*> stack;
+    stack.push_back(&state.m_Root);
+
+    while (!stack.empty() && !m_Cancelled)
+    {
+        DirectoryNode* pNode = stack.back();
+
+        {
+            std::unique_lock<std::mutex> lock(state.m_ResultLock);
+
+            while (!pNode->m_Done && !m_Cancelled)
+                state.m_ResultReady.wait_for(lock, PollInterval);
+
+            if (m_Cancelled)
+                break;
+        }
+
+        stack.pop_back();
+
+        if (!pNode->m_Files.empty())
+        {
+            FileBatch batch = std::move(pNode->m_Files);
+
+            if (!onBatch(batch))
+                Cancel();
+        }
+
+        // Push subdirectories in reverse order, so the first is delivered first.
+        for (auto it = pNode->m_Subdirs.rbegin(); it != pNode->m_Subdirs.rend(); ++it)
+            stack.push_back(it->get());
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::DeliverAsFound
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryScanner::DeliverAsFound(
+    ScanState& state,
+    const BatchCallback& onBatch
+)
+{
+    while (!m_Cancelled)
+    {
+        FileBatch batch;
+
+        {
+            std::unique_lock<std::mutex> lock(state.m_ResultLock);
+
+            // Batches are posted before the pending count is decremented,
+            // so no results are waiting once the count reaches zero.
+            while (state.m_Results.empty() && state.m_PendingDirectories != 0 && !m_Cancelled)
+                state.m_ResultReady.wait_for(lock, PollInterval);
+
+            if (state.m_Results.empty())
+                break;
+
+            batch = std::move(state.m_Results.front());
+            state.m_Results.pop_front();
+        }
+
+        if (!onBatch(batch))
+            Cancel();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::WorkerThread
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryScanner::WorkerThread(
+    ScanState& state,
+    size_t workerIndex
+)
+{
+    while (!m_Cancelled)
+    {
+        DirectoryNode* pNode = GetWork(state, workerIndex);
+
+        if (pNode == nullptr)
+        {
+            // Nothing to do. Finished if no directories are pending,
+            // otherwise wait for another worker to find some.
+            if (state.m_PendingDirectories == 0)
+                break;
+
+            std::unique_lock<std::mutex> lock(state.m_WorkLock);
+            state.m_WorkAvailable.wait_for(lock, PollInterval);
+            continue;
+        }
+
+        ScanDirectory(state, workerIndex, pNode);
+
+        if (--state.m_PendingDirectories == 0)
+        {
+            // Last directory done. Wake everyone up so they can exit.
+            { std::lock_guard<std::mutex> lock(state.m_WorkLock); }
+            state.m_WorkAvailable.notify_all();
+
+            { std::lock_guard<std::mutex> lock(state.m_ResultLock); }
+            state.m_ResultReady.notify_all();
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::GetWork
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CDirectoryScanner::DirectoryNode*
+CDirectoryScanner::GetWork(
+    ScanState& state,
+    size_t workerIndex
+)
+{
+    // Newest directory from our own queue.
+    {
+        WorkerQueue& queue = *state.m_Queues[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.m_Lock);
+
+        if (!queue.m_Directories.empty())
+        {
+            DirectoryNode* pNode = queue.m_Directories.back();
+            queue.m_Directories.pop_back();
+            return pNode;
+        }
+    }
+
+    // Oldest directory from another worker's queue.
+    size_t workerCount = state.m_Queues.size();
+
+    for (size_t offset = 1; offset < workerCount; offset++)
+    {
+        WorkerQueue& victim = *state.m_Queues[(workerIndex + offset) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.m_Lock);
+
+        if (!victim.m_Directories.empty())
+        {
+            DirectoryNode* pNode = victim.m_Directories.front();
+            victim.m_Directories.pop_front();
+            return pNode;
+        }
+    }
+
+    return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::ScanDirectory
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryScanner::ScanDirectory(
+    ScanState& state,
+    size_t workerIndex,
+    DirectoryNode* pNode
+)
+{
+    FileBatch files;
+    std::vector<fs::path> subdirs;
+
+    // Inaccessible directories (and files) are silently skipped,
+    // same as for a single threaded scan.
+
+    std::error_code ec;
+
+    for (fs::directory_iterator it(pNode->m_Path, fs::directory_options::skip_permission_denied, ec);
+         !ec && it != fs::directory_iterator();
+         it.increment(ec))
+    {
+        if (m_Cancelled)
+            break;
+
+        const fs::directory_entry& entry = *it;
+
+        std::error_code ecEntry;
+
+        if (entry.is_directory(ecEntry))
+        {
+            // Don't follow directory symlinks (same as recursive_directory_iterator).
+            if (state.m_RecurseIntoSubdirs && !entry.is_symlink(ecEntry))
+                subdirs.push_back(entry.path());
+        }
+        else if (entry.is_regular_file(ecEntry))
+        {
+            if (!m_Filter || m_Filter(entry.path()))
+            {
+                files.push_back(entry.path());
+
+                if (!m_DeterministicOrder && files.size() >= m_BatchSize)
+                    PostBatch(state, files);
+            }
+        }
+    }
+
+    if (m_DeterministicOrder)
+    {
+        std::sort(files.begin(), files.end());
+        std::sort(subdirs.begin(), subdirs.end());
+    }
+    else if (!files.empty())
+    {
+        PostBatch(state, files);
+    }
+
+    std::vector<std::unique_ptr<DirectoryNode>> subdirNodes;
+    subdirNodes.reserve(subdirs.size());
+
+    for (fs::path& subdir: subdirs)
+        subdirNodes.push_back(std::make_unique<DirectoryNode>(std::move(subdir)));
+
+    if (!subdirNodes.empty())
+    {
+        // Count the subdirectories before queueing them, so the
+        // pending count can't drop to zero while work remains.
+        state.m_PendingDirectories += subdirNodes.size();
+
+        {
+            WorkerQueue& queue = *state.m_Queues[workerIndex];
+            std::lock_guard<std::mutex> lock(queue.m_Lock);
+
+            // Queue in reverse order, so we take the first one next.
+            for (auto it = subdirNodes.rbegin(); it != subdirNodes.rend(); ++it)
+                queue.m_Directories.push_back(it->get());
+        }
+
+        state.m_WorkAvailable.notify_all();
+    }
+
+    // Publish results.
+    {
+        std::lock_guard<std::mutex> lock(state.m_ResultLock);
+        pNode->m_Files = std::move(files);
+        pNode->m_Subdirs = std::move(subdirNodes);
+        pNode->m_Done = true;
+    }
+
+    if (m_DeterministicOrder)
+        state.m_ResultReady.notify_all();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner::PostBatch
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CDirectoryScanner::PostBatch(
+    ScanState& state,
+    FileBatch& batch
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(state.m_ResultLock);
+        state.m_Results.push_back(std::move(batch));
+    }
+
+    state.m_ResultReady.notify_one();
+
+    batch = FileBatch();
+    batch.reserve(m_BatchSize);
+}
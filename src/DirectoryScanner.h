@@ -0,0 +1,181 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryScanner.h
+//
+//  CDirectoryScanner class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryScanner
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Multi-threaded directory tree enumerator.
+//
+// A pool of worker threads walks the tree. Each worker owns a queue of
+// directories waiting to be scanned. A worker pushes the subdirectories it
+// finds onto the back of its own queue, and takes its next directory from
+// the back (depth first, good locality). An idle worker steals from the
+// front of another worker's queue, which is where the oldest (and usually
+// largest) subtrees are.
+//
+// Discovered files are delivered in batches on the thread that called
+// Scan(), so the batch callback doesn't need to be thread-safe.
+class CDirectoryScanner
+{
+    public:
+
+        // Batch of discovered files.
+        using FileBatch = std::vector<fs::path>;
+
+        // Called on the Scan() thread for each batch of files.
+        // Return false to cancel the scan.
+        using BatchCallback = std::function<bool (FileBatch& batch)>;
+
+        // Called on worker threads to decide if a file should be included.
+        // Must be thread-safe.
+        using FileFilter = std::function<bool (const fs::path& path)>;
+
+        CDirectoryScanner(
+            unsigned concurrency = 0,           // Number of worker threads (0 = default).
+            bool deterministicOrder = false     // Deliver files in the same order every time?
+        );
+
+        ~CDirectoryScanner();
+
+        // No copy ctor.
+        CDirectoryScanner(const CDirectoryScanner&) = delete;
+
+        // No copy assignment.
+        CDirectoryScanner& operator=(const CDirectoryScanner&) = delete;
+
+        // Set filter for discovered files.
+        // By default, all regular files are included.
+        void
+        SetFileFilter(
+            FileFilter filter
+        )
+        {
+            m_Filter = std::move(filter);
+        }
+
+        // Set the maximum number of files per batch.
+        // (Ignored in deterministic mode, which delivers one batch per directory.)
+        void
+        SetBatchSize(
+            size_t batchSize
+        )
+        {
+            m_BatchSize = std::max(batchSize, (size_t) 1);
+        }
+
+        // Scan a directory, and optionally its subdirectories.
+        //
+        // In deterministic mode, files are delivered in depth first order:
+        // a directory's files (sorted by name), then each of its
+        // subdirectories (sorted by name). Otherwise files are delivered
+        // in whatever order the workers find them, which is faster.
+        //
+        // Returns false if the scan was cancelled.
+        bool
+        Scan(
+            const fs::path& rootPath,
+            bool recurseIntoSubdirs,
+            const BatchCallback& onBatch
+        );
+
+        // Cancel the scan in progress.
+        // Can be called from any thread, including the batch callback.
+        // Stays cancelled, so a Scan() that hasn't started yet (or a
+        // later one) returns false straight away.
+        void
+        Cancel() noexcept
+        {
+            m_Cancelled = true;
+        }
+
+        // Has the scan been cancelled?
+        bool
+        IsCancelled() const noexcept
+        {
+            return m_Cancelled;
+        }
+
+    private:
+
+        struct DirectoryNode;
+        struct WorkerQueue;
+        struct ScanState;
+
+        // Worker thread main loop.
+        void
+        WorkerThread(
+            ScanState& state,
+            size_t workerIndex
+        );
+
+        // Get next directory to scan: from our own queue first,
+        // otherwise steal from another worker.
+        DirectoryNode*
+        GetWork(
+            ScanState& state,
+            size_t workerIndex
+        );
+
+        // Scan a single directory.
+        void
+        ScanDirectory(
+            ScanState& state,
+            size_t workerIndex,
+            DirectoryNode* pNode
+        );
+
+        // Hand a batch of files over to the Scan() thread.
+        void
+        PostBatch(
+            ScanState& state,
+            FileBatch& batch
+        );
+
+        // Deliver files to the callback in depth first order.
+        void
+        DeliverInOrder(
+            ScanState& state,
+            const BatchCallback& onBatch
+        );
+
+        // Deliver files to the callback as they are found.
+        void
+        DeliverAsFound(
+            ScanState& state,
+            const BatchCallback& onBatch
+        );
+
+        // Number of worker threads.
+        unsigned m_Concurrency;
+
+        // Deliver files in the same order every time?
+        bool m_DeterministicOrder;
+
+        // Maximum number of files per batch.
+        size_t m_BatchSize;
+
+        // File filter.
+        FileFilter m_Filter;
+
+        // Set when the scan is cancelled.
+        std::atomic<bool> m_Cancelled;
+};
@@ -0,0 +1,32 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileHandle.h
+//
+//  FileHandle type.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileHandle
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle to a file in a CFileList. Handles are stable: adding, removing,
+// sorting, or shuffling other files doesn't change them. A handle becomes
+// invalid when its file is removed, and may then be reused for a new file.
+using FileHandle = uint32_t;
+
+// Invalid FileHandle value.
+const FileHandle InvalidFileHandle = (FileHandle) -1;
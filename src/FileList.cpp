@@ -0,0 +1,1460 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileList.cpp
+//
+//  CFileInfo and CFileList classes.
+//
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+
+#include "precomp.h"
+
+#ifdef _WIN32
+  #include "WallpaperChangerApp.h"
+#endif
+
+#include "FileList.h"
+#include "DirectoryScanner.h"
+
+//============================================================================
+//
+//  CStringArena
+//
+//============================================================================
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CStringArena::Add
+//
+//////////////////////////////////////////////////////////////////////////////
+
+LPCWSTR
+CStringArena::Add(
+    std::wstring_view str
+)
+{
+    size_t length = str.size() + 1;     // Include null terminator.
+
+    WCHAR* pString;
+
+    if (length > BlockSize)
+    {
+        // Oversize string gets a block of its own. Insert it before the
+        // current block, so the current block can continue to be filled.
+        auto pBlock = std::make_unique<WCHAR[]>(length);
+        pString = pBlock.get();
+        m_Blocks.insert(m_Blocks.empty() ? m_Blocks.end() : m_Blocks.end() - 1, std::move(pBlock));
+    }
+    else
+    {
+        if (m_BlockUsed + length > BlockSize)
+        {
+            m_Blocks.push_back(std::make_unique<WCHAR[]>(BlockSize));
+            m_BlockUsed = 0;
+        }
+
+        pString = m_Blocks.back().get() + m_BlockUsed;
+        m_BlockUsed += length;
+    }
+
+    std::copy(str.begin(), str.end(), pString);
+    pString[str.size()] = L'\0';
+
+    return pString;
+}
+
+//============================================================================
+//
+//  CFileList
+//
+//============================================================================
+
+// FNV-1a hash constants.
+static const size_t FnvOffsetBasis = 14695981039346656037ULL;
+static const size_t FnvPrime = 1099511628211ULL;
+
+// Fold path character for case insensitive comparison.
+// Forward and back slashes are treated as the same character.
+static FORCEINLINE WCHAR FoldPathChar(WCHAR ch)
+{
+    if (ch < 0x80)
+    {
+        if (ch >= L'a' && ch <= L'z')
+            return ch - (L'a' - L'A');
+        if (ch == L'/')
+            return L'\\';
+        return ch;
+    }
+
+#ifdef _WIN32
+    // CharUpperW() converts a single character if the high word is zero.
+    return (WCHAR)(ULONG_PTR) ::CharUpperW((LPWSTR)(ULONG_PTR) ch);
+#else
+    return (WCHAR) towupper(ch);
+#endif
+}
+
+// Hash path (FNV-1a) using case insensitive comparison.
+static size_t HashPath(std::wstring_view path, size_t hash = FnvOffsetBasis)
+{
+    for (WCHAR ch: path)
+    {
+        hash ^= FoldPathChar(ch);
+        hash *= FnvPrime;
+    }
+
+    return hash;
+}
+
+// Hash file name within a directory.
+static FORCEINLINE size_t HashFile(DirectoryId dirId, std::wstring_view fileName)
+{
+    return HashPath(fileName, (FnvOffsetBasis ^ dirId) * FnvPrime);
+}
+
+// Compare paths using case insensitive comparison.
+static bool PathsEqual(std::wstring_view path1, std::wstring_view path2)
+{
+    if (path1.size() != path2.size())
+        return false;
+
+    for (size_t idx = 0; idx < path1.size(); idx++)
+    {
+        if (FoldPathChar(path1[idx]) != FoldPathChar(path2[idx]))
+            return false;
+    }
+
+    return true;
+}
+
+// Case insensitive comparison of two (not null terminated) strings.
+static FORCEINLINE int CompareNoCase(std::wstring_view str1, std::wstring_view str2)
+{
+    int result = _wcsnicmp(str1.data(), str2.data(), std::min(str1.size(), str2.size()));
+
+    if (result == 0 && str1.size() != str2.size())
+        result = (str1.size() < str2.size()) ? -1 : 1;
+
+    return result;
+}
+
+// Fold character for collation. Folds to lower case, which puts
+// punctuation like '_' before letters (same as _wcsicmp).
+static FORCEINLINE WCHAR FoldCollationChar(WCHAR ch)
+{
+    if (ch < 0x80)
+    {
+        if (ch >= L'A' && ch <= L'Z')
+            return ch + (L'a' - L'A');
+        return ch;
+    }
+
+#ifdef _WIN32
+    // CharLowerW() converts a single character if the high word is zero.
+    return (WCHAR)(ULONG_PTR) ::CharLowerW((LPWSTR)(ULONG_PTR) ch);
+#else
+    return (WCHAR) towlower(ch);
+#endif
+}
+
+// Append collation key for a string. Keys are compared with a plain
+// binary (code unit) comparison, which is much faster than comparing
+// the original strings with _wcsicmp, because all of the case folding
+// and number parsing has been done up front.
+//
+// Characters are case folded. If naturalOrder is true, each run of
+// digits is replaced by its length (ignoring leading zeros) as the
+// character '0' + length, then the digits. A shorter number is always a
+// smaller number, so "img2" sorts before "img10". And '0' + length is a
+// digit for numbers of up to 9 digits (and punctuation after that), so
+// numbers still sort where digits do: after ' ', '-', and '.', and before
+// letters ("img 1" < "img1" < "imga", same as _wcsicmp).
+static void AppendCollationKey(std::wstring& key, std::wstring_view str, bool naturalOrder)
+{
+    for (size_t idx = 0; idx < str.size(); /**/)
+    {
+        if (naturalOrder && str[idx] >= L'0' && str[idx] <= L'9')
+        {
+            size_t start = idx;
+            while (idx < str.size() && str[idx] >= L'0' && str[idx] <= L'9')
+                idx++;
+
+            while (start < idx && str[start] == L'0')
+                start++;
+
+            key += (WCHAR) (L'0' + std::min(idx - start, (size_t) (UINT16_MAX - L'0')));
+            key.append(str.substr(start, idx - start));
+        }
+        else
+        {
+            key += FoldCollationChar(str[idx++]);
+        }
+    }
+}
+
+// Get the first four characters of a collation key as an integer,
+// so most comparisons don't need to look at the strings at all.
+static FORCEINLINE uint64_t GetCollationPrefix(std::wstring_view key)
+{
+    uint64_t prefix = 0;
+
+    for (size_t idx = 0; idx < 4; idx++)
+        prefix = (prefix << 16) | ((idx < key.size()) ? (uint16_t) key[idx] : 0);
+
+    return prefix;
+}
+
+// Get path string. The path's own string on Windows; elsewhere paths
+// aren't UTF-16, so it's a converted copy. Bind the result to a const
+// reference before taking views into it.
+#ifdef _WIN32
+static FORCEINLINE const std::wstring& GetPathString(const fs::path& path)
+{
+    return path.native();
+}
+#else
+static std::wstring GetPathString(const fs::path& path)
+{
+    return path.wstring();
+}
+#endif
+
+// Split full path into directory (including trailing separator) and file name.
+static void SplitPath(std::wstring_view path, std::wstring_view* pDirPath, std::wstring_view* pFileName)
+{
+    size_t pos = path.find_last_of(L"\\/:");
+    pos = (pos == std::wstring_view::npos) ? 0 : pos + 1;
+
+    *pDirPath = path.substr(0, pos);
+    *pFileName = path.substr(pos);
+}
+
+// Get length of the display name (stem) within a file name.
+// Follows the same rules as fs::path::stem().
+static size_t GetStemLength(std::wstring_view fileName)
+{
+    if (fileName == L"." || fileName == L"..")
+        return fileName.size();
+
+    size_t dot = fileName.find_last_of(L'.');
+
+    return (dot != std::wstring_view::npos && dot != 0) ? dot : fileName.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetFullPath
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+CFileList::GetFullPath(
+    FileHandle hFile
+)
+const
+{
+    const CFileInfo& fileInfo = GetFileInfo(hFile);
+
+    std::wstring_view dirPath = m_Directories[fileInfo.m_DirectoryId].GetPath();
+    std::wstring_view fileName = fileInfo.GetFileName();
+
+    std::wstring fullPath;
+    fullPath.reserve(dirPath.size() + fileName.size());
+    fullPath.append(dirPath);
+    fullPath.append(fileName);
+
+    return fs::path(std::move(fullPath));
+}
+
+// Get image dimensions.
+static void ReadImageSize(const fs::path& path, CImageSize* pImageSize)
+{
+    UINT width, height;
+
+    if (GetImageFileDimensions(path, &width, &height))
+    {
+        pImageSize->m_Width = width;
+        pImageSize->m_Height = height;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetPathHash
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CFileList::GetPathHash(
+    FileHandle hFile
+)
+const
+{
+    const CFileInfo& fileInfo = GetFileInfo(hFile);
+
+    // FNV-1a is computed one character at a time, so hashing the
+    // file name on top of the directory hashes the full path.
+    size_t dirHash = HashPath(m_Directories[fileInfo.m_DirectoryId].GetPath());
+
+    return HashPath(fileInfo.GetFileName(), dirHash);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetFileStat
+//
+//////////////////////////////////////////////////////////////////////////////
+
+const CFileStat&
+CFileList::GetFileStat(
+    FileHandle hFile
+)
+const
+{
+    ATLASSERT(IsValid(hFile));
+
+    if (hFile >= m_FileStats.size())
+        m_FileStats.resize(m_FileInfo.size(), CFileStat());
+
+    CFileStat& fileStat = m_FileStats[hFile];
+
+    // Files that can't be stat'ed aren't tried again.
+    if (!fileStat.IsKnown())
+        fileStat = StatFile(GetFullPath(hFile));
+
+    return fileStat;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::SetFileStat
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::SetFileStat(
+    FileHandle hFile,
+    const CFileStat& fileStat
+)
+{
+    ATLASSERT(IsValid(hFile));
+
+    if (hFile >= m_FileStats.size())
+        m_FileStats.resize(m_FileInfo.size(), CFileStat());
+
+    m_FileStats[hFile] = fileStat;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::StatFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+CFileStat
+CFileList::StatFile(
+    const fs::path& fullPath
+)
+{
+    std::error_code ec;
+
+    fs::file_time_type writeTime = fs::last_write_time(fullPath, ec);
+    if (ec)
+        return { 0, CFileStat::FailedTime };
+
+    uintmax_t fileSize = fs::file_size(fullPath, ec);
+    if (ec)
+        return { 0, CFileStat::FailedTime };
+
+    // A time of exactly zero would look like it hasn't been stat'ed.
+    int64_t lastWriteTime = writeTime.time_since_epoch().count();
+    if (lastWriteTime == CFileStat::UnknownTime)
+        lastWriteTime = 1;
+
+    return { fileSize, lastWriteTime };
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetImageSize
+//
+//////////////////////////////////////////////////////////////////////////////
+
+const CImageSize&
+CFileList::GetImageSize(
+    FileHandle hFile
+)
+const
+{
+    ATLASSERT(IsValid(hFile));
+
+    if (hFile >= m_ImageSizes.size())
+        m_ImageSizes.resize(m_FileInfo.size(), CImageSize());
+
+    CImageSize& imageSize = m_ImageSizes[hFile];
+
+    if (imageSize.m_Width == 0)
+        ReadImageSize(GetFullPath(hFile), &imageSize);
+
+    return imageSize;
+}
+
+#ifdef _WIN32
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetLargeThumbnail
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+HBITMAP
+CFileList::GetLargeThumbnail(
+    const fs::path& fullPath
+)
+{
+    HBITMAP hBitmap = NULL;
+
+    CComPtr<IShellItem> pItem;
+    HRESULT hr = ::SHCreateItemFromParsingName(fullPath.c_str(), nullptr, IID_PPV_ARGS(&pItem));
+    if (FAILED(hr))
+    {
+        // "This should never happen"
+        DebugPrint(L"SHCreateItemFromParsingName failed for %s\n", fullPath.c_str());
+        return NULL;
+    }
+
+    CComPtr<IShellItemImageFactory> pImageFactory;
+    hr = pItem->QueryInterface(IID_PPV_ARGS(&pImageFactory));
+    if (SUCCEEDED(hr))
+    {
+        hr = pImageFactory->GetImage({256, 256},
+                                     SIIGBF_ICONBACKGROUND,
+                                     &hBitmap);
+        if (FAILED(hr) && hBitmap != NULL)
+        {
+            // This seems like a very unlikely case (FAILED yet returned a bitmap),
+            // but we don't want to leak GDI handles, so we're going to deal with it.
+            ::DeleteObject(hBitmap);
+            hBitmap = NULL;
+        }
+    }
+
+    return hBitmap;
+}
+
+#endif // _WIN32
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::Find
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CFileList::iterator
+CFileList::Find(
+    const fs::path& path
+)
+{
+    FileHandle hFile = Lookup(path);
+    return (hFile != InvalidFileHandle) ? iat(m_FileInfo[hFile].m_ListIndex) : end();
+}
+
+CFileList::iterator
+CFileList::Find(
+    FileHandle hFile
+)
+{
+    // File records know their own position.
+    if (IsValid(hFile))
+        return iat(m_FileInfo[hFile].m_ListIndex);
+    return end();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::Lookup
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle
+CFileList::Lookup(
+    const fs::path& path
+)
+const
+{
+    if (m_Files.empty())
+        return InvalidFileHandle;
+
+    const std::wstring& pathString = GetPathString(path);
+
+    std::wstring_view dirPath, fileName;
+    SplitPath(pathString, &dirPath, &fileName);
+
+    // If the directory isn't known, neither is the file.
+    DirectoryId dirId = FindDirectory(dirPath);
+    if (dirId == InvalidDirectoryId)
+        return InvalidFileHandle;
+
+    if (m_Index.empty())
+        RebuildIndex();
+
+    return m_Index[FindIndexSlot(dirId, fileName, HashFile(dirId, fileName))];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::LookupDirectory
+//  CFileList::FindDirectory
+//
+//////////////////////////////////////////////////////////////////////////////
+
+DirectoryId
+CFileList::LookupDirectory(
+    const fs::path& path
+)
+const
+{
+    std::wstring dirPath = GetPathString(path);
+
+    // Interned directories include the trailing separator.
+    if (!dirPath.empty() && dirPath.back() != L'\\' && dirPath.back() != L'/')
+        dirPath.push_back(L'\\');
+
+    return FindDirectory(dirPath);
+}
+
+DirectoryId
+CFileList::FindDirectory(
+    std::wstring_view dirPath
+)
+const
+{
+    if (m_Directories.empty())
+        return InvalidDirectoryId;
+
+    if (m_DirectoryIndex.empty())
+        RebuildDirectoryIndex();
+
+    return m_DirectoryIndex[FindDirectorySlot(dirPath, HashPath(dirPath))];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::Add
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CFileList::iterator
+CFileList::Add(
+    const fs::path& path,
+    bool recurseIntoSubdirs /*= false*/
+)
+{
+    if (fs::is_regular_file(path))
+    {
+        return AddIfNew(path);
+    }
+
+    if (fs::is_directory(path))
+    {
+        // Scan directory tree with a pool of threads. Deterministic
+        // order, so adding the same tree twice gives the same list.
+        CDirectoryScanner scanner(0, true);
+        return AddDirectory(path, recurseIntoSubdirs, scanner);
+    }
+
+    return end();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::AddDirectory
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CFileList::iterator
+CFileList::AddDirectory(
+    const fs::path& path,
+    bool recurseIntoSubdirs,
+    CDirectoryScanner& scanner
+)
+{
+    // Keep track of the index of the first file added, so we can create
+    // an iterator when we're done. Can't create the iterator while adding
+    // files because the next push_back() would invalidate it.
+    size_t firstFileAdded = (size_t) -1;
+
+    // Only image files. The filter runs on the scanner's worker threads.
+    scanner.SetFileFilter([] (const fs::path& filePath) { return IsValidImageFile(filePath); });
+
+    scanner.Scan(path,
+                 recurseIntoSubdirs,
+                 /*LAMBDA*/ [this, &firstFileAdded] (CDirectoryScanner::FileBatch& batch)
+                 {
+                     for (const fs::path& filePath: batch)
+                     {
+                         // Not AddIfNew() != end(): end() may be taken before
+                         // the add moves the list.
+                         size_t fileCount = m_Files.size();
+                         AddIfNew(filePath);
+
+                         if (m_Files.size() != fileCount && firstFileAdded == (size_t) -1)
+                             firstFileAdded = fileCount;
+                     }
+                     return true;
+                 });
+
+    return (firstFileAdded != (size_t) -1) ? iat(firstFileAdded) : end();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::AddIfNew
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CFileList::iterator
+CFileList::AddIfNew(
+    const fs::path& path
+)
+{
+    const std::wstring& pathString = GetPathString(path);
+
+    std::wstring_view dirPath, fileName;
+    SplitPath(pathString, &dirPath, &fileName);
+
+    // Windows paths are limited to 32K characters.
+    if (dirPath.size() > UINT16_MAX || fileName.size() > UINT16_MAX)
+        return end();
+
+    // Check if file already exists.
+    if (Lookup(path) != InvalidFileHandle)
+        return end();
+
+    DirectoryId dirId = InternDirectory(dirPath);
+
+    // Get a file record (recycle one if possible).
+    FileHandle hFile;
+    if (!m_FreeHandles.empty())
+    {
+        hFile = m_FreeHandles.back();
+        m_FreeHandles.pop_back();
+    }
+    else
+    {
+        hFile = (FileHandle) m_FileInfo.size();
+        m_FileInfo.emplace_back();
+    }
+
+    // Precomputed sort keys don't cover the new file.
+    m_SortKeys.clear();
+
+    if (hFile < m_FileStats.size())
+        m_FileStats[hFile] = CFileStat();
+
+    CFileInfo& fileInfo = m_FileInfo[hFile];
+    fileInfo.m_pFileName   = m_Strings.Add(fileName);
+    fileInfo.m_DirectoryId = dirId;
+    fileInfo.m_ListIndex   = (uint32_t) m_Files.size();
+    fileInfo.m_NameLength  = (uint16_t) fileName.size();
+    fileInfo.m_StemLength  = (uint16_t) GetStemLength(fileName);
+    fileInfo.m_AddStamp    = m_AddCount++;
+
+    m_Files.push_back(hFile);
+
+    AddToIndex(hFile);
+
+    return m_Files.end() - 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::InternDirectory
+//
+//////////////////////////////////////////////////////////////////////////////
+
+DirectoryId
+CFileList::InternDirectory(
+    std::wstring_view dirPath
+)
+{
+    DirectoryId dirId = FindDirectory(dirPath);
+    if (dirId != InvalidDirectoryId)
+        return dirId;
+
+    // Intern the parent directory first, so parent ids
+    // are always less than the ids of their children.
+    DirectoryId parentId = InvalidDirectoryId;
+    if (dirPath.size() > 1)
+    {
+        size_t pos = dirPath.find_last_of(L"\\/", dirPath.size() - 2);
+        if (pos != std::wstring_view::npos)
+            parentId = InternDirectory(dirPath.substr(0, pos + 1));
+    }
+
+    // Keep load factor at or below 50%.
+    if (((m_Directories.size() + 1) * 2) > m_DirectoryIndex.size())
+        RebuildDirectoryIndex();
+
+    dirId = (DirectoryId) m_Directories.size();
+
+    CDirectoryInfo dirInfo;
+    dirInfo.m_pPath      = m_Strings.Add(dirPath);
+    dirInfo.m_ParentId   = parentId;
+    dirInfo.m_PathLength = (uint16_t) dirPath.size();
+    m_Directories.push_back(dirInfo);
+
+    m_DirectoryIndex[FindDirectorySlot(dirPath, HashPath(dirPath))] = dirId;
+
+    return dirId;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::UpdateListIndexes
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::UpdateListIndexes(
+    size_t firstIndex /*= 0*/
+)
+{
+    for (size_t idx = firstIndex; idx < m_Files.size(); idx++)
+        m_FileInfo[m_Files[idx]].m_ListIndex = (uint32_t) idx;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::FindDirectorySlot
+//  CFileList::FindIndexSlot
+//  CFileList::AddToIndex
+//  CFileList::RemoveFromIndex
+//  CFileList::RebuildIndex
+//  CFileList::RebuildDirectoryIndex
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CFileList::FindDirectorySlot(
+    std::wstring_view dirPath,
+    size_t hash
+)
+const
+{
+    ATLASSERT(!m_DirectoryIndex.empty());
+
+    const size_t mask = m_DirectoryIndex.size() - 1;
+
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        DirectoryId dirId = m_DirectoryIndex[slot];
+
+        if (dirId == InvalidDirectoryId ||
+            PathsEqual(m_Directories[dirId].GetPath(), dirPath))
+        {
+            return slot;
+        }
+    }
+}
+
+size_t
+CFileList::FindIndexSlot(
+    DirectoryId dirId,
+    std::wstring_view fileName,
+    size_t hash
+)
+const
+{
+    ATLASSERT(!m_Index.empty());
+
+    const size_t mask = m_Index.size() - 1;
+
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        FileHandle hFile = m_Index[slot];
+
+        if (hFile == InvalidFileHandle)
+            return slot;
+
+        const CFileInfo& fileInfo = m_FileInfo[hFile];
+
+        if (fileInfo.m_DirectoryId == dirId &&
+            PathsEqual(fileInfo.GetFileName(), fileName))
+        {
+            return slot;
+        }
+    }
+}
+
+void
+CFileList::AddToIndex(
+    FileHandle hFile
+)
+{
+    // Keep load factor at or below 50%.
+    // Rebuilding the index also adds the new file.
+    if ((m_Files.size() * 2) > m_Index.size())
+    {
+        RebuildIndex();
+        return;
+    }
+
+    const CFileInfo& fileInfo = m_FileInfo[hFile];
+
+    size_t slot = FindIndexSlot(fileInfo.m_DirectoryId,
+                                fileInfo.GetFileName(),
+                                HashFile(fileInfo.m_DirectoryId, fileInfo.GetFileName()));
+
+    ATLASSERT(m_Index[slot] == InvalidFileHandle);
+
+    m_Index[slot] = hFile;
+}
+
+void
+CFileList::RemoveFromIndex(
+    FileHandle hFile
+)
+{
+    if (m_Index.empty())
+        RebuildIndex();
+
+    const CFileInfo& fileInfo = m_FileInfo[hFile];
+
+    size_t slot = FindIndexSlot(fileInfo.m_DirectoryId,
+                                fileInfo.GetFileName(),
+                                HashFile(fileInfo.m_DirectoryId, fileInfo.GetFileName()));
+
+    if (m_Index[slot] != hFile)
+    {
+        ATLASSERT(false);   // "This should never happen"
+        return;
+    }
+
+    // Backward shift deletion. Move later entries in the probe sequence
+    // into the hole, so lookups never need to skip over deleted slots.
+
+    const size_t mask = m_Index.size() - 1;
+
+    size_t hole = slot;
+
+    for (size_t next = (hole + 1) & mask; m_Index[next] != InvalidFileHandle; next = (next + 1) & mask)
+    {
+        const CFileInfo& nextInfo = m_FileInfo[m_Index[next]];
+
+        size_t home = HashFile(nextInfo.m_DirectoryId, nextInfo.GetFileName()) & mask;
+
+        // Can the entry at "next" be moved to "hole"? Only if its home
+        // slot isn't cyclically within (hole, next].
+        bool homeInRange = (hole <= next) ? (hole < home && home <= next)
+                                          : (hole < home || home <= next);
+        if (!homeInRange)
+        {
+            m_Index[hole] = m_Index[next];
+            hole = next;
+        }
+    }
+
+    m_Index[hole] = InvalidFileHandle;
+}
+
+void
+CFileList::RebuildIndex()
+const
+{
+    // Size for a load factor of 25% or less, so there's room to grow.
+    size_t newSize = 1024;
+    while (newSize < m_Files.size() * 4)
+        newSize *= 2;
+
+    m_Index.assign(newSize, InvalidFileHandle);
+
+    for (FileHandle hFile: m_Files)
+    {
+        const CFileInfo& fileInfo = m_FileInfo[hFile];
+
+        size_t slot = FindIndexSlot(fileInfo.m_DirectoryId,
+                                    fileInfo.GetFileName(),
+                                    HashFile(fileInfo.m_DirectoryId, fileInfo.GetFileName()));
+        m_Index[slot] = hFile;
+    }
+}
+
+void
+CFileList::RebuildDirectoryIndex()
+const
+{
+    // Size for a load factor of 25% or less (counting a directory
+    // that's about to be added), so there's room to grow.
+    size_t newSize = 64;
+    while (newSize < (m_Directories.size() + 1) * 4)
+        newSize *= 2;
+
+    m_DirectoryIndex.assign(newSize, InvalidDirectoryId);
+
+    for (DirectoryId dirId = 0; dirId < m_Directories.size(); dirId++)
+    {
+        std::wstring_view dirPath = m_Directories[dirId].GetPath();
+        m_DirectoryIndex[FindDirectorySlot(dirPath, HashPath(dirPath))] = dirId;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::Sort
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::Sort(
+    FileSortOrder order /*= SORT_DisplayName*/,
+    bool naturalOrder /*= true*/
+)
+{
+    if (order == SORT_DisplayName && naturalOrder && !m_SortKeys.empty())
+    {
+        // Use the precomputed ranks (from the playlist index).
+        std::sort(std::execution::par,
+                  m_Files.begin(),
+                  m_Files.end(),
+                  [this] (const FileHandle h1, const FileHandle h2)
+                  {
+                      return m_SortKeys[h1] < m_SortKeys[h2];
+                  });
+    }
+    else
+    {
+        SortFiles(m_Files, order, naturalOrder);
+    }
+
+    UpdateListIndexes();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::SortFiles
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::SortFiles(
+    std::vector<FileHandle>& files,
+    FileSortOrder order,
+    bool naturalOrder
+)
+const
+{
+    PrefetchSortInfo(order);
+
+    bool compareNames = (order == SORT_DisplayName || order == SORT_FullPath);
+
+    if (compareNames)
+        BuildCollationKeys(naturalOrder);
+
+    // Rank the directories, so files in different directories can be
+    // compared without looking at the directory paths. There are far
+    // fewer directories than files.
+    std::vector<uint32_t> dirRank;
+
+    if (order == SORT_FullPath)
+    {
+        std::vector<std::wstring> dirKeys(m_Directories.size());
+        for (size_t dirId = 0; dirId < m_Directories.size(); dirId++)
+            AppendCollationKey(dirKeys[dirId], m_Directories[dirId].GetPath(), naturalOrder);
+
+        std::vector<DirectoryId> dirOrder(m_Directories.size());
+        std::iota(dirOrder.begin(), dirOrder.end(), (DirectoryId) 0);
+        std::sort(dirOrder.begin(),
+                  dirOrder.end(),
+                  [&dirKeys] (const DirectoryId d1, const DirectoryId d2)
+                  {
+                      return dirKeys[d1] < dirKeys[d2];
+                  });
+
+        dirRank.resize(m_Directories.size());
+        for (size_t rank = 0; rank < dirOrder.size(); rank++)
+            dirRank[dirOrder[rank]] = (uint32_t) rank;
+    }
+
+    // Reduce each file to a 64-bit key, plus its position in the
+    // list to break ties. Only files with the same key need any
+    // further comparison (of the full collation keys).
+    struct SortEntry
+    {
+        uint64_t m_Key;
+        FileHandle m_hFile;
+        uint32_t m_Position;
+    };
+
+    std::vector<SortEntry> entries(files.size());
+
+    for (size_t idx = 0; idx < files.size(); idx++)
+    {
+        FileHandle hFile = files[idx];
+        SortEntry& entry = entries[idx];
+
+        entry.m_hFile = hFile;
+        entry.m_Position = (uint32_t) idx;
+
+        switch (order)
+        {
+            case SORT_DisplayName:
+                entry.m_Key = GetCollationPrefix(m_CollationKeys[hFile]);
+                break;
+
+            case SORT_FullPath:
+                entry.m_Key = ((uint64_t) dirRank[m_FileInfo[hFile].m_DirectoryId] << 32) |
+                              (GetCollationPrefix(m_CollationKeys[hFile]) >> 32);
+                break;
+
+            case SORT_LastWriteTime:
+                // Flip the sign bit, so signed order is unsigned order.
+                entry.m_Key = (uint64_t) m_FileStats[hFile].m_LastWriteTime ^ (1ULL << 63);
+                break;
+
+            case SORT_FileSize:
+                entry.m_Key = m_FileStats[hFile].m_Size;
+                break;
+
+            case SORT_ImageDimensions:
+                entry.m_Key = (uint64_t) m_ImageSizes[hFile].m_Width * m_ImageSizes[hFile].m_Height;
+                break;
+
+            default:
+                ATLASSERT(false);
+                entry.m_Key = 0;
+                break;
+        }
+    }
+
+    std::sort(std::execution::par,
+              entries.begin(),
+              entries.end(),
+              [this, order, compareNames] (const SortEntry& e1, const SortEntry& e2)
+              {
+                  if (e1.m_Key != e2.m_Key)
+                      return e1.m_Key < e2.m_Key;
+
+                  if (compareNames)
+                  {
+                      int result = m_CollationKeys[e1.m_hFile].compare(m_CollationKeys[e2.m_hFile]);
+
+                      // Same directory and display name. Compare extensions.
+                      if (result == 0 && order == SORT_FullPath)
+                      {
+                          const CFileInfo& file1 = m_FileInfo[e1.m_hFile];
+                          const CFileInfo& file2 = m_FileInfo[e2.m_hFile];
+                          result = CompareNoCase(file1.GetFileName().substr(file1.m_StemLength),
+                                                 file2.GetFileName().substr(file2.m_StemLength));
+                      }
+
+                      if (result != 0)
+                          return result < 0;
+                  }
+
+                  return e1.m_Position < e2.m_Position;
+              });
+
+    for (size_t idx = 0; idx < files.size(); idx++)
+        files[idx] = entries[idx].m_hFile;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::BuildCollationKeys
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::BuildCollationKeys(
+    bool naturalOrder
+)
+const
+{
+    if (naturalOrder != m_NaturalCollation)
+    {
+        m_CollationKeys.clear();
+        m_CollationKeyStrings.clear();
+        m_NaturalCollation = naturalOrder;
+    }
+
+    m_CollationKeys.resize(m_FileInfo.size());
+
+    std::wstring key;
+
+    for (FileHandle hFile: m_Files)
+    {
+        if (m_CollationKeys[hFile].data() != nullptr)
+            continue;
+
+        key.clear();
+        AppendCollationKey(key, m_FileInfo[hFile].GetDisplayName(), naturalOrder);
+        m_CollationKeys[hFile] = std::wstring_view(m_CollationKeyStrings.Add(key), key.size());
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::PrefetchSortInfo
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::PrefetchSortInfo(
+    FileSortOrder order
+)
+const
+{
+    // Each file only touches its own record, so the
+    // files can be queried on the thread pool.
+    switch (order)
+    {
+        case SORT_LastWriteTime:
+        case SORT_FileSize:
+            if (m_FileStats.size() < m_FileInfo.size())
+                m_FileStats.resize(m_FileInfo.size(), CFileStat());
+
+            std::for_each(std::execution::par,
+                          m_Files.begin(),
+                          m_Files.end(),
+                          [this] (const FileHandle hFile)
+                          {
+                              if (!m_FileStats[hFile].IsKnown())
+                                  m_FileStats[hFile] = StatFile(GetFullPath(hFile));
+                          });
+            break;
+
+        case SORT_ImageDimensions:
+            if (m_ImageSizes.size() < m_FileInfo.size())
+                m_ImageSizes.resize(m_FileInfo.size(), CImageSize());
+
+            std::for_each(std::execution::par,
+                          m_Files.begin(),
+                          m_Files.end(),
+                          [this] (const FileHandle hFile)
+                          {
+                              if (m_ImageSizes[hFile].m_Width == 0)
+                                  ReadImageSize(GetFullPath(hFile), &m_ImageSizes[hFile]);
+                          });
+            break;
+
+        default:
+            break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetDisplayNameRanks
+//
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint32_t>
+CFileList::GetDisplayNameRanks()
+const
+{
+    // Same ordering as Sort().
+    std::vector<FileHandle> sortedFiles = m_Files;
+    SortFiles(sortedFiles, SORT_DisplayName, true);
+
+    std::vector<uint32_t> ranks(m_Files.size());
+    for (size_t rank = 0; rank < sortedFiles.size(); rank++)
+        ranks[m_FileInfo[sortedFiles[rank]].m_ListIndex] = (uint32_t) rank;
+
+    return ranks;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::Shuffle
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::Shuffle()
+{
+    std::random_device seed;
+    std::mt19937 rng(seed());
+    std::shuffle(m_Files.begin(), m_Files.end(), rng);
+
+    UpdateListIndexes();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetRandom
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle
+CFileList::GetRandom()
+{
+    ATLASSERT(!m_Files.empty());
+    std::random_device seed;
+    std::mt19937 rng(seed());
+    return m_Files[rng() % m_Files.size()];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::GetMemoryUsage
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CFileList::GetMemoryUsage()
+const
+{
+    return m_Files.capacity()          * sizeof(FileHandle) +
+           m_FileInfo.capacity()       * sizeof(CFileInfo) +
+           m_FreeHandles.capacity()    * sizeof(FileHandle) +
+           m_Directories.capacity()    * sizeof(CDirectoryInfo) +
+           m_Index.capacity()          * sizeof(FileHandle) +
+           m_DirectoryIndex.capacity() * sizeof(DirectoryId) +
+           m_SortKeys.capacity()       * sizeof(uint32_t) +
+           m_FileStats.capacity()      * sizeof(CFileStat) +
+           m_ImageSizes.capacity()     * sizeof(CImageSize) +
+           m_CollationKeys.capacity()  * sizeof(std::wstring_view) +
+           m_Strings.GetMemoryUsage() +
+           m_CollationKeyStrings.GetMemoryUsage();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::clear
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::clear()
+noexcept
+{
+    // Remove all files from the file list.
+    // Called by dtor, and can also be called by application.
+
+    m_Files.clear();
+    m_Files.shrink_to_fit();
+
+    m_FileInfo.clear();
+    m_FileInfo.shrink_to_fit();
+
+    m_FreeHandles.clear();
+    m_FreeHandles.shrink_to_fit();
+
+    m_Directories.clear();
+    m_Directories.shrink_to_fit();
+
+    m_Index.clear();
+    m_Index.shrink_to_fit();
+
+    m_DirectoryIndex.clear();
+    m_DirectoryIndex.shrink_to_fit();
+
+    m_SortKeys.clear();
+    m_SortKeys.shrink_to_fit();
+
+    m_FileStats.clear();
+    m_FileStats.shrink_to_fit();
+
+    m_ImageSizes.clear();
+    m_ImageSizes.shrink_to_fit();
+
+    m_CollationKeys.clear();
+    m_CollationKeys.shrink_to_fit();
+
+    m_Strings.clear();
+    m_CollationKeyStrings.clear();
+
+    m_ClearAddCount = m_AddCount;
+
+    m_hCurrentFile = InvalidFileHandle;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::Remove
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CFileList::Remove(
+    iterator it
+)
+{
+    FileHandle hFile = *it;
+
+    size_t listIndex = m_FileInfo[hFile].m_ListIndex;
+
+    RemoveFromIndex(hFile);
+    FreeFileInfo(hFile);
+
+    m_Files.erase(it);
+
+    // Files after the removed one have moved down by one.
+    UpdateListIndexes(listIndex);
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::RemoveIf
+//
+//////////////////////////////////////////////////////////////////////////////
+
+template <typename Predicate>
+size_t
+CFileList::RemoveIf(
+    Predicate shouldRemove
+)
+{
+    // Make sure the index exists first, because m_Files
+    // is inconsistent until the pass is complete.
+    if (m_Index.empty())
+        RebuildIndex();
+
+    // Stable compaction: kept files stay in the same order.
+    size_t keepCount = 0;
+
+    for (size_t idx = 0; idx < m_Files.size(); idx++)
+    {
+        FileHandle hFile = m_Files[idx];
+
+        if (shouldRemove(hFile))
+        {
+            RemoveFromIndex(hFile);
+            FreeFileInfo(hFile);
+        }
+        else
+        {
+            m_Files[keepCount++] = hFile;
+        }
+    }
+
+    size_t removeCount = m_Files.size() - keepCount;
+
+    if (removeCount != 0)
+    {
+        m_Files.resize(keepCount);
+        UpdateListIndexes();
+    }
+
+    return removeCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::RemoveMany
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CFileList::RemoveMany(
+    const std::vector<FileHandle>& files
+)
+{
+    // Mark the files to be removed (by handle).
+    std::vector<bool> removeFile(m_FileInfo.size(), false);
+    size_t markCount = 0;
+
+    for (FileHandle hFile: files)
+    {
+        if (IsValid(hFile) && !removeFile[hFile])
+        {
+            removeFile[hFile] = true;
+            markCount++;
+        }
+    }
+
+    if (markCount == 0)
+        return 0;
+
+    return RemoveIf(
+        /*LAMBDA*/ [&removeFile] (FileHandle hFile)
+        {
+            return removeFile[hFile];
+        }
+    );
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::RemoveFolder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CFileList::RemoveFolder(
+    const fs::path& path,
+    bool recurseIntoSubdirs /*= false*/
+)
+{
+    DirectoryId folderId = LookupDirectory(path);
+
+    if (folderId == InvalidDirectoryId)
+        return 0;
+
+    // Mark the directories whose files are to be removed. Parents always
+    // have smaller ids than their children, so a single pass in id order
+    // finds all the subdirectories.
+    std::vector<bool> removeDir(m_Directories.size(), false);
+    removeDir[folderId] = true;
+
+    if (recurseIntoSubdirs)
+    {
+        for (DirectoryId dirId = folderId + 1; dirId < m_Directories.size(); dirId++)
+        {
+            DirectoryId parentId = m_Directories[dirId].m_ParentId;
+            if (parentId != InvalidDirectoryId && removeDir[parentId])
+                removeDir[dirId] = true;
+        }
+    }
+
+    // Remove the files in a single pass over the list.
+    return RemoveIf(
+        /*LAMBDA*/ [this, &removeDir] (FileHandle hFile)
+        {
+            return removeDir[m_FileInfo[hFile].m_DirectoryId];
+        }
+    );
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList::FreeFileInfo
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CFileList::FreeFileInfo(
+    FileHandle hFile
+)
+{
+    // Recycle the file record. The file name string stays
+    // in the arena until the list is cleared.
+    m_FileInfo[hFile].m_pFileName = nullptr;
+
+    // The handle will be recycled, so it can't stay current.
+    if (hFile == m_hCurrentFile)
+        m_hCurrentFile = InvalidFileHandle;
+
+    if (hFile < m_FileStats.size())
+        m_FileStats[hFile] = CFileStat();
+    if (hFile < m_ImageSizes.size())
+        m_ImageSizes[hFile] = CImageSize();
+    if (hFile < m_CollationKeys.size())
+        m_CollationKeys[hFile] = std::wstring_view();
+    m_FreeHandles.push_back(hFile);
+}
@@ -0,0 +1,940 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileList.h
+//
+//  CFileInfo and CFileList classes.
+//
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "FileHandle.h"
+
+class CDirectoryScanner;
+class CPlayListIndex;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CStringArena
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Append-only string storage. Strings are packed into large blocks, rather
+// than each being a separate heap allocation, and never move once added.
+// Memory is only released when the whole arena is cleared.
+class CStringArena
+{
+    public:
+
+        CStringArena()
+            :
+            m_Blocks(),
+            m_BlockUsed(BlockSize),
+            m_MappedFiles()
+        {
+        }
+
+        // No copy ctor.
+        CStringArena(const CStringArena&) = delete;
+
+        // No copy assignment.
+        CStringArena& operator=(const CStringArena&) = delete;
+
+        // Move ctor.
+        CStringArena(CStringArena&& that) noexcept
+            :
+            m_Blocks(std::move(that.m_Blocks)),
+            m_BlockUsed(that.m_BlockUsed),
+            m_MappedFiles(std::move(that.m_MappedFiles))
+        {
+            that.m_BlockUsed = BlockSize;
+        }
+
+        // Move assignment.
+        CStringArena& operator=(CStringArena&& that) noexcept
+        {
+            if (this != &that)
+            {
+                m_Blocks = std::move(that.m_Blocks);
+                m_BlockUsed = that.m_BlockUsed;
+                m_MappedFiles = std::move(that.m_MappedFiles);
+                that.m_BlockUsed = BlockSize;
+            }
+            return *this;
+        }
+
+        // Add string to the arena.
+        // Returns pointer to null terminated copy of the string.
+        LPCWSTR
+        Add(
+            std::wstring_view str
+        );
+
+        // Keep a mapped file alive for as long as the arena, so strings
+        // can be used directly from the file instead of being copied.
+        void
+        AddMappedFile(
+            CMappedFile&& file
+        )
+        {
+            m_MappedFiles.push_back(std::move(file));
+        }
+
+        // Release all strings.
+        void
+        clear() noexcept
+        {
+            m_Blocks.clear();
+            m_Blocks.shrink_to_fit();
+            m_BlockUsed = BlockSize;
+            m_MappedFiles.clear();
+            m_MappedFiles.shrink_to_fit();
+        }
+
+        // Get number of bytes allocated by the arena.
+        // (Doesn't include mapped files.)
+        size_t
+        GetMemoryUsage() const
+        {
+            return m_Blocks.size() * BlockSize * sizeof(WCHAR);
+        }
+
+    private:
+
+        // Block size in characters (128 KB).
+        static const size_t BlockSize = 64 * 1024;
+
+        // Blocks. Strings longer than BlockSize get a block of their own.
+        std::vector<std::unique_ptr<WCHAR[]>> m_Blocks;
+
+        // Number of characters used in the last block.
+        size_t m_BlockUsed;
+
+        // Mapped files containing strings.
+        std::vector<CMappedFile> m_MappedFiles;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileStat
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// File size and last write time.
+struct CFileStat
+{
+    // m_LastWriteTime if the file hasn't been stat'ed yet.
+    static constexpr int64_t UnknownTime = 0;
+
+    // m_LastWriteTime if the file couldn't be stat'ed (e.g. it's
+    // missing). Sorts before any real time.
+    static constexpr int64_t FailedTime = INT64_MIN;
+
+    // File size in bytes.
+    uint64_t m_Size;
+
+    // Last write time (fs::file_time_type ticks), UnknownTime, or FailedTime.
+    int64_t m_LastWriteTime;
+
+    // Has the file been stat'ed (successfully or not)?
+    bool
+    IsKnown() const
+    {
+        return m_LastWriteTime != UnknownTime;
+    }
+
+    bool
+    IsFailed() const
+    {
+        return m_LastWriteTime == FailedTime;
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageSize
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Image dimensions in pixels.
+struct CImageSize
+{
+    // Width. Zero if unknown.
+    uint32_t m_Width;
+
+    // Height. Zero if unknown.
+    uint32_t m_Height;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileSortOrder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Sort order for CFileList::Sort().
+enum FileSortOrder
+{
+    // Display name (file name without extension), ignoring directories.
+    SORT_DisplayName = 0,
+
+    // Directory, then file name.
+    SORT_FullPath = 1,
+
+    // Last write time, oldest first.
+    SORT_LastWriteTime = 2,
+
+    // File size, smallest first.
+    SORT_FileSize = 3,
+
+    // Image size (number of pixels), smallest first.
+    SORT_ImageDimensions = 4,
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryId
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Id of an interned directory in a CFileList. Files in the same directory
+// share the same directory id. Ids are never reused while the list exists.
+using DirectoryId = uint32_t;
+
+// Invalid DirectoryId value.
+const DirectoryId InvalidDirectoryId = (DirectoryId) -1;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CDirectoryInfo
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Directory information.
+// Directories form a tree (trie of path prefixes): each directory refers
+// to its parent, which is always interned first, so a parent's id is
+// always less than the ids of its children.
+class CDirectoryInfo
+{
+    public:
+
+        // Get directory path (including the trailing separator).
+        std::wstring_view
+        GetPath() const
+        {
+            return std::wstring_view(m_pPath, m_PathLength);
+        }
+
+        // Get parent directory id.
+        // InvalidDirectoryId if this is a root directory.
+        DirectoryId
+        GetParentId() const
+        {
+            return m_ParentId;
+        }
+
+    private:
+
+        friend class CFileList;
+        friend class CPlayListIndexFormat;
+
+        // Directory path (null terminated, in CFileList string arena).
+        LPCWSTR m_pPath;
+
+        // Parent directory.
+        DirectoryId m_ParentId;
+
+        // Directory path length.
+        uint16_t m_PathLength;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileInfo
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// File information.
+// Compact record owned by a CFileList. The file is stored as a directory id
+// plus a file name, so the directory prefix is only stored once per directory.
+class CFileInfo
+{
+    public:
+
+        // Get directory containing the file.
+        DirectoryId
+        GetDirectoryId() const
+        {
+            return m_DirectoryId;
+        }
+
+        // Get file name (without directory).
+        std::wstring_view
+        GetFileName() const
+        {
+            return std::wstring_view(m_pFileName, m_NameLength);
+        }
+
+        // Get display name for the file.
+        std::wstring_view
+        GetDisplayName() const
+        {
+            // There is a CPU vs memory tradeoff with the display name.
+            // The name was originally generated by GetDisplayName()
+            // on every call, which saved memory and was performant
+            // for purposes of displaying the names in the listview.
+            // But then I tried to sort the playlist by display name,
+            // and it was 100X slower than sorting by full path.
+            // So now the display name (the file stem) is located by
+            // CFileList when the file is added, and kept as a view
+            // into the file name. Same speed, no extra string.
+
+            return std::wstring_view(m_pFileName, m_StemLength);
+        }
+
+    private:
+
+        friend class CFileList;
+        friend class CPlayListIndexFormat;
+
+        // File name (null terminated, in CFileList string arena).
+        // nullptr if this record is unused.
+        LPCWSTR m_pFileName;
+
+        // Directory containing the file.
+        DirectoryId m_DirectoryId;
+
+        // Position of this file in the CFileList that owns it.
+        // Maintained by CFileList, so finding a file doesn't
+        // require a search.
+        uint32_t m_ListIndex;
+
+        // File name length.
+        uint16_t m_NameLength;
+
+        // Display name (stem) length. Display name is a prefix of the file name.
+        uint16_t m_StemLength;
+
+        // Number of files added to the list before this one
+        // (see CFileList::GetAddStamp()).
+        uint32_t m_AddStamp;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFileList
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// File list (in memory).
+// Doesn't use any Windows APIs, except for the thumbnails and the case
+// folding of non-ASCII characters (see Portable.h).
+class CFileList
+{
+    protected:
+
+        friend class CPlayListIndex;
+        friend class CPlayListIndexFormat;
+
+        using ContainerType = std::vector<FileHandle>;
+
+        // Files in list order.
+        ContainerType m_Files;
+
+        // File records, indexed by FileHandle.
+        // Records of removed files are recycled via m_FreeHandles.
+        std::vector<CFileInfo> m_FileInfo;
+
+        // Handles of unused m_FileInfo records.
+        std::vector<FileHandle> m_FreeHandles;
+
+        // Interned directories, indexed by DirectoryId.
+        std::vector<CDirectoryInfo> m_Directories;
+
+        // Storage for file name and directory path strings.
+        CStringArena m_Strings;
+
+        // Case-insensitive file hash index. Open addressing hash table
+        // (linear probing) of FileHandles, keyed by directory id and file
+        // name, so finding a file by path doesn't require walking the whole
+        // list. Windows file names are case insensitive, so "C:\Foo.jpg" and
+        // "c:\FOO.JPG" are the same file. Size is always zero or a power of two.
+        // Built on first use when the list is bulk loaded (see CPlayListIndex).
+        mutable std::vector<FileHandle> m_Index;
+
+        // Case-insensitive directory hash index. Same scheme as m_Index.
+        // Directories are never removed, so there are no deletions.
+        mutable std::vector<DirectoryId> m_DirectoryIndex;
+
+        // Precomputed sort keys (rank by display name), indexed by
+        // FileHandle. Empty if not available.
+        std::vector<uint32_t> m_SortKeys;
+
+        // File sizes and write times, indexed by FileHandle.
+        // Filled in on demand by GetFileStat(), or by SetFileStat().
+        mutable std::vector<CFileStat> m_FileStats;
+
+        // Image dimensions, indexed by FileHandle.
+        // Filled in on demand by GetImageSize().
+        mutable std::vector<CImageSize> m_ImageSizes;
+
+        // Collation keys for display names, indexed by FileHandle.
+        // Built on demand by Sort(), then kept until the file is removed.
+        // See BuildCollationKey() for the format.
+        mutable std::vector<std::wstring_view> m_CollationKeys;
+
+        // Storage for collation keys.
+        mutable CStringArena m_CollationKeyStrings;
+
+        // Do the collation keys use natural numeric order?
+        mutable bool m_NaturalCollation;
+
+        // Number of files ever added to the list. Not reset by clear(),
+        // so add stamps taken before a clear() stay in the past.
+        uint32_t m_AddCount;
+
+        // m_AddCount when the list was last cleared (the first file added
+        // since then has this add stamp).
+        uint32_t m_ClearAddCount;
+
+        // Current file (e.g. the one being displayed). Handles stay the
+        // same when files are added, removed, or sorted, and the file's
+        // position is in its record, so the current file doesn't need to
+        // be searched for. Reset if the file is removed.
+        FileHandle m_hCurrentFile;
+
+    public:
+
+        // Make the CFileList class act like m_Files container.
+
+        using value_type        = ContainerType::value_type;
+        using reference         = ContainerType::reference;
+        using const_reference   = ContainerType::const_reference;
+        using pointer           = ContainerType::pointer;
+        using const_pointer     = ContainerType::const_pointer;
+        using iterator          = ContainerType::iterator;
+        using const_iterator    = ContainerType::const_iterator;
+        using size_type         = ContainerType::size_type;
+
+        FORCEINLINE iterator begin() noexcept               { return m_Files.begin();     }
+        FORCEINLINE iterator end() noexcept                 { return m_Files.end();       }
+        FORCEINLINE const_iterator begin() const noexcept   { return m_Files.cbegin();    }
+        FORCEINLINE const_iterator end() const noexcept     { return m_Files.cend();      }
+        FORCEINLINE const_iterator cbegin() const noexcept  { return m_Files.cbegin();    }
+        FORCEINLINE const_iterator cend() const noexcept    { return m_Files.cend();      }
+        FORCEINLINE reference front()                       { return m_Files.front();     }
+        FORCEINLINE const_reference front() const           { return m_Files.front();     }
+        FORCEINLINE reference back()                        { return m_Files.back();      }
+        FORCEINLINE const_reference back() const            { return m_Files.back();      }
+        FORCEINLINE iterator iat(size_type idx) noexcept    { return m_Files.begin()+idx; }
+        FORCEINLINE size_type size() const noexcept         { return m_Files.size();      }
+        FORCEINLINE bool empty() const noexcept             { return m_Files.empty();     }
+        FORCEINLINE void reserve(size_type capacity)        { m_Files.reserve(capacity); m_FileInfo.reserve(capacity); }
+        void clear() noexcept;
+
+    public:
+
+        CFileList()
+            :
+            m_Files(),
+            m_FileInfo(),
+            m_FreeHandles(),
+            m_Directories(),
+            m_Strings(),
+            m_Index(),
+            m_DirectoryIndex(),
+            m_SortKeys(),
+            m_FileStats(),
+            m_ImageSizes(),
+            m_CollationKeys(),
+            m_CollationKeyStrings(),
+            m_NaturalCollation(false),
+            m_AddCount(0),
+            m_ClearAddCount(0),
+            m_hCurrentFile(InvalidFileHandle)
+        {
+        }
+
+        ~CFileList()
+        {
+            clear();
+        }
+
+        // No copy ctor.
+        CFileList(const CFileList&) = delete;
+
+        // No copy assignment.
+        CFileList& operator=(const CFileList&) = delete;
+
+        // Move ctor.
+        CFileList(CFileList&& that) noexcept
+            :
+            m_Files(std::move(that.m_Files)),
+            m_FileInfo(std::move(that.m_FileInfo)),
+            m_FreeHandles(std::move(that.m_FreeHandles)),
+            m_Directories(std::move(that.m_Directories)),
+            m_Strings(std::move(that.m_Strings)),
+            m_Index(std::move(that.m_Index)),
+            m_DirectoryIndex(std::move(that.m_DirectoryIndex)),
+            m_SortKeys(std::move(that.m_SortKeys)),
+            m_FileStats(std::move(that.m_FileStats)),
+            m_ImageSizes(std::move(that.m_ImageSizes)),
+            m_CollationKeys(std::move(that.m_CollationKeys)),
+            m_CollationKeyStrings(std::move(that.m_CollationKeyStrings)),
+            m_NaturalCollation(that.m_NaturalCollation),
+            m_AddCount(that.m_AddCount),
+            m_ClearAddCount(that.m_ClearAddCount),
+            m_hCurrentFile(that.m_hCurrentFile)
+        {
+        }
+
+        // Move assignment.
+        CFileList&
+        operator=(
+            CFileList&& that
+        )
+        noexcept
+        {
+            if (this != &that)
+            {
+                clear();
+                this->m_Files = std::move(that.m_Files);
+                this->m_FileInfo = std::move(that.m_FileInfo);
+                this->m_FreeHandles = std::move(that.m_FreeHandles);
+                this->m_Directories = std::move(that.m_Directories);
+                this->m_Strings = std::move(that.m_Strings);
+                this->m_Index = std::move(that.m_Index);
+                this->m_DirectoryIndex = std::move(that.m_DirectoryIndex);
+                this->m_SortKeys = std::move(that.m_SortKeys);
+                this->m_FileStats = std::move(that.m_FileStats);
+                this->m_ImageSizes = std::move(that.m_ImageSizes);
+                this->m_CollationKeys = std::move(that.m_CollationKeys);
+                this->m_CollationKeyStrings = std::move(that.m_CollationKeyStrings);
+                this->m_NaturalCollation = that.m_NaturalCollation;
+                this->m_AddCount = std::max(this->m_AddCount, that.m_AddCount);
+                this->m_ClearAddCount = that.m_ClearAddCount;
+                this->m_hCurrentFile = that.m_hCurrentFile;
+            }
+            return *this;
+        }
+
+        // Get file information (by handle).
+        FORCEINLINE
+        const CFileInfo&
+        GetFileInfo(
+            FileHandle hFile
+        ) const
+        {
+            ATLASSERT(IsValid(hFile));
+            return m_FileInfo[hFile];
+        }
+
+        // Get directory information (by id).
+        FORCEINLINE
+        const CDirectoryInfo&
+        GetDirectoryInfo(
+            DirectoryId dirId
+        ) const
+        {
+            ATLASSERT(dirId < m_Directories.size());
+            return m_Directories[dirId];
+        }
+
+        // Get full path of file (by handle).
+        fs::path
+        GetFullPath(
+            FileHandle hFile
+        ) const;
+
+        // Get display name of file (by handle).
+        FORCEINLINE
+        std::wstring_view
+        GetDisplayName(
+            FileHandle hFile
+        ) const
+        {
+            return GetFileInfo(hFile).GetDisplayName();
+        }
+
+        // Get case insensitive hash of the full path (by handle).
+        // Stays the same if the file is removed and added again.
+        uint64_t
+        GetPathHash(
+            FileHandle hFile
+        ) const;
+
+        // Get file size and last write time (by handle).
+        // The file system is only queried the first time.
+        const CFileStat&
+        GetFileStat(
+            FileHandle hFile
+        ) const;
+
+        // Get file size and last write time (by handle) if they're
+        // already known, without querying the file system. The time is
+        // CFileStat::UnknownTime if they aren't. They may be out of date
+        // (e.g. read from the playlist index).
+        CFileStat
+        GetKnownFileStat(
+            FileHandle hFile
+        ) const
+        {
+            ATLASSERT(IsValid(hFile));
+            return (hFile < m_FileStats.size()) ? m_FileStats[hFile] : CFileStat();
+        }
+
+        // Record a file's size and last write time (e.g. ones
+        // StatFile() got on another thread).
+        void
+        SetFileStat(
+            FileHandle hFile,
+            const CFileStat& fileStat
+        );
+
+        // Get file size and last write time from the file system.
+        // Doesn't touch the list, so it can be called on any thread.
+        static
+        CFileStat
+        StatFile(
+            const fs::path& fullPath
+        );
+
+        // Get image dimensions (by handle).
+        // The file is only read the first time.
+        const CImageSize&
+        GetImageSize(
+            FileHandle hFile
+        ) const;
+
+#ifdef _WIN32
+        // Get large (256x256) thumbnail bitmap for file using IShellItemImageFactory.
+        HBITMAP
+        GetLargeThumbnail(
+            FileHandle hFile
+        ) const
+        {
+            return GetLargeThumbnail(GetFullPath(hFile));
+        }
+
+        // Get large (256x256) thumbnail bitmap for file using IShellItemImageFactory.
+        // Doesn't touch the list, so it can be called on any thread
+        // (with COM initialized).
+        static
+        HBITMAP
+        GetLargeThumbnail(
+            const fs::path& fullPath
+        );
+#endif
+
+        // Check if handle refers to a file in the list.
+        FORCEINLINE
+        bool
+        IsValid(
+            FileHandle hFile
+        ) const
+        {
+            return hFile < m_FileInfo.size() && m_FileInfo[hFile].m_pFileName != nullptr;
+        }
+
+        // Get the handle range (all valid handles are less than this).
+        FileHandle
+        GetHandleLimit() const
+        {
+            return (FileHandle) m_FileInfo.size();
+        }
+
+        // Get the number of files added to the list before a file (by
+        // handle). Tells the files added since some point (see
+        // GetAddCount()) from the ones that were already there, even
+        // though handles are recycled.
+        uint32_t
+        GetAddStamp(
+            FileHandle hFile
+        ) const
+        {
+            return GetFileInfo(hFile).m_AddStamp;
+        }
+
+        // Get the number of files ever added to the list.
+        uint32_t
+        GetAddCount() const
+        {
+            return m_AddCount;
+        }
+
+        // Get the number of files added to the list before it was last
+        // cleared. Add stamps counted from here are the same each time
+        // the list is loaded the same way (e.g. from the same playlist).
+        uint32_t
+        GetClearAddCount() const
+        {
+            return m_ClearAddCount;
+        }
+
+        // Get the current file.
+        // Returns InvalidFileHandle if not set, or if the file was removed.
+        FORCEINLINE
+        FileHandle
+        GetCurrentFile() const
+        {
+            return m_hCurrentFile;
+        }
+
+        // Set the current file.
+        FORCEINLINE
+        void
+        SetCurrentFile(
+            FileHandle hFile
+        )
+        {
+            m_hCurrentFile = IsValid(hFile) ? hFile : InvalidFileHandle;
+        }
+
+        // Get position of file in the list (by handle).
+        // Returns size() if the file isn't in the list.
+        size_type
+        GetPosition(
+            FileHandle hFile
+        ) const
+        {
+            return IsValid(hFile) ? m_FileInfo[hFile].m_ListIndex : size();
+        }
+
+        // Find file in list (by path).
+        CFileList::iterator
+        Find(
+            const fs::path& path
+        );
+
+        // Find file in list (by handle).
+        iterator
+        Find(
+            FileHandle hFile
+        );
+
+        // Find file in list (by path).
+        // Returns InvalidFileHandle if file isn't in the list.
+        FileHandle
+        Lookup(
+            const fs::path& path
+        ) const;
+
+        // Find directory (by path).
+        // Returns InvalidDirectoryId if no file in the list was ever in the directory.
+        DirectoryId
+        LookupDirectory(
+            const fs::path& path
+        ) const;
+
+        // Check if file is in the list (by path).
+        bool
+        Contains(
+            const fs::path& path
+        ) const
+        {
+            return Lookup(path) != InvalidFileHandle;
+        }
+
+        // Add single file or entire directory to file list.
+        // Prevents duplicate files from being added to list.
+        // Returns iterator to first added file, or end() if error.
+        // Directories are scanned on the calling thread, so the UI
+        // adds them with CDirectoryImport instead.
+        iterator
+        Add(
+            const fs::path& path,           // File or directory to add.
+            bool recurseIntoSubdirs = false // Recurse into subdirectories?
+        );
+
+        // Add files found by a directory scan.
+        // Use this instead of Add() to control the scan (e.g. to cancel it).
+        // Returns iterator to first added file, or end() if no files added.
+        iterator
+        AddDirectory(
+            const fs::path& path,           // Directory to add.
+            bool recurseIntoSubdirs,        // Recurse into subdirectories?
+            CDirectoryScanner& scanner      // Scanner to use.
+        );
+
+        // Remove an entry from the file list (by path).
+        bool
+        Remove(
+            const fs::path& path    // Full path of file to remove.
+        )
+        {
+            iterator it = Find(path);
+            return (it != end()) ? Remove(it) : false;
+        }
+
+        // Remove an entry from the file list (by handle).
+        bool
+        Remove(
+            FileHandle hFile        // Handle of file to remove.
+        )
+        {
+            iterator it = Find(hFile);
+            return (it != end()) ? Remove(it) : false;
+        }
+
+        // Remove an entry from the file list (by iterator).
+        bool
+        Remove(
+            iterator it
+        );
+
+        // Remove a set of files from the file list (by handle), in a
+        // single pass over the list. Much faster than removing the files
+        // one at a time. Invalid and duplicate handles are ignored.
+        // Returns number of files removed.
+        size_t
+        RemoveMany(
+            const std::vector<FileHandle>& files
+        );
+
+        // Remove all files in a directory from the file list.
+        // Returns number of files removed.
+        size_t
+        RemoveFolder(
+            const fs::path& path,           // Directory to remove.
+            bool recurseIntoSubdirs = false // Also remove files in subdirectories?
+        );
+
+        // Sort the file list. Names are compared case insensitively,
+        // and if naturalOrder is true, numbers in names are compared by
+        // value, so "img2" sorts before "img10". Files that compare equal
+        // keep their current order.
+        void
+        Sort(
+            FileSortOrder order = SORT_DisplayName,
+            bool naturalOrder = true
+        );
+
+        // Randomly shuffle the file list.
+        void
+        Shuffle();
+
+        // Pick a random file from the list.
+        FileHandle
+        GetRandom();
+
+        // Get approximate number of bytes used by the file list.
+        size_t
+        GetMemoryUsage() const;
+
+    private:
+
+        // Add file to m_Files if it doesn't already exist.
+        // Returns iterator to added file, or end() if already exists.
+        iterator
+        AddIfNew(
+            const fs::path& path
+        );
+
+        // Remove the files for which shouldRemove(hFile) returns true,
+        // in a single pass over the list. Returns number of files removed.
+        template <typename Predicate>
+        size_t
+        RemoveIf(
+            Predicate shouldRemove
+        );
+
+        // Update m_ListIndex for files in m_Files[firstIndex...].
+        void
+        UpdateListIndexes(
+            size_t firstIndex = 0
+        );
+
+        // Find directory (by path, including trailing separator).
+        DirectoryId
+        FindDirectory(
+            std::wstring_view dirPath
+        ) const;
+
+        // Find or add directory (by path, including trailing separator).
+        // Also interns the parent directories.
+        DirectoryId
+        InternDirectory(
+            std::wstring_view dirPath
+        );
+
+        // Find slot in m_DirectoryIndex for directory path. Returns slot
+        // containing the directory (if found) or the empty slot where it
+        // would be inserted.
+        size_t
+        FindDirectorySlot(
+            std::wstring_view dirPath,
+            size_t hash
+        ) const;
+
+        // Find slot in m_Index for file. Returns slot containing the
+        // file (if found) or the empty slot where it would be inserted.
+        size_t
+        FindIndexSlot(
+            DirectoryId dirId,
+            std::wstring_view fileName,
+            size_t hash
+        ) const;
+
+        // Add file to m_Index.
+        void
+        AddToIndex(
+            FileHandle hFile
+        );
+
+        // Remove file from m_Index.
+        void
+        RemoveFromIndex(
+            FileHandle hFile
+        );
+
+        // Resize m_Index and re-insert all files.
+        void
+        RebuildIndex() const;
+
+        // Resize m_DirectoryIndex and re-insert all directories.
+        void
+        RebuildDirectoryIndex() const;
+
+        // Get rank of each file (in list order) when sorted by display name.
+        std::vector<uint32_t>
+        GetDisplayNameRanks() const;
+
+        // Sort files (a permutation of m_Files) without touching the list.
+        void
+        SortFiles(
+            std::vector<FileHandle>& files,
+            FileSortOrder order,
+            bool naturalOrder
+        ) const;
+
+        // Make sure every file in the list has a collation key.
+        void
+        BuildCollationKeys(
+            bool naturalOrder
+        ) const;
+
+        // Make sure every file in the list has the file
+        // information needed to sort in the given order.
+        // The file system is queried in parallel.
+        void
+        PrefetchSortInfo(
+            FileSortOrder order
+        ) const;
+
+        // Release file record for reuse.
+        void
+        FreeFileInfo(
+            FileHandle hFile
+        );
+};
@@ -0,0 +1,373 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  HeadlessWallpaperBackend.cpp
+//
+//  CHeadlessWallpaperBackend class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "HeadlessWallpaperBackend.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CHeadlessWallpaperBackend::CHeadlessWallpaperBackend
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CHeadlessWallpaperBackend::CHeadlessWallpaperBackend(
+    const std::vector<CWallpaperMonitor>& monitors,
+    CWallpaperCache::DecodeFunction decode,
+    const fs::path& outputPath
+) :
+    m_Monitors(monitors),
+    m_VirtualRect(),
+    m_Decode(std::move(decode)),
+    m_OutputPath(outputPath),
+    m_WallpaperFiles(monitors.size()),
+    m_BackgroundColor(0),
+    m_Position(RESIZE_Fill),
+    m_Enabled(false),
+    m_DecodedImages(),
+    m_Frame(),
+    m_FrameSize(),
+    m_NewFrame(),
+    m_MonitorPixels(),
+    m_ComposeTimes()
+{
+    ATLASSERT(!m_Monitors.empty());
+
+    m_VirtualRect = m_Monitors[0].m_Rect;
+
+    for (const CWallpaperMonitor& monitor : m_Monitors)
+    {
+        m_VirtualRect.left = std::min(m_VirtualRect.left, monitor.m_Rect.left);
+        m_VirtualRect.top = std::min(m_VirtualRect.top, monitor.m_Rect.top);
+        m_VirtualRect.right = std::max(m_VirtualRect.right, monitor.m_Rect.right);
+        m_VirtualRect.bottom = std::max(m_VirtualRect.bottom, monitor.m_Rect.bottom);
+    }
+
+    m_FrameSize = { m_VirtualRect.right - m_VirtualRect.left, m_VirtualRect.bottom - m_VirtualRect.top };
+    m_Frame.assign((size_t) m_FrameSize.cx * m_FrameSize.cy, 0xFF000000);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CHeadlessWallpaperBackend::Connect
+//  CHeadlessWallpaperBackend::Disconnect
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CHeadlessWallpaperBackend::Connect()
+{
+    return true;
+}
+
+void
+CHeadlessWallpaperBackend::Disconnect()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CHeadlessWallpaperBackend getters/setters
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CHeadlessWallpaperBackend::GetWallpaper(
+    std::wstring* pWallpaperFile
+)
+{
+    // Like the shell: nothing if the monitors don't all have the same one.
+    pWallpaperFile->clear();
+
+    if (std::all_of(m_WallpaperFiles.begin(),
+                    m_WallpaperFiles.end(),
+                    [this] (const std::wstring& wallpaperFile) { return wallpaperFile == m_WallpaperFiles[0]; }))
+    {
+        *pWallpaperFile = m_WallpaperFiles[0];
+    }
+
+    return true;
+}
+
+bool
+CHeadlessWallpaperBackend::SetWallpaper(
+    const std::wstring& wallpaperFile
+)
+{
+    return SetWallpaperFiles(std::vector<std::wstring>(m_Monitors.size(), wallpaperFile));
+}
+
+bool
+CHeadlessWallpaperBackend::GetMonitorWallpaper(
+    const std::wstring& monitorID,
+    std::wstring* pWallpaperFile
+)
+{
+    for (size_t monitorIndex = 0; monitorIndex < m_Monitors.size(); monitorIndex++)
+    {
+        if (m_Monitors[monitorIndex].m_MonitorID == monitorID)
+        {
+            *pWallpaperFile = m_WallpaperFiles[monitorIndex];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+CHeadlessWallpaperBackend::SetMonitorWallpaper(
+    const std::wstring& monitorID,
+    const std::wstring& wallpaperFile
+)
+{
+    for (size_t monitorIndex = 0; monitorIndex < m_Monitors.size(); monitorIndex++)
+    {
+        if (m_Monitors[monitorIndex].m_MonitorID == monitorID)
+        {
+            std::vector<std::wstring> wallpaperFiles = m_WallpaperFiles;
+            wallpaperFiles[monitorIndex] = wallpaperFile;
+            return SetWallpaperFiles(wallpaperFiles);
+        }
+    }
+
+    return false;
+}
+
+bool
+CHeadlessWallpaperBackend::GetBackgroundColor(
+    COLORREF* pColor
+)
+{
+    *pColor = m_BackgroundColor;
+    return true;
+}
+
+bool
+CHeadlessWallpaperBackend::SetBackgroundColor(
+    COLORREF color
+)
+{
+    m_BackgroundColor = color;
+    return Compose();
+}
+
+bool
+CHeadlessWallpaperBackend::GetPosition(
+    WallpaperResizeMode* pPosition
+)
+{
+    *pPosition = m_Position;
+    return true;
+}
+
+bool
+CHeadlessWallpaperBackend::SetPosition(
+    WallpaperResizeMode position
+)
+{
+    m_Position = position;
+    return Compose();
+}
+
+bool
+CHeadlessWallpaperBackend::Enable(
+    bool enable
+)
+{
+    m_Enabled = enable;
+    return Compose();
+}
+
+bool
+CHeadlessWallpaperBackend::GetMonitors(
+    std::vector<CWallpaperMonitor>* pMonitors
+)
+{
+    *pMonitors = m_Monitors;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CHeadlessWallpaperBackend::SetWallpaperFiles
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CHeadlessWallpaperBackend::SetWallpaperFiles(
+    const std::vector<std::wstring>& wallpaperFiles
+)
+{
+    std::vector<std::wstring> previousFiles = m_WallpaperFiles;
+    bool previousEnabled = m_Enabled;
+
+    m_WallpaperFiles = wallpaperFiles;
+    m_Enabled = true;
+
+    if (Compose())
+        return true;
+
+    // Like the shell, keep showing what we were (Compose() only replaces
+    // the frame once it's been written).
+    m_WallpaperFiles.swap(previousFiles);
+    m_Enabled = previousEnabled;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CHeadlessWallpaperBackend::Compose
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CHeadlessWallpaperBackend::Compose()
+{
+    using Clock = std::chrono::steady_clock;
+
+    m_ComposeTimes = {};
+
+    Clock::time_point startTime = Clock::now();
+
+    // Decode the wallpapers (the ones that have changed), and forget the
+    // ones that aren't shown any more.
+
+    for (const std::wstring& wallpaperFile : m_WallpaperFiles)
+    {
+        if (!m_Enabled || wallpaperFile.empty() || m_DecodedImages.count(wallpaperFile) != 0)
+            continue;
+
+        DecodedImage image = {};
+
+        if (!m_Decode(wallpaperFile, &image.m_Pixels, &image.m_Size) ||
+            image.m_Size.cx <= 0 ||
+            image.m_Size.cy <= 0 ||
+            image.m_Pixels.size() < (size_t) image.m_Size.cx * image.m_Size.cy)
+        {
+            DebugPrint(L"CHeadlessWallpaperBackend::Compose: Can't decode: %s\n", wallpaperFile.c_str());
+            return false;
+        }
+
+        m_DecodedImages[wallpaperFile] = std::move(image);
+    }
+
+    for (auto it = m_DecodedImages.begin(); it != m_DecodedImages.end(); )
+    {
+        if (std::find(m_WallpaperFiles.begin(), m_WallpaperFiles.end(), it->first) == m_WallpaperFiles.end())
+            it = m_DecodedImages.erase(it);
+        else
+            ++it;
+    }
+
+    Clock::time_point decodeTime = Clock::now();
+
+    // Fill the parts of the frame no monitor covers, like the shell does.
+
+    uint32_t backgroundPixel = 0xFF000000 |
+                               (uint32_t) GetRValue(m_BackgroundColor) << 16 |
+                               (uint32_t) GetGValue(m_BackgroundColor) << 8 |
+                               (uint32_t) GetBValue(m_BackgroundColor);
+
+    // Composed into m_NewFrame, so the frame doesn't change if it can't
+    // be written.
+    m_NewFrame.resize(m_Frame.size());
+    std::fill(m_NewFrame.begin(), m_NewFrame.end(), backgroundPixel);
+
+    if (m_Position == RESIZE_Span)
+    {
+        // The first monitor's image across the whole virtual screen.
+        auto it = m_DecodedImages.find(m_WallpaperFiles[0]);
+        if (m_Enabled && it != m_DecodedImages.end())
+        {
+            ResizeWallpaperPixels(it->second.m_Pixels.data(),
+                                  it->second.m_Size,
+                                  m_NewFrame.data(),
+                                  m_FrameSize,
+                                  m_Position,
+                                  m_BackgroundColor);
+        }
+    }
+    else
+    {
+        // Each monitor gets its own image.
+        for (size_t monitorIndex = 0; monitorIndex < m_Monitors.size(); monitorIndex++)
+        {
+            const RECT& rect = m_Monitors[monitorIndex].m_Rect;
+            SIZE monitorSize = { rect.right - rect.left, rect.bottom - rect.top };
+            uint32_t* pDest = m_NewFrame.data() +
+                              (size_t) (rect.top - m_VirtualRect.top) * m_FrameSize.cx +
+                              (rect.left - m_VirtualRect.left);
+
+            auto it = m_DecodedImages.find(m_WallpaperFiles[monitorIndex]);
+            if (m_Enabled && it != m_DecodedImages.end())
+            {
+                m_MonitorPixels.resize((size_t) monitorSize.cx * monitorSize.cy);
+
+                ResizeWallpaperPixels(it->second.m_Pixels.data(),
+                                      it->second.m_Size,
+                                      m_MonitorPixels.data(),
+                                      monitorSize,
+                                      m_Position,
+                                      m_BackgroundColor);
+
+                for (LONG y = 0; y < monitorSize.cy; y++)
+                {
+                    std::copy_n(m_MonitorPixels.data() + (size_t) y * monitorSize.cx,
+                                monitorSize.cx,
+                                pDest + (size_t) y * m_FrameSize.cx);
+                }
+            }
+        }
+    }
+
+    Clock::time_point resizeTime = Clock::now();
+
+    // Write the frame to a temporary file, then rename it, so a reader
+    // never sees a partly written frame.
+
+    bool ok = true;
+
+    if (!m_OutputPath.empty())
+    {
+        fs::path tempPath = fs::path(m_OutputPath) += ".tmp";
+        std::error_code ec;
+
+        ok = CWallpaperCache::WriteBitmapFile(tempPath, m_NewFrame.data(), m_FrameSize);
+
+        if (ok)
+            fs::rename(tempPath, m_OutputPath, ec);
+
+        if (!ok || ec)
+        {
+            DebugPrint(L"CHeadlessWallpaperBackend::Compose: Can't write: %s\n", m_OutputPath.c_str());
+            fs::remove(tempPath, ec);
+            ok = false;
+        }
+    }
+
+    if (ok)
+        m_Frame.swap(m_NewFrame);
+
+    Clock::time_point writeTime = Clock::now();
+
+    m_ComposeTimes.m_Decode = std::chrono::duration_cast<std::chrono::microseconds>(decodeTime - startTime);
+    m_ComposeTimes.m_Resize = std::chrono::duration_cast<std::chrono::microseconds>(resizeTime - decodeTime);
+    m_ComposeTimes.m_Write = std::chrono::duration_cast<std::chrono::microseconds>(writeTime - resizeTime);
+
+    return ok;
+}
@@ -0,0 +1,186 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  HeadlessWallpaperBackend.h
+//
+//  CHeadlessWallpaperBackend class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WallpaperCache.h"
+#include "WallpaperSession.h"
+
+// A wallpaper backend without a desktop. Composes the frame the desktop
+// would show for a given monitor layout -- each monitor's wallpaper resized
+// for it (or the first monitor's spanned across all of them) on the
+// background color -- and writes it to a .bmp file. The frame is also kept
+// in memory.
+//
+// For profiling the whole wallpaper change (playlist, decoding, resizing,
+// and displaying) where there's no shell, and for checking what the
+// desktop would look like with a monitor layout you don't have.
+//
+// Doesn't use any Windows APIs (images are decoded by the caller's decode
+// function).
+class CHeadlessWallpaperBackend : public CWallpaperBackend
+{
+    public:
+
+        // Time spent composing the last frame, by stage.
+        struct ComposeTimes
+        {
+            std::chrono::microseconds m_Decode;
+            std::chrono::microseconds m_Resize;
+            std::chrono::microseconds m_Write;
+        };
+
+        CHeadlessWallpaperBackend(
+            const std::vector<CWallpaperMonitor>& monitors,
+            CWallpaperCache::DecodeFunction decode,
+            const fs::path& outputPath                      // Empty: only keep the frame in memory.
+        );
+
+        //
+        //  CWallpaperBackend
+        //
+
+        bool
+        Connect() override;
+
+        void
+        Disconnect() override;
+
+        bool
+        GetWallpaper(
+            std::wstring* pWallpaperFile
+        ) override;
+
+        bool
+        SetWallpaper(
+            const std::wstring& wallpaperFile
+        ) override;
+
+        bool
+        GetMonitorWallpaper(
+            const std::wstring& monitorID,
+            std::wstring* pWallpaperFile
+        ) override;
+
+        bool
+        SetMonitorWallpaper(
+            const std::wstring& monitorID,
+            const std::wstring& wallpaperFile
+        ) override;
+
+        bool
+        GetBackgroundColor(
+            COLORREF* pColor
+        ) override;
+
+        bool
+        SetBackgroundColor(
+            COLORREF color
+        ) override;
+
+        bool
+        GetPosition(
+            WallpaperResizeMode* pPosition
+        ) override;
+
+        bool
+        SetPosition(
+            WallpaperResizeMode position
+        ) override;
+
+        bool
+        Enable(
+            bool enable
+        ) override;
+
+        bool
+        GetMonitors(
+            std::vector<CWallpaperMonitor>* pMonitors
+        ) override;
+
+        //
+        //  Output
+        //
+
+        // Get the last composed frame (32bpp top-down, no row padding,
+        // covering the bounding rectangle of the monitors).
+        const std::vector<uint32_t>&
+        GetFrame(
+            SIZE* pSize
+        ) const
+        {
+            *pSize = m_FrameSize;
+            return m_Frame;
+        }
+
+        const ComposeTimes&
+        GetComposeTimes() const
+        {
+            return m_ComposeTimes;
+        }
+
+    private:
+
+        // An image file, decoded.
+        struct DecodedImage
+        {
+            std::vector<uint32_t> m_Pixels;
+            SIZE m_Size;
+        };
+
+        // Show different wallpaper files (one for each monitor). If they
+        // can't be decoded, nothing changes.
+        bool
+        SetWallpaperFiles(
+            const std::vector<std::wstring>& wallpaperFiles
+        );
+
+        // Compose the frame for the current state, and write it out.
+        bool
+        Compose();
+
+        std::vector<CWallpaperMonitor> m_Monitors;
+
+        // Bounding rectangle of the monitors.
+        RECT m_VirtualRect;
+
+        CWallpaperCache::DecodeFunction m_Decode;
+
+        fs::path m_OutputPath;
+
+        // The "desktop". One wallpaper file for each monitor.
+        std::vector<std::wstring> m_WallpaperFiles;
+        COLORREF m_BackgroundColor;
+        WallpaperResizeMode m_Position;
+        bool m_Enabled;
+
+        // m_WallpaperFiles, decoded. (Kept so changing the position, the
+        // color, or another monitor's file doesn't decode them again.)
+        std::map<std::wstring, DecodedImage> m_DecodedImages;
+
+        std::vector<uint32_t> m_Frame;
+        SIZE m_FrameSize;
+
+        // The frame being composed. Swapped with m_Frame once it's
+        // written.
+        std::vector<uint32_t> m_NewFrame;
+
+        // Scratch buffer for one monitor.
+        std::vector<uint32_t> m_MonitorPixels;
+
+        ComposeTimes m_ComposeTimes;
+};
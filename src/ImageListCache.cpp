@@ -0,0 +1,190 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ImageListCache.cpp
+//
+//  CImageListCache class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "ImageListCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::CImageListCache
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CImageListCache::CImageListCache(
+    size_t budget /*= 0*/
+)
+    :
+    m_Budget(budget),
+    m_MemoryUsage(0),
+    m_Lru(),
+    m_Map(),
+    m_FreeSlots(),
+    m_Stats()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::SetBudget
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CImageListCache::SetBudget(
+    size_t budget
+)
+{
+    m_Budget = budget;
+
+    MakeRoom(0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::Clear
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CImageListCache::Clear()
+{
+    for (const CacheEntry& entry: m_Lru)
+    {
+        if (entry.m_ImageListIndex != -1)
+            m_FreeSlots.push_back(entry.m_ImageListIndex);
+    }
+
+    m_Lru.clear();
+    m_Map.clear();
+    m_MemoryUsage = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::Reset
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CImageListCache::Reset()
+{
+    m_Lru.clear();
+    m_Map.clear();
+    m_FreeSlots.clear();
+    m_MemoryUsage = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::Find
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CImageListCache::Find(
+    const CThumbnailKey& key,
+    int* pImageListIndex
+)
+{
+    auto it = m_Map.find(key);
+
+    if (it == m_Map.end())
+    {
+        m_Stats.m_Misses++;
+        return false;
+    }
+
+    m_Stats.m_Hits++;
+
+    // Move to front of list (most recently used).
+    m_Lru.splice(m_Lru.begin(), m_Lru, it->second);
+
+    *pImageListIndex = it->second->m_ImageListIndex;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::Insert
+//
+//////////////////////////////////////////////////////////////////////////////
+
+int*
+CImageListCache::Insert(
+    const CThumbnailKey& key,
+    size_t bytes
+)
+{
+    auto it = m_Map.find(key);
+
+    if (it != m_Map.end())
+    {
+        // Already cached (e.g. requested twice). Reuse its slot.
+        CacheEntry& entry = *it->second;
+
+        m_MemoryUsage -= entry.m_Bytes;
+        entry.m_Bytes = bytes;
+        m_MemoryUsage += bytes;
+
+        m_Lru.splice(m_Lru.begin(), m_Lru, it->second);
+        return &entry.m_ImageListIndex;
+    }
+
+    MakeRoom(bytes);
+
+    int imageListIndex = -1;
+
+    if (!m_FreeSlots.empty())
+    {
+        imageListIndex = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+    }
+
+    m_Lru.push_front({ key, imageListIndex, bytes });
+    m_Map.emplace(key, m_Lru.begin());
+    m_MemoryUsage += bytes;
+
+    return &m_Lru.front().m_ImageListIndex;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache::MakeRoom
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CImageListCache::MakeRoom(
+    size_t bytes
+)
+{
+    // Always keep room for at least one entry, even if it's over budget.
+    while (!m_Lru.empty() && m_MemoryUsage + bytes > m_Budget)
+    {
+        const CacheEntry& oldest = m_Lru.back();
+
+        if (oldest.m_ImageListIndex != -1)
+            m_FreeSlots.push_back(oldest.m_ImageListIndex);
+
+        m_MemoryUsage -= oldest.m_Bytes;
+        m_Map.erase(oldest.m_Key);
+        m_Lru.pop_back();
+
+        m_Stats.m_Evictions++;
+    }
+}
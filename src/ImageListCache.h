@@ -2,7 +2,7 @@
 //
 //  ImageListCache.h
 //
-//  CImageListCache class template.
+//  CThumbnailKey and CImageListCache classes.
 //
 //----------------------------------------------------------------------------
 //
@@ -17,80 +17,195 @@
 
 #pragma once
 
-template <size_t CacheSize>
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailKey
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Identifies a thumbnail by the file it was made from, rather than by
+// FileHandle, so it stays valid when the playlist is reloaded, sorted, or
+// shuffled. Including the write time and size means a thumbnail is not
+// reused after the file has been changed.
+struct CThumbnailKey
+{
+    // Case insensitive hash of the full path (see CFileList::GetPathHash()).
+    uint64_t m_PathHash;
+
+    // Last write time (fs::file_time_type ticks).
+    int64_t m_LastWriteTime;
+
+    // File size in bytes.
+    uint64_t m_FileSize;
+
+    bool
+    operator==(
+        const CThumbnailKey& that
+    ) const
+    {
+        return m_PathHash == that.m_PathHash &&
+               m_LastWriteTime == that.m_LastWriteTime &&
+               m_FileSize == that.m_FileSize;
+    }
+};
+
+// Hash function for CThumbnailKey.
+struct CThumbnailKeyHash
+{
+    size_t
+    operator()(
+        const CThumbnailKey& key
+    ) const
+    {
+        // The path hash is already well mixed. The time and size
+        // only need to be spread out before they're folded in.
+        return (size_t) (key.m_PathHash ^
+                         ((uint64_t) key.m_LastWriteTime * 0x9E3779B97F4A7C15ull) ^
+                         (key.m_FileSize * 0xC2B2AE3D27D4EB4Full));
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CImageListCache
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Least recently used cache of thumbnails in an image list.
+//
+// The cache doesn't own the image list -- it keeps track of which slot
+// holds which thumbnail. Entries are looked up through a hash table and
+// kept on a recency list, so lookups and evictions are O(1) no matter how
+// many thumbnails are cached.
+//
+// The cache is limited by memory rather than by number of entries. When
+// an entry is evicted, its image list slot is handed out again to the next
+// new entry, since image list indexes shift if an image is removed.
 class CImageListCache
 {
     public:
 
-        CImageListCache()
-            :
-            m_Cache()
+        // Cache statistics.
+        struct CStats
         {
-        }
+            uint64_t m_Hits;
+            uint64_t m_Misses;
+            uint64_t m_Evictions;
+        };
+
+        CImageListCache(
+            size_t budget = 0       // Memory budget in bytes.
+        );
+
+        // No copy ctor.
+        CImageListCache(const CImageListCache&) = delete;
+
+        // No copy assignment.
+        CImageListCache& operator=(const CImageListCache&) = delete;
 
+        // Change the memory budget. Evicts entries if needed.
         void
-        Clear()
+        SetBudget(
+            size_t budget
+        );
+
+        // Get the memory budget in bytes.
+        size_t
+        GetBudget() const
+        {
+            return m_Budget;
+        }
+
+        // Get the number of bytes used by cached thumbnails.
+        size_t
+        GetMemoryUsage() const
+        {
+            return m_MemoryUsage;
+        }
+
+        // Get the number of cached thumbnails.
+        size_t
+        size() const
         {
-            for (CacheEntry& entry: m_Cache)
-            {
-                entry.m_Key = nullptr;
-            }
+            return m_Map.size();
         }
 
+        // Get hit/miss counts.
+        const CStats&
+        GetStats() const
+        {
+            return m_Stats;
+        }
+
+        // Forget all entries (e.g. the thumbnails need to be redrawn).
+        // Their image list slots are reused by later entries.
+        void
+        Clear();
+
+        // Forget all entries and their image list slots
+        // (e.g. the image list has been emptied).
+        void
+        Reset();
+
+        // Is a thumbnail cached? Doesn't count as a use.
         bool
-        Lookup(
-            void* key,
-            int** ppImageListIndex
-        )
+        Contains(
+            const CThumbnailKey& key
+        ) const
         {
-            using std::begin;
-            using std::end;
-
-            auto it = std::find_if(begin(m_Cache),
-                                   end(m_Cache),
-                                   [key] (CacheEntry& entry) { return entry.m_Key == key; });
-
-            if (it == begin(m_Cache))
-            {
-                // Found existing entry in cache.
-                // Already at top of list.
-                *ppImageListIndex = &it->m_ImageListIndex;
-                return true;
-            }
-            else if (it != end(m_Cache))
-            {
-                // Found existing entry in cache.
-                // Move to top of list (most recently used).
-                // "That's a rotate!"
-                std::rotate(begin(m_Cache), it, it+1);
-                *ppImageListIndex = &m_Cache[0].m_ImageListIndex;
-                return true;
-            }
-            else
-            {
-                // Not in the cache.
-                // Replace the oldest entry.
-                std::rotate(begin(m_Cache), end(m_Cache)-1, end(m_Cache));
-                m_Cache[0].m_Key = key;
-                *ppImageListIndex = &m_Cache[0].m_ImageListIndex;
-                return false;
-            }
+            return m_Map.find(key) != m_Map.end();
         }
 
+        // Find a thumbnail. Marks it most recently used.
+        // Returns false if it isn't cached.
+        bool
+        Find(
+            const CThumbnailKey& key,
+            int* pImageListIndex
+        );
+
+        // Add a thumbnail, evicting least recently used entries to make
+        // room. Returns the image list slot for the thumbnail, which the
+        // caller must fill in with ImageList_Replace(). If the slot is -1,
+        // the caller must add a new image, and store its index in the slot.
+        int*
+        Insert(
+            const CThumbnailKey& key,
+            size_t bytes            // Size of the thumbnail in bytes.
+        );
+
     private:
 
         struct CacheEntry
         {
-            CacheEntry()
-                :
-                m_Key(nullptr),
-                m_ImageListIndex(-1)
-            {
-            }
-
-            void* m_Key;
+            CThumbnailKey m_Key;
             int m_ImageListIndex;
+            size_t m_Bytes;
         };
 
-        CacheEntry m_Cache[CacheSize];
+        using LruList = std::list<CacheEntry>;
+
+        // Evict least recently used entries until
+        // there's room for another bytes bytes.
+        void
+        MakeRoom(
+            size_t bytes
+        );
+
+        // Memory budget in bytes.
+        size_t m_Budget;
+
+        // Bytes used by the cached thumbnails.
+        size_t m_MemoryUsage;
+
+        // Entries, most recently used first.
+        LruList m_Lru;
+
+        // Entries by key.
+        std::unordered_map<CThumbnailKey, LruList::iterator, CThumbnailKeyHash> m_Map;
+
+        // Image list slots of evicted entries, to be reused.
+        std::vector<int> m_FreeSlots;
+
+        CStats m_Stats;
 };
@@ -165,9 +165,12 @@ LRESULT CMainFrame::OnPlaylistManager(UINT /*uNotifyCode*/, int /*nID*/, CWindow
 
     if (playlistManager.DoModal(m_hWnd) == IDOK)
     {
-        // Load new playlist.
+        // Load new playlist. It may be the same playlist, edited.
+        CListViewState listViewState;
+        SaveListViewState(listViewState);
+
         LoadPlaylist(playlistManager.GetNewPlayListName());
-        PopulateListView(WallpaperManager.GetCurrentWallpaperFile());
+        UpdateListView(listViewState, WallpaperManager.GetCurrentWallpaperFile());
     }
     else
     {
@@ -236,6 +239,8 @@ LRESULT CMainFrame::OnAddImage(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndC
                 if (it == m_PlayList.end())
                     continue;  // File is already in playlist.
 
+                m_PlayList.JournalAdd(*it);
+
                 // Add file to listview.
                 int iItem = AddFileToListView(*it);
 
@@ -249,13 +254,37 @@ LRESULT CMainFrame::OnAddImage(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndC
             // Save the updated playlist
             // (only if a file was added).
             if (iFirstAddedItem != -1)
-                m_PlayList.Save();
+                m_PlayList.SaveChanges();
         }
     }
 
     return 0;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnStopAdding
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle ID_PLAYLIST_STOP_ADDING command.
+LRESULT CMainFrame::OnStopAdding(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
+{
+    DebugPrintCmdSpew("ID_PLAYLIST_STOP_ADDING\n");
+
+    if (!m_Importing)
+        return 0;
+
+    // Images already added stay in the playlist.
+    m_pDirectoryImport->Cancel();
+    m_Importing = false;
+
+    UISetText(ID_DEFAULT_PANE, Format(L"%zu images added", m_ImportedFileCount).c_str());
+    UIEnable(ID_PLAYLIST_STOP_ADDING, FALSE);
+
+    return 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::OnRemoveImage
@@ -267,35 +296,43 @@ LRESULT CMainFrame::OnRemoveImage(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*w
 {
     DebugPrintCmdSpew("ID_PLAYLIST_REMOVE\n");
 
-    BeginListViewUpdate();
+    // Collect the selected files.
+    std::vector<FileHandle> filesToRemove = m_ListViewModel.GetSelectedHandles();
 
-    fs::path currentWallpaperFile = WallpaperManager.GetCurrentWallpaperFile();
-    bool deletedCurrentWallpaper = false;
+    if (filesToRemove.empty())
+        return 0;
 
-    int iItem, iStart = -1, iItemToSelect = -1;
+    size_t firstSelectedItem = m_ListViewModel.GetNextSelected(CPlayListViewModel::InvalidRow);
 
-    while ((iItem = m_ListView.GetNextItem(iStart, LVNI_SELECTED)) != -1)
+    FileHandle hCurrentFile = m_PlayList.GetCurrentFile();
+    bool deletedCurrentWallpaper = false;
+
+    for (FileHandle hFile: filesToRemove)
     {
-        if (iItemToSelect == -1)
-            iItemToSelect = iItem;
+        if (hFile == hCurrentFile)
+            deletedCurrentWallpaper = true;
+
+        m_PlayList.JournalRemove(hFile);
+    }
 
-        iStart = m_ListView.GetNextItem(iItem, LVNI_PREVIOUS);
+    // Don't load thumbnails for the removed files. Results that are
+    // already on the way are checked against the playlist when they arrive.
+    std::unordered_set<FileHandle> removedFiles(filesToRemove.begin(), filesToRemove.end());
+    m_pThumbnailLoader->Cancel([&removedFiles] (FileHandle hFile) { return removedFiles.count(hFile) != 0; });
 
-        CFileInfo* pFile = GetListViewItemData(iItem);
+    // Remove the files from the playlist in one pass.
+    m_PlayList.RemoveMany(filesToRemove);
 
-        if (pFile->m_FullPath == currentWallpaperFile)
-            deletedCurrentWallpaper = true;
+    // Remove the items from the listview. The listview's selection is
+    // by item number, which is about to change, so clear it first.
+    BeginListViewUpdate();
 
-        m_ListView.DeleteItem(iItem);
+    m_ListView.SetItemState(-1, 0, LVIS_SELECTED);
 
-        m_PlayList.Remove(pFile);
-    }
+    m_ListViewModel.Remove(filesToRemove);
 
-    if (iItemToSelect != -1)
-    {
-        if (iItemToSelect >= m_ListView.GetItemCount())
-            iItemToSelect = m_ListView.GetItemCount() - 1;
-    }
+    // Select the item that took the place of the first removed item.
+    int iItemToSelect = m_ListViewModel.empty() ? -1 : (int) std::min(firstSelectedItem, m_ListViewModel.size() - 1);
 
     EndListViewUpdate(iItemToSelect);
 
@@ -303,12 +340,15 @@ LRESULT CMainFrame::OnRemoveImage(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*w
     {
         // If we deleted the current wallpaper, display whatever is selected now.
         // If the list is empty, the net result will be a solid color desktop background.
+        int iItem = GetCurrentSelectedItem();
+        if (iItem != -1)
+            m_PlayList.SetPlaybackFile(GetListViewItemData(iItem));
+
         ChangeWallpaperImage(GetCurrentSelectedFile());
     }
 
-    // Save the updated playlist (but only if a file was removed).
-    if (iItemToSelect != -1)
-        m_PlayList.Save();
+    // Save the updated playlist.
+    m_PlayList.SaveChanges();
 
     return 0;
 }
@@ -324,13 +364,44 @@ LRESULT CMainFrame::OnShuffle(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCt
 {
     DebugPrintCmdSpew("ID_PLAYLIST_SHUFFLE\n");
 
-    fs::path selectedFile = GetCurrentSelectedFile();
+    CListViewState listViewState;
+    SaveListViewState(listViewState);
 
+    // Only the view is shuffled. The playlist file keeps its order, so
+    // its files get the same handles when it's loaded again, and the
+    // saved playback position still applies (see CPlaybackPosition).
     m_PlayList.Shuffle();
 
-    m_PlayList.Save();
+    UpdateListView(listViewState, WallpaperManager.GetCurrentWallpaperFile());
 
-    PopulateListView(selectedFile);
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnSort
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle ID_PLAYLIST_SORT_X command.
+LRESULT CMainFrame::OnSort(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl*/)
+{
+    // The commands are in the same order as FileSortOrder.
+    FileSortOrder order = (FileSortOrder) (nID - ID_PLAYLIST_SORT_NAME);
+
+    DebugPrintCmdSpew("ID_PLAYLIST_SORT %d\n", (int) order);
+
+    CListViewState listViewState;
+    SaveListViewState(listViewState);
+
+    // Sorting by date or size stats every file (on a pool of threads),
+    // and by image size reads every file's header.
+    CWaitCursor waitCursor;
+
+    // Same as shuffling, only the view is sorted.
+    m_PlayList.Sort(order);
+
+    UpdateListView(listViewState, WallpaperManager.GetCurrentWallpaperFile());
 
     return 0;
 }
@@ -372,8 +443,11 @@ LRESULT CMainFrame::OnOpenRecent(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl
     if (!playlistName.empty())
     {
         // Load selected playlist.
+        CListViewState listViewState;
+        SaveListViewState(listViewState);
+
         LoadPlaylist(playlistName);
-        PopulateListView(WallpaperManager.GetCurrentWallpaperFile());
+        UpdateListView(listViewState, WallpaperManager.GetCurrentWallpaperFile());
     }
 
     return 0;
@@ -417,6 +491,9 @@ LRESULT CMainFrame::OnShowSelected(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*
     // Only change wallpaper if a single item is selected.
     if (m_ListView.GetSelectedCount() == 1)
     {
+        // Next/Prev continue from the selected image.
+        m_PlayList.SetPlaybackFile(GetListViewItemData(GetCurrentSelectedItem()));
+
         ChangeWallpaperImage(GetCurrentSelectedFile());
     }
 
@@ -435,10 +512,10 @@ LRESULT CMainFrame::OnShowNextPrev(UINT /*uNotifyCode*/, int nID, CWindow /*wndC
     DebugPrintCmdSpew("ID_WALLPAPER_NEXT/PREV\n");
 
     // Show next/previous wallpaper.
-    CFileInfo* pFile = ShowNextOrPrev(nID);
+    FileHandle hFile = ShowNextOrPrev(nID);
 
     // Select new wallpaper in list view.
-    m_ListView.SelectItem(GetWallpaperItem(pFile));
+    m_ListView.SelectItem(GetWallpaperItem(hFile));
 
     return 0;
 }
@@ -458,13 +535,15 @@ LRESULT CMainFrame::OnShowRandom(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wn
     if (!m_PlayList.empty())
     {
         // Pick a new wallpaper image at random.
-        CFileInfo* pFile = m_PlayList.GetRandom();
+        // Next/Prev continue from there.
+        FileHandle hFile = m_PlayList.GetRandom();
+        m_PlayList.SetPlaybackFile(hFile);
 
         // Display the new wallpaper image.
-        ChangeWallpaperImage(pFile->m_FullPath);
+        ChangeWallpaperImage(m_PlayList.GetFullPath(hFile));
 
         // Select new wallpaper in list view.
-        m_ListView.SelectItem(GetWallpaperItem(pFile));
+        m_ListView.SelectItem(GetWallpaperItem(hFile));
     }
 
     return 0;
@@ -484,8 +563,11 @@ LRESULT CMainFrame::OnShowSafe(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndC
     if (!GetAppOptions()->m_SafePlaylist.empty())
     {
         // Load "Safe For Work" playlist.
+        CListViewState listViewState;
+        SaveListViewState(listViewState);
+
         LoadPlaylist(GetAppOptions()->m_SafePlaylist);
-        PopulateListView(WallpaperManager.GetCurrentWallpaperFile());
+        UpdateListView(listViewState, WallpaperManager.GetCurrentWallpaperFile());
     }
 
     return 0;
@@ -681,3 +763,20 @@ LRESULT CMainFrame::OnOpenContainingFolder(UINT /*uNotifyCode*/, int /*nID*/, CW
 
     return 0;
 }
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnZoom
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle ID_VIEW_ZOOM_IN and ID_VIEW_ZOOM_OUT commands.
+LRESULT CMainFrame::OnZoom(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl*/)
+{
+    DebugPrintCmdSpew("ID_VIEW_ZOOM_IN/OUT\n");
+
+    // Zooming in shows a larger (lower) pyramid level.
+    SetThumbnailLevel(m_ThumbnailLevel + ((nID == ID_VIEW_ZOOM_IN) ? -1 : 1));
+
+    return 0;
+}
@@ -23,6 +23,8 @@
 #include "Options.h"
 #include "MainFrame.h"
 
+static_assert(std::is_same_v<FileHandle, CPlayListViewModel::Handle>, "CPlayListViewModel::Handle must be FileHandle");
+
 //****************************************************************************
 //
 //  ListView functions
@@ -45,6 +47,7 @@ void CMainFrame::CreateListView()
         LVS_ICON |
         LVS_SHOWSELALWAYS |
         LVS_SHAREIMAGELISTS |
+        LVS_OWNERDATA |
         0;
 
     const DWORD dwExtStyle =
@@ -68,26 +71,342 @@ void CMainFrame::CreateListView()
 
     m_ListView.InsertColumn(0, TEXT("Name"), LVCFMT_LEFT, 300);
 
-    // Our thumbnail height is always 128 pixels.
-    // The width varies based on the main screen
-    // aspect ratio. Explorer varies both width
-    // and height, which sometimes looks fugly.
+    // Our thumbnail height is 256, 128, 64, or 32 pixels
+    // (a level of the thumbnail pyramid). The width varies
+    // based on the main screen aspect ratio. Explorer varies
+    // both width and height, which sometimes looks fugly.
 
     int cxDesktop = GetSystemMetrics(SM_CXSCREEN);
     int cyDesktop = GetSystemMetrics(SM_CYSCREEN);
     double displayRatio = (double) cxDesktop / (double) cyDesktop;
-    m_ThumbnailSize = { (int) std::round(128.0 * displayRatio), 128 };
+    m_ThumbnailBaseSize = CThumbnailPyramid::GetBaseSize(displayRatio);
+
+    int level = 0;
+    while (level < CThumbnailPyramid::LevelCount - 1 &&
+           (CThumbnailPyramid::BaseHeight >> level) > GetAppOptions()->m_ThumbnailHeight)
+    {
+        level++;
+    }
+
+    m_ThumbnailLevel = level;
+    m_ThumbnailSize = CThumbnailPyramid::GetLevelSize(m_ThumbnailBaseSize, level);
 
     m_ListView.SetIconSpacing(m_ThumbnailSize.cx + 26,
                               m_ThumbnailSize.cy + 48);
 
+    m_ImageListCache.SetBudget((size_t) GetAppOptions()->m_ThumbnailCacheSize * 1024 * 1024);
+
     m_ImageList.Create(m_ThumbnailSize.cx,
                        m_ThumbnailSize.cy,
                        ILC_COLOR32,
-                       ImageListCacheSize,
-                       1);
+                       (int) (m_ImageListCache.GetBudget() / GetThumbnailBytes()) + 1,
+                       16);
 
     m_ListView.SetImageList(m_ImageList, LVSIL_NORMAL);
+
+    AddPlaceholderImage();
+
+    CreateThumbnailLoader();
+
+    UIEnable(ID_VIEW_ZOOM_IN, (BOOL)(level > 0));
+    UIEnable(ID_VIEW_ZOOM_OUT, (BOOL)(level < CThumbnailPyramid::LevelCount - 1));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::AddPlaceholderImage
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::AddPlaceholderImage()
+{
+    CClientDC listViewDC(m_ListView);
+
+    CBitmap placeholderBitmap;
+    placeholderBitmap.CreateCompatibleBitmap(listViewDC, m_ThumbnailSize.cx, m_ThumbnailSize.cy);
+
+    {
+        CDC memDC;
+        memDC.CreateCompatibleDC(listViewDC);
+
+        HBITMAP hOldBitmap = memDC.SelectBitmap(placeholderBitmap);
+
+        RECT rect = { 0, 0, m_ThumbnailSize.cx, m_ThumbnailSize.cy };
+        memDC.FillSolidRect(&rect, GetSysColor(COLOR_BTNFACE));
+
+        memDC.SelectBitmap(hOldBitmap);
+    }
+
+    // The placeholder is never evicted from the cache,
+    // because the cache doesn't know about it.
+    m_PlaceholderImage = m_ImageList.Add(placeholderBitmap);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::CreateThumbnailLoader
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::CreateThumbnailLoader()
+{
+    m_ThumbnailResizeMode = WallpaperManager.GetResizeMode();
+
+    // Thumbnails made in earlier sessions. Opened by the loader threads.
+    m_ThumbnailPack.Initialize(GetApp()->GetAppDataFilePath(L"Thumbnails.pack"),
+                               (uint64_t) GetAppOptions()->m_ThumbnailPackSize * 1024 * 1024);
+
+    m_pThumbnailLoader = std::make_unique<CThumbnailLoader>(
+        // Load function. Runs on the loader threads.
+        /*LAMBDA*/ [this, baseSize = SIZE(m_ThumbnailBaseSize)] (const fs::path& path, CThumbnailKey* pKey) -> HBITMAP
+        {
+            // The size and time the UI thread has may be stale (e.g. from
+            // the playlist index), or not known yet. Get the current ones,
+            // so an edited image doesn't match its old thumbnail.
+            CFileStat fileStat = CFileList::StatFile(path);
+
+            pKey->m_LastWriteTime = fileStat.m_LastWriteTime;
+            pKey->m_FileSize = fileStat.m_Size;
+
+            if (fileStat.IsFailed())
+                return NULL;
+
+            const CThumbnailKey& key = *pKey;
+
+            WallpaperResizeMode resizeMode = m_ThumbnailResizeMode;
+            bool linearLight = (GetAppOptions()->m_LinearLightResizeModes & (1 << resizeMode)) != 0;
+            COLORREF backgroundColor = GetSysColor(COLOR_WINDOW);
+            int level = m_ThumbnailLevel;
+
+            // Use the thumbnail from the pack if it's up to date.
+            HBITMAP hBitmap = m_ThumbnailPack.Read(key, baseSize, level, resizeMode, linearLight, backgroundColor);
+
+            if (hBitmap)
+                return hBitmap;
+
+            hBitmap = CFileList::GetLargeThumbnail(path);
+
+            if (!hBitmap)
+                return NULL;
+
+            // Make the smaller sizes too, so zooming out doesn't need the
+            // image to be decoded again. The 256 pixel size is only made
+            // when it's shown, since it's 3/4 of the pyramid's pixels.
+            int firstLevel = std::min(level, 1);
+
+            ResizeWallpaperBitmap(&hBitmap,
+                                  CThumbnailPyramid::GetLevelSize(baseSize, firstLevel),
+                                  resizeMode,
+                                  backgroundColor,
+                                  FILTER_Lanczos3,
+                                  linearLight);
+
+            CThumbnailPyramid pyramid;
+
+            if (!pyramid.Create(hBitmap, baseSize, firstLevel))
+                return hBitmap;
+
+            ::DeleteObject(hBitmap);
+
+            m_ThumbnailPack.Write(key, resizeMode, linearLight, backgroundColor, pyramid);
+
+            return pyramid.CreateBitmap(level);
+        },
+        // Notify function. Wakes up the UI thread to collect the thumbnails.
+        /*LAMBDA*/ [hWnd = m_hWnd] ()
+        {
+            ::PostMessageW(hWnd, WM_THUMBNAILS_READY, 0, 0);
+        });
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::SetThumbnailLevel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::SetThumbnailLevel(int level)
+{
+    level = std::clamp(level, 0, CThumbnailPyramid::LevelCount - 1);
+
+    if (level == m_ThumbnailLevel)
+        return;
+
+    // Thumbnails that are being loaded are the old size.
+    m_pThumbnailLoader->CancelAll();
+
+    m_ThumbnailLevel = level;
+    m_ThumbnailSize = CThumbnailPyramid::GetLevelSize(m_ThumbnailBaseSize, level);
+
+    // Changing the icon size empties the image list. The thumbnails are
+    // loaded again as they're drawn, from the pack (which has all the
+    // sizes), so they don't have to be decoded again.
+    m_ListView.SetImageList(NULL, LVSIL_NORMAL);
+
+    m_ImageList.SetIconSize(m_ThumbnailSize.cx, m_ThumbnailSize.cy);
+    m_ImageListCache.Reset();
+
+    AddPlaceholderImage();
+
+    m_ListView.SetImageList(m_ImageList, LVSIL_NORMAL);
+
+    m_ListView.SetIconSpacing(m_ThumbnailSize.cx + 26,
+                              m_ThumbnailSize.cy + 48);
+
+    m_ScrollPredictor.Reset();
+
+    // Keep the focused item in view.
+    int iFocusedItem = m_ListView.GetNextItem(-1, LVNI_FOCUSED);
+
+    if (iFocusedItem != -1)
+        m_ListView.EnsureVisible(iFocusedItem, FALSE);
+
+    m_ListView.Invalidate();
+
+    UIEnable(ID_VIEW_ZOOM_IN, (BOOL)(level > 0));
+    UIEnable(ID_VIEW_ZOOM_OUT, (BOOL)(level < CThumbnailPyramid::LevelCount - 1));
+
+    GetAppOptions()->m_ThumbnailHeight = m_ThumbnailSize.cy;
+    GetAppOptions()->SaveToRegistry();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::HandleWheelZoom
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool CMainFrame::HandleWheelZoom(const MSG* pMsg)
+{
+    if (pMsg->message != WM_MOUSEWHEEL ||
+        pMsg->hwnd != m_ListView ||
+        (GET_KEYSTATE_WPARAM(pMsg->wParam) & MK_CONTROL) == 0)
+    {
+        return false;
+    }
+
+    // High resolution wheels (and touchpads) send less than
+    // WHEEL_DELTA at a time. Zoom one step per WHEEL_DELTA.
+    m_WheelZoomDelta += GET_WHEEL_DELTA_WPARAM(pMsg->wParam);
+
+    while (m_WheelZoomDelta >= WHEEL_DELTA)
+    {
+        SetThumbnailLevel(m_ThumbnailLevel - 1);
+        m_WheelZoomDelta -= WHEEL_DELTA;
+    }
+
+    while (m_WheelZoomDelta <= -WHEEL_DELTA)
+    {
+        SetThumbnailLevel(m_ThumbnailLevel + 1);
+        m_WheelZoomDelta += WHEEL_DELTA;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::GetVisibleItems
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool CMainFrame::GetVisibleItems(int* pFirstItem, int* pItemCount)
+{
+    int itemCount = m_ListView.GetItemCount();
+
+    if (itemCount == 0)
+        return false;
+
+    // The icon view is auto-arranged in rows, in item order. Work out
+    // which rows are in view from the view origin and the item spacing.
+
+    CRect clientRect;
+    m_ListView.GetClientRect(&clientRect);
+
+    CSize spacing;
+    m_ListView.GetItemSpacing(spacing);
+
+    if (spacing.cx <= 0 || spacing.cy <= 0)
+        return false;
+
+    CPoint origin;
+    m_ListView.GetOrigin(&origin);
+
+    CPoint firstPosition;
+    m_ListView.GetItemPosition(0, &firstPosition);
+
+    int itemsPerRow = 1;
+    CPoint position;
+    while (itemsPerRow < itemCount &&
+           m_ListView.GetItemPosition(itemsPerRow, &position) &&
+           position.y == firstPosition.y)
+    {
+        itemsPerRow++;
+    }
+
+    // Include partly visible rows at the top and bottom.
+    int firstRow = std::max(0, (origin.y - firstPosition.y) / spacing.cy);
+    int rowCount = (clientRect.Height() + spacing.cy - 1) / spacing.cy + 1;
+
+    int firstItem = std::min(firstRow * itemsPerRow, itemCount - 1);
+
+    *pFirstItem = firstItem;
+    *pItemCount = std::min(rowCount * itemsPerRow, itemCount - firstItem);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::UpdatePrefetch
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::UpdatePrefetch()
+{
+    int firstItem;
+    int itemCount;
+
+    if (!GetVisibleItems(&firstItem, &itemCount))
+        return;
+
+    m_ScrollPredictor.Update(firstItem, itemCount, ::GetTickCount64());
+
+    // Keep prefetched thumbnails to a fraction of the cache, so they
+    // can't push out the thumbnails that are in view.
+    size_t maxItems = m_ImageListCache.GetBudget() / GetThumbnailBytes() / 4;
+
+    std::vector<size_t> items;
+    m_ScrollPredictor.GetPrefetchItems(m_ListView.GetItemCount(), maxItems, items);
+
+    // The new prediction replaces the old one.
+    m_pThumbnailLoader->ClearPrefetch();
+
+    for (size_t iItem: items)
+    {
+        FileHandle hFile = GetListViewItemData((int) iItem);
+        CThumbnailKey thumbnailKey;
+
+        if (GetThumbnailKey(hFile, &thumbnailKey) && !m_ImageListCache.Contains(thumbnailKey))
+            m_pThumbnailLoader->Prefetch(hFile, m_PlayList.GetFullPath(hFile), thumbnailKey);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::GetThumbnailKey
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool CMainFrame::GetThumbnailKey(FileHandle hFile, CThumbnailKey* pKey)
+{
+    // The loader threads stat the file, and OnThumbnailsReady() records
+    // the result. Until then the time is unknown (zero), which nothing in
+    // the cache matches, so the thumbnail gets requested.
+    CFileStat fileStat = m_PlayList.GetKnownFileStat(hFile);
+
+    *pKey = { m_PlayList.GetPathHash(hFile), fileStat.m_LastWriteTime, fileStat.m_Size };
+
+    return !fileStat.IsFailed();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -99,8 +418,21 @@ void CMainFrame::CreateListView()
 void CMainFrame::ClearListView()
 {
     m_ListView.DeleteAllItems();
+    m_ListViewModel.Clear();
 
-    m_ImageListCache.Clear();
+    // All FileHandles are about to become invalid. The cached
+    // thumbnails aren't keyed by FileHandle, so they're kept.
+    m_pThumbnailLoader->CancelAll();
+
+    m_ScrollPredictor.Reset();
+
+    const CImageListCache::CStats& stats = m_ImageListCache.GetStats();
+    DebugPrint(L"Thumbnail cache: %zu thumbnails, %zu KB, %llu hits, %llu misses, %llu evictions\n",
+               m_ImageListCache.size(),
+               m_ImageListCache.GetMemoryUsage() / 1024,
+               stats.m_Hits,
+               stats.m_Misses,
+               stats.m_Evictions);
 
     UISetText(ID_DEFAULT_PANE, NULL);
 }
@@ -117,38 +449,175 @@ void CMainFrame::PopulateListView(const fs::path& selectedFile /*= fs::path()*/)
 
     ClearListView();
 
-    int iSelectedItem = -1;
+    // The listview only needs the item count. It gets everything
+    // else from the model, one item at a time, as items are drawn.
+    m_ListViewModel.Assign(m_PlayList.begin(), m_PlayList.end());
 
-    for (CFileInfo* pFile: m_PlayList)
-    {
-        // Add file to listview.
-        int iItem = AddFileToListView(pFile);
+    FileHandle hSelectedFile = selectedFile.empty() ? InvalidFileHandle : m_PlayList.Lookup(selectedFile);
 
-        // Remember the new listview item number for the selected file.
-        if (iSelectedItem == -1 && !selectedFile.empty() && pFile->m_FullPath == selectedFile)
-            iSelectedItem = iItem;
-    }
+    int iSelectedItem = GetWallpaperItem(hSelectedFile);
 
-    if (iSelectedItem == -1)
+    if (iSelectedItem == -1 && !m_ListViewModel.empty())
         iSelectedItem  = 0;
 
     EndListViewUpdate(iSelectedItem);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::SaveListViewState
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::SaveListViewState(CListViewState& state)
+{
+    state.m_Keys = GetListViewKeys();
+
+    state.m_SelectedItems.clear();
+
+    for (size_t iItem = m_ListViewModel.GetNextSelected(CPlayListViewModel::InvalidRow);
+         iItem != CPlayListViewModel::InvalidRow;
+         iItem = m_ListViewModel.GetNextSelected(iItem))
+    {
+        state.m_SelectedItems.push_back(iItem);
+    }
+
+    state.m_FocusedItem = m_ListView.GetNextItem(-1, LVNI_FOCUSED);
+
+    state.m_TopItem = -1;
+    state.m_TopItemOffset = 0;
+
+    int firstItem;
+    int itemCount;
+
+    if (GetVisibleItems(&firstItem, &itemCount))
+    {
+        CPoint origin;
+        m_ListView.GetOrigin(&origin);
+
+        CPoint position;
+        m_ListView.GetItemPosition(firstItem, &position);
+
+        state.m_TopItem = firstItem;
+        state.m_TopItemOffset = position.y - origin.y;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::UpdateListView
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::UpdateListView(const CListViewState& oldState, const fs::path& selectedFile)
+{
+    BeginListViewUpdate();
+
+    // The listview's selection is by item number,
+    // so clear it before the items change.
+    m_ListView.SetItemState(-1, 0, LVIS_SELECTED);
+
+    m_ListViewModel.Assign(m_PlayList.begin(), m_PlayList.end());
+
+    CSequenceDiff diff;
+    diff.Compute(oldState.m_Keys, GetListViewKeys());
+
+    DebugPrint(L"ListView update: %zu deleted, %zu inserted, %zu moved\n",
+               diff.GetDeleteCount(),
+               diff.GetInsertCount(),
+               diff.GetMoveCount());
+
+    int itemCount = (int) m_ListViewModel.size();
+
+    if (m_ListView.GetItemCount() != itemCount)
+        m_ListView.SetItemCountEx(itemCount, LVSICF_NOSCROLL);
+
+    // Get the new item number of an old item. -1 if it's gone.
+    auto getNewItem = [&diff] (size_t iOldItem) -> int
+    {
+        size_t iNewItem = diff.GetNewIndex(iOldItem);
+        return (iNewItem == CSequenceDiff::InvalidIndex) ? -1 : (int) iNewItem;
+    };
+
+    for (size_t iOldItem: oldState.m_SelectedItems)
+    {
+        int iItem = getNewItem(iOldItem);
+
+        if (iItem != -1)
+            m_ListView.SetItemState(iItem, LVIS_SELECTED, LVIS_SELECTED);
+    }
+
+    if (m_ListViewModel.GetSelectedCount() == 0)
+    {
+        // None of the selected items are left.
+        FileHandle hSelectedFile = selectedFile.empty() ? InvalidFileHandle : m_PlayList.Lookup(selectedFile);
+
+        int iSelectedItem = GetWallpaperItem(hSelectedFile);
+
+        if (iSelectedItem == -1 && itemCount != 0)
+            iSelectedItem = 0;
+
+        EndListViewUpdate(iSelectedItem);
+        return;
+    }
+
+    int iFocusedItem = (oldState.m_FocusedItem == -1) ? -1 : getNewItem(oldState.m_FocusedItem);
+
+    if (iFocusedItem != -1)
+        m_ListView.SetItemState(iFocusedItem, LVIS_FOCUSED, LVIS_FOCUSED);
+
+    // Keep the item that was at the top of the view where it was.
+    int iTopItem = (oldState.m_TopItem == -1) ? -1 : getNewItem(oldState.m_TopItem);
+
+    if (iTopItem != -1)
+    {
+        CPoint origin;
+        m_ListView.GetOrigin(&origin);
+
+        CPoint position;
+        m_ListView.GetItemPosition(iTopItem, &position);
+
+        int dy = position.y - origin.y - oldState.m_TopItemOffset;
+
+        if (dy != 0)
+            m_ListView.Scroll(CSize(0, dy));
+    }
+
+    // If items were moved (e.g. shuffled), the rest of the view
+    // is different anyway, so bring the focused item into view.
+    if (diff.GetMoveCount() != 0 && iFocusedItem != -1)
+        m_ListView.EnsureVisible(iFocusedItem, FALSE);
+
+    EndListViewUpdate(-1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::GetListViewKeys
+//
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint64_t> CMainFrame::GetListViewKeys()
+{
+    std::vector<uint64_t> keys(m_ListViewModel.size());
+
+    for (size_t iItem = 0; iItem < keys.size(); iItem++)
+        keys[iItem] = m_PlayList.GetPathHash(m_ListViewModel.GetHandle(iItem));
+
+    return keys;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::AddFileToListView
 //
 //////////////////////////////////////////////////////////////////////////////
 
-int CMainFrame::AddFileToListView(CFileInfo* pFile, int nItem /*= INT_MAX*/)
+int CMainFrame::AddFileToListView(FileHandle hFile)
 {
-    return m_ListView.InsertItem(LVIF_TEXT | LVIF_IMAGE | LVIF_PARAM,
-                                 nItem,
-                                 LPSTR_TEXTCALLBACK,
-                                 0, 0,
-                                 I_IMAGECALLBACK,
-                                 (LPARAM) pFile);
+    size_t row = m_ListViewModel.Append(hFile);
+
+    return (row == CPlayListViewModel::InvalidRow) ? -1 : (int) row;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -165,6 +634,11 @@ void CMainFrame::BeginListViewUpdate()
 
 void CMainFrame::EndListViewUpdate(int iSelectedItem)
 {
+    int itemCount = (int) m_ListViewModel.size();
+
+    if (m_ListView.GetItemCount() != itemCount)
+        m_ListView.SetItemCountEx(itemCount, LVSICF_NOSCROLL);
+
     if (iSelectedItem != -1)
     {
         m_ListView.SelectItem(iSelectedItem);
@@ -184,11 +658,42 @@ void CMainFrame::EndListViewUpdate(int iSelectedItem)
 
 void CMainFrame::RefreshListView()
 {
+    // Thumbnails that are being loaded use the old resize mode.
+    m_ThumbnailResizeMode = WallpaperManager.GetResizeMode();
+    m_pThumbnailLoader->CancelAll();
+
     m_ImageListCache.Clear();
 
     m_ListView.RedrawItems(0, m_ListView.GetItemCount()-1);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::ShowSelectionInfo
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::ShowSelectionInfo()
+{
+    size_t selectedCount = m_ListViewModel.GetSelectedCount();
+
+    if (selectedCount == 1)
+    {
+        FileHandle hFile = m_ListViewModel.GetHandle(m_ListViewModel.GetNextSelected(CPlayListViewModel::InvalidRow));
+        UISetText(ID_DEFAULT_PANE, (std::wstring(L"Selected: ") + m_PlayList.GetFullPath(hFile).native()).c_str());
+    }
+    else if (selectedCount > 1)
+    {
+        UISetText(ID_DEFAULT_PANE, Format(L"%zu images selected\n", selectedCount).c_str());
+    }
+    else
+    {
+        UISetText(ID_DEFAULT_PANE, L"No images selected\n");
+    }
+
+    UIEnable(ID_PLAYLIST_REMOVE, (BOOL)(selectedCount > 0));
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::GetCurrentSelectedItem
@@ -213,7 +718,7 @@ fs::path CMainFrame::GetCurrentSelectedFile()
     if (iItem == -1)
         return fs::path();
     else
-        return GetListViewItemData(iItem)->m_FullPath;
+        return m_PlayList.GetFullPath(GetListViewItemData(iItem));
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -224,22 +729,8 @@ fs::path CMainFrame::GetCurrentSelectedFile()
 
 int CMainFrame::GetCurrentWallpaperItem()
 {
-    fs::path currentWallpaperFile = WallpaperManager.GetCurrentWallpaperFile();
-
-    if (currentWallpaperFile.empty())
-        return -1;
-
-    // Find current wallpaper in the playlist,
-    // then find the corresponding ListView item.
-
-    auto it = std::find_if(m_PlayList.begin(), m_PlayList.end(),
-                           [currentWallpaperFile] (CFileInfo* pFile)
-                           { return pFile->m_FullPath == currentWallpaperFile; });
-
-    if (it != m_PlayList.end())
-        return GetWallpaperItem(*it);
-    else
-        return -1;
+    // The playlist keeps track of the current wallpaper.
+    return GetWallpaperItem(m_PlayList.GetCurrentFile());
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -248,14 +739,11 @@ int CMainFrame::GetCurrentWallpaperItem()
 //
 //////////////////////////////////////////////////////////////////////////////
 
-int CMainFrame::GetWallpaperItem(CFileInfo* pFile)
+int CMainFrame::GetWallpaperItem(FileHandle hFile)
 {
-    if (pFile)
-    {
-        LVFINDINFOW findInfo = { LVFI_PARAM, NULL, (LPARAM) pFile, {0,0}, 0 };
-        return m_ListView.FindItem(&findInfo, -1);
-    }
-    return -1;
+    size_t row = m_ListViewModel.GetRow(hFile);
+
+    return (row == CPlayListViewModel::InvalidRow) ? -1 : (int) row;
 }
 
 //****************************************************************************
@@ -293,16 +781,21 @@ LRESULT CMainFrame::OnGetEmptyMarkup(NMHDR* phdr)
 // Handle LVN_GETDISPINFO notifications.
 LRESULT CMainFrame::OnGetDispInfo(NMHDR* phdr)
 {
+    // IMPORTANT: lParam is not set -- use GetListViewItemData() with iItem.
     NMLVDISPINFO* pNotify = (NMLVDISPINFO*) phdr;
-    CFileInfo* pFile = (CFileInfo*) pNotify->item.lParam;
+    FileHandle hFile = GetListViewItemData(pNotify->item.iItem);
+    const CFileInfo& fileInfo = m_PlayList.GetFileInfo(hFile);
 
     if (pNotify->item.mask & LVIF_TEXT)
     {
         static WCHAR wszItemName[MAX_PATH];
 
-        ::StringCbCopyW(wszItemName,
-                        sizeof(wszItemName),
-                        pFile->GetDisplayName());
+        std::wstring_view displayName = fileInfo.GetDisplayName();
+
+        ::StringCchCopyNW(wszItemName,
+                          _countof(wszItemName),
+                          displayName.data(),
+                          displayName.size());
 
         pNotify->item.pszText = wszItemName;
 
@@ -311,46 +804,85 @@ LRESULT CMainFrame::OnGetDispInfo(NMHDR* phdr)
 
     if (pNotify->item.mask & LVIF_IMAGE)
     {
-        int* pImageListIndex = nullptr;
+        int imageListIndex;
+        CThumbnailKey thumbnailKey;
 
-        if (m_ImageListCache.Lookup(pFile, &pImageListIndex))
+        if (!GetThumbnailKey(hFile, &thumbnailKey))
+        {
+            // The file is missing or can't be read. It isn't asked
+            // for again on every repaint.
+
+            pNotify->item.iImage = m_PlaceholderImage;
+        }
+        else if (m_ImageListCache.Find(thumbnailKey, &imageListIndex))
         {
             // Image is already in the cache.
 
-            pNotify->item.iImage = *pImageListIndex;
+            pNotify->item.iImage = imageListIndex;
 
             // DebugPrintCmdSpew("OnGetDispInfo: CACHED [%d] iImage = %d\n", pNotify->item.iItem, pNotify->item.iImage);
         }
         else
         {
-            // Image isn't in the cache. Add it.
-
-            CBitmap thumbnailBitmap = pFile->GetLargeThumbnail();
-
-            if (thumbnailBitmap.IsNull())
-            {
-                ATLASSERT(false);
-                return 0;
-            }
-
-            ResizeWallpaperBitmap(&thumbnailBitmap.m_hBitmap,
-                                  m_ThumbnailSize,
-                                  WallpaperManager.GetResizeMode(),
-                                  GetSysColor(COLOR_WINDOW));
-
-            if (*pImageListIndex == -1)
-            {
-                *pImageListIndex = m_ImageList.Add(thumbnailBitmap);
-                pNotify->item.iImage = *pImageListIndex;
-                // DebugPrintCmdSpew("OnGetDispInfo: ADD [%d] iImage = %d\n", pNotify->item.iItem, pNotify->item.iImage);
-            }
-            else
-            {
-                m_ImageList.Replace(*pImageListIndex, thumbnailBitmap, NULL);
-                pNotify->item.iImage = *pImageListIndex;
-                // DebugPrintCmdSpew("OnGetDispInfo: REPLACE [%d] iImage = %d\n", pNotify->item.iItem, pNotify->item.iImage);
-            }
+            // Image isn't in the cache. Show the placeholder, and load the
+            // thumbnail in the background. OnThumbnailsReady() adds it to
+            // the cache and redraws the item.
+
+            pNotify->item.iImage = m_PlaceholderImage;
+
+            m_pThumbnailLoader->Request(hFile, m_PlayList.GetFullPath(hFile), thumbnailKey);
+
+            // DebugPrintCmdSpew("OnGetDispInfo: REQUEST [%d]\n", pNotify->item.iItem);
+        }
+    }
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnThumbnailsReady
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_THUMBNAILS_READY messages from the thumbnail loader.
+LRESULT CMainFrame::OnThumbnailsReady(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/)
+{
+    std::vector<CThumbnailLoader::Result> results;
+
+    m_pThumbnailLoader->TakeResults(results);
+
+    for (CThumbnailLoader::Result& result: results)
+    {
+        CBitmap thumbnailBitmap = result.m_hBitmap;
+
+        // The file may have been removed while its thumbnail was being
+        // loaded, and its handle reused for a different file.
+        if (!m_PlayList.IsValid(result.m_hFile) ||
+            m_PlayList.GetFullPath(result.m_hFile) != result.m_Path)
+        {
+            continue;
         }
+
+        // Keep the size and time the loader thread got, even if the
+        // thumbnail couldn't be made, so the file isn't stat'ed again.
+        m_PlayList.SetFileStat(result.m_hFile, { result.m_Key.m_FileSize, result.m_Key.m_LastWriteTime });
+
+        if (thumbnailBitmap.IsNull())
+            continue;
+
+        int* pImageListIndex = m_ImageListCache.Insert(result.m_Key, GetThumbnailBytes());
+
+        if (*pImageListIndex == -1)
+            *pImageListIndex = m_ImageList.Add(thumbnailBitmap);
+        else
+            m_ImageList.Replace(*pImageListIndex, thumbnailBitmap, NULL);
+
+        // DebugPrintCmdSpew("OnThumbnailsReady: iImage = %d\n", *pImageListIndex);
+
+        int iItem = GetWallpaperItem(result.m_hFile);
+        if (iItem != -1)
+            m_ListView.RedrawItems(iItem, iItem);
     }
 
     return 0;
@@ -367,14 +899,50 @@ LRESULT CMainFrame::OnGetInfoTip(NMHDR* phdr)
 {
     // IMPORTANT: lParam is not set -- use GetListViewItemData() with iItem.
     NMLVGETINFOTIP* pNotify = (NMLVGETINFOTIP*) phdr;
-    CFileInfo* pFile = GetListViewItemData(pNotify->iItem);
+    FileHandle hFile = GetListViewItemData(pNotify->iItem);
 
     // DebugPrintCmdSpew("OnGetInfoTip: iItem = %d\n", pNotify->iItem);
 
     // Show full path in the tooltip.
     ::StringCchCopyW(pNotify->pszText,
                      pNotify->cchTextMax,
-                     pFile->m_FullPath.c_str());
+                     m_PlayList.GetFullPath(hFile).c_str());
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnBeginScroll
+//  CMainFrame::OnEndScroll
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle LVN_BEGINSCROLL notifications.
+LRESULT CMainFrame::OnBeginScroll(NMHDR* /*phdr*/)
+{
+    // Follow the scrolling, to prefetch the thumbnails
+    // of the items that are about to come into view.
+    UpdatePrefetch();
+    SetTimer(ID_PREFETCH_TIMER, PrefetchTimerInterval, NULL);
+
+    return 0;
+}
+
+// Handle LVN_ENDSCROLL notifications.
+LRESULT CMainFrame::OnEndScroll(NMHDR* /*phdr*/)
+{
+    KillTimer(ID_PREFETCH_TIMER);
+
+    // Thumbnails requested while scrolling are mostly for items that have
+    // scrolled out of view again. Cancel them, and repaint so the items
+    // that are in view now ask for their thumbnails again.
+    m_pThumbnailLoader->Cancel([] (FileHandle /*hFile*/) { return true; });
+
+    m_ListView.Invalidate(FALSE);
+
+    // Prefetch around where the scrolling stopped.
+    UpdatePrefetch();
 
     return 0;
 }
@@ -390,27 +958,96 @@ LRESULT CMainFrame::OnItemChanged(NMHDR* phdr)
 {
     NMLISTVIEW* pNotify = (NMLISTVIEW*) phdr;
 
-    // Show information about selection in status bar.
+    if ((pNotify->uChanged & LVIF_STATE) == 0)
+        return 0;
 
-    int selectedCount = m_ListView.GetSelectedCount();
+    bool selected = (pNotify->uNewState & LVIS_SELECTED) != 0;
 
-    if (selectedCount == 1)
-    {
-        CFileInfo* pFile = GetListViewItemData(m_ListView.GetNextItem(-1, LVNI_SELECTED));
-        UISetText(ID_DEFAULT_PANE, (std::wstring(L"Selected: ") + std::wstring(pFile->m_FullPath)).c_str());
-    }
-    else if (selectedCount > 1)
+    // Keep the model's copy of the selection up to date.
+    // iItem is -1 if the change was applied to all items.
+    if (pNotify->iItem == -1)
+        m_ListViewModel.SetAllSelected(selected);
+    else if ((pNotify->uNewState ^ pNotify->uOldState) & LVIS_SELECTED)
+        m_ListViewModel.SetSelected(pNotify->iItem, pNotify->iItem, selected);
+
+    ShowSelectionInfo();
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnODStateChanged
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle LVN_ODSTATECHANGED notifications.
+LRESULT CMainFrame::OnODStateChanged(NMHDR* phdr)
+{
+    // Sent instead of LVN_ITEMCHANGED when a range
+    // of items is selected (e.g. shift + click).
+    NMLVODSTATECHANGE* pNotify = (NMLVODSTATECHANGE*) phdr;
+
+    if ((pNotify->uNewState ^ pNotify->uOldState) & LVIS_SELECTED)
     {
-        UISetText(ID_DEFAULT_PANE, Format(L"%d images selected\n", selectedCount).c_str());
+        m_ListViewModel.SetSelected(pNotify->iFrom,
+                                    pNotify->iTo,
+                                    (pNotify->uNewState & LVIS_SELECTED) != 0);
+
+        ShowSelectionInfo();
     }
-    else
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnODFindItem
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle LVN_ODFINDITEM notifications.
+LRESULT CMainFrame::OnODFindItem(NMHDR* phdr)
+{
+    // Sent when the user types in the listview, to find
+    // the next item whose name starts with what was typed.
+    NMLVFINDITEMW* pNotify = (NMLVFINDITEMW*) phdr;
+    const LVFINDINFOW& findInfo = pNotify->lvfi;
+
+    if ((findInfo.flags & LVFI_STRING) == 0 || findInfo.psz == NULL)
+        return -1;
+
+    size_t itemCount = m_ListViewModel.size();
+    size_t searchLength = wcslen(findInfo.psz);
+    bool partialMatch = (findInfo.flags & LVFI_PARTIAL) != 0;
+
+    size_t startItem = (pNotify->iStart > 0) ? (size_t) pNotify->iStart : 0;
+
+    for (size_t idx = 0; idx < itemCount; idx++)
     {
-        UISetText(ID_DEFAULT_PANE, L"No images selected\n");
-    }
+        size_t iItem = startItem + idx;
 
-    UIEnable(ID_PLAYLIST_REMOVE, (BOOL)(m_ListView.GetSelectedCount() > 0));
+        if (iItem >= itemCount)
+        {
+            if ((findInfo.flags & LVFI_WRAP) == 0)
+                break;
 
-    return 0;
+            iItem -= itemCount;
+        }
+
+        std::wstring_view displayName = m_PlayList.GetFileInfo(GetListViewItemData((int) iItem)).GetDisplayName();
+
+        if (displayName.size() < searchLength ||
+            (!partialMatch && displayName.size() != searchLength))
+        {
+            continue;
+        }
+
+        if (_wcsnicmp(displayName.data(), findInfo.psz, searchLength) == 0)
+            return (LRESULT) iItem;
+    }
+
+    return -1;
 }
 
 //////////////////////////////////////////////////////////////////////////////
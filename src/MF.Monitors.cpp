@@ -0,0 +1,275 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  MF.Monitors.cpp
+//
+//  CMainFrame per-monitor wallpaper functions.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "resource.h"
+
+#include "WallpaperChangerApp.h"
+
+#include "Options.h"
+#include "MainFrame.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnDisplayChange
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_DISPLAYCHANGE message.
+void CMainFrame::OnDisplayChange(UINT /*uBitsPerPixel*/, CSize /*sizeScreen*/)
+{
+    DebugPrintCmdSpew("WM_DISPLAYCHANGE\n");
+
+    // Monitors whose resolution changed get their wallpaper rendered
+    // again. If monitors came or went, the others' playback moves with
+    // them (it's kept by monitor, not by index).
+    if (WallpaperManager.OnDisplayChange() && WallpaperManager.IsPerMonitor())
+    {
+        LoadMonitorPlayback();
+        ChangeMonitorWallpapers(fs::path(WallpaperManager.GetCurrentWallpaperFile()));
+    }
+    else if (WallpaperManager.IsPerMonitor())
+    {
+        StartRenderTimer();
+    }
+
+    SetMsgHandled(FALSE);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::LoadMonitorPlayback
+//  CMainFrame::SaveMonitorPlayback
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::LoadMonitorPlayback()
+{
+    m_MonitorPlayback.clear();
+    m_MonitorPlayback.resize(WallpaperManager.GetMonitorCount());
+
+    for (size_t monitorIndex = 1; monitorIndex < m_MonitorPlayback.size(); monitorIndex++)
+    {
+        MonitorPlayback& playback = m_MonitorPlayback[monitorIndex];
+
+        CRegistryKey monitorKey = CWallpaperManager::GetMonitorRegistryKey(WallpaperManager.GetMonitorID(monitorIndex));
+
+        // A monitor plays the current playlist, unless it has its own.
+        // (If its own is the current one, it shares m_PlayList: two copies
+        // of a playlist would both journal to the same file, and edits
+        // made in one wouldn't reach the other.)
+        std::wstring playlistName;
+        if (monitorKey.Read(L"Playlist", playlistName) &&
+            !playlistName.empty() &&
+            _wcsicmp(playlistName.c_str(), m_PlayList.GetPlaylistName().c_str()) != 0)
+        {
+            fs::path playlistPath = CPlayList::NameToPath(playlistName);
+
+            if (fs::is_regular_file(playlistPath))
+            {
+                DebugPrint(L"Loading playlist for monitor %u: %s\n", (UINT) monitorIndex, playlistPath.c_str());
+
+                playback.m_pPlayList = std::make_unique<CPlayList>();
+                playback.m_pPlayList->Load(playlistPath);
+            }
+        }
+
+        // Pick up where this monitor left off (or at the same file in a
+        // new cycle, if the playlist file has been rewritten since).
+        CPlaybackPosition position;
+
+        if (CPlayList::ReadPlaybackPosition(monitorKey, &position))
+            playback.m_Cursor.SetPosition(GetMonitorPlaylist(monitorIndex), position);
+        else
+            playback.m_Cursor.Reset(GetMonitorPlaylist(monitorIndex), CShuffleOrder::MakeSeed(), 0);
+    }
+}
+
+void CMainFrame::SaveMonitorPlayback(size_t monitorIndex)
+{
+    const CPlaybackCursor& cursor = m_MonitorPlayback[monitorIndex].m_Cursor;
+
+    CRegistryKey monitorKey = CWallpaperManager::GetMonitorRegistryKey(WallpaperManager.GetMonitorID(monitorIndex));
+
+    CPlayList::WritePlaybackPosition(monitorKey, cursor.GetPosition(GetMonitorPlaylist(monitorIndex)));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::GetMonitorPlaylist
+//  CMainFrame::GetMonitorUpcomingFiles
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlayList& CMainFrame::GetMonitorPlaylist(size_t monitorIndex)
+{
+    if (monitorIndex == 0 || !m_MonitorPlayback[monitorIndex].m_pPlayList)
+        return m_PlayList;
+
+    return *m_MonitorPlayback[monitorIndex].m_pPlayList;
+}
+
+std::vector<FileHandle> CMainFrame::GetMonitorUpcomingFiles(size_t monitorIndex, size_t count)
+{
+    if (monitorIndex == 0)
+        return m_PlayList.GetUpcomingFiles(count);
+
+    return m_MonitorPlayback[monitorIndex].m_Cursor.GetUpcomingFiles(GetMonitorPlaylist(monitorIndex), count);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::MoveMonitorCursors
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::MoveMonitorCursors(bool forward)
+{
+    for (size_t monitorIndex = 1; monitorIndex < m_MonitorPlayback.size(); monitorIndex++)
+    {
+        CPlayList& playlist = GetMonitorPlaylist(monitorIndex);
+        CPlaybackCursor& cursor = m_MonitorPlayback[monitorIndex].m_Cursor;
+
+        // Use the monitor's prepared wallpaper if it's ready (see
+        // ShowNextOrPrev()).
+        FileHandle hFile = forward ? GetPreparedMonitorWallpaper(monitorIndex) : InvalidFileHandle;
+
+        if (hFile != InvalidFileHandle)
+            cursor.SetFile(playlist, hFile);
+        else
+            MoveToExistingFile(playlist, &cursor, forward);
+
+        SaveMonitorPlayback(monitorIndex);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::GetPreparedMonitorWallpaper
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle CMainFrame::GetPreparedMonitorWallpaper(size_t monitorIndex)
+{
+    fs::path preparedPath;
+
+    if (monitorIndex >= m_MonitorPlayback.size())
+        return InvalidFileHandle;
+
+    if (WallpaperManager.GetPreparedWallpaper(monitorIndex, &preparedPath) != CWallpaperCache::PREPARE_Ready)
+        return InvalidFileHandle;
+
+    // The playlist may have changed since it was prepared.
+    CPlayList& playlist = GetMonitorPlaylist(monitorIndex);
+
+    for (FileHandle hFile : GetMonitorUpcomingFiles(monitorIndex, MaxPrepareCandidates))
+    {
+        if (playlist.GetFullPath(hFile) == preparedPath)
+            return hFile;
+    }
+
+    return InvalidFileHandle;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::ChangeMonitorWallpapers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::ChangeMonitorWallpapers(const fs::path& wallpaperPath)
+{
+    // No monitors (the shell couldn't list them): show it on all of them.
+    if (m_MonitorPlayback.empty())
+    {
+        if (!wallpaperPath.empty())
+            WallpaperManager.SetWallpaper(wallpaperPath);
+        else
+            WallpaperManager.SetWallpaperToColor(WallpaperManager.GetBackgroundColor());
+        return;
+    }
+
+    // The first monitor shows the current file; the others show their
+    // cursors' files. A monitor whose playlist is empty keeps what it has.
+    std::vector<fs::path> wallpaperPaths(m_MonitorPlayback.size());
+    bool anyWallpaper = false;
+
+    for (size_t monitorIndex = 0; monitorIndex < wallpaperPaths.size(); monitorIndex++)
+    {
+        if (monitorIndex == 0)
+        {
+            wallpaperPaths[monitorIndex] = wallpaperPath;
+        }
+        else
+        {
+            CPlayList& playlist = GetMonitorPlaylist(monitorIndex);
+            FileHandle hFile = m_MonitorPlayback[monitorIndex].m_Cursor.GetFile();
+
+            if (playlist.IsValid(hFile))
+                wallpaperPaths[monitorIndex] = playlist.GetFullPath(hFile);
+        }
+
+        anyWallpaper |= !wallpaperPaths[monitorIndex].empty();
+    }
+
+    if (!anyWallpaper)
+    {
+        // Display solid color on desktop.
+        WallpaperManager.SetWallpaperToColor(WallpaperManager.GetBackgroundColor());
+        return;
+    }
+
+    WallpaperManager.SetMonitorWallpapers(wallpaperPaths);
+
+    // Pre-render each monitor's next few at its resolution.
+    for (size_t monitorIndex = 0; monitorIndex < wallpaperPaths.size(); monitorIndex++)
+    {
+        CPlayList& playlist = GetMonitorPlaylist(monitorIndex);
+
+        std::vector<fs::path> upcomingPaths;
+        for (FileHandle hFile : GetMonitorUpcomingFiles(monitorIndex, (size_t) GetAppOptions()->m_RenderAheadCount))
+            upcomingPaths.push_back(playlist.GetFullPath(hFile));
+
+        WallpaperManager.RenderAhead(monitorIndex, upcomingPaths);
+    }
+
+    // Monitors with a resize mode of their own show their wallpaper once
+    // it's rendered, if it wasn't rendered ahead.
+    StartRenderTimer();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::PrepareMonitorWallpapers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::PrepareMonitorWallpapers()
+{
+    // Each monitor's cache has its own render thread, so they're all
+    // prepared at once.
+    for (size_t monitorIndex = 0; monitorIndex < m_MonitorPlayback.size(); monitorIndex++)
+    {
+        CPlayList& playlist = GetMonitorPlaylist(monitorIndex);
+
+        std::vector<fs::path> candidatePaths;
+        for (FileHandle hFile : GetMonitorUpcomingFiles(monitorIndex, MaxPrepareCandidates))
+            candidatePaths.push_back(playlist.GetFullPath(hFile));
+
+        WallpaperManager.PrepareWallpaper(monitorIndex, candidatePaths);
+    }
+}
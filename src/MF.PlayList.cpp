@@ -23,8 +23,6 @@
 #include "Options.h"
 #include "MainFrame.h"
 
-#define SHUFFLE_PLAYLIST_ON_LOAD TRUE
-
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::LoadPlaylist
@@ -47,8 +45,15 @@ bool CMainFrame::LoadPlaylist(ConstWString playlistName)
         return false;
     }
 
+    // Images still being found in dropped folders
+    // were meant for the old playlist.
+
+    m_pDirectoryImport->Cancel();
+    m_Importing = false;
+    UIEnable(ID_PLAYLIST_STOP_ADDING, FALSE);
+
     // Clear the list view because all existing
-    // CFileInfo objects are about to be deleted.
+    // FileHandles are about to become invalid.
 
     ClearListView();
 
@@ -67,11 +72,10 @@ bool CMainFrame::LoadPlaylist(ConstWString playlistName)
                       MB_ICONWARNING | MB_OK);
     }
 
-#if SHUFFLE_PLAYLIST_ON_LOAD
-    m_PlayList.Shuffle();
-#else
-    m_PlayList.Sort();
-#endif
+    // Monitors that play this playlist start over in it.
+
+    if (WallpaperManager.IsPerMonitor())
+        LoadMonitorPlayback();
 
     // Update playlist MRU.
 
@@ -90,32 +94,24 @@ bool CMainFrame::LoadPlaylist(ConstWString playlistName)
 
     if (!m_PlayList.empty())
     {
-        std::wstring currentWallpaperFile = WallpaperManager.GetCurrentWallpaperFile();
+        FileHandle hCurrentFile = m_PlayList.Lookup(WallpaperManager.GetCurrentWallpaperFile());
 
-        auto it = std::find_if(m_PlayList.begin(), m_PlayList.end(),
-                               [currentWallpaperFile] (CFileInfo* pFile)
-                               { return pFile->m_FullPath == currentWallpaperFile; });
-
-        if (it == m_PlayList.end())
+        if (hCurrentFile == InvalidFileHandle)
         {
-#if SHUFFLE_PLAYLIST_ON_LOAD
-            // Display first image from the newly loaded playlist.
-            // List was shuffled after being loaded, so the "first"
-            // image is randomized.
-            CFileInfo* pFile = m_PlayList.front();
-            ChangeWallpaperImage(pFile->m_FullPath);
-#else
-            // Display random image from the newly loaded playlist.
-            CFileInfo* pFile = m_PlayList.GetRandom();
-            ChangeWallpaperImage(pFile->m_FullPath);
-#endif
+            // Pick up where this playlist left off: display the
+            // image at its saved position in the shuffled order.
+            FileHandle hFile = m_PlayList.GetCurrentFile();
+            ChangeWallpaperImage(m_PlayList.GetFullPath(hFile));
         }
         else
         {
+            // Continue the shuffled order from the current image.
+            m_PlayList.SetPlaybackFile(hCurrentFile);
+
             // "Change" to the image that is currently being displayed.
             // Done for the side effect of starting a new countdown
             // (exiting pause mode if needed) and updating the UI.
-            ChangeWallpaperImage((*it)->m_FullPath);
+            ChangeWallpaperImage(m_PlayList.GetFullPath(hCurrentFile));
         }
     }
     else
@@ -135,10 +131,22 @@ bool CMainFrame::LoadPlaylist(ConstWString playlistName)
 
 void CMainFrame::ChangeWallpaperImage(fs::path wallpaperPath)
 {
-    if (!wallpaperPath.empty())
+    if (WallpaperManager.IsPerMonitor())
+    {
+        // Display it on the first monitor, and the others' on theirs.
+        ChangeMonitorWallpapers(wallpaperPath);
+    }
+    else if (!wallpaperPath.empty())
     {
         // Display wallpaper image on desktop.
         WallpaperManager.SetWallpaper(wallpaperPath);
+
+        // Pre-render the next few, so changing to them is quick.
+        std::vector<fs::path> upcomingPaths;
+        for (FileHandle hFile : m_PlayList.GetUpcomingFiles((size_t) GetAppOptions()->m_RenderAheadCount))
+            upcomingPaths.push_back(m_PlayList.GetFullPath(hFile));
+
+        WallpaperManager.RenderAhead(upcomingPaths);
     }
     else
     {
@@ -153,48 +161,97 @@ void CMainFrame::ChangeWallpaperImage(fs::path wallpaperPath)
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CMainFrame::ShowNextOrPrev
+//  CMainFrame::GetPreparedWallpaper
 //
 //////////////////////////////////////////////////////////////////////////////
 
-CFileInfo* CMainFrame::ShowNextOrPrev(int nID)
+FileHandle CMainFrame::GetPreparedWallpaper()
 {
-    // Nothing to do if playlist is empty.
-    if (m_PlayList.size() == 0)
-        return nullptr;
+    fs::path preparedPath;
 
-    // Find the current wallpaper in playlist.
-    fs::path currentWallpaperFile = WallpaperManager.GetCurrentWallpaperFile();
-    auto it = std::find_if(m_PlayList.begin(), m_PlayList.end(),
-                           [currentWallpaperFile] (const CFileInfo* pFile)
-                           { return pFile->m_FullPath == currentWallpaperFile; });
+    if (WallpaperManager.GetPreparedWallpaper(&preparedPath) != CWallpaperCache::PREPARE_Ready)
+        return InvalidFileHandle;
 
-    if (nID == ID_WALLPAPER_NEXT)
+    // The playlist may have changed since it was prepared.
+    for (FileHandle hFile : m_PlayList.GetUpcomingFiles(MaxPrepareCandidates))
     {
-        if (it == m_PlayList.end())
-        {
-            // If current wallpaper not found, go to first image in playlist.
-            // This happens when you open a different playlist that doesn't
-            // contain the currently displayed wallpaper.
-            it = m_PlayList.begin();
-        }
-        else
+        if (m_PlayList.GetFullPath(hFile) == preparedPath)
+            return hFile;
+    }
+
+    return InvalidFileHandle;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::ShowNextOrPrev
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle CMainFrame::ShowNextOrPrev(int nID)
+{
+    // The other monitors move on too (they may have their own playlists).
+    if (WallpaperManager.IsPerMonitor())
+    {
+        MoveMonitorCursors(nID == ID_WALLPAPER_NEXT);
+
+        if (m_PlayList.size() == 0)
         {
-            // Go to next wallpaper in sequence. Wrap from end to beginning.
-            if (++it == m_PlayList.end())
-                it = m_PlayList.begin();
+            ChangeWallpaperImage(fs::path());
+            return InvalidFileHandle;
         }
     }
-    else
+
+    // Nothing to do if playlist is empty.
+    if (m_PlayList.size() == 0)
+        return InvalidFileHandle;
+
+    // Use the prepared next wallpaper if it's ready. Files before it in
+    // the shuffled order couldn't be used, so this skips them.
+    FileHandle hFile = InvalidFileHandle;
+    if (nID == ID_WALLPAPER_NEXT)
     {
-        // Go to previous wallpaper in sequence. Wrap from beginning to end.
-        if (it == m_PlayList.begin())
-            it = m_PlayList.end();
-        --it;
+        hFile = WallpaperManager.IsPerMonitor() ? GetPreparedMonitorWallpaper(0) : GetPreparedWallpaper();
+        if (hFile != InvalidFileHandle)
+            m_PlayList.SetPlaybackFile(hFile);
     }
 
+    // Go to next/previous wallpaper in the shuffled order. The playlist
+    // keeps track of the current wallpaper (see SetPlaybackFile()), so
+    // there's no need to look it up.
+    if (hFile == InvalidFileHandle)
+        hFile = MoveToExistingFile(m_PlayList, NULL, nID == ID_WALLPAPER_NEXT);
+
     // Display the new wallpaper image.
-    ChangeWallpaperImage((*it)->m_FullPath);
+    ChangeWallpaperImage(m_PlayList.GetFullPath(hFile));
+
+    return hFile;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::MoveToExistingFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle CMainFrame::MoveToExistingFile(CPlayList& playlist, CPlaybackCursor* pCursor, bool forward)
+{
+    // Playlists loaded from the index aren't checked for missing files,
+    // so skip them here, the same as preparing does. Otherwise the
+    // desktop would go to a solid color. Gives up after as many files as
+    // preparing tries, so a folder that's gone doesn't stall the UI.
+    FileHandle hFile = InvalidFileHandle;
+
+    for (size_t attempt = 0; attempt < MaxPrepareCandidates; attempt++)
+    {
+        hFile = pCursor ? pCursor->Move(playlist, forward) : playlist.MovePlaybackCursor(forward);
+
+        std::error_code ec;
+        if (hFile == InvalidFileHandle || fs::is_regular_file(playlist.GetFullPath(hFile), ec))
+            break;
+
+        DebugPrint(L"Skipping missing file: %s\n", playlist.GetFullPath(hFile).c_str());
+    }
 
-    return *it;
+    return hFile;
 }
@@ -60,6 +60,68 @@ void CMainFrame::OnUserInterfaceUpdateTimer(UINT_PTR /*nID*/)
         StopUserInterfaceUpdateTimer();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnPrefetchTimer
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_TMER message for ID_PREFETCH_TIMER.
+void CMainFrame::OnPrefetchTimer(UINT_PTR /*nID*/)
+{
+    // Runs while the listview is scrolling (see OnBeginScroll()).
+    UpdatePrefetch();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnPrepareTimer
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_TMER message for ID_PREPARE_TIMER.
+void CMainFrame::OnPrepareTimer(UINT_PTR /*nID*/)
+{
+    DebugPrintCmdSpew("WM_TIMER: ID_PREPARE_TIMER\n");
+
+    // Only fires once per countdown.
+    StopPrepareTimer();
+
+    if (IsPaused())
+        return;
+
+    // Prepare the next wallpaper in the background, so all that's left
+    // when the countdown reaches zero is to set it. Files that are missing
+    // or can't be decoded are skipped now, rather than when it's too late
+    // to pick another one (see ShowNextOrPrev()).
+    if (WallpaperManager.IsPerMonitor())
+    {
+        PrepareMonitorWallpapers();
+        return;
+    }
+
+    std::vector<fs::path> candidatePaths;
+    for (FileHandle hFile : m_PlayList.GetUpcomingFiles(MaxPrepareCandidates))
+        candidatePaths.push_back(m_PlayList.GetFullPath(hFile));
+
+    WallpaperManager.PrepareWallpaper(candidatePaths);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnRenderTimer
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_TMER message for ID_RENDER_TIMER.
+void CMainFrame::OnRenderTimer(UINT_PTR /*nID*/)
+{
+    DebugPrintCmdSpew("WM_TIMER: ID_RENDER_TIMER\n");
+
+    if (!WallpaperManager.ShowRenderedWallpapers())
+        KillTimer(ID_RENDER_TIMER);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::SetCountdownTimerInterval
@@ -104,6 +166,9 @@ void CMainFrame::BeginCountdown()
     // Start countdown timer.
     m_CountdownTimer.Start();
 
+    // Start timer to prepare the next wallpaper.
+    StartPrepareTimer();
+
     // Show countdown in user interface.
     ShowCountdownTimer();
 
@@ -171,6 +236,7 @@ void CMainFrame::PauseTimedChanges()
     if (!IsPaused())
     {
         m_CountdownTimer.Pause();
+        StopPrepareTimer();
 
         GetAppOptions()->m_Paused = true;
         GetAppOptions()->SaveToRegistry();
@@ -186,7 +252,10 @@ void CMainFrame::ResumeTimedChanges()
         ExitPausedState();
 
         if (m_CountdownTimer.IsPaused())
+        {
             m_CountdownTimer.Resume();
+            StartPrepareTimer();
+        }
         else
             BeginCountdown();
     }
@@ -259,3 +328,44 @@ void CMainFrame::StopUserInterfaceUpdateTimer()
         KillTimer(ID_UI_UPDATE_TIMER);
     }
 }
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::StartPrepareTimer
+//  CMainFrame::StopPrepareTimer
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::StartPrepareTimer()
+{
+    StopPrepareTimer();
+
+    // Whatever was prepared was for an earlier countdown.
+    WallpaperManager.CancelPrepare();
+
+    int prepareAheadSeconds = GetAppOptions()->m_PrepareAheadSeconds;
+
+    if (prepareAheadSeconds == 0 || !m_CountdownTimer.IsStarted() || m_CountdownTimer.IsPaused())
+        return;
+
+    time_t secondsUntilPrepare = std::max(m_CountdownTimer.GetTimeRemaining() - (time_t) prepareAheadSeconds, (time_t) 0);
+
+    SetTimer(ID_PREPARE_TIMER, std::max((UINT) secondsUntilPrepare * 1000U, (UINT) USER_TIMER_MINIMUM), NULL);
+}
+
+void CMainFrame::StopPrepareTimer()
+{
+    KillTimer(ID_PREPARE_TIMER);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::StartRenderTimer
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CMainFrame::StartRenderTimer()
+{
+    // Stops itself when there's nothing left to show.
+    SetTimer(ID_RENDER_TIMER, RenderTimerInterval, NULL);
+}
@@ -338,8 +338,11 @@ LRESULT CMainFrame::OnToolbarPlaylistComboSelChange(UINT /*uNotifyCode*/, int /*
                 m_Toolbar_PlaylistCombo.GetLBText(nIndex, strItemText);
 
                 // Load new playlist.
+                CListViewState listViewState;
+                SaveListViewState(listViewState);
+
                 LoadPlaylist((LPWSTR)strItemText);
-                PopulateListView(WallpaperManager.GetCurrentWallpaperFile());
+                UpdateListView(listViewState, WallpaperManager.GetCurrentWallpaperFile());
             }
 
             // Set focus back to the main window
@@ -39,7 +39,24 @@ CMainFrame::CMainFrame()
     m_UserInterfaceUpdateTimerStarted(false),
 
     // Window isn't visible until explicitly shown.
-    m_WindowIsVisible(false)
+    m_WindowIsVisible(false),
+
+    // Listview items are added by PopulateListView().
+    m_ListViewModel(),
+
+    // Thumbnails are set up by CreateListView().
+    m_ThumbnailLevel(1),
+    m_WheelZoomDelta(0),
+    m_PlaceholderImage(-1),
+    m_ThumbnailPack(),
+    m_pThumbnailLoader(),
+    m_ThumbnailResizeMode(RESIZE_Fill),
+    m_ScrollPredictor(),
+
+    // Folder import is set up by OnCreate().
+    m_pDirectoryImport(),
+    m_Importing(false),
+    m_ImportedFileCount(0)
 {
 }
 
@@ -77,6 +94,16 @@ LRESULT CMainFrame::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/)
     // Create list view (initializes m_ListView and sets m_hWndClient).
     CreateListView();
 
+    // Find the images in dropped folders in the background.
+    // Wakes up the UI thread to add them to the playlist.
+    m_pDirectoryImport = std::make_unique<CDirectoryImport>(
+        /*LAMBDA*/ [hWnd = m_hWnd] ()
+        {
+            ::PostMessageW(hWnd, WM_DIRECTORY_FILES_READY, 0, 0);
+        });
+
+    UIEnable(ID_PLAYLIST_STOP_ADDING, FALSE);
+
     // Load last used playlist (initializes m_PlayList).
     LoadPlaylist(GetAppOptions()->GetRecentPlaylistName(0));
 
@@ -133,8 +160,9 @@ void CMainFrame::OnDestroy()
     pLoop->RemoveMessageFilter(this);
     pLoop->RemoveIdleHandler(this);
 
-    // Stop being a drop target.
+    // Stop being a drop target, and stop adding dropped folders.
     DragAcceptFiles(FALSE);
+    m_pDirectoryImport.reset();
 
     // Remove tray icon.
     m_TrayIcon.Destroy();
@@ -142,6 +170,12 @@ void CMainFrame::OnDestroy()
     // Stop timers.
     m_CountdownTimer.Stop();
     StopUserInterfaceUpdateTimer();
+    KillTimer(ID_PREFETCH_TIMER);
+    StopPrepareTimer();
+
+    // Stop loading thumbnails.
+    m_pThumbnailLoader.reset();
+    m_ThumbnailPack.Close();
 
     // Unregister hotkeys.
     ::UnregisterHotKey(m_hWnd, ID_WALLPAPER_NEXT);
@@ -186,6 +220,32 @@ void CMainFrame::OnEndSession(BOOL bEnding, UINT uLogOff)
         DestroyWindow();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnSettingChange
+//  CMainFrame::OnSysColorChange
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_SETTINGCHANGE message.
+void CMainFrame::OnSettingChange(UINT uFlags, LPCTSTR /*lpszSection*/)
+{
+    // The wallpaper (or its position) may have been changed by somebody else.
+    if (uFlags == SPI_SETDESKWALLPAPER)
+        WallpaperManager.OnWallpaperSettingsChanged();
+
+    SetMsgHandled(FALSE);
+}
+
+// Handle WM_SYSCOLORCHANGE message.
+void CMainFrame::OnSysColorChange()
+{
+    // The desktop background color may have been changed by somebody else.
+    WallpaperManager.OnWallpaperSettingsChanged();
+
+    SetMsgHandled(FALSE);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::OnSize
@@ -300,6 +360,22 @@ void CMainFrame::OnDropFiles(HDROP hDrop)
         strPath.resize(pathLength);
         ::DragQueryFileW(hDrop, idx, strPath.data(), pathLength + 1);
 
+        // Folders (and their subfolders) are scanned in the background.
+        // OnDirectoryFilesReady() adds their images as they're found.
+        if (fs::is_directory(strPath))
+        {
+            if (!m_Importing)
+            {
+                m_Importing = true;
+                m_ImportedFileCount = 0;
+            }
+
+            m_pDirectoryImport->Add(strPath, true);
+            UIEnable(ID_PLAYLIST_STOP_ADDING, TRUE);
+            UISetText(ID_DEFAULT_PANE, L"Adding images...");
+            continue;
+        }
+
         // Make sure "file" is really a file and not a directory.
         if (!fs::is_regular_file(strPath))
             continue;
@@ -313,6 +389,8 @@ void CMainFrame::OnDropFiles(HDROP hDrop)
         if (it == m_PlayList.end())
             continue;  // File is already in playlist.
 
+        m_PlayList.JournalAdd(*it);
+
         // Add file to listview.
         int iItem = AddFileToListView(*it);
 
@@ -327,7 +405,7 @@ void CMainFrame::OnDropFiles(HDROP hDrop)
 
     // Save the updated playlist (but only if a file was added).
     if (iFirstAddedItem != -1)
-        m_PlayList.Save();
+        m_PlayList.SaveChanges();
 
     // Free memory for drag-and-drop.
     ::DragFinish(hDrop);
@@ -336,6 +414,70 @@ void CMainFrame::OnDropFiles(HDROP hDrop)
     OnAppOpen(0, 0, nullptr);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMainFrame::OnDirectoryFilesReady
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Handle WM_DIRECTORY_FILES_READY messages from the directory import.
+LRESULT CMainFrame::OnDirectoryFilesReady(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/)
+{
+    if (!m_Importing)
+        return 0;
+
+    std::vector<fs::path> files;
+
+    bool moreToCome = m_pDirectoryImport->TakeResults(files);
+
+    size_t importedFileCount = m_ImportedFileCount;
+
+    BeginListViewUpdate();
+
+    int iFirstAddedItem = -1;
+
+    for (const fs::path& path: files)
+    {
+        // Add file to playlist.
+        auto it = m_PlayList.Add(path, false);
+        if (it == m_PlayList.end())
+            continue;  // File is already in playlist.
+
+        m_PlayList.JournalAdd(*it);
+
+        // Add file to listview.
+        int iItem = AddFileToListView(*it);
+
+        // Select the first file of the import (but not of each batch,
+        // so the selection doesn't jump around while the user looks).
+        if (iFirstAddedItem == -1 && m_ImportedFileCount == 0)
+            iFirstAddedItem = iItem;
+
+        m_ImportedFileCount++;
+    }
+
+    EndListViewUpdate(iFirstAddedItem);
+
+    // Save the updated playlist (only if a file was added). Saved
+    // as the files come in, so closing during a long import keeps them.
+    if (m_ImportedFileCount != importedFileCount)
+        m_PlayList.SaveChanges();
+
+    if (moreToCome)
+    {
+        UISetText(ID_DEFAULT_PANE, Format(L"Adding images... %zu added", m_ImportedFileCount).c_str());
+    }
+    else
+    {
+        m_Importing = false;
+
+        UISetText(ID_DEFAULT_PANE, Format(L"%zu images added", m_ImportedFileCount).c_str());
+        UIEnable(ID_PLAYLIST_STOP_ADDING, FALSE);
+    }
+
+    return 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CMainFrame::PreTranslateMessage
@@ -344,6 +486,9 @@ void CMainFrame::OnDropFiles(HDROP hDrop)
 
 BOOL CMainFrame::PreTranslateMessage(MSG* pMsg)
 {
+    if (HandleWheelZoom(pMsg))
+        return TRUE;
+
     // Let frame window base class handle translation.
     return CFrameWindowImpl<CMainFrame>::PreTranslateMessage(pMsg);
 }
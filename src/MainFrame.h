@@ -21,6 +21,12 @@
 #include "PlayList.h"
 #include "CountdownTimer.h"
 #include "ImageListCache.h"
+#include "ThumbnailLoader.h"
+#include "DirectoryImport.h"
+#include "ThumbnailPack.h"
+#include "ScrollPredictor.h"
+#include "PlayListViewModel.h"
+#include "SequenceDiff.h"
 #include "WallpaperManager.h"
 #include "ToolBarHelper.h"
 
@@ -57,12 +63,36 @@
             return TRUE; \
     }
 
+// Posted by the thumbnail loader when thumbnails are ready to collect.
+#define WM_THUMBNAILS_READY (WM_APP + 1)
+
+// Posted by the directory import when images are ready to collect.
+#define WM_DIRECTORY_FILES_READY (WM_APP + 2)
+
 // Class name for the frame window. Doesn't need to be a GUID,
 // but does need to be a globally unique string. Used in WinMain()
 // to find an existing instance of the application and activate it,
 // rather than starting a new instance.
 #define FRAME_WND_CLASS_NAME L"{E37BBFBA-168F-4EF8-B799-3BDF269F1C90}"
 
+// ListView items and view state, saved before the playlist is reordered
+// or reloaded. Items are identified by path hash, because FileHandles
+// don't survive a reload.
+struct CListViewState
+{
+    // Path hash of each item.
+    std::vector<uint64_t> m_Keys;
+
+    std::vector<size_t> m_SelectedItems;
+
+    // Focused item, or -1.
+    int m_FocusedItem;
+
+    // First item in view, and its distance from the top of the view.
+    int m_TopItem;
+    int m_TopItemOffset;
+};
+
 // Main application frame window.
 class CMainFrame
     :
@@ -81,6 +111,7 @@ class CMainFrame
 
         BEGIN_UPDATE_UI_MAP(CMainFrame)
             UPDATE_ELEMENT(ID_PLAYLIST_REMOVE, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
+            UPDATE_ELEMENT(ID_PLAYLIST_STOP_ADDING, UPDUI_MENUPOPUP)
             UPDATE_ELEMENT(ID_WALLPAPER_CHANGE, UPDUI_MENUPOPUP)
             UPDATE_ELEMENT(ID_WALLPAPER_NEXT, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
             UPDATE_ELEMENT(ID_WALLPAPER_PREV, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
@@ -88,6 +119,8 @@ class CMainFrame
             UPDATE_ELEMENT(ID_WALLPAPER_SAFE, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
             UPDATE_ELEMENT(ID_WALLPAPER_PAUSE, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
             UPDATE_ELEMENT(ID_APP_LICENSE, UPDUI_MENUPOPUP)
+            UPDATE_ELEMENT(ID_VIEW_ZOOM_IN, UPDUI_MENUPOPUP)
+            UPDATE_ELEMENT(ID_VIEW_ZOOM_OUT, UPDUI_MENUPOPUP)
             UPDATE_ELEMENT(ID_DEFAULT_PANE, UPDUI_STATUSBAR)
         END_UPDATE_UI_MAP()
 
@@ -100,9 +133,15 @@ class CMainFrame
             MSG_WM_SHOWWINDOW(OnShowWindow)
             MSG_WM_INITMENUPOPUP(OnInitMenuPopup)
             MSG_WM_DROPFILES(OnDropFiles)
+            MSG_WM_SETTINGCHANGE(OnSettingChange)
+            MSG_WM_SYSCOLORCHANGE(OnSysColorChange)
+            MSG_WM_DISPLAYCHANGE(OnDisplayChange)
 
             TIMER_ID_HANDLER_EX(ID_COUNTDOWN_TIMER, OnCountdownTimer)
             TIMER_ID_HANDLER_EX(ID_UI_UPDATE_TIMER, OnUserInterfaceUpdateTimer)
+            TIMER_ID_HANDLER_EX(ID_PREFETCH_TIMER, OnPrefetchTimer)
+            TIMER_ID_HANDLER_EX(ID_PREPARE_TIMER, OnPrepareTimer)
+            TIMER_ID_HANDLER_EX(ID_RENDER_TIMER, OnRenderTimer)
 
 #ifdef _DEBUG
             MSG_WM_COMMAND(OnCommand)
@@ -121,7 +160,9 @@ class CMainFrame
             COMMAND_ID_HANDLER_EX(ID_PLAYLIST_MANAGER, OnPlaylistManager)
             COMMAND_ID_HANDLER_EX(ID_PLAYLIST_ADD, OnAddImage)
             COMMAND_ID_HANDLER_EX(ID_PLAYLIST_REMOVE, OnRemoveImage)
+            COMMAND_ID_HANDLER_EX(ID_PLAYLIST_STOP_ADDING, OnStopAdding)
             COMMAND_ID_HANDLER_EX(ID_PLAYLIST_SHUFFLE, OnShuffle)
+            COMMAND_RANGE_HANDLER_EX(ID_PLAYLIST_SORT_NAME, ID_PLAYLIST_SORT_DIMENSIONS, OnSort)
             COMMAND_ID_HANDLER_EX(ID_PLAYLIST_CURRENT, OnCurrent)
             COMMAND_RANGE_HANDLER_EX(ID_PLAYLIST_RECENT_1, ID_PLAYLIST_RECENT_5, OnOpenRecent)
             COMMAND_ID_HANDLER_EX(ID_EDIT_SELECT_ALL, OnSelectAll)
@@ -141,20 +182,28 @@ class CMainFrame
             COMMAND_ID_HANDLER_EX(ID_OPEN_IMAGE_FILE, OnOpenImage)
             COMMAND_ID_HANDLER_EX(ID_EDIT_IMAGE_FILE, OnEditImage)
             COMMAND_ID_HANDLER_EX(ID_OPEN_IMAGE_FOLDER, OnOpenContainingFolder)
+            COMMAND_ID_HANDLER_EX(ID_VIEW_ZOOM_IN, OnZoom)
+            COMMAND_ID_HANDLER_EX(ID_VIEW_ZOOM_OUT, OnZoom)
 
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_GETEMPTYMARKUP, OnGetEmptyMarkup)
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_GETDISPINFO, OnGetDispInfo)
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_GETINFOTIP, OnGetInfoTip)
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_ITEMCHANGED, OnItemChanged)
+            NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_ODSTATECHANGED, OnODStateChanged)
+            NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_ODFINDITEM, OnODFindItem)
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, NM_RCLICK, OnRightClick)
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, NM_DBLCLK, OnDoubleClick)
             NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, NM_RETURN, OnReturn)
+            NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_BEGINSCROLL, OnBeginScroll)
+            NOTIFY_HANDLER_EX(ID_PLAYLIST_VIEW, LVN_ENDSCROLL, OnEndScroll)
 
             COMMAND_HANDLER_EX(IDC_PLAYLISTS, CBN_DROPDOWN, OnToolbarPlaylistComboDropDown)
             COMMAND_HANDLER_EX(IDC_PLAYLISTS, CBN_SELCHANGE, OnToolbarPlaylistComboSelChange)
 
             MESSAGE_HANDLER_EX(WM_TRAYICON, OnTrayIconMsg)
             MESSAGE_HANDLER_EX(m_TrayIcon.m_TaskbarRestartMessage, OnTaskbarRestarted)
+            MESSAGE_HANDLER_EX(WM_THUMBNAILS_READY, OnThumbnailsReady)
+            MESSAGE_HANDLER_EX(WM_DIRECTORY_FILES_READY, OnDirectoryFilesReady)
             COMMAND_ID_HANDLER_EX(ID_APP_OPEN, OnAppOpen)
 
             CHAIN_MSG_MAP(CUpdateUI<CMainFrame>)
@@ -174,6 +223,9 @@ class CMainFrame
         void OnShowWindow(BOOL bShow, UINT nStatus);
         void OnInitMenuPopup(CMenuHandle menuPopup, UINT nIndex, BOOL bSysMenu);
         void OnDropFiles(HDROP hDrop);
+        LRESULT OnDirectoryFilesReady(UINT uMsg, WPARAM wParam, LPARAM lParam);
+        void OnSettingChange(UINT uFlags, LPCTSTR lpszSection);
+        void OnSysColorChange();
 
         // CMessageFilter implementation.
         virtual BOOL PreTranslateMessage(MSG* pMsg) override;
@@ -215,7 +267,11 @@ class CMainFrame
         }
 
         // Show next or previous wallpaper image.
-        CFileInfo* ShowNextOrPrev(int nID);
+        FileHandle ShowNextOrPrev(int nID);
+
+        // Move a playback cursor (the playlist's own if pCursor is NULL)
+        // to the next or previous file that still exists.
+        FileHandle MoveToExistingFile(CPlayList& playlist, CPlaybackCursor* pCursor, bool forward);
 
         //
         //  Countdown timer functions.
@@ -227,6 +283,15 @@ class CMainFrame
         // Handle WM_TMER message for ID_UI_UPDATE_TIMER.
         void OnUserInterfaceUpdateTimer(UINT_PTR nID);
 
+        // Handle WM_TMER message for ID_PREFETCH_TIMER.
+        void OnPrefetchTimer(UINT_PTR nID);
+
+        // Handle WM_TMER message for ID_PREPARE_TIMER.
+        void OnPrepareTimer(UINT_PTR nID);
+
+        // Handle WM_TMER message for ID_RENDER_TIMER.
+        void OnRenderTimer(UINT_PTR nID);
+
         // Set the countdown timer interval.
         void SetCountdownTimerInterval();
 
@@ -263,6 +328,58 @@ class CMainFrame
         // Stop the user interface update timer.
         void StopUserInterfaceUpdateTimer();
 
+        // Start the timer to prepare the next wallpaper a few seconds
+        // before the countdown reaches zero, and forget any wallpaper
+        // prepared earlier.
+        void StartPrepareTimer();
+
+        // Stop the prepare timer.
+        void StopPrepareTimer();
+
+        // Start the timer to show the monitors' wallpapers once they're
+        // rendered (see CWallpaperManager::ShowRenderedWallpapers()).
+        void StartRenderTimer();
+
+        // Get the prepared next wallpaper, if it's ready and is still one
+        // of the next files in the playback order. Returns InvalidFileHandle
+        // otherwise.
+        FileHandle GetPreparedWallpaper();
+
+        //
+        //  Per-monitor wallpaper functions.
+        //
+
+        // Handle WM_DISPLAYCHANGE message.
+        void OnDisplayChange(UINT uBitsPerPixel, CSize sizeScreen);
+
+        // Set up playback on each monitor: load the monitors' own
+        // playlists, and their playback positions.
+        void LoadMonitorPlayback();
+
+        // Save a monitor's playback position.
+        void SaveMonitorPlayback(size_t monitorIndex);
+
+        // Get the playlist a monitor plays.
+        CPlayList& GetMonitorPlaylist(size_t monitorIndex);
+
+        // Get the files that come after a monitor's current file.
+        std::vector<FileHandle> GetMonitorUpcomingFiles(size_t monitorIndex, size_t count);
+
+        // Move the playback cursor of every monitor after the first to
+        // the next or previous file. (The first monitor shows the current
+        // file, see ShowNextOrPrev().)
+        void MoveMonitorCursors(bool forward);
+
+        // Same as GetPreparedWallpaper(), for a monitor.
+        FileHandle GetPreparedMonitorWallpaper(size_t monitorIndex);
+
+        // Show a wallpaper image on the first monitor, and each other
+        // monitor's current file on it, and pre-render what comes next.
+        void ChangeMonitorWallpapers(const fs::path& wallpaperPath);
+
+        // Prepare the next wallpaper on every monitor (in parallel).
+        void PrepareMonitorWallpapers();
+
         //
         //  ListView functions.
         //
@@ -276,19 +393,70 @@ class CMainFrame
         // Populate ListView with items from playlist.
         void PopulateListView(const fs::path& selectedFile = fs::path());
 
-        // Add file to ListView.
-        int AddFileToListView(CFileInfo* pFile, int nItem = INT_MAX);
+        // Save the ListView's items, selection, and scroll position
+        // before the playlist is reordered or reloaded.
+        void SaveListViewState(CListViewState& state);
+
+        // Update the ListView after the playlist has been reordered or
+        // reloaded. Items that are still in the playlist keep their
+        // selection, and the view stays where it was if it can. If no
+        // selected item is left, selectedFile is selected.
+        void UpdateListView(const CListViewState& oldState, const fs::path& selectedFile);
+
+        // Get the path hash of each ListView item.
+        std::vector<uint64_t> GetListViewKeys();
+
+        // Add file to the end of the ListView. Returns its item number.
+        // The ListView's item count is updated by EndListViewUpdate().
+        int AddFileToListView(FileHandle hFile);
 
         // Begin ListView update.
         void BeginListViewUpdate();
 
-        // End ListView update.
+        // End ListView update. Sets the ListView's item count
+        // to match m_ListViewModel.
         void EndListViewUpdate(int iSelectedItem);
 
         // Force all listview items to be redrawn.
         // Use after image resize mode changes.
         void RefreshListView();
 
+        // Add the image shown until an item's thumbnail is loaded.
+        void AddPlaceholderImage();
+
+        // Start the thumbnail loader threads.
+        void CreateThumbnailLoader();
+
+        // Change the thumbnail size (thumbnail pyramid level,
+        // 0 = largest). Thumbnails are reloaded at the new size.
+        void SetThumbnailLevel(int level);
+
+        // Zoom the listview in or out with Ctrl+mouse wheel.
+        // Returns true if the message was handled.
+        bool HandleWheelZoom(const MSG* pMsg);
+
+        // Get the range of listview items that are in view.
+        // Returns false if there aren't any.
+        bool GetVisibleItems(int* pFirstItem, int* pItemCount);
+
+        // Predict which items are about to come into view,
+        // and ask for their thumbnails ahead of time.
+        void UpdatePrefetch();
+
+        // Get the thumbnail cache key for a file, from what's already known
+        // about it (doesn't touch the file system). Returns false if the
+        // file couldn't be stat'ed, so there's no thumbnail to load.
+        bool GetThumbnailKey(FileHandle hFile, CThumbnailKey* pKey);
+
+        // Get the number of bytes used by a thumbnail.
+        size_t GetThumbnailBytes() const
+        {
+            return (size_t) m_ThumbnailSize.cx * m_ThumbnailSize.cy * 4;
+        }
+
+        // Show information about the selection in the status bar.
+        void ShowSelectionInfo();
+
         // Get the currently selected ListView item.
         // If multiple items are selected, returns the one with focus.
         int GetCurrentSelectedItem();
@@ -302,12 +470,12 @@ class CMainFrame
         int GetCurrentWallpaperItem();
 
         // Get the ListView item for a particular wallpaper image.
-        int GetWallpaperItem(CFileInfo* pFile);
+        int GetWallpaperItem(FileHandle hFile);
 
-        // Get the CFileInfo associated with a ListView item.
-        FORCEINLINE CFileInfo* GetListViewItemData(int iItem)
+        // Get the FileHandle associated with a ListView item.
+        FORCEINLINE FileHandle GetListViewItemData(int iItem)
         {
-            return (CFileInfo*) m_ListView.GetItemData(iItem);
+            return m_ListViewModel.GetHandle((size_t) iItem);
         }
 
         //
@@ -318,9 +486,16 @@ class CMainFrame
         LRESULT OnGetDispInfo(NMHDR* phdr);
         LRESULT OnGetInfoTip(NMHDR* phdr);
         LRESULT OnItemChanged(NMHDR* phdr);
+        LRESULT OnODStateChanged(NMHDR* phdr);
+        LRESULT OnODFindItem(NMHDR* phdr);
         LRESULT OnRightClick(NMHDR* phdr);
         LRESULT OnDoubleClick(NMHDR* phdr);
         LRESULT OnReturn(NMHDR* phdr);
+        LRESULT OnBeginScroll(NMHDR* phdr);
+        LRESULT OnEndScroll(NMHDR* phdr);
+
+        // Handle WM_THUMBNAILS_READY from the thumbnail loader.
+        LRESULT OnThumbnailsReady(UINT uMsg, WPARAM wParam, LPARAM lParam);
 
         //
         //  Toolbar functions.
@@ -371,7 +546,9 @@ class CMainFrame
         LRESULT OnPlaylistManager(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnAddImage(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnRemoveImage(UINT uNotifyCode, int nID, CWindow wndCtl);
+        LRESULT OnStopAdding(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnShuffle(UINT uNotifyCode, int nID, CWindow wndCtl);
+        LRESULT OnSort(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnCurrent(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnOpenRecent(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnSelectAll(UINT uNotifyCode, int nID, CWindow wndCtl);
@@ -385,6 +562,7 @@ class CMainFrame
         LRESULT OnOpenImage(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnEditImage(UINT uNotifyCode, int nID, CWindow wndCtl);
         LRESULT OnOpenContainingFolder(UINT uNotifyCode, int nID, CWindow wndCtl);
+        LRESULT OnZoom(UINT uNotifyCode, int nID, CWindow wndCtl);
 
     private:
 
@@ -399,8 +577,26 @@ class CMainFrame
 
         CPlayList m_PlayList;
 
+        // Playback on a monitor (per-monitor wallpapers).
+        struct MonitorPlayback
+        {
+            // Its own playlist, or null to play m_PlayList.
+            std::unique_ptr<CPlayList> m_pPlayList;
+
+            CPlaybackCursor m_Cursor;
+        };
+
+        // Playback on each monitor, in CWallpaperManager's order. The first
+        // monitor's isn't used: it plays m_PlayList's current file (the one
+        // the list view shows), with the playlist's own cursor.
+        std::vector<MonitorPlayback> m_MonitorPlayback;
+
+        // Virtual (LVS_OWNERDATA) listview. The items
+        // and their selection are kept in m_ListViewModel.
         CListViewCtrl m_ListView;
 
+        CPlayListViewModel m_ListViewModel;
+
         CTrayIcon m_TrayIcon;
 
         CToolBarCtrl m_Toolbar;
@@ -410,16 +606,61 @@ class CMainFrame
 
         CMenuHandle m_PlaylistMenu;
 
-        // We only need a small cache.  Larger caches don't
-        // improve performance, and can burn a lot of memory.
-        static const int ImageListCacheSize = 4;
+        // Finds the images in folders dropped on the window,
+        // on a background thread.
+        std::unique_ptr<CDirectoryImport> m_pDirectoryImport;
+
+        // Is a folder import in progress? (Messages from a cancelled
+        // one can still arrive afterwards.)
+        bool m_Importing;
+
+        // Images added to the playlist by the current folder import.
+        size_t m_ImportedFileCount;
 
-        CImageListCache<ImageListCacheSize> m_ImageListCache;
+        // Thumbnails in m_ImageList, by file identity. Kept when another
+        // playlist is loaded, so switching back doesn't reload them.
+        CImageListCache m_ImageListCache;
 
         CImageListManaged m_ImageList;
 
+        // Size of the largest thumbnails (level 0 of the thumbnail
+        // pyramid). Depends on the main screen aspect ratio.
+        CSize m_ThumbnailBaseSize;
+
+        // Thumbnail pyramid level shown in the listview (0 = largest).
+        // Read by the thumbnail loader threads.
+        std::atomic<int> m_ThumbnailLevel;
+
+        // Size of the thumbnails shown in the listview.
         CSize m_ThumbnailSize;
 
+        // Mouse wheel movement not yet turned into zoom steps.
+        int m_WheelZoomDelta;
+
+        // Image list index of the placeholder thumbnail.
+        int m_PlaceholderImage;
+
+        // Thumbnails saved from earlier sessions. Used by the loader threads.
+        CThumbnailPack m_ThumbnailPack;
+
+        // Loads thumbnails on background threads.
+        std::unique_ptr<CThumbnailLoader> m_pThumbnailLoader;
+
+        // Resize mode for thumbnails. Read by the thumbnail loader threads.
+        std::atomic<WallpaperResizeMode> m_ThumbnailResizeMode;
+
+        // Tracks listview scrolling, to prefetch thumbnails.
+        CScrollPredictor m_ScrollPredictor;
+
+        // Prefetch timer interval while the listview is scrolling (ms).
+        static const UINT PrefetchTimerInterval = 50;
+
+        // Most files to try when preparing the next wallpaper.
+        static const size_t MaxPrepareCandidates = 8;
+
+        // How often to check for rendered monitor wallpapers (ms).
+        static const UINT RenderTimerInterval = 250;
+
         CCountdownTimer m_CountdownTimer;
 
         bool m_UserInterfaceUpdateTimerStarted;
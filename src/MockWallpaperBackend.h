@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  MockWallpaperBackend.h
+//
+//  CMockWallpaperBackend class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WallpaperSession.h"
+
+// A stand-in for the shell's wallpaper, for trying out CWallpaperSession
+// without a desktop. Keeps the "desktop" state in memory, counts calls,
+// can make each call take a while (like a round trip to explorer), and
+// can drop the connection (like explorer restarting).
+class CMockWallpaperBackend : public CWallpaperBackend
+{
+    public:
+
+        CMockWallpaperBackend(
+            std::chrono::microseconds callLatency = std::chrono::microseconds(0),
+            std::chrono::microseconds connectLatency = std::chrono::microseconds(0)
+        ) :
+            m_Monitors(1, CWallpaperMonitor{ L"MOCK#0", { 0, 0, 1920, 1080 } }),
+            m_WallpaperFile(),
+            m_MonitorWallpaperFiles(),
+            m_BackgroundColor(0),
+            m_Position(RESIZE_Fill),
+            m_Enabled(true),
+            m_ConnectCount(0),
+            m_GetCount(0),
+            m_SetCount(0),
+            m_CallLatency(callLatency),
+            m_ConnectLatency(connectLatency),
+            m_ConnectionAlive(false)
+        {
+        }
+
+        //
+        //  CWallpaperBackend
+        //
+
+        bool
+        Connect() override
+        {
+            Wait(m_ConnectLatency);
+            m_ConnectCount++;
+            m_ConnectionAlive = true;
+            return true;
+        }
+
+        void
+        Disconnect() override
+        {
+            m_ConnectionAlive = false;
+        }
+
+        bool
+        GetWallpaper(
+            std::wstring* pWallpaperFile
+        ) override
+        {
+            if (!BeginCall(&m_GetCount))
+                return false;
+
+            *pWallpaperFile = m_WallpaperFile;
+            return true;
+        }
+
+        bool
+        SetWallpaper(
+            const std::wstring& wallpaperFile
+        ) override
+        {
+            if (!BeginCall(&m_SetCount))
+                return false;
+
+            m_WallpaperFile = wallpaperFile;
+            m_Enabled = true;
+
+            for (const CWallpaperMonitor& monitor : m_Monitors)
+                m_MonitorWallpaperFiles[monitor.m_MonitorID] = wallpaperFile;
+
+            return true;
+        }
+
+        bool
+        GetMonitorWallpaper(
+            const std::wstring& monitorID,
+            std::wstring* pWallpaperFile
+        ) override
+        {
+            if (!BeginCall(&m_GetCount))
+                return false;
+
+            *pWallpaperFile = m_MonitorWallpaperFiles[monitorID];
+            return true;
+        }
+
+        bool
+        SetMonitorWallpaper(
+            const std::wstring& monitorID,
+            const std::wstring& wallpaperFile
+        ) override
+        {
+            if (!BeginCall(&m_SetCount))
+                return false;
+
+            m_MonitorWallpaperFiles[monitorID] = wallpaperFile;
+            m_Enabled = true;
+
+            // Like the shell: no single wallpaper if the monitors differ.
+            m_WallpaperFile = wallpaperFile;
+            for (const auto& entry : m_MonitorWallpaperFiles)
+            {
+                if (entry.second != wallpaperFile)
+                    m_WallpaperFile.clear();
+            }
+
+            return true;
+        }
+
+        bool
+        GetBackgroundColor(
+            COLORREF* pColor
+        ) override
+        {
+            if (!BeginCall(&m_GetCount))
+                return false;
+
+            *pColor = m_BackgroundColor;
+            return true;
+        }
+
+        bool
+        SetBackgroundColor(
+            COLORREF color
+        ) override
+        {
+            if (!BeginCall(&m_SetCount))
+                return false;
+
+            m_BackgroundColor = color;
+            return true;
+        }
+
+        bool
+        GetPosition(
+            WallpaperResizeMode* pPosition
+        ) override
+        {
+            if (!BeginCall(&m_GetCount))
+                return false;
+
+            *pPosition = m_Position;
+            return true;
+        }
+
+        bool
+        SetPosition(
+            WallpaperResizeMode position
+        ) override
+        {
+            if (!BeginCall(&m_SetCount))
+                return false;
+
+            m_Position = position;
+            return true;
+        }
+
+        bool
+        Enable(
+            bool enable
+        ) override
+        {
+            if (!BeginCall(&m_SetCount))
+                return false;
+
+            m_Enabled = enable;
+            return true;
+        }
+
+        bool
+        GetMonitors(
+            std::vector<CWallpaperMonitor>* pMonitors
+        ) override
+        {
+            if (!BeginCall(&m_GetCount))
+                return false;
+
+            *pMonitors = m_Monitors;
+            return true;
+        }
+
+        //
+        //  Simulation
+        //
+
+        // Drop the connection. Calls fail until the next Connect().
+        void
+        DropConnection()
+        {
+            m_ConnectionAlive = false;
+        }
+
+    public:
+
+        // The "desktop". Change m_Monitors to try another layout.
+        std::vector<CWallpaperMonitor> m_Monitors;
+        std::wstring m_WallpaperFile;
+        std::map<std::wstring, std::wstring> m_MonitorWallpaperFiles;
+        COLORREF m_BackgroundColor;
+        WallpaperResizeMode m_Position;
+        bool m_Enabled;
+
+        // Call counts.
+        int m_ConnectCount;
+        int m_GetCount;
+        int m_SetCount;
+
+    private:
+
+        bool
+        BeginCall(
+            int* pCount
+        )
+        {
+            if (!m_ConnectionAlive)
+                return false;
+
+            Wait(m_CallLatency);
+            (*pCount)++;
+            return true;
+        }
+
+        static
+        void
+        Wait(
+            std::chrono::microseconds latency
+        )
+        {
+            if (latency.count() != 0)
+                std::this_thread::sleep_for(latency);
+        }
+
+        std::chrono::microseconds m_CallLatency;
+        std::chrono::microseconds m_ConnectLatency;
+        bool m_ConnectionAlive;
+};
@@ -22,6 +22,7 @@
 
 #include "Options.h"
 #include "PlayList.h"
+#include "Resize.h"
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -49,6 +50,14 @@ void CWallpaperChangerOptions::ResetToDefaults()
     m_PrevImageHotkey    = { 'P', MOD_CONTROL | MOD_ALT };
     m_RandomImageHotkey  = { 'R', MOD_CONTROL | MOD_ALT };
     m_SafePlaylistHotkey = { 'B', MOD_CONTROL | MOD_ALT };
+    m_ThumbnailCacheSize = 64;
+    m_ThumbnailPackSize = 256;
+    m_ThumbnailHeight = 128;
+    m_LinearLightResizeModes = (1 << RESIZE_Stretch) | (1 << RESIZE_Fit) | (1 << RESIZE_Fill) | (1 << RESIZE_Span);
+    m_WallpaperCacheSize = 256;
+    m_RenderAheadCount = 3;
+    m_PrepareAheadSeconds = 15;
+    m_PerMonitorWallpaper = false;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -77,6 +86,74 @@ void CWallpaperChangerOptions::LoadFromRegistry()
     result |= (appKey.Read(L"Hotkey.Random", strHotKey) && m_RandomImageHotkey.Parse(strHotKey));
     result |= (appKey.Read(L"Hotkey.Safe", strHotKey)   && m_SafePlaylistHotkey.Parse(strHotKey));
 
+    result |= appKey.Read(L"ThumbnailCacheSize", m_ThumbnailCacheSize);
+    result |= appKey.Read(L"ThumbnailPackSize", m_ThumbnailPackSize);
+    result |= appKey.Read(L"ThumbnailHeight", m_ThumbnailHeight);
+    result |= appKey.Read(L"LinearLightResizeModes", m_LinearLightResizeModes);
+    result |= appKey.Read(L"WallpaperCacheSize", m_WallpaperCacheSize);
+    result |= appKey.Read(L"RenderAheadCount", m_RenderAheadCount);
+    result |= appKey.Read(L"PrepareAheadSeconds", m_PrepareAheadSeconds);
+    result |= appKey.Read(L"PerMonitorWallpaper", m_PerMonitorWallpaper);
+
+    // Validate thumbnail cache size.
+    if (m_ThumbnailCacheSize < 0)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid thumbnail cache size: %d\n", m_ThumbnailCacheSize);
+        m_ThumbnailCacheSize = 64;
+        result |= false;
+    }
+
+    // Validate thumbnail pack size.
+    if (m_ThumbnailPackSize < 0)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid thumbnail pack size: %d\n", m_ThumbnailPackSize);
+        m_ThumbnailPackSize = 256;
+        result |= false;
+    }
+
+    // Validate thumbnail height (only the thumbnail pyramid sizes).
+    if (m_ThumbnailHeight != 256 &&
+        m_ThumbnailHeight != 128 &&
+        m_ThumbnailHeight != 64 &&
+        m_ThumbnailHeight != 32)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid thumbnail height: %d\n", m_ThumbnailHeight);
+        m_ThumbnailHeight = 128;
+        result |= false;
+    }
+
+    // Validate linear light resize modes (only bits for resize modes).
+    if ((m_LinearLightResizeModes & ~((1 << (RESIZE_Span + 1)) - 1)) != 0)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid linear light resize modes: 0x%x\n", m_LinearLightResizeModes);
+        m_LinearLightResizeModes &= (1 << (RESIZE_Span + 1)) - 1;
+        result |= false;
+    }
+
+    // Validate wallpaper cache size.
+    if (m_WallpaperCacheSize < 0)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid wallpaper cache size: %d\n", m_WallpaperCacheSize);
+        m_WallpaperCacheSize = 256;
+        result |= false;
+    }
+
+    // Validate render ahead count (each one is a screen-sized file).
+    if (m_RenderAheadCount < 0 || m_RenderAheadCount > 16)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid render ahead count: %d\n", m_RenderAheadCount);
+        m_RenderAheadCount = 3;
+        result |= false;
+    }
+
+    // Validate prepare ahead time (less than the shortest change interval).
+    if (m_PrepareAheadSeconds < 0 || m_PrepareAheadSeconds >= 60)
+    {
+        DebugPrint(L"WallpaperChanger: Invalid prepare ahead time: %d\n", m_PrepareAheadSeconds);
+        m_PrepareAheadSeconds = 15;
+        result |= false;
+    }
+
     // Validate that playlists in MRU list exist.
     for (auto it = m_RecentPlaylists.begin(); it != m_RecentPlaylists.end(); )
     {
@@ -156,6 +233,15 @@ void CWallpaperChangerOptions::SaveToRegistry()
     appKey.Write(L"Hotkey.Prev", m_PrevImageHotkey.ToString());
     appKey.Write(L"Hotkey.Random", m_RandomImageHotkey.ToString());
     appKey.Write(L"Hotkey.Safe", m_SafePlaylistHotkey.ToString());
+
+    appKey.Write(L"ThumbnailCacheSize", m_ThumbnailCacheSize);
+    appKey.Write(L"ThumbnailPackSize", m_ThumbnailPackSize);
+    appKey.Write(L"ThumbnailHeight", m_ThumbnailHeight);
+    appKey.Write(L"LinearLightResizeModes", m_LinearLightResizeModes);
+    appKey.Write(L"WallpaperCacheSize", m_WallpaperCacheSize);
+    appKey.Write(L"RenderAheadCount", m_RenderAheadCount);
+    appKey.Write(L"PrepareAheadSeconds", m_PrepareAheadSeconds);
+    appKey.Write(L"PerMonitorWallpaper", m_PerMonitorWallpaper);
 }
 
 //////////////////////////////////////////////////////////////////////////////
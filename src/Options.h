@@ -60,6 +60,36 @@ class CWallpaperChangerOptions
         // Hotkey for "Safe Playlist".
         CHotKeyDefinition m_SafePlaylistHotkey;
 
+        // Memory for listview thumbnails (megabytes).
+        int m_ThumbnailCacheSize;
+
+        // Disk space for saved thumbnails (megabytes). 0 = don't save.
+        int m_ThumbnailPackSize;
+
+        // Listview thumbnail height (pixels): 256, 128, 64, or 32.
+        int m_ThumbnailHeight;
+
+        // Resize modes that filter in linear light instead of sRGB
+        // (bit 1 << WallpaperResizeMode for each).
+        int m_LinearLightResizeModes;
+
+        // Disk space for pre-rendered wallpapers (megabytes). 0 = don't
+        // pre-render.
+        int m_WallpaperCacheSize;
+
+        // Number of upcoming wallpapers to pre-render.
+        int m_RenderAheadCount;
+
+        // Seconds before a timed change to prepare the next wallpaper.
+        // 0 = don't prepare.
+        int m_PrepareAheadSeconds;
+
+        // Show a different wallpaper on each monitor? Each monitor goes
+        // through the current playlist on its own, or through a playlist
+        // of its own, with its own resize mode (see CWallpaperManager).
+        // Takes effect the next time the application starts.
+        bool m_PerMonitorWallpaper;
+
     public:
 
         CWallpaperChangerOptions();
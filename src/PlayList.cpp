@@ -2,7 +2,7 @@
 //
 //  PlayList.cpp
 //
-//  CFileInfo, CFileList, and CPlayList classes.
+//  CPlayList class.
 //
 //----------------------------------------------------------------------------
 //
@@ -20,361 +20,485 @@
 #include "WallpaperChangerApp.h"
 
 #include "PlayList.h"
+#include "PlayListFormat.h"
+#include "PlayListIndex.h"
+#include "PlayListJournal.h"
 #include "WallpaperManager.h"
 
 //============================================================================
 //
-//  CFileInfo
+//  CPlayList
 //
 //============================================================================
 
+// Write a playlist file.
+static bool WritePlaylistFile(const fs::path& path, const PlaylistEntries& entries)
+{
+    // Build the whole file in memory and write it in one go.
+    std::string fileData = FormatPlaylistFile(entries);
+
+    FILE* fp = _wfopen(path.c_str(), L"wb");
+
+    if (!fp)
+        return false;
+
+    bool ok = fwrite(fileData.data(), fileData.size(), 1, fp) == 1;
+
+    if (fclose(fp) != 0)
+        ok = false;
+
+    return ok;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileInfo::GetLargeThumbnail
+//  CPlayList::CPlayList
 //
 //////////////////////////////////////////////////////////////////////////////
 
-HBITMAP
-CFileInfo::GetLargeThumbnail()
-const
+CPlayList::CPlayList()
+    :
+    CFileList(),
+    m_PlaylistPath(),
+    m_pJournal(std::make_unique<CPlayListJournal>()),
+    m_Playback()
 {
-    HBITMAP hBitmap = NULL;
-
-    CComPtr<IShellItem> pItem;
-    HRESULT hr = ::SHCreateItemFromParsingName(m_FullPath.c_str(), nullptr, IID_PPV_ARGS(&pItem));
-    if (FAILED(hr))
-    {
-        // "This should never happen"
-        DebugPrint(L"SHCreateItemFromParsingName failed for %s\n", m_FullPath.c_str());
-        return NULL;
-    }
-
-    CComPtr<IShellItemImageFactory> pImageFactory;
-    hr = pItem->QueryInterface(IID_PPV_ARGS(&pImageFactory));
-    if (SUCCEEDED(hr))
-    {
-        hr = pImageFactory->GetImage({256, 256},
-                                     SIIGBF_ICONBACKGROUND,
-                                     &hBitmap);
-        if (FAILED(hr) && hBitmap != NULL)
-        {
-            // This seems like a very unlikely case (FAILED yet returned a bitmap),
-            // but we don't want to leak GDI handles, so we're going to deal with it.
-            ::DeleteObject(hBitmap);
-            hBitmap = NULL;
-        }
-    }
-
-    return hBitmap;
 }
 
-//============================================================================
+//////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList
+//  CPlayList::~CPlayList
 //
-//============================================================================
+//////////////////////////////////////////////////////////////////////////////
+
+CPlayList::~CPlayList()
+{
+    WaitForPendingWrites();
+}
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::Find
+//  CPlayList::CPlayList (move)
 //
 //////////////////////////////////////////////////////////////////////////////
 
-CFileList::iterator
-CFileList::Find(
-    const fs::path& path
+CPlayList::CPlayList(
+    CPlayList&& that
 )
+noexcept
+    :
+    CFileList(std::move(that)),
+    m_PlaylistPath(std::move(that.m_PlaylistPath)),
+    m_pJournal(std::move(that.m_pJournal)),
+    m_Playback(that.m_Playback)
 {
-    for (iterator it = begin(); it != end(); ++it)
-    {
-        if ((*it)->m_FullPath == path)
-            return it;
-    }
-    return end();
 }
 
-CFileList::iterator
-CFileList::Find(
-    const CFileInfo* pFile
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayList::operator= (move)
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlayList&
+CPlayList::operator=(
+    CPlayList&& that
 )
+noexcept
 {
-    for (iterator it = begin(); it != end(); ++it)
+    if (this != &that)
     {
-        if (*it == pFile)
-            return it;
+        WaitForPendingWrites();
+        CFileList::operator=(std::move(that));
+        m_PlaylistPath = std::move(that.m_PlaylistPath);
+        m_pJournal = std::move(that.m_pJournal);
+        m_Playback = that.m_Playback;
     }
-    return end();
+    return *this;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::Add
+//  CPlayList::Load
 //
 //////////////////////////////////////////////////////////////////////////////
 
-CFileList::iterator
-CFileList::Add(
-    const fs::path& path,
-    bool recurseIntoSubdirs /*= false*/
+bool
+CPlayList::Load(
+    const fs::path& path
 )
 {
-    if (fs::is_regular_file(path))
+    clear();
+
+    m_PlaylistPath = path;
+
+    if (!m_pJournal)
+        m_pJournal = std::make_unique<CPlayListJournal>();
+
+    bool ok = true;
+
+    // Use the binary index if it's up to date. Much faster than parsing
+    // the playlist, and the strings are used directly from the mapped file.
+    if (CPlayListIndex::Read(path, *this))
     {
-        return AddIfNew(path);
+        DebugPrint(L"CPlayList::Load: %zu files from index, %zu bytes (%zu bytes/file)\n",
+                   size(),
+                   GetMemoryUsage(),
+                   empty() ? (size_t) 0 : GetMemoryUsage() / size());
     }
-
-    if (fs::is_directory(path))
+    else
     {
-        // Keep track of the index of the first file added, so we can create
-        // an iterator when we're done. Can't create the iterator while adding
-        // files because the next push_back() would invalidate it.
-        size_t firstFileAdded = (size_t) -1;
+        std::string fileData = SlurpFile(path);
 
-        if (recurseIntoSubdirs)
-        {
-            for (const auto& entry: fs::recursive_directory_iterator(path))
-            {
-                if (entry.is_regular_file())
-                {
-                    if (AddIfNew(entry.path()) != end())
-                    {
-                        if (firstFileAdded == -1)
-                            firstFileAdded = m_Files.size() - 1;
-                    }
-                }
-            }
-        }
-        else
-        {
-            for (const auto& entry: fs::directory_iterator(path))
-            {
-                if (entry.is_regular_file())
-                {
-                    if (AddIfNew(entry.path()) != end())
-                    {
-                        if (firstFileAdded == -1)
-                            firstFileAdded = m_Files.size() - 1;
-                    }
-                }
-            }
-        }
+        if (!ParsePlaylistFile(fileData.data(), fileData.size(), *this))
+            ok = false;
+
+        DebugPrint(L"CPlayList::Load: %zu files, %zu bytes (%zu bytes/file)\n",
+                   size(),
+                   GetMemoryUsage(),
+                   empty() ? (size_t) 0 : GetMemoryUsage() / size());
 
-        return (firstFileAdded != -1) ? iat(firstFileAdded) : end();
+        // Rebuild the index for next time. Not if files were missing,
+        // because the playlist is about to be rewritten without them.
+        if (ok)
+            CPlayListIndex::Write(path, *this);
     }
 
-    return end();
+    // Apply the edits made since the playlist file was written.
+    if (!m_pJournal->Replay(path, *this))
+        ok = false;
+
+    // If the list is OK (i.e. isn't about to be saved anyway),
+    // fold a big journal back into the playlist file.
+    if (ok)
+        CompactJournalIfNeeded();
+
+    LoadPlaybackPosition();
+
+    return ok;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::AddIfNew
+//  CPlayList::Save
 //
 //////////////////////////////////////////////////////////////////////////////
 
-CFileList::iterator
-CFileList::AddIfNew(
+bool
+CPlayList::Save(
     const fs::path& path
 )
 {
-    if (Find(path) == end())
-    {
-        // New file.
-        m_Files.push_back(new CFileInfo(path));
-        return m_Files.end() - 1;
-    }
-    else
+    WaitForPendingWrites();
+
+    m_PlaylistPath = path;
+
+    if (!m_pJournal)
+        m_pJournal = std::make_unique<CPlayListJournal>();
+
+    // Rename current playlist file (if any) to .bak extension.
+    // The intent is to provide *some* recovery mechanism in case
+    // of failure during playlist write.  Recovery isn't exposed
+    // in UI -- a sophisticated user must go into the application
+    // data directory and manually fix it.
+    if (fs::is_regular_file(path))
     {
-        // File already exists.
-        return end();
+        std::error_code ec;
+        fs::path bakFilePath = fs::path(path).replace_extension(L"bak");
+        fs::remove(bakFilePath, ec);
+        fs::rename(path, bakFilePath, ec);
     }
+
+    if (!WritePlaylistFile(path, GetPlaylistEntries(*this)))
+        return false;
+
+    // The playlist file has all the edits now.
+    m_pJournal->Discard(path);
+
+    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::Sort
+//  CPlayList::JournalAdd
 //
 //////////////////////////////////////////////////////////////////////////////
 
 void
-CFileList::Sort()
+CPlayList::JournalAdd(
+    FileHandle hFile
+)
 {
-    using FileInfoPtr = CFileInfo*;
-
-    std::sort(m_Files.begin(),
-              m_Files.end(),
-              [] (const FileInfoPtr p1, const FileInfoPtr p2)
-              {
-#if 1
-                  // Sort using case insensitive comparison of display name.
-                  // The net effect is to ignore directories.
-                  return _wcsicmp(p1->GetDisplayName(), p2->GetDisplayName()) < 0;
-#else
-                  // Sort using case insensitive comparison of full path.
-                  // The net effect is to sort files by directory, and then
-                  // by file name and extension.
-                  // return _wcsicmp(p1->m_FullPath.c_str(), p2->m_FullPath.c_str()) < 0;
-#endif
-              });
+    if (m_pJournal)
+        m_pJournal->RecordAdd(GetFullPath(hFile));
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::Shuffle
+//  CPlayList::JournalRemove
 //
 //////////////////////////////////////////////////////////////////////////////
 
 void
-CFileList::Shuffle()
+CPlayList::JournalRemove(
+    FileHandle hFile
+)
 {
-    std::random_device seed;
-    std::mt19937 rng(seed());
-    std::shuffle(m_Files.begin(), m_Files.end(), rng);
+    if (m_pJournal)
+        m_pJournal->RecordRemove(GetFullPath(hFile));
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::GetRandom
+//  CPlayList::SaveChanges
 //
 //////////////////////////////////////////////////////////////////////////////
 
-CFileInfo*
-CFileList::GetRandom()
+bool
+CPlayList::SaveChanges()
 {
-    ATLASSERT(!m_Files.empty());
-    std::random_device seed;
-    std::mt19937 rng(seed());
-    return m_Files[rng() % m_Files.size()];
+    // Fall back to writing the whole list
+    // if the journal can't be written.
+    if (!m_pJournal || !m_pJournal->Commit(m_PlaylistPath))
+        return Save();
+
+    CompactJournalIfNeeded();
+
+    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::clear
+//  CPlayList::CompactJournalIfNeeded
 //
 //////////////////////////////////////////////////////////////////////////////
 
 void
-CFileList::clear()
-noexcept
+CPlayList::CompactJournalIfNeeded()
 {
-    // Remove all CFileInfo objects from the file list.
-    // Called by dtor, and can also be called by application.
+    if (!m_pJournal->NeedsCompaction())
+        return;
 
-    for (CFileInfo* pFile: m_Files)
-        delete pFile;
+    // The compaction thread writes a snapshot of the list,
+    // so the list can keep changing in the meantime.
+    PlaylistEntries entries = GetPlaylistEntries(*this);
 
-    m_Files.clear();
+    m_pJournal->Compact(
+        m_PlaylistPath,
+        /*LAMBDA*/ [entries = std::move(entries)] (const fs::path& tempPath)
+        {
+            return WritePlaylistFile(tempPath, entries);
+        }
+    );
+}
 
-    m_Files.shrink_to_fit();
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayList::WaitForPendingWrites
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayList::WaitForPendingWrites()
+{
+    if (m_pJournal)
+        m_pJournal->Wait();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CFileList::Remove
+//  CPlayList::SetPlaybackFile
 //
 //////////////////////////////////////////////////////////////////////////////
 
-bool
-CFileList::Remove(
-    iterator it
+void
+CPlayList::SetPlaybackFile(
+    FileHandle hFile
 )
 {
-    CFileInfo* pFile = *it;
+    SetCurrentFile(hFile);
 
-    delete pFile;
+    if (GetCurrentFile() == InvalidFileHandle)
+        return;
 
-    m_Files.erase(it);
+    uint64_t cursor = m_Playback.GetIndex();
 
-    return true;
+    m_Playback.SetFile(*this, hFile);
+
+    if (m_Playback.GetIndex() != cursor)
+        SavePlaybackPosition();
 }
 
-//============================================================================
+//////////////////////////////////////////////////////////////////////////////
 //
-//  CPlayList
+//  CPlayList::MovePlaybackCursor
 //
-//============================================================================
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle
+CPlayList::MovePlaybackCursor(
+    bool forward
+)
+{
+    // The current file may have been changed with SetCurrentFile().
+    m_Playback.SetFile(*this, GetCurrentFile());
+
+    FileHandle hFile = m_Playback.Move(*this, forward);
+
+    if (hFile != InvalidFileHandle)
+    {
+        SavePlaybackPosition();
+        SetCurrentFile(hFile);
+    }
+
+    return hFile;
+}
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CPlayList::Load
+//  CPlayList::GetUpcomingFiles
 //
 //////////////////////////////////////////////////////////////////////////////
 
-bool
-CPlayList::Load(
-    const fs::path& path
+std::vector<FileHandle>
+CPlayList::GetUpcomingFiles(
+    size_t count
 )
 {
-    clear();
+    m_Playback.SetFile(*this, GetCurrentFile());
 
-    m_PlaylistPath = path;
+    return m_Playback.GetUpcomingFiles(*this, count);
+}
 
-    bool ok = true;
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayList::LoadPlaybackPosition
+//  CPlayList::SavePlaybackPosition
+//
+//////////////////////////////////////////////////////////////////////////////
 
-    ForEachLineOfFile(
-        path,
-        /*LAMBDA*/ [this, &ok] (const std::wstring& lineW)
-        {
-            // Ignore comment lines.
-            if (lineW.front() == L';' || lineW.front() == L'#')
-                return true;
+// Get registry key for a playlist's settings.
+static CRegistryKey GetPlaylistRegistryKey(ConstWString playlistName)
+{
+    return GetApp()->GetAppRegistrySubKey((std::wstring(L"Playlists\\") + playlistName.c_str()).c_str());
+}
 
-            // Add file to the list.
-            if (this->Add(lineW) == this->end())
-            {
-                DebugPrint(L"CFileList::Load: Failed to add: %s\n", lineW.c_str());
-                ok = false;
-            }
+void
+CPlayList::LoadPlaybackPosition()
+{
+    CRegistryKey playlistKey = GetPlaylistRegistryKey(GetPlaylistName());
 
-            return true;
-        }
-    );
+    CPlaybackPosition position;
 
-    return ok;
+    if (ReadPlaybackPosition(playlistKey, &position))
+    {
+        // If the playlist file has been rewritten in another order since
+        // (e.g. compacted), this starts a new cycle at the saved file.
+        if (!m_Playback.SetPosition(*this, position))
+            DebugPrint(L"CPlayList::LoadPlaybackPosition: New cycle at %s\n", position.m_FilePath.c_str());
+    }
+    else
+    {
+        // First time this playlist has been played.
+        m_Playback.Reset(*this, CShuffleOrder::MakeSeed(), 0);
+    }
+
+    if (!empty())
+        SetCurrentFile(m_Playback.GetFile());
+}
+
+void
+CPlayList::SavePlaybackPosition()
+{
+    CRegistryKey playlistKey = GetPlaylistRegistryKey(GetPlaylistName());
+
+    WritePlaybackPosition(playlistKey, m_Playback.GetPosition(*this));
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //
-//  CPlayList::Save
+//  CPlayList::ReadPlaybackPosition
+//  CPlayList::WritePlaybackPosition
 //
 //////////////////////////////////////////////////////////////////////////////
 
+/*static*/
 bool
-CPlayList::Save(
-    const fs::path& path
+CPlayList::ReadPlaybackPosition(
+    const CRegistryKey& key,
+    CPlaybackPosition* pPosition
 )
 {
-    m_PlaylistPath = path;
-
-    // Rename current playlist file (if any) to .bak extension.
-    // The intent is to provide *some* recovery mechanism in case
-    // of failure during playlist write.  Recovery isn't exposed
-    // in UI -- a sophisticated user must go into the application
-    // data directory and manually fix it.
-    if (fs::is_regular_file(path))
+    UINT64 seed = 0;
+    UINT64 cursor = 0;
+    UINT64 domainSize = 0;
+    DWORD cycleAddCount = 0;
+    std::wstring filePath;
+
+    if (!key.Read(L"ShuffleSeed", seed) ||
+        !key.Read(L"ShuffleCursor", cursor) ||
+        !key.Read(L"ShuffleDomain", domainSize) ||
+        !key.Read(L"ShuffleAddCount", cycleAddCount) ||
+        !key.Read(L"ShuffleFile", filePath))
     {
-        std::error_code ec;
-        fs::path bakFilePath = fs::path(path).replace_extension(L"bak");
-        fs::remove(bakFilePath, ec);
-        fs::rename(path, bakFilePath, ec);
+        return false;
     }
 
-    FILE* fp = _wfopen(path.c_str(), L"wb");
+    pPosition->m_Seed          = seed;
+    pPosition->m_Index         = cursor;
+    pPosition->m_DomainSize    = domainSize;
+    pPosition->m_CycleAddCount = cycleAddCount;
+    pPosition->m_FilePath      = std::move(filePath);
 
-    if (!fp)
-        return false;
+    return true;
+}
 
-    fputs("# Wallpaper Changer playlist\r\n\r\n", fp);
+/*static*/
+void
+CPlayList::WritePlaybackPosition(
+    const CRegistryKey& key,
+    const CPlaybackPosition& position
+)
+{
+    key.Write(L"ShuffleSeed", (UINT64) position.m_Seed);
+    key.Write(L"ShuffleCursor", (UINT64) position.m_Index);
+    key.Write(L"ShuffleDomain", (UINT64) position.m_DomainSize);
+    key.Write(L"ShuffleAddCount", (DWORD) position.m_CycleAddCount);
+    key.Write(L"ShuffleFile", position.m_FilePath);
+}
 
-    for (const CFileInfo* pFile: m_Files)
-    {
-        std::string strU8 = UTF16_to_UTF8(pFile->m_FullPath);
-        fwrite(strU8.c_str(), strU8.size(), 1, fp);
-        fputs("\r\n", fp);
-    }
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayList::DeletePlaybackPosition
+//  CPlayList::RenamePlaybackPosition
+//
+//////////////////////////////////////////////////////////////////////////////
 
-    fclose(fp);
+/*static*/
+void
+CPlayList::DeletePlaybackPosition(
+    ConstWString playlistName
+)
+{
+    CRegistryKey playlistsKey = GetApp()->GetAppRegistrySubKey(L"Playlists");
+    playlistsKey.DeleteKey(playlistName);
+}
 
-    return true;
+/*static*/
+void
+CPlayList::RenamePlaybackPosition(
+    ConstWString oldName,
+    ConstWString newName
+)
+{
+    CPlaybackPosition position;
+
+    bool found = ReadPlaybackPosition(GetPlaylistRegistryKey(oldName), &position);
+
+    DeletePlaybackPosition(oldName);
+
+    if (found)
+        WritePlaybackPosition(GetPlaylistRegistryKey(newName), position);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -471,6 +595,8 @@ CPlayList::CreateDefaultPlaylists()
             CPlayList defaultPlaylist;
 
             // Add the currently displayed wallpaper to the Default playlist.
+            // (If it's a file we rendered, this gets the file it was
+            // rendered from instead.)
             fs::path currentWindowsWallpaper = CWallpaperManager::GetCurrentWindowsWallpaperFile();
             if (!currentWindowsWallpaper.empty() &&
                 fs::is_regular_file(currentWindowsWallpaper))
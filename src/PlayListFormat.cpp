@@ -0,0 +1,218 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListFormat.cpp
+//
+//  Playlist file and journal formats.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "PlayListFormat.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  GetPlaylistEntries
+//
+//////////////////////////////////////////////////////////////////////////////
+
+PlaylistEntries
+GetPlaylistEntries(
+    const CFileList& list
+)
+{
+    PlaylistEntries entries;
+    entries.reserve(list.size());
+
+    for (FileHandle hFile: list)
+    {
+        const CFileInfo& fileInfo = list.GetFileInfo(hFile);
+        entries.emplace_back(list.GetDirectoryInfo(fileInfo.GetDirectoryId()).GetPath(),
+                             fileInfo.GetFileName());
+    }
+
+    return entries;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FormatPlaylistFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+std::string
+FormatPlaylistFile(
+    const PlaylistEntries& entries
+)
+{
+    // Build the whole file in memory, so it can be written in one go.
+    std::string fileData = "# Wallpaper Changer playlist\r\n\r\n";
+
+    std::wstring fullPath;
+
+    for (const auto& entry: entries)
+    {
+        fullPath.assign(entry.first);
+        fullPath.append(entry.second);
+        fileData += UTF16_to_UTF8(fullPath);
+        fileData += "\r\n";
+    }
+
+    return fileData;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ParsePlaylistFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+ParsePlaylistFile(
+    const char* pData,
+    size_t dataSize,
+    CFileList& list
+)
+{
+    bool ok = true;
+
+    const char* pEndOfData = pData + dataSize;
+
+    for (const char* pLine = pData; pLine != pEndOfData; /**/)
+    {
+        // Find end of line (CR, LF, or end of data).
+        const char* pEndOfLine = pLine;
+        while (pEndOfLine != pEndOfData && *pEndOfLine != '\r' && *pEndOfLine != '\n')
+            ++pEndOfLine;
+
+        // Trim blanks.
+        const char* pStart = pLine;
+        const char* pEnd = pEndOfLine;
+
+        while (pStart != pEnd && (*pStart == ' ' || *pStart == '\t'))
+            ++pStart;
+        while (pEnd != pStart && (pEnd[-1] == ' ' || pEnd[-1] == '\t'))
+            --pEnd;
+
+        // Ignore blank lines and comment lines.
+        if (pStart != pEnd && *pStart != ';' && *pStart != '#')
+        {
+            fs::path filePath = UTF8_to_UTF16(std::string(pStart, pEnd));
+
+            // Add file to the list. (Get the end iterator after
+            // adding, because adding can reallocate the list.)
+            auto it = list.Add(filePath);
+            if (it == list.end())
+            {
+                DebugPrint(L"ParsePlaylistFile: Failed to add: %s\n", filePath.c_str());
+                ok = false;
+            }
+        }
+
+        // Skip CR/LF or LF at end of line.
+        if (pEndOfLine != pEndOfData && *pEndOfLine == '\r')
+            ++pEndOfLine;
+        if (pEndOfLine != pEndOfData && *pEndOfLine == '\n')
+            ++pEndOfLine;
+
+        pLine = pEndOfLine;
+    }
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  AppendJournalRecord
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+AppendJournalRecord(
+    std::string& records,
+    char recordType,
+    const fs::path& filePath
+)
+{
+    records += recordType;
+    records += UTF16_to_UTF8(filePath.wstring());
+    records += "\r\n";
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ReplayJournal
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CJournalReplayResult
+ReplayJournal(
+    const char* pData,
+    size_t dataSize,
+    CFileList& list
+)
+{
+    CJournalReplayResult result = { 0, 0, true };
+
+    size_t offset = 0;
+
+    while (offset < dataSize)
+    {
+        const char* pLine = pData + offset;
+        const char* pEnd = (const char*) memchr(pLine, '\n', dataSize - offset);
+
+        // Last record is incomplete. Ignore it.
+        if (!pEnd)
+            break;
+
+        offset = (pEnd - pData) + 1;
+
+        if (pEnd > pLine && pEnd[-1] == '\r')
+            --pEnd;
+
+        if (pEnd - pLine < 2)
+            continue;
+
+        std::string pathU8(pLine + 1, pEnd);
+        fs::path filePath = UTF8_to_UTF16(pathU8);
+
+        switch (*pLine)
+        {
+            case JournalAddRecord:
+            {
+                // Already in the list if the record was
+                // compacted into the playlist file.
+                auto it = list.Add(filePath, false);
+                if (it == list.end() && !list.Contains(filePath))
+                {
+                    DebugPrint(L"ReplayJournal: Failed to add: %s\n", filePath.c_str());
+                    result.m_AllAdded = false;
+                }
+                break;
+            }
+
+            case JournalRemoveRecord:
+                list.Remove(filePath);
+                break;
+
+            default:
+                DebugPrint(L"ReplayJournal: Bad record: %s\n", filePath.c_str());
+                break;
+        }
+
+        result.m_RecordCount++;
+    }
+
+    result.m_ValidSize = offset;
+
+    return result;
+}
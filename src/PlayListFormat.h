@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListFormat.h
+//
+//  Playlist file and journal formats.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileList.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Playlist file format
+//
+//  UTF-8 text, one full path per line. Lines starting with ';' or '#'
+//  are comments. Leading and trailing blanks, and blank lines, are
+//  ignored.
+//
+//  Nothing here touches files, so it doesn't use any Windows APIs.
+//  CPlayList and CPlayListJournal do the file handling.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Playlist entries for writing a playlist file: directory path and file name.
+// The strings live in the list's string arena, so they stay valid until the
+// list is cleared, even if the files are removed from the list.
+using PlaylistEntries = std::vector<std::pair<std::wstring_view, std::wstring_view>>;
+
+// Get playlist entries for the files in a list, in order.
+PlaylistEntries
+GetPlaylistEntries(
+    const CFileList& list
+);
+
+// Make the contents of a playlist file.
+std::string
+FormatPlaylistFile(
+    const PlaylistEntries& entries
+);
+
+// Add the files in a playlist file to a list. Returns false if a file
+// couldn't be added (e.g. it's a duplicate, or its path is too long).
+bool
+ParsePlaylistFile(
+    const char* pData,
+    size_t dataSize,
+    CFileList& list
+);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Journal format
+//
+//  UTF-8 records, one per line: "+path" for an added file, "-path" for a
+//  removed file, ending with CR LF. Records are only ever appended. A
+//  record without a line ending is torn (e.g. the write was cut short by
+//  a power failure), and is ignored.
+//
+//  Replaying a record that's already reflected in the list is harmless
+//  (the file is already there, or already gone), so a journal can be
+//  replayed on top of a playlist file that already has some of it.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Record types.
+static const char JournalAddRecord = '+';
+static const char JournalRemoveRecord = '-';
+
+// Result of replaying a journal.
+struct CJournalReplayResult
+{
+    // Number of complete records.
+    size_t m_RecordCount;
+
+    // Size of the complete records (bytes). Anything after
+    // this is a torn record.
+    size_t m_ValidSize;
+
+    // Were all the files added by the journal added (or already
+    // in the list)? False if one is no longer valid.
+    bool m_AllAdded;
+};
+
+// Append a record to a journal.
+void
+AppendJournalRecord(
+    std::string& records,
+    char recordType,
+    const fs::path& filePath
+);
+
+// Apply a journal's records to a list, in order.
+CJournalReplayResult
+ReplayJournal(
+    const char* pData,
+    size_t dataSize,
+    CFileList& list
+);
@@ -0,0 +1,122 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListIndex.cpp
+//
+//  CPlayListIndex class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "WallpaperChangerApp.h"
+
+#include "PlayListIndex.h"
+#include "PlayListIndexFormat.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndex::GetIndexPath
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+fs::path
+CPlayListIndex::GetIndexPath(
+    const fs::path& playlistPath
+)
+{
+    return fs::path(playlistPath) += L".idx";
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndex::Read
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CPlayListIndex::Read(
+    const fs::path& playlistPath,
+    CFileList& list
+)
+{
+    CMappedFile indexFile;
+    CMappedFile playlistFile;
+
+    if (!indexFile.Open(GetIndexPath(playlistPath)) ||
+        !playlistFile.Open(playlistPath))
+    {
+        return false;
+    }
+
+    if (!CPlayListIndexFormat::Read(indexFile.GetData(), indexFile.GetSize(), playlistFile.GetData(), playlistFile.GetSize(), list))
+    {
+        DebugPrint(L"CPlayListIndex::Read: Index is out of date or corrupt: %s\n", playlistPath.c_str());
+        return false;
+    }
+
+    // The strings stay in the mapped file.
+    list.m_Strings.AddMappedFile(std::move(indexFile));
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndex::Write
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CPlayListIndex::Write(
+    const fs::path& playlistPath,
+    const CFileList& list
+)
+{
+    std::vector<BYTE> indexData;
+
+    {
+        CMappedFile playlistFile;
+
+        if (!playlistFile.Open(playlistPath) ||
+            !CPlayListIndexFormat::Make(playlistFile.GetData(), playlistFile.GetSize(), list, indexData))
+        {
+            return false;
+        }
+    }
+
+    // Write to a temporary file, then replace the index, so a failure
+    // part way through can't leave a truncated index behind.
+
+    fs::path indexPath = GetIndexPath(playlistPath);
+    fs::path tempPath = fs::path(indexPath) += L".tmp";
+
+    if (!WriteDataToFile(tempPath, indexData))
+    {
+        DebugPrint(L"CPlayListIndex::Write: Failed to write: %s\n", tempPath.c_str());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    if (!::MoveFileExW(tempPath.c_str(), indexPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DebugPrint(L"CPlayListIndex::Write: Failed to replace: %s\n", indexPath.c_str());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListIndex.h
+//
+//  CPlayListIndex class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "PlayList.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndex
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Binary index for a playlist file ("Name.wppl.idx").
+//
+// The index holds everything needed to load the playlist: a string table
+// (directory paths and file names), display name lengths, sort keys, and
+// the file sizes and write times that were known when it was written (the
+// rest are zero, and looked up on demand). It's memory mapped and used in
+// place, so loading a playlist doesn't parse or convert any text, doesn't
+// touch the files in the list, and doesn't copy any strings. Files that
+// have gone missing are skipped when they come up for playback (see
+// CMainFrame::MoveToExistingFile()).
+//
+// The header records the size and checksum of the playlist file. If they
+// don't match (e.g. the playlist has been saved since), the index is
+// ignored, and rebuilt the next time the playlist is loaded.
+class CPlayListIndex
+{
+    public:
+
+        // Get path of the index for a playlist file.
+        static
+        fs::path
+        GetIndexPath(
+            const fs::path& playlistPath
+        );
+
+        // Load file list from the playlist's index.
+        // Returns false if the index is missing, invalid, or out of date.
+        static
+        bool
+        Read(
+            const fs::path& playlistPath,
+            CFileList& list
+        );
+
+        // Write index for a playlist. The list must contain
+        // exactly the files in the playlist file, in order.
+        static
+        bool
+        Write(
+            const fs::path& playlistPath,
+            const CFileList& list
+        );
+};
@@ -0,0 +1,269 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListIndexFormat.cpp
+//
+//  Playlist index file format, and CPlayListIndexFormat class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "PlayListIndexFormat.h"
+
+// Check that a table is within the index file, and properly aligned.
+static bool IsValidTable(uint64_t offset, uint64_t count, size_t entrySize, size_t fileSize)
+{
+    return (offset % 8) == 0 &&
+           offset <= fileSize &&
+           count <= (fileSize - offset) / entrySize;
+}
+
+// Round size up to a multiple of 8.
+static FORCEINLINE size_t Align8(size_t size)
+{
+    return (size + 7) & ~(size_t) 7;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ChecksumPlaylistFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+ChecksumPlaylistFile(
+    const void* pData,
+    size_t dataSize
+)
+{
+    const BYTE* pBytes = (const BYTE*) pData;
+
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t idx = 0; idx < dataSize; idx++)
+    {
+        hash ^= pBytes[idx];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndexFormat::Make
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CPlayListIndexFormat::Make(
+    const void* pPlaylistData,
+    size_t playlistSize,
+    const CFileList& list,
+    std::vector<BYTE>& indexData
+)
+{
+    IndexHeader header = {};
+    header.m_Magic            = IndexMagic;
+    header.m_Version          = IndexVersion;
+    header.m_PlaylistSize     = playlistSize;
+    header.m_PlaylistChecksum = ChecksumPlaylistFile(pPlaylistData, playlistSize);
+
+    // Build the string table and the directory and file tables.
+
+    std::vector<WCHAR> strings;
+
+    auto addString =
+        [&strings] (std::wstring_view str)
+        {
+            uint32_t offset = (uint32_t) strings.size();
+            strings.insert(strings.end(), str.begin(), str.end());
+            strings.push_back(L'\0');
+            return offset;
+        };
+
+    std::vector<IndexDirectory> directories(list.m_Directories.size());
+
+    for (size_t dirId = 0; dirId < directories.size(); dirId++)
+    {
+        const CDirectoryInfo& dirInfo = list.m_Directories[dirId];
+
+        IndexDirectory& entry = directories[dirId];
+        entry.m_PathOffset = addString(dirInfo.GetPath());
+        entry.m_ParentId   = dirInfo.m_ParentId;
+        entry.m_PathLength = dirInfo.m_PathLength;
+    }
+
+    std::vector<uint32_t> sortKeys = list.GetDisplayNameRanks();
+
+    // Only the file stats that are already known are stored. Statting
+    // every file here would hold up loading the playlist (this is called
+    // by CPlayList::Load()). The rest are filled in on demand, as usual.
+    // Failures aren't stored, so the files are tried again next time.
+    const CFileStat unknownStat = {};
+
+    std::vector<IndexFile> files(list.size());
+
+    for (size_t idx = 0; idx < files.size(); idx++)
+    {
+        FileHandle hFile = list.m_Files[idx];
+        const CFileInfo& fileInfo = list.m_FileInfo[hFile];
+        const CFileStat& fileStat = (hFile < list.m_FileStats.size() && !list.m_FileStats[hFile].IsFailed()) ? list.m_FileStats[hFile] : unknownStat;
+
+        IndexFile& entry = files[idx];
+        entry.m_NameOffset    = addString(fileInfo.GetFileName());
+        entry.m_DirectoryId   = fileInfo.m_DirectoryId;
+        entry.m_NameLength    = fileInfo.m_NameLength;
+        entry.m_StemLength    = fileInfo.m_StemLength;
+        entry.m_SortKey       = sortKeys[idx];
+        entry.m_Size          = fileStat.m_Size;
+        entry.m_LastWriteTime = fileStat.m_LastWriteTime;
+    }
+
+    // String offsets are 32 bits.
+    if (strings.size() > UINT32_MAX)
+        return false;
+
+    header.m_DirectoryCount       = (uint32_t) directories.size();
+    header.m_FileCount            = (uint32_t) files.size();
+    header.m_DirectoryTableOffset = Align8(sizeof(header));
+    header.m_FileTableOffset      = Align8(header.m_DirectoryTableOffset + directories.size() * sizeof(IndexDirectory));
+    header.m_StringTableOffset    = Align8(header.m_FileTableOffset + files.size() * sizeof(IndexFile));
+    header.m_StringTableSize      = strings.size();
+
+    indexData.assign(header.m_StringTableOffset + strings.size() * sizeof(WCHAR), 0);
+
+    memcpy(indexData.data(), &header, sizeof(header));
+    memcpy(indexData.data() + header.m_DirectoryTableOffset, directories.data(), directories.size() * sizeof(IndexDirectory));
+    memcpy(indexData.data() + header.m_FileTableOffset, files.data(), files.size() * sizeof(IndexFile));
+    memcpy(indexData.data() + header.m_StringTableOffset, strings.data(), strings.size() * sizeof(WCHAR));
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndexFormat::Read
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CPlayListIndexFormat::Read(
+    const void* pIndexData,
+    size_t indexSize,
+    const void* pPlaylistData,
+    size_t playlistSize,
+    CFileList& list
+)
+{
+    ATLASSERT(list.empty());
+
+    const BYTE* pData = (const BYTE*) pIndexData;
+
+    if (indexSize < sizeof(IndexHeader))
+        return false;
+
+    const IndexHeader& header = *(const IndexHeader*) pData;
+
+    if (header.m_Magic != IndexMagic || header.m_Version != IndexVersion)
+        return false;
+
+    // Make sure the index was built from the current playlist file.
+    if (playlistSize != header.m_PlaylistSize ||
+        ChecksumPlaylistFile(pPlaylistData, playlistSize) != header.m_PlaylistChecksum)
+    {
+        DebugPrint(L"CPlayListIndexFormat::Read: Index is out of date\n");
+        return false;
+    }
+
+    if (!IsValidTable(header.m_DirectoryTableOffset, header.m_DirectoryCount, sizeof(IndexDirectory), indexSize) ||
+        !IsValidTable(header.m_FileTableOffset, header.m_FileCount, sizeof(IndexFile), indexSize) ||
+        !IsValidTable(header.m_StringTableOffset, header.m_StringTableSize, sizeof(WCHAR), indexSize))
+    {
+        DebugPrint(L"CPlayListIndexFormat::Read: Index is corrupt\n");
+        return false;
+    }
+
+    const IndexDirectory* pDirectories = (const IndexDirectory*) (pData + header.m_DirectoryTableOffset);
+    const IndexFile* pFiles = (const IndexFile*) (pData + header.m_FileTableOffset);
+    const WCHAR* pStrings = (const WCHAR*) (pData + header.m_StringTableOffset);
+    const uint64_t stringTableSize = header.m_StringTableSize;
+
+    auto isValidString =
+        [pStrings, stringTableSize] (uint32_t offset, uint16_t length)
+        {
+            return offset < stringTableSize &&
+                   length < stringTableSize - offset &&
+                   pStrings[offset + length] == L'\0';
+        };
+
+    // Create the directory and file records. Strings stay in the index data.
+
+    list.m_Directories.resize(header.m_DirectoryCount);
+
+    for (DirectoryId dirId = 0; dirId < header.m_DirectoryCount; dirId++)
+    {
+        const IndexDirectory& entry = pDirectories[dirId];
+
+        // Parents always come before their children.
+        if (!isValidString(entry.m_PathOffset, entry.m_PathLength) ||
+            (entry.m_ParentId != InvalidDirectoryId && entry.m_ParentId >= dirId))
+        {
+            DebugPrint(L"CPlayListIndexFormat::Read: Index is corrupt\n");
+            list.clear();
+            return false;
+        }
+
+        CDirectoryInfo& dirInfo = list.m_Directories[dirId];
+        dirInfo.m_pPath      = pStrings + entry.m_PathOffset;
+        dirInfo.m_ParentId   = entry.m_ParentId;
+        dirInfo.m_PathLength = entry.m_PathLength;
+    }
+
+    list.m_Files.resize(header.m_FileCount);
+    list.m_FileInfo.resize(header.m_FileCount);
+    list.m_SortKeys.resize(header.m_FileCount);
+    list.m_FileStats.resize(header.m_FileCount);
+
+    for (FileHandle hFile = 0; hFile < header.m_FileCount; hFile++)
+    {
+        const IndexFile& entry = pFiles[hFile];
+
+        if (!isValidString(entry.m_NameOffset, entry.m_NameLength) ||
+            entry.m_DirectoryId >= header.m_DirectoryCount ||
+            entry.m_StemLength > entry.m_NameLength)
+        {
+            DebugPrint(L"CPlayListIndexFormat::Read: Index is corrupt\n");
+            list.clear();
+            return false;
+        }
+
+        CFileInfo& fileInfo = list.m_FileInfo[hFile];
+        fileInfo.m_pFileName   = pStrings + entry.m_NameOffset;
+        fileInfo.m_DirectoryId = entry.m_DirectoryId;
+        fileInfo.m_ListIndex   = hFile;
+        fileInfo.m_NameLength  = entry.m_NameLength;
+        fileInfo.m_StemLength  = entry.m_StemLength;
+        fileInfo.m_AddStamp    = list.m_AddCount++;
+
+        list.m_Files[hFile] = hFile;
+        list.m_SortKeys[hFile] = entry.m_SortKey;
+        list.m_FileStats[hFile].m_Size = entry.m_Size;
+        list.m_FileStats[hFile].m_LastWriteTime = entry.m_LastWriteTime;
+    }
+
+    // The hash indexes are built on first use.
+
+    return true;
+}
@@ -0,0 +1,128 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListIndexFormat.h
+//
+//  Playlist index file format.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileList.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Index file format
+//
+//  Header, directory table, file table, and string table, in that order.
+//  Tables are 8 byte aligned. Strings are WCHARs (UTF-16 on Windows) and
+//  null terminated. Directory ids are positions in the directory table,
+//  and files are stored in playlist order.
+//
+//  Nothing here touches files, so it doesn't use any Windows APIs.
+//  CPlayListIndex does the file handling.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static const uint32_t IndexMagic = 0x58504C57;  // "WPLX"
+static const uint32_t IndexVersion = 3;     // 2: Sort keys use natural numeric order.
+                                            // 3: Numbers sort where digits do.
+
+struct IndexHeader
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+
+    // Playlist file this index was built from.
+    uint64_t m_PlaylistSize;
+    uint64_t m_PlaylistChecksum;
+
+    uint32_t m_DirectoryCount;
+    uint32_t m_FileCount;
+
+    // Table offsets in bytes, from start of file.
+    uint64_t m_DirectoryTableOffset;
+    uint64_t m_FileTableOffset;
+    uint64_t m_StringTableOffset;
+
+    // String table size in characters.
+    uint64_t m_StringTableSize;
+};
+
+struct IndexDirectory
+{
+    uint32_t m_PathOffset;      // In string table (characters).
+    uint32_t m_ParentId;
+    uint16_t m_PathLength;
+    uint16_t m_Reserved[3];
+};
+
+struct IndexFile
+{
+    uint32_t m_NameOffset;      // In string table (characters).
+    uint32_t m_DirectoryId;
+    uint16_t m_NameLength;
+    uint16_t m_StemLength;
+    uint32_t m_SortKey;
+    uint64_t m_Size;
+    int64_t m_LastWriteTime;
+};
+
+static_assert(sizeof(IndexHeader) == 64, "IndexHeader has unexpected size");
+static_assert(sizeof(IndexDirectory) == 16, "IndexDirectory has unexpected size");
+static_assert(sizeof(IndexFile) == 32, "IndexFile has unexpected size");
+
+// Checksum (FNV-1a) of a playlist file.
+uint64_t
+ChecksumPlaylistFile(
+    const void* pData,
+    size_t dataSize
+);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListIndexFormat
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Reads and makes the contents of playlist index files.
+class CPlayListIndexFormat
+{
+    public:
+
+        // Make the contents of the index for a playlist file. The list
+        // must contain exactly the files in the playlist file, in order.
+        // Returns false if the list can't be indexed (e.g. it's too big).
+        static
+        bool
+        Make(
+            const void* pPlaylistData,
+            size_t playlistSize,
+            const CFileList& list,
+            std::vector<BYTE>& indexData
+        );
+
+        // Load file list from the contents of a playlist's index. The
+        // strings are used in place, so the index data must stay put
+        // until the list is cleared. Returns false (and leaves the list
+        // empty) if the index is invalid, or wasn't made from this
+        // playlist file.
+        static
+        bool
+        Read(
+            const void* pIndexData,
+            size_t indexSize,
+            const void* pPlaylistData,
+            size_t playlistSize,
+            CFileList& list
+        );
+};
@@ -0,0 +1,371 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListJournal.cpp
+//
+//  CPlayListJournal class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "WallpaperChangerApp.h"
+
+#include "PlayListJournal.h"
+#include "PlayListFormat.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ReplaceFileContents
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Replace a file with new contents. The data is written to a temporary
+// file first, so the file is either updated completely or not at all.
+static bool ReplaceFileContents(const fs::path& path, const void* pData, size_t dataSize)
+{
+    std::error_code ec;
+
+    if (dataSize == 0)
+    {
+        fs::remove(path, ec);
+        return !ec;
+    }
+
+    fs::path tempPath = fs::path(path) += L".tmp";
+
+    if (!WriteDataToFile(tempPath, pData, dataSize) ||
+        !::MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::CPlayListJournal
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlayListJournal::CPlayListJournal()
+    :
+    m_Pending(),
+    m_Mutex(),
+    m_JournalSize(0),
+    m_PlaylistSize(0),
+    m_CompactionThread(),
+    m_Compacting(false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::~CPlayListJournal
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlayListJournal::~CPlayListJournal()
+{
+    Wait();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::GetJournalPath
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+fs::path
+CPlayListJournal::GetJournalPath(
+    const fs::path& playlistPath
+)
+{
+    return fs::path(playlistPath) += L".journal";
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::Replay
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CPlayListJournal::Replay(
+    const fs::path& playlistPath,
+    CFileList& list
+)
+{
+    Wait();
+
+    std::error_code ec;
+    m_PlaylistSize = fs::file_size(playlistPath, ec);
+    if (ec)
+        m_PlaylistSize = 0;
+
+    m_JournalSize = 0;
+    m_Pending.clear();
+
+    fs::path journalPath = GetJournalPath(playlistPath);
+
+    CMappedFile journal;
+    if (!journal.Open(journalPath))
+        return true;    // No edits since the playlist was written.
+
+    const char* pData = (const char*) journal.GetData();
+    size_t dataSize = journal.GetSize();
+
+    CJournalReplayResult result = ReplayJournal(pData, dataSize, list);
+
+    DebugPrint(L"CPlayListJournal::Replay: %zu records, %zu bytes\n", result.m_RecordCount, result.m_ValidSize);
+
+    // Drop the incomplete record, so new records
+    // aren't appended to the end of it.
+    if (result.m_ValidSize < dataSize)
+    {
+        DebugPrint(L"CPlayListJournal::Replay: Discarding %zu bytes\n", dataSize - result.m_ValidSize);
+
+        std::string validRecords(pData, result.m_ValidSize);
+        journal.Close();
+
+        if (!ReplaceFileContents(journalPath, validRecords.data(), validRecords.size()))
+            return false;
+    }
+
+    m_JournalSize = result.m_ValidSize;
+
+    return result.m_AllAdded;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::RecordAdd
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListJournal::RecordAdd(
+    const fs::path& filePath
+)
+{
+    AppendJournalRecord(m_Pending, JournalAddRecord, filePath);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::RecordRemove
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListJournal::RecordRemove(
+    const fs::path& filePath
+)
+{
+    AppendJournalRecord(m_Pending, JournalRemoveRecord, filePath);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::Commit
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CPlayListJournal::Commit(
+    const fs::path& playlistPath
+)
+{
+    if (m_Pending.empty())
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    FILE* fp = _wfopen(GetJournalPath(playlistPath).c_str(), L"ab");
+
+    if (!fp)
+        return false;
+
+    bool ok = fwrite(m_Pending.data(), m_Pending.size(), 1, fp) == 1;
+
+    if (fclose(fp) != 0)
+        ok = false;
+
+    if (!ok)
+        return false;
+
+    m_JournalSize += m_Pending.size();
+    m_Pending.clear();
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::Discard
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListJournal::Discard(
+    const fs::path& playlistPath
+)
+{
+    Wait();
+
+    std::error_code ec;
+    fs::remove(GetJournalPath(playlistPath), ec);
+
+    m_PlaylistSize = fs::file_size(playlistPath, ec);
+    if (ec)
+        m_PlaylistSize = 0;
+
+    m_JournalSize = 0;
+    m_Pending.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::NeedsCompaction
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CPlayListJournal::NeedsCompaction()
+{
+    if (m_Compacting)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_JournalSize >= MinCompactionSize &&
+           m_JournalSize * CompactionRatio >= m_PlaylistSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::Compact
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListJournal::Compact(
+    const fs::path& playlistPath,
+    WriteFunction writePlaylist
+)
+{
+    ATLASSERT(m_Pending.empty());
+
+    Wait();
+
+    uint64_t journalSize;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        journalSize = m_JournalSize;
+    }
+
+    m_Compacting = true;
+
+    m_CompactionThread = std::thread(
+        /*LAMBDA*/ [this, playlistPath, writePlaylist = std::move(writePlaylist), journalSize] ()
+        {
+            CompactionThread(playlistPath, writePlaylist, journalSize);
+            m_Compacting = false;
+        }
+    );
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::CompactionThread
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListJournal::CompactionThread(
+    const fs::path& playlistPath,
+    const WriteFunction& writePlaylist,
+    uint64_t journalSize
+)
+{
+    // Write the new playlist file. This is the slow part,
+    // and it doesn't touch the journal, so the journal
+    // is free to grow while it's happening.
+    fs::path tempPath = fs::path(playlistPath) += L".tmp";
+
+    std::error_code ec;
+
+    if (!writePlaylist(tempPath))
+    {
+        DebugPrint(L"CPlayListJournal::Compact: Failed to write: %s\n", tempPath.c_str());
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    uint64_t playlistSize = fs::file_size(tempPath, ec);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // Replace the playlist file, keeping the old one as a .bak file
+    // (same as CPlayList::Save).
+    fs::path bakFilePath = fs::path(playlistPath).replace_extension(L"bak");
+
+    if (!::ReplaceFileW(playlistPath.c_str(), tempPath.c_str(), bakFilePath.c_str(),
+                        REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL) &&
+        !::MoveFileExW(tempPath.c_str(), playlistPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DebugPrint(L"CPlayListJournal::Compact: Failed to replace: %s\n", playlistPath.c_str());
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    m_PlaylistSize = playlistSize;
+
+    // Drop the records that are now in the playlist file, keeping
+    // any that were appended while the playlist was being written.
+    fs::path journalPath = GetJournalPath(playlistPath);
+
+    std::string newRecords;
+
+    if (m_JournalSize > journalSize)
+    {
+        CMappedFile journal;
+        if (!journal.Open(journalPath) || journal.GetSize() != m_JournalSize)
+            return;     // Leave it. Replaying the old records is harmless.
+
+        newRecords.assign((const char*) journal.GetData() + journalSize,
+                          (size_t) (m_JournalSize - journalSize));
+    }
+
+    if (ReplaceFileContents(journalPath, newRecords.data(), newRecords.size()))
+        m_JournalSize = newRecords.size();
+
+    DebugPrint(L"CPlayListJournal::Compact: %s, %llu bytes, %llu journal bytes left\n",
+               playlistPath.c_str(),
+               playlistSize,
+               m_JournalSize);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal::Wait
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListJournal::Wait()
+{
+    if (m_CompactionThread.joinable())
+        m_CompactionThread.join();
+}
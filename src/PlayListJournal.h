@@ -0,0 +1,159 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListJournal.h
+//
+//  CPlayListJournal class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "PlayList.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListJournal
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Append-only journal of playlist edits ("Name.wppl.journal").
+//
+// Adding or removing a few files appends a short record per file to the
+// journal, rather than rewriting the whole playlist file. Records are
+// UTF-8 lines: "+path" for an added file, "-path" for a removed file
+// (see PlayListFormat.h).
+// The journal is replayed on top of the playlist file when it's loaded,
+// so edits survive a crash. A torn record at the end of the journal
+// (e.g. power failure during the write) is ignored.
+//
+// Once the journal gets big compared to the playlist file, the playlist
+// is compacted on a background thread: the whole list is written to a new
+// playlist file, which replaces the old one, and the records it now
+// contains are dropped from the journal.
+//
+// Replaying a record that's already reflected in the playlist file is
+// harmless (the file is already there, or already gone), so a crash
+// part way through compaction doesn't lose or duplicate anything.
+class CPlayListJournal
+{
+    public:
+
+        // Writes a new playlist file to the given path.
+        // Called on the compaction thread.
+        using WriteFunction = std::function<bool (const fs::path& path)>;
+
+        CPlayListJournal();
+
+        // Waits for compaction to finish.
+        ~CPlayListJournal();
+
+        // No copy ctor.
+        CPlayListJournal(const CPlayListJournal&) = delete;
+
+        // No copy assignment.
+        CPlayListJournal& operator=(const CPlayListJournal&) = delete;
+
+        // Get path of the journal for a playlist file.
+        static
+        fs::path
+        GetJournalPath(
+            const fs::path& playlistPath
+        );
+
+        // Apply the journal to a list just loaded from the playlist file.
+        // Returns false if a file added by the journal is no longer valid.
+        bool
+        Replay(
+            const fs::path& playlistPath,
+            CFileList& list
+        );
+
+        // Record an added file.
+        // Not written to the journal until Commit().
+        void
+        RecordAdd(
+            const fs::path& filePath
+        );
+
+        // Record a removed file.
+        // Not written to the journal until Commit().
+        void
+        RecordRemove(
+            const fs::path& filePath
+        );
+
+        // Append the recorded edits to the journal.
+        bool
+        Commit(
+            const fs::path& playlistPath
+        );
+
+        // Has the whole playlist just been written? Discards the journal,
+        // since the playlist file now includes all the edits.
+        void
+        Discard(
+            const fs::path& playlistPath
+        );
+
+        // Is the journal big enough to be worth compacting?
+        bool
+        NeedsCompaction();
+
+        // Start compacting the playlist on a background thread.
+        // writePlaylist must write the list as it is right now
+        // (i.e. the playlist file plus everything in the journal).
+        void
+        Compact(
+            const fs::path& playlistPath,
+            WriteFunction writePlaylist
+        );
+
+        // Wait for compaction (if any) to finish.
+        void
+        Wait();
+
+    private:
+
+        // Compaction thread.
+        void
+        CompactionThread(
+            const fs::path& playlistPath,
+            const WriteFunction& writePlaylist,
+            uint64_t journalSize
+        );
+
+        // Don't compact until the journal is at least this big (bytes).
+        static const uint64_t MinCompactionSize = 64 * 1024;
+
+        // Compact when the journal is at least 1/CompactionRatio
+        // the size of the playlist file.
+        static const uint64_t CompactionRatio = 4;
+
+        // Edits recorded since the last Commit() (UTF-8 records).
+        std::string m_Pending;
+
+        // Guards the journal file and sizes, which are
+        // updated by the compaction thread.
+        std::mutex m_Mutex;
+
+        // Size of the journal file.
+        uint64_t m_JournalSize;
+
+        // Size of the playlist file.
+        uint64_t m_PlaylistSize;
+
+        // Compaction thread.
+        std::thread m_CompactionThread;
+
+        // Set while compaction is in progress.
+        std::atomic<bool> m_Compacting;
+};
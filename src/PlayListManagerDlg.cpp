@@ -21,6 +21,8 @@
 #include "WallpaperChangerApp.h"
 
 #include "PlayList.h"
+#include "PlayListIndex.h"
+#include "PlayListJournal.h"
 #include "PlayListManagerDlg.h"
 #include "PlayListNameDlg.h"
 
@@ -150,6 +152,14 @@ void CPlayListManagerDlg::OnDeletePlaylist(UINT /*uNotifyCode*/, int /*nID*/, CW
         fs::path playlistPath = CPlayList::NameToPath(playlistName);
         std::error_code ec;
         fs::remove(playlistPath, ec);
+
+        // Remove the playlist's index and journal too (if any).
+        std::error_code ecIndex;
+        fs::remove(CPlayListIndex::GetIndexPath(playlistPath), ecIndex);
+        fs::remove(CPlayListJournal::GetJournalPath(playlistPath), ecIndex);
+
+        CPlayList::DeletePlaybackPosition(playlistName);
+
         if (ec)
         {
             // This really should never happen.
@@ -210,8 +220,22 @@ void CPlayListManagerDlg::OnRenamePlaylist(UINT /*uNotifyCode*/, int /*nID*/, CW
         fs::path oldPath = CPlayList::NameToPath(oldName);
         fs::path newPath = CPlayList::NameToPath(newName);
 
+        // Don't rename the playlist out from under a background write.
+        m_CurrentPlayList.WaitForPendingWrites();
+
         std::error_code ec;
         fs::rename(oldPath, newPath, ec);
+
+        // Rename the playlist's index and journal too (if any).
+        if (!ec)
+        {
+            std::error_code ecIndex;
+            fs::rename(CPlayListIndex::GetIndexPath(oldPath), CPlayListIndex::GetIndexPath(newPath), ecIndex);
+            fs::rename(CPlayListJournal::GetJournalPath(oldPath), CPlayListJournal::GetJournalPath(newPath), ecIndex);
+
+            CPlayList::RenamePlaybackPosition(oldName, newName);
+        }
+
         if (ec)
         {
             // This really should never happen.
@@ -0,0 +1,420 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListViewModel.cpp
+//
+//  CPlayListViewModel class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "PlayListViewModel.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::CPlayListViewModel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlayListViewModel::CPlayListViewModel() :
+    m_Source(),
+    m_Rows(),
+    m_RowIndex(),
+    m_Selection(),
+    m_SelectedCount(0),
+    m_Filter(),
+    m_Compare()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::Clear
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListViewModel::Clear()
+{
+    m_Source.clear();
+    m_Rows.clear();
+    m_RowIndex.clear();
+    m_Selection.clear();
+    m_SelectedCount = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::Append
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CPlayListViewModel::Append(
+    Handle handle
+)
+{
+    ATLASSERT(handle != InvalidHandle);
+
+    m_Source.push_back(handle);
+
+    if (m_Filter && !m_Filter(handle))
+        return InvalidRow;
+
+    size_t row = m_Rows.size();
+
+    // Sorted rows: insert after any rows that compare equal,
+    // so the new entry stays in source order among them.
+    if (m_Compare)
+        row = std::upper_bound(m_Rows.begin(), m_Rows.end(), handle, m_Compare) - m_Rows.begin();
+
+    m_Rows.insert(m_Rows.begin() + row, handle);
+
+    InsertSelectionBit(row);
+
+    if (handle >= m_RowIndex.size())
+        m_RowIndex.resize((size_t) handle + 1, NoRow);
+
+    UpdateRowIndex(row);
+
+    return row;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::Remove
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CPlayListViewModel::Remove(
+    const std::vector<Handle>& handles
+)
+{
+    if (handles.empty())
+        return 0;
+
+    // Flag the entries to remove, by handle.
+    std::vector<bool> isRemoved;
+
+    for (Handle handle: handles)
+    {
+        if (handle == InvalidHandle)
+            continue;
+
+        if (handle >= isRemoved.size())
+            isRemoved.resize((size_t) handle + 1, false);
+
+        isRemoved[handle] = true;
+    }
+
+    auto wasRemoved = [&isRemoved] (Handle handle) { return handle < isRemoved.size() && isRemoved[handle]; };
+
+    m_Source.erase(std::remove_if(m_Source.begin(), m_Source.end(), wasRemoved), m_Source.end());
+
+    // Slide the remaining rows (and their selection bits) down.
+    size_t rowCount = m_Rows.size();
+    size_t newRowCount = 0;
+
+    m_SelectedCount = 0;
+
+    for (size_t row = 0; row < rowCount; row++)
+    {
+        Handle handle = m_Rows[row];
+
+        if (wasRemoved(handle))
+        {
+            m_RowIndex[handle] = NoRow;
+            continue;
+        }
+
+        bool selected = (m_Selection[row / WordBits] & Bit(row)) != 0;
+
+        m_Rows[newRowCount] = handle;
+
+        if (selected)
+        {
+            m_Selection[newRowCount / WordBits] |= Bit(newRowCount);
+            m_SelectedCount++;
+        }
+        else
+        {
+            m_Selection[newRowCount / WordBits] &= ~Bit(newRowCount);
+        }
+
+        newRowCount++;
+    }
+
+    m_Rows.resize(newRowCount);
+    m_Selection.resize((newRowCount + WordBits - 1) / WordBits);
+
+    // Clear the bits past the last row.
+    if (newRowCount % WordBits != 0)
+        m_Selection.back() &= Bit(newRowCount) - 1;
+
+    UpdateRowIndex();
+
+    return rowCount - newRowCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::SetFilter
+//  CPlayListViewModel::SetSortOrder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListViewModel::SetFilter(
+    FilterFunction filter
+)
+{
+    m_Filter = std::move(filter);
+    Rebuild();
+}
+
+void
+CPlayListViewModel::SetSortOrder(
+    CompareFunction compare
+)
+{
+    m_Compare = std::move(compare);
+    Rebuild();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::SetSelected
+//  CPlayListViewModel::SetAllSelected
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListViewModel::SetSelected(
+    size_t firstRow,
+    size_t lastRow,
+    bool selected
+)
+{
+    lastRow = std::min(lastRow, m_Rows.size() - 1);
+
+    if (m_Rows.empty() || firstRow > lastRow)
+        return;
+
+    size_t firstWord = firstRow / WordBits;
+    size_t lastWord = lastRow / WordBits;
+
+    for (size_t iWord = firstWord; iWord <= lastWord; iWord++)
+    {
+        Word mask = ~(Word) 0;
+
+        if (iWord == firstWord)
+            mask &= ~(Bit(firstRow) - 1);
+
+        if (iWord == lastWord && lastRow % WordBits != WordBits - 1)
+            mask &= Bit(lastRow + 1) - 1;
+
+        Word oldWord = m_Selection[iWord];
+        Word newWord = selected ? (oldWord | mask) : (oldWord & ~mask);
+
+        m_SelectedCount += CountBits(newWord);
+        m_SelectedCount -= CountBits(oldWord);
+
+        m_Selection[iWord] = newWord;
+    }
+}
+
+void
+CPlayListViewModel::SetAllSelected(
+    bool selected
+)
+{
+    if (selected)
+    {
+        SetSelected(0, m_Rows.size() - 1, true);
+    }
+    else
+    {
+        std::fill(m_Selection.begin(), m_Selection.end(), 0);
+        m_SelectedCount = 0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::GetNextSelected
+//
+//////////////////////////////////////////////////////////////////////////////
+
+size_t
+CPlayListViewModel::GetNextSelected(
+    size_t row
+) const
+{
+    // InvalidRow + 1 is zero.
+    size_t startRow = row + 1;
+
+    if (startRow >= m_Rows.size() || m_SelectedCount == 0)
+        return InvalidRow;
+
+    // Skip over words with no bits set.
+    size_t iWord = startRow / WordBits;
+    Word word = m_Selection[iWord] & ~(Bit(startRow) - 1);
+
+    while (word == 0)
+    {
+        if (++iWord == m_Selection.size())
+            return InvalidRow;
+
+        word = m_Selection[iWord];
+    }
+
+    size_t nextRow = iWord * WordBits;
+
+    while ((word & 1) == 0)
+    {
+        word >>= 1;
+        nextRow++;
+    }
+
+    return nextRow;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::GetSelectedHandles
+//
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<CPlayListViewModel::Handle>
+CPlayListViewModel::GetSelectedHandles() const
+{
+    std::vector<Handle> handles;
+    handles.reserve(m_SelectedCount);
+
+    for (size_t row = GetNextSelected(InvalidRow); row != InvalidRow; row = GetNextSelected(row))
+        handles.push_back(m_Rows[row]);
+
+    return handles;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::CountBits
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+size_t
+CPlayListViewModel::CountBits(
+    Word word
+)
+{
+    // Add up the bits in pairs, nibbles, then bytes.
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (size_t) ((word * 0x0101010101010101ull) >> 56);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::Rebuild
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListViewModel::Rebuild()
+{
+    std::vector<Handle> selectedHandles = GetSelectedHandles();
+
+    for (Handle handle: m_Rows)
+        m_RowIndex[handle] = NoRow;
+
+    if (m_Filter)
+    {
+        m_Rows.clear();
+        std::copy_if(m_Source.begin(), m_Source.end(), std::back_inserter(m_Rows), m_Filter);
+    }
+    else
+    {
+        m_Rows = m_Source;
+    }
+
+    if (m_Compare)
+        std::stable_sort(m_Rows.begin(), m_Rows.end(), m_Compare);
+
+    Handle maxHandle = m_Rows.empty() ? 0 : *std::max_element(m_Rows.begin(), m_Rows.end());
+
+    if (maxHandle >= m_RowIndex.size())
+        m_RowIndex.resize((size_t) maxHandle + 1, NoRow);
+
+    UpdateRowIndex();
+
+    // Select the same entries (if they're still shown).
+    m_Selection.assign((m_Rows.size() + WordBits - 1) / WordBits, 0);
+    m_SelectedCount = 0;
+
+    for (Handle handle: selectedHandles)
+    {
+        size_t row = GetRow(handle);
+
+        if (row != InvalidRow)
+        {
+            m_Selection[row / WordBits] |= Bit(row);
+            m_SelectedCount++;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::UpdateRowIndex
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListViewModel::UpdateRowIndex(
+    size_t firstRow /*= 0*/
+)
+{
+    for (size_t row = firstRow; row < m_Rows.size(); row++)
+        m_RowIndex[m_Rows[row]] = (uint32_t) row;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel::InsertSelectionBit
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlayListViewModel::InsertSelectionBit(
+    size_t row
+)
+{
+    // Called after the row has been added to m_Rows.
+    if (m_Selection.size() * WordBits < m_Rows.size())
+        m_Selection.push_back(0);
+
+    size_t iWord = row / WordBits;
+
+    // Shift the bits after the new row up by one, carrying the top bit
+    // of each word into the next.
+    for (size_t i = m_Selection.size() - 1; i > iWord; i--)
+        m_Selection[i] = (m_Selection[i] << 1) | (m_Selection[i - 1] >> (WordBits - 1));
+
+    Word word = m_Selection[iWord];
+    Word lowMask = Bit(row) - 1;
+
+    m_Selection[iWord] = (word & lowMask) | ((word & ~lowMask) << 1);
+}
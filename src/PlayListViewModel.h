@@ -0,0 +1,245 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListViewModel.h
+//
+//  CPlayListViewModel class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlayListViewModel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Rows of a virtual (LVS_OWNERDATA) listview showing a playlist.
+//
+// The listview doesn't store any items -- it only knows how many rows
+// there are, and asks for whatever it needs by row number. This class
+// maps row numbers to file handles and back, both in O(1), so populating
+// the view costs the same no matter how long the playlist is.
+//
+// The rows are a projection of the source entries (the playlist, in
+// playlist order): entries can be filtered out, and the rows can be
+// sorted, without changing the playlist. The selection is kept as a bitset
+// by row. It's carried over (by handle) when the projection changes.
+//
+// Doesn't know anything about windows or playlists, so it can be tested
+// on its own.
+class CPlayListViewModel
+{
+    public:
+
+        // Entry handle (same as FileHandle).
+        using Handle = uint32_t;
+
+        // Invalid Handle value.
+        static constexpr Handle InvalidHandle = (Handle) -1;
+
+        // Invalid row number (entry isn't shown).
+        static constexpr size_t InvalidRow = (size_t) -1;
+
+        // Returns true if an entry should be shown.
+        using FilterFunction = std::function<bool (Handle)>;
+
+        // Returns true if the first entry goes before the second.
+        using CompareFunction = std::function<bool (Handle, Handle)>;
+
+        CPlayListViewModel();
+
+        // No copy ctor.
+        CPlayListViewModel(const CPlayListViewModel&) = delete;
+
+        // No copy assignment.
+        CPlayListViewModel& operator=(const CPlayListViewModel&) = delete;
+
+        // Replace the source entries. Clears the selection.
+        template <typename Iterator>
+        void
+        Assign(
+            Iterator first,
+            Iterator last
+        )
+        {
+            m_Source.assign(first, last);
+            SetAllSelected(false);
+            Rebuild();
+        }
+
+        // Remove all entries.
+        void
+        Clear();
+
+        // Add an entry to the end of the source entries.
+        // Returns its row, or InvalidRow if it's filtered out.
+        size_t
+        Append(
+            Handle handle
+        );
+
+        // Remove a set of entries in a single pass.
+        // Returns the number of rows removed.
+        size_t
+        Remove(
+            const std::vector<Handle>& handles
+        );
+
+        // Only show the entries for which filter(handle) returns true.
+        // An empty function shows all entries.
+        void
+        SetFilter(
+            FilterFunction filter
+        );
+
+        // Sort the rows. Entries that compare equal are kept in source
+        // order. An empty function shows the entries in source order.
+        void
+        SetSortOrder(
+            CompareFunction compare
+        );
+
+        // Get the number of rows.
+        size_t
+        size() const
+        {
+            return m_Rows.size();
+        }
+
+        bool
+        empty() const
+        {
+            return m_Rows.empty();
+        }
+
+        // Get the entry shown in a row.
+        // Returns InvalidHandle if row is out of range.
+        Handle
+        GetHandle(
+            size_t row
+        ) const
+        {
+            return (row < m_Rows.size()) ? m_Rows[row] : InvalidHandle;
+        }
+
+        // Get the row showing an entry.
+        // Returns InvalidRow if the entry isn't shown.
+        size_t
+        GetRow(
+            Handle handle
+        ) const
+        {
+            return (handle < m_RowIndex.size() && m_RowIndex[handle] != NoRow) ? m_RowIndex[handle] : InvalidRow;
+        }
+
+        // Is a row selected?
+        bool
+        IsSelected(
+            size_t row
+        ) const
+        {
+            return row < m_Rows.size() && (m_Selection[row / WordBits] & Bit(row)) != 0;
+        }
+
+        // Select or deselect rows firstRow...lastRow (inclusive).
+        void
+        SetSelected(
+            size_t firstRow,
+            size_t lastRow,
+            bool selected
+        );
+
+        // Select or deselect all rows.
+        void
+        SetAllSelected(
+            bool selected
+        );
+
+        // Get the number of selected rows.
+        size_t
+        GetSelectedCount() const
+        {
+            return m_SelectedCount;
+        }
+
+        // Get the first selected row after row. Pass InvalidRow to
+        // start at the beginning. Returns InvalidRow if there are none.
+        size_t
+        GetNextSelected(
+            size_t row
+        ) const;
+
+        // Get the selected entries, in row order.
+        std::vector<Handle>
+        GetSelectedHandles() const;
+
+    private:
+
+        using Word = uint64_t;
+
+        static constexpr size_t WordBits = 64;
+
+        // m_RowIndex value for entries that aren't shown.
+        static constexpr uint32_t NoRow = (uint32_t) -1;
+
+        static
+        Word
+        Bit(
+            size_t row
+        )
+        {
+            return (Word) 1 << (row % WordBits);
+        }
+
+        // Count the bits set in a word.
+        static
+        size_t
+        CountBits(
+            Word word
+        );
+
+        // Rebuild the rows from the source entries. Keeps the selection.
+        void
+        Rebuild();
+
+        // Update m_RowIndex for rows firstRow...
+        void
+        UpdateRowIndex(
+            size_t firstRow = 0
+        );
+
+        // Make room for a new (unselected) row in the selection bitset.
+        void
+        InsertSelectionBit(
+            size_t row
+        );
+
+        // Source entries (playlist order).
+        std::vector<Handle> m_Source;
+
+        // Entry shown in each row.
+        std::vector<Handle> m_Rows;
+
+        // Row of each entry, indexed by handle. NoRow if not shown.
+        std::vector<uint32_t> m_RowIndex;
+
+        // Selection bitset, by row.
+        std::vector<Word> m_Selection;
+
+        // Number of bits set in m_Selection.
+        size_t m_SelectedCount;
+
+        FilterFunction m_Filter;
+
+        CompareFunction m_Compare;
+};
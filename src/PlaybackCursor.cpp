@@ -0,0 +1,285 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlaybackCursor.cpp
+//
+//  CPlaybackCursor class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "PlaybackCursor.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::CPlaybackCursor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlaybackCursor::CPlaybackCursor()
+    :
+    m_PlaybackOrder(),
+    m_PlaybackCursor(0),
+    m_CycleAddCount(0),
+    m_hFile(InvalidFileHandle)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::SetFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlaybackCursor::SetFile(
+    const CFileList& list,
+    FileHandle hFile
+)
+{
+    if (!list.IsValid(hFile))
+        return;
+
+    UpdatePlaybackOrder(list);
+
+    if (IsInCycle(list, hFile))
+        m_PlaybackCursor = m_PlaybackOrder.GetIndex(hFile);
+
+    m_hFile = hFile;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::Move
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FileHandle
+CPlaybackCursor::Move(
+    const CFileList& list,
+    bool forward
+)
+{
+    if (list.empty())
+        return InvalidFileHandle;
+
+    UpdatePlaybackOrder(list);
+
+    auto isInCycle = [this, &list] (uint64_t hFile) { return IsInCycle(list, hFile); };
+
+    // Put the cursor back on its file (e.g. the user picked it). If the
+    // file was removed, carry on from the same place in the order.
+    if (IsInCycle(list, m_hFile))
+        m_PlaybackCursor = m_PlaybackOrder.GetIndex(m_hFile);
+
+    uint64_t cursor;
+
+    if (forward)
+    {
+        cursor = m_PlaybackOrder.FindNext(m_PlaybackCursor + 1, isInCycle);
+
+        // Start a new cycle in a new order after the last file.
+        if (cursor == m_PlaybackOrder.size())
+        {
+            StartCycle(list, CShuffleOrder::MakeSeed());
+            cursor = m_PlaybackOrder.FindNext(0, isInCycle);
+        }
+    }
+    else
+    {
+        cursor = (m_PlaybackCursor == 0) ? m_PlaybackOrder.size() : m_PlaybackOrder.FindPrevious(m_PlaybackCursor - 1, isInCycle);
+
+        // Wrap back to the end of the current cycle.
+        if (cursor == m_PlaybackOrder.size())
+            cursor = m_PlaybackOrder.FindPrevious(m_PlaybackOrder.size() - 1, isInCycle);
+
+        // All the files in the cycle have been removed.
+        if (cursor == m_PlaybackOrder.size())
+        {
+            StartCycle(list, CShuffleOrder::MakeSeed());
+            cursor = m_PlaybackOrder.FindNext(0, isInCycle);
+        }
+    }
+
+    // A new cycle has every file in the list, so there's always one.
+    ATLASSERT(cursor < m_PlaybackOrder.size());
+
+    m_PlaybackCursor = cursor;
+    m_hFile = (FileHandle) m_PlaybackOrder.GetPosition(cursor);
+
+    return m_hFile;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::GetUpcomingFiles
+//
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<FileHandle>
+CPlaybackCursor::GetUpcomingFiles(
+    const CFileList& list,
+    size_t count
+)
+{
+    std::vector<FileHandle> files;
+
+    if (list.empty())
+        return files;
+
+    UpdatePlaybackOrder(list);
+
+    auto isInCycle = [this, &list] (uint64_t hFile) { return IsInCycle(list, hFile); };
+
+    // Same as Move(): start from the cursor's file.
+    uint64_t cursor = m_PlaybackCursor;
+    if (IsInCycle(list, m_hFile))
+        cursor = m_PlaybackOrder.GetIndex(m_hFile);
+
+    while (files.size() < count)
+    {
+        cursor = m_PlaybackOrder.FindNext(cursor + 1, isInCycle);
+        if (cursor == m_PlaybackOrder.size())
+            break;
+
+        files.push_back((FileHandle) m_PlaybackOrder.GetPosition(cursor));
+    }
+
+    return files;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::Reset
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlaybackCursor::Reset(
+    const CFileList& list,
+    uint64_t seed,
+    uint64_t index
+)
+{
+    StartCycle(list, seed);
+
+    m_hFile = InvalidFileHandle;
+
+    if (list.empty())
+        return;
+
+    auto isInCycle = [this, &list] (uint64_t hFile) { return IsInCycle(list, hFile); };
+
+    uint64_t cursor = m_PlaybackOrder.FindNext((index < m_PlaybackOrder.size()) ? index : 0, isInCycle);
+    if (cursor == m_PlaybackOrder.size())
+        cursor = m_PlaybackOrder.FindNext(0, isInCycle);
+
+    m_PlaybackCursor = cursor;
+    m_hFile = (FileHandle) m_PlaybackOrder.GetPosition(cursor);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::GetPosition
+//  CPlaybackCursor::SetPosition
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CPlaybackPosition
+CPlaybackCursor::GetPosition(
+    const CFileList& list
+) const
+{
+    CPlaybackPosition position = {};
+    position.m_Seed          = m_PlaybackOrder.GetSeed();
+    position.m_Index         = m_PlaybackCursor;
+    position.m_DomainSize    = m_PlaybackOrder.size();
+    position.m_CycleAddCount = m_CycleAddCount - list.GetClearAddCount();
+
+    // The file at the cursor, which isn't the current file if that was
+    // added during the cycle (or removed).
+    if (m_PlaybackCursor < m_PlaybackOrder.size())
+    {
+        FileHandle hFile = (FileHandle) m_PlaybackOrder.GetPosition(m_PlaybackCursor);
+        if (list.IsValid(hFile))
+            position.m_FilePath = list.GetFullPath(hFile).wstring();
+    }
+
+    return position;
+}
+
+bool
+CPlaybackCursor::SetPosition(
+    const CFileList& list,
+    const CPlaybackPosition& position
+)
+{
+    FileHandle hSavedFile = position.m_FilePath.empty() ? InvalidFileHandle : list.Lookup(position.m_FilePath);
+
+    // The list has the handles it had when the position was saved if the
+    // saved file is back where it was in the saved order. (Handles are
+    // given out in the order the files are loaded, so any change to the
+    // playlist file's order moves them.)
+    if (hSavedFile != InvalidFileHandle &&
+        position.m_DomainSize <= list.GetHandleLimit() &&
+        position.m_Index < position.m_DomainSize &&
+        position.m_CycleAddCount <= list.GetAddCount() - list.GetClearAddCount())
+    {
+        CShuffleOrder order(position.m_DomainSize, position.m_Seed);
+
+        if (order.GetPosition(position.m_Index) == hSavedFile)
+        {
+            m_PlaybackOrder = order;
+            m_PlaybackCursor = position.m_Index;
+            m_CycleAddCount = list.GetClearAddCount() + position.m_CycleAddCount;
+            m_hFile = hSavedFile;
+            return true;
+        }
+    }
+
+    // Otherwise the seed and index would pick some other file, and the
+    // files already played in the cycle could be played again. Start a
+    // new cycle at the saved file.
+    Reset(list, position.m_Seed, 0);
+    SetFile(list, hSavedFile);
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor::UpdatePlaybackOrder
+//  CPlaybackCursor::StartCycle
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CPlaybackCursor::UpdatePlaybackOrder(
+    const CFileList& list
+)
+{
+    // Files added or removed since the cycle started don't change the
+    // order, so this only has to start the first cycle of a new cursor.
+    if (m_PlaybackOrder.size() == 0)
+        StartCycle(list, CShuffleOrder::MakeSeed());
+}
+
+void
+CPlaybackCursor::StartCycle(
+    const CFileList& list,
+    uint64_t seed
+)
+{
+    m_PlaybackOrder.Reset(list.GetHandleLimit(), seed);
+    m_PlaybackCursor = 0;
+    m_CycleAddCount = list.GetAddCount();
+}
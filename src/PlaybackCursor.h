@@ -0,0 +1,195 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlaybackCursor.h
+//
+//  CPlaybackCursor class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileList.h"
+#include "ShuffleOrder.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackPosition
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// A playback cursor's place, as saved between runs (see
+// CPlaybackCursor::GetPosition()).
+//
+// The seed, index, and domain size only mean the same thing if the list
+// is loaded with the same handles it had when they were saved, which
+// isn't the case once the playlist file has been rewritten in another
+// order (or compacted). The file's path tells whether it was.
+struct CPlaybackPosition
+{
+    // Seed of the cycle's shuffled order.
+    uint64_t m_Seed;
+
+    // Index of the cursor in the shuffled order.
+    uint64_t m_Index;
+
+    // Handle range the cycle shuffles.
+    uint64_t m_DomainSize;
+
+    // Files added to the list when the cycle started, counted from
+    // the last time the list was cleared (see CFileList::GetClearAddCount()).
+    uint32_t m_CycleAddCount;
+
+    // Full path of the file at the cursor.
+    std::wstring m_FilePath;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CPlaybackCursor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// A place in a list's shuffled playback order, and the file there.
+// A playlist has one of its own; more of them let several players (e.g.
+// one per monitor) go through the same list independently. Only means
+// something to the list that moves it.
+//
+// Files are played in a shuffled order that visits every file once per
+// cycle. Each cycle is shuffled differently. The order is a shuffle of
+// the list's handle range as it was when the cycle started, not of
+// positions in the list, so sorting or editing the list doesn't change
+// it. Files removed since then are skipped, and files added since then
+// wait for the next cycle.
+class CPlaybackCursor
+{
+    public:
+
+        CPlaybackCursor();
+
+        // Get the current file. May have been removed from the
+        // list since (see CFileList::IsValid()).
+        FileHandle
+        GetFile() const
+        {
+            return m_hFile;
+        }
+
+        // Get the seed and index (see Reset()).
+        uint64_t
+        GetSeed() const
+        {
+            return m_PlaybackOrder.GetSeed();
+        }
+
+        uint64_t
+        GetIndex() const
+        {
+            return m_PlaybackCursor;
+        }
+
+        // Make a file the current file (e.g. one the user picked), and
+        // move the cursor to it, so the next and previous files are
+        // relative to it. A file added since the cycle started isn't in it
+        // yet, so then the cursor stays where it was, and carries on from
+        // there.
+        void
+        SetFile(
+            const CFileList& list,
+            FileHandle hFile
+        );
+
+        // Move to the next or previous file, and make that the current
+        // file. Going forward past the end of the cycle starts a new one,
+        // and going back past its start wraps to its end. Returns the new
+        // current file, or InvalidFileHandle if the list is empty.
+        FileHandle
+        Move(
+            const CFileList& list,
+            bool forward
+        );
+
+        // Get the files that come after the current file (up to count of
+        // them), without moving. Stops at the end of the current cycle,
+        // since the next cycle isn't shuffled until it starts.
+        std::vector<FileHandle>
+        GetUpcomingFiles(
+            const CFileList& list,
+            size_t count
+        );
+
+        // Start a cycle in the order made from seed, at the index'th file
+        // (or the first file after it that's in the list). An index past
+        // the end starts at the beginning.
+        void
+        Reset(
+            const CFileList& list,
+            uint64_t seed,
+            uint64_t index
+        );
+
+        // Get the cursor's place, to save it.
+        CPlaybackPosition
+        GetPosition(
+            const CFileList& list
+        ) const;
+
+        // Go back to a saved place. If the list doesn't have the same
+        // handles it had then, starts a new cycle at the saved file
+        // instead (or at the start, if the file is gone), and returns
+        // false.
+        bool
+        SetPosition(
+            const CFileList& list,
+            const CPlaybackPosition& position
+        );
+
+    private:
+
+        // Start a cursor's first cycle, if it hasn't been used yet.
+        void
+        UpdatePlaybackOrder(
+            const CFileList& list
+        );
+
+        // Start a new cycle: shuffle the list's current handle range.
+        void
+        StartCycle(
+            const CFileList& list,
+            uint64_t seed
+        );
+
+        // Is a file in the current cycle? (It's in the list, and was
+        // added before the cycle started.)
+        bool
+        IsInCycle(
+            const CFileList& list,
+            uint64_t hFile
+        ) const
+        {
+            return hFile < m_PlaybackOrder.size() &&
+                   list.IsValid((FileHandle) hFile) &&
+                   list.GetAddStamp((FileHandle) hFile) < m_CycleAddCount;
+        }
+
+        // Shuffled playback order. Maps the playback cursor
+        // to a FileHandle.
+        CShuffleOrder m_PlaybackOrder;
+
+        // Index of the current file in the playback order.
+        uint64_t m_PlaybackCursor;
+
+        // Number of files that had been added to the list when the
+        // cycle started (see CFileList::GetAddStamp()).
+        uint32_t m_CycleAddCount;
+
+        FileHandle m_hFile;
+};
@@ -0,0 +1,150 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Portable.h
+//
+//  Stand-ins for the Windows headers, for building the classes that don't
+//  use Windows on other platforms.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Included by precomp.h instead of the Windows, ATL, and WTL headers when
+// _WIN32 isn't defined. Only for the classes that say they don't use any
+// Windows APIs (e.g. CResampler, CWallpaperSession, CSequenceDiff), which
+// are built on Linux for the tests and benchmarks in ..\test. Has just the
+// types and macros those classes use, not an emulation of Windows.
+
+//----------------------------------------------------------------------------
+//  C Runtime and C++ STL headers
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <assert.h>
+
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <random>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <list>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+//----------------------------------------------------------------------------
+//  Windows types
+//----------------------------------------------------------------------------
+
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef unsigned int UINT;
+typedef wchar_t WCHAR;
+typedef const WCHAR* LPCWSTR;
+typedef uint32_t COLORREF;
+
+struct SIZE
+{
+    LONG cx;
+    LONG cy;
+};
+
+struct RECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+};
+
+// Bitmaps are opaque handles. The tests make their own.
+struct HBITMAP__;
+typedef HBITMAP__* HBITMAP;
+
+#ifndef NULL
+  #define NULL 0
+#endif
+
+#define TRUE 1
+#define FALSE 0
+
+#define RGB(r, g, b)    ((COLORREF) ((BYTE) (r) | ((uint32_t) (BYTE) (g) << 8) | ((uint32_t) (BYTE) (b) << 16)))
+#define GetRValue(rgb)  ((BYTE) (rgb))
+#define GetGValue(rgb)  ((BYTE) ((uint32_t) (rgb) >> 8))
+#define GetBValue(rgb)  ((BYTE) ((uint32_t) (rgb) >> 16))
+
+// Frees a bitmap (CThumbnailLoader frees the ones nobody collects).
+// Defined by the program, since it makes the bitmaps.
+BOOL DeleteObject(HBITMAP hBitmap);
+
+//----------------------------------------------------------------------------
+//  C Runtime
+//----------------------------------------------------------------------------
+
+#define _wcsnicmp wcsncasecmp
+
+//----------------------------------------------------------------------------
+//  Util.h
+//----------------------------------------------------------------------------
+
+// Memory mapped files are only used by the playlist index, which isn't
+// built here. Stands in for the type, so CStringArena can hold them.
+class CMappedFile
+{
+};
+
+// Check if file is a valid wallpaper image (by extension).
+// Defined by the program.
+bool IsValidImageFile(const fs::path& imageFile);
+
+// Get image dimensions from the file header. Defined by the program.
+bool GetImageFileDimensions(const fs::path& imageFile, UINT* pWidth, UINT* pHeight);
+
+// Convert between UTF-8 and wide strings (UTF-32 here, not UTF-16).
+inline std::string UTF16_to_UTF8(const std::wstring& strW) { return fs::path(strW).u8string(); }
+inline std::wstring UTF8_to_UTF16(const std::string& strU8) { return fs::u8path(strU8).wstring(); }
+
+//----------------------------------------------------------------------------
+//  ATL and compiler macros
+//----------------------------------------------------------------------------
+
+#define ATLASSERT(expr) assert(expr)
+
+#define FORCEINLINE inline __attribute__((always_inline))
+
+//----------------------------------------------------------------------------
+//  DebugPrint
+//----------------------------------------------------------------------------
+
+#define DebugPrint(format, ...) do {} while (0)
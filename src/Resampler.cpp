@@ -0,0 +1,1096 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Resampler.cpp
+//
+//  CResampler class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "Resampler.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define RESAMPLER_X86
+#endif
+
+#ifdef RESAMPLER_X86
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    // MSVC allows AVX2 intrinsics in any function.
+    #define TARGET_AVX2
+  #else
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+  #endif
+#endif
+
+using Weights = CResampleWeights;
+
+// Added to sums before shifting, to round to nearest.
+static const int32_t Rounding = 1 << (Weights::WeightBits - 1);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Filters
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static double BoxFilter(double x)
+{
+    // Half open, so a source pixel exactly half way between two
+    // destination pixels only counts for one of them.
+    return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+}
+
+static double TriangleFilter(double x)
+{
+    x = std::abs(x);
+
+    return (x < 1.0) ? 1.0 - x : 0.0;
+}
+
+static double CubicFilter(double x)
+{
+    // Keys cubic convolution with a = -0.5 (Catmull-Rom).
+    const double a = -0.5;
+
+    x = std::abs(x);
+
+    if (x < 1.0)
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+
+    if (x < 2.0)
+        return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+
+    return 0.0;
+}
+
+static double Sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+
+    x *= 3.14159265358979323846;
+
+    return std::sin(x) / x;
+}
+
+static double Lanczos3Filter(double x)
+{
+    return (x > -3.0 && x < 3.0) ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+}
+
+struct FilterInfo
+{
+    double (*m_Function)(double x);
+
+    // Filter is zero outside -m_Support...m_Support.
+    double m_Support;
+};
+
+// By ResampleFilter.
+static const FilterInfo Filters[] =
+{
+    { BoxFilter,      0.5 },
+    { TriangleFilter, 1.0 },
+    { CubicFilter,    2.0 },
+    { Lanczos3Filter, 3.0 },
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Linear light
+//
+//  Linear pixels are four 15-bit channels in a uint64_t, in the same order
+//  as the channels of a 32bpp pixel. 15 bits (not 16) so they can be
+//  multiplied by the weights with signed 16-bit arithmetic, like the
+//  8-bit channels. Alpha isn't gamma encoded, so it's only scaled.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static const int LinearBits = 15;
+static const int LinearMax = (1 << LinearBits) - 1;
+
+struct LinearTables
+{
+    // sRGB -> linear.
+    uint16_t m_ToLinear[256];
+
+    // Alpha -> linear (scaled).
+    uint16_t m_AlphaToLinear[256];
+
+    // Linear -> sRGB.
+    uint8_t m_FromLinear[LinearMax + 1];
+
+    // Linear -> alpha.
+    uint8_t m_AlphaFromLinear[LinearMax + 1];
+};
+
+static const LinearTables& GetLinearTables()
+{
+    static const std::unique_ptr<LinearTables> pTables = /*LAMBDA*/ [] ()
+    {
+        auto pTables = std::make_unique<LinearTables>();
+
+        for (int i = 0; i < 256; i++)
+        {
+            double value = i / 255.0;
+            double linear = (value <= 0.04045) ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+
+            pTables->m_ToLinear[i] = (uint16_t) std::lround(linear * LinearMax);
+            pTables->m_AlphaToLinear[i] = (uint16_t) std::lround(value * LinearMax);
+        }
+
+        for (int i = 0; i <= LinearMax; i++)
+        {
+            double linear = (double) i / LinearMax;
+            double value = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+
+            pTables->m_FromLinear[i] = (uint8_t) std::lround(value * 255.0);
+            pTables->m_AlphaFromLinear[i] = (uint8_t) std::lround(linear * 255.0);
+        }
+
+        return pTables;
+    }();
+
+    return *pTables;
+}
+
+static void ToLinearRow(const uint32_t* pSrcRow, int width, uint64_t* pDstRow)
+{
+    const LinearTables& tables = GetLinearTables();
+
+    for (int x = 0; x < width; x++)
+    {
+        uint32_t pixel = pSrcRow[x];
+
+        pDstRow[x] = (uint64_t) tables.m_ToLinear[pixel & 0xFF] |
+                     ((uint64_t) tables.m_ToLinear[(pixel >> 8) & 0xFF] << 16) |
+                     ((uint64_t) tables.m_ToLinear[(pixel >> 16) & 0xFF] << 32) |
+                     ((uint64_t) tables.m_AlphaToLinear[pixel >> 24] << 48);
+    }
+}
+
+static void FromLinearRow(const uint64_t* pSrcRow, int width, uint32_t* pDstRow)
+{
+    const LinearTables& tables = GetLinearTables();
+
+    for (int x = 0; x < width; x++)
+    {
+        uint64_t pixel = pSrcRow[x];
+
+        pDstRow[x] = (uint32_t) tables.m_FromLinear[pixel & LinearMax] |
+                     ((uint32_t) tables.m_FromLinear[(pixel >> 16) & LinearMax] << 8) |
+                     ((uint32_t) tables.m_FromLinear[(pixel >> 32) & LinearMax] << 16) |
+                     ((uint32_t) tables.m_AlphaFromLinear[(pixel >> 48) & LinearMax] << 24);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Scalar kernels
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Scale a sum back down and clamp it to a channel value.
+static inline uint32_t ClampChannel(int32_t sum)
+{
+    sum >>= Weights::WeightBits;
+
+    return (uint32_t) ((sum < 0) ? 0 : (sum > 255) ? 255 : sum);
+}
+
+static void HorizontalScalar(const Weights& weights, const uint32_t* pSrcRow, uint32_t* pDstRow)
+{
+    for (int x = 0; x < weights.m_DstSize; x++)
+    {
+        const uint32_t* pSrc = pSrcRow + weights.m_First[x];
+        const int16_t* pWeights = weights.GetWeights(x);
+        int count = weights.m_Count[x];
+
+        int32_t sums[4] = { Rounding, Rounding, Rounding, Rounding };
+
+        for (int k = 0; k < count; k++)
+        {
+            uint32_t pixel = pSrc[k];
+
+            for (int channel = 0; channel < 4; channel++)
+                sums[channel] += pWeights[k] * (int32_t) ((pixel >> (channel * 8)) & 0xFF);
+        }
+
+        pDstRow[x] = ClampChannel(sums[0]) |
+                     (ClampChannel(sums[1]) << 8) |
+                     (ClampChannel(sums[2]) << 16) |
+                     (ClampChannel(sums[3]) << 24);
+    }
+}
+
+// Make pixels firstPixel...lastPixel-1 of a row of the vertical pass.
+static void VerticalScalarPixels(const Weights& weights, int dstRow, const uint32_t* const* pRows, int firstPixel, int lastPixel, uint32_t* pDstRow)
+{
+    const uint32_t* const* pSrcRows = pRows + weights.m_First[dstRow];
+    const int16_t* pWeights = weights.GetWeights(dstRow);
+    int count = weights.m_Count[dstRow];
+
+    for (int x = firstPixel; x < lastPixel; x++)
+    {
+        int32_t sums[4] = { Rounding, Rounding, Rounding, Rounding };
+
+        for (int k = 0; k < count; k++)
+        {
+            uint32_t pixel = pSrcRows[k][x];
+
+            for (int channel = 0; channel < 4; channel++)
+                sums[channel] += pWeights[k] * (int32_t) ((pixel >> (channel * 8)) & 0xFF);
+        }
+
+        pDstRow[x] = ClampChannel(sums[0]) |
+                     (ClampChannel(sums[1]) << 8) |
+                     (ClampChannel(sums[2]) << 16) |
+                     (ClampChannel(sums[3]) << 24);
+    }
+}
+
+static void VerticalScalar(const Weights& weights, int dstRow, const uint32_t* const* pRows, int width, uint32_t* pDstRow)
+{
+    VerticalScalarPixels(weights, dstRow, pRows, 0, width, pDstRow);
+}
+
+// Scale a sum back down and clamp it to a linear channel value.
+static inline uint64_t ClampLinearChannel(int32_t sum)
+{
+    sum >>= Weights::WeightBits;
+
+    return (uint64_t) ((sum < 0) ? 0 : (sum > LinearMax) ? LinearMax : sum);
+}
+
+static void HorizontalLinearScalar(const Weights& weights, const uint64_t* pSrcRow, uint64_t* pDstRow)
+{
+    for (int x = 0; x < weights.m_DstSize; x++)
+    {
+        const uint64_t* pSrc = pSrcRow + weights.m_First[x];
+        const int16_t* pWeights = weights.GetWeights(x);
+        int count = weights.m_Count[x];
+
+        int32_t sums[4] = { Rounding, Rounding, Rounding, Rounding };
+
+        for (int k = 0; k < count; k++)
+        {
+            uint64_t pixel = pSrc[k];
+
+            for (int channel = 0; channel < 4; channel++)
+                sums[channel] += pWeights[k] * (int32_t) ((pixel >> (channel * 16)) & 0xFFFF);
+        }
+
+        pDstRow[x] = ClampLinearChannel(sums[0]) |
+                     (ClampLinearChannel(sums[1]) << 16) |
+                     (ClampLinearChannel(sums[2]) << 32) |
+                     (ClampLinearChannel(sums[3]) << 48);
+    }
+}
+
+static void VerticalLinearScalarPixels(const Weights& weights, int dstRow, const uint64_t* const* pRows, int firstPixel, int lastPixel, uint64_t* pDstRow)
+{
+    const uint64_t* const* pSrcRows = pRows + weights.m_First[dstRow];
+    const int16_t* pWeights = weights.GetWeights(dstRow);
+    int count = weights.m_Count[dstRow];
+
+    for (int x = firstPixel; x < lastPixel; x++)
+    {
+        int32_t sums[4] = { Rounding, Rounding, Rounding, Rounding };
+
+        for (int k = 0; k < count; k++)
+        {
+            uint64_t pixel = pSrcRows[k][x];
+
+            for (int channel = 0; channel < 4; channel++)
+                sums[channel] += pWeights[k] * (int32_t) ((pixel >> (channel * 16)) & 0xFFFF);
+        }
+
+        pDstRow[x] = ClampLinearChannel(sums[0]) |
+                     (ClampLinearChannel(sums[1]) << 16) |
+                     (ClampLinearChannel(sums[2]) << 32) |
+                     (ClampLinearChannel(sums[3]) << 48);
+    }
+}
+
+static void VerticalLinearScalar(const Weights& weights, int dstRow, const uint64_t* const* pRows, int width, uint64_t* pDstRow)
+{
+    VerticalLinearScalarPixels(weights, dstRow, pRows, 0, width, pDstRow);
+}
+
+#ifdef RESAMPLER_X86
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  SSE2 kernels
+//
+//  Channels are widened to 16 bits and interleaved so each _mm_madd_epi16
+//  multiplies the same channel of two pixels by their weights and adds
+//  them, giving 32-bit sums.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Two weights, for _mm_madd_epi16.
+static inline int32_t WeightPair(int16_t weight0, int16_t weight1)
+{
+    return (int32_t) ((uint32_t) (uint16_t) weight0 | ((uint32_t) (uint16_t) weight1 << 16));
+}
+
+// Scale four channel sums back down and pack them into a pixel.
+static inline uint32_t PackPixelSSE2(__m128i sums)
+{
+    sums = _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(Rounding)), Weights::WeightBits);
+    sums = _mm_packs_epi32(sums, sums);
+
+    return (uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(sums, sums));
+}
+
+// Add taps k...count-1 of a horizontal destination pixel to its sums.
+static inline __m128i HorizontalTapsSSE2(const uint32_t* pSrc, const int16_t* pWeights, int k, int count, __m128i sums)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    for (/**/; k + 2 <= count; k += 2)
+    {
+        // B0 B1 G0 G1 R0 R1 A0 A1
+        __m128i pixels = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int) pSrc[k]), _mm_cvtsi32_si128((int) pSrc[k + 1]));
+        pixels = _mm_unpacklo_epi8(pixels, zero);
+
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(pixels, _mm_set1_epi32(WeightPair(pWeights[k], pWeights[k + 1]))));
+    }
+
+    if (k < count)
+    {
+        // B0 0 G0 0 R0 0 A0 0
+        __m128i pixels = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int) pSrc[k]), zero);
+        pixels = _mm_unpacklo_epi8(pixels, zero);
+
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(pixels, _mm_set1_epi32(WeightPair(pWeights[k], 0))));
+    }
+
+    return sums;
+}
+
+static void HorizontalSSE2(const Weights& weights, const uint32_t* pSrcRow, uint32_t* pDstRow)
+{
+    for (int x = 0; x < weights.m_DstSize; x++)
+    {
+        __m128i sums = HorizontalTapsSSE2(pSrcRow + weights.m_First[x],
+                                          weights.GetWeights(x),
+                                          0,
+                                          weights.m_Count[x],
+                                          _mm_setzero_si128());
+
+        pDstRow[x] = PackPixelSSE2(sums);
+    }
+}
+
+// Make pixels x... of a row of the vertical pass, 4 at a time.
+// Returns where it stopped.
+static inline int VerticalPixelsSSE2(const Weights& weights, int dstRow, const uint32_t* const* pRows, int x, int width, uint32_t* pDstRow)
+{
+    const uint32_t* const* pSrcRows = pRows + weights.m_First[dstRow];
+    const int16_t* pWeights = weights.GetWeights(dstRow);
+    int count = weights.m_Count[dstRow];
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(Rounding);
+
+    for (/**/; x + 4 <= width; x += 4)
+    {
+        // Sums for bytes 0-3, 4-7, 8-11, and 12-15.
+        __m128i sums0 = rounding;
+        __m128i sums1 = rounding;
+        __m128i sums2 = rounding;
+        __m128i sums3 = rounding;
+
+        for (int k = 0; k < count; k += 2)
+        {
+            // An odd row out is paired with itself, with a weight of zero.
+            bool hasPair = k + 1 < count;
+
+            __m128i row0 = _mm_loadu_si128((const __m128i*) (pSrcRows[k] + x));
+            __m128i row1 = hasPair ? _mm_loadu_si128((const __m128i*) (pSrcRows[k + 1] + x)) : row0;
+            __m128i weightPair = _mm_set1_epi32(WeightPair(pWeights[k], hasPair ? pWeights[k + 1] : 0));
+
+            __m128i low = _mm_unpacklo_epi8(row0, row1);
+            __m128i high = _mm_unpackhi_epi8(row0, row1);
+
+            sums0 = _mm_add_epi32(sums0, _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), weightPair));
+            sums1 = _mm_add_epi32(sums1, _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), weightPair));
+            sums2 = _mm_add_epi32(sums2, _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), weightPair));
+            sums3 = _mm_add_epi32(sums3, _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), weightPair));
+        }
+
+        sums0 = _mm_srai_epi32(sums0, Weights::WeightBits);
+        sums1 = _mm_srai_epi32(sums1, Weights::WeightBits);
+        sums2 = _mm_srai_epi32(sums2, Weights::WeightBits);
+        sums3 = _mm_srai_epi32(sums3, Weights::WeightBits);
+
+        __m128i result = _mm_packus_epi16(_mm_packs_epi32(sums0, sums1), _mm_packs_epi32(sums2, sums3));
+
+        _mm_storeu_si128((__m128i*) (pDstRow + x), result);
+    }
+
+    return x;
+}
+
+static void VerticalSSE2(const Weights& weights, int dstRow, const uint32_t* const* pRows, int width, uint32_t* pDstRow)
+{
+    int x = VerticalPixelsSSE2(weights, dstRow, pRows, 0, width, pDstRow);
+
+    VerticalScalarPixels(weights, dstRow, pRows, x, width, pDstRow);
+}
+
+// Linear pixels are already 16 bits per channel, so they only need to be
+// interleaved.
+
+static void HorizontalLinearSSE2(const Weights& weights, const uint64_t* pSrcRow, uint64_t* pDstRow)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(Rounding);
+
+    for (int x = 0; x < weights.m_DstSize; x++)
+    {
+        const uint64_t* pSrc = pSrcRow + weights.m_First[x];
+        const int16_t* pWeights = weights.GetWeights(x);
+        int count = weights.m_Count[x];
+
+        __m128i sums = rounding;
+
+        int k = 0;
+
+        for (/**/; k + 2 <= count; k += 2)
+        {
+            // B0 B1 G0 G1 R0 R1 A0 A1
+            __m128i pixels = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) (pSrc + k)),
+                                                _mm_loadl_epi64((const __m128i*) (pSrc + k + 1)));
+
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(pixels, _mm_set1_epi32(WeightPair(pWeights[k], pWeights[k + 1]))));
+        }
+
+        if (k < count)
+        {
+            // B0 0 G0 0 R0 0 A0 0
+            __m128i pixels = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) (pSrc + k)), zero);
+
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(pixels, _mm_set1_epi32(WeightPair(pWeights[k], 0))));
+        }
+
+        sums = _mm_srai_epi32(sums, Weights::WeightBits);
+        sums = _mm_max_epi16(_mm_packs_epi32(sums, sums), zero);
+
+        _mm_storel_epi64((__m128i*) (pDstRow + x), sums);
+    }
+}
+
+static void VerticalLinearSSE2(const Weights& weights, int dstRow, const uint64_t* const* pRows, int width, uint64_t* pDstRow)
+{
+    const uint64_t* const* pSrcRows = pRows + weights.m_First[dstRow];
+    const int16_t* pWeights = weights.GetWeights(dstRow);
+    int count = weights.m_Count[dstRow];
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(Rounding);
+
+    int x = 0;
+
+    for (/**/; x + 4 <= width; x += 4)
+    {
+        // Sums for pixels x...x+3.
+        __m128i sums0 = rounding;
+        __m128i sums1 = rounding;
+        __m128i sums2 = rounding;
+        __m128i sums3 = rounding;
+
+        for (int k = 0; k < count; k += 2)
+        {
+            // An odd row out is paired with itself, with a weight of zero.
+            bool hasPair = k + 1 < count;
+
+            const uint64_t* pRow0 = pSrcRows[k] + x;
+            const uint64_t* pRow1 = hasPair ? pSrcRows[k + 1] + x : pRow0;
+
+            __m128i row0a = _mm_loadu_si128((const __m128i*) pRow0);
+            __m128i row0b = _mm_loadu_si128((const __m128i*) (pRow0 + 2));
+            __m128i row1a = _mm_loadu_si128((const __m128i*) pRow1);
+            __m128i row1b = _mm_loadu_si128((const __m128i*) (pRow1 + 2));
+            __m128i weightPair = _mm_set1_epi32(WeightPair(pWeights[k], hasPair ? pWeights[k + 1] : 0));
+
+            sums0 = _mm_add_epi32(sums0, _mm_madd_epi16(_mm_unpacklo_epi16(row0a, row1a), weightPair));
+            sums1 = _mm_add_epi32(sums1, _mm_madd_epi16(_mm_unpackhi_epi16(row0a, row1a), weightPair));
+            sums2 = _mm_add_epi32(sums2, _mm_madd_epi16(_mm_unpacklo_epi16(row0b, row1b), weightPair));
+            sums3 = _mm_add_epi32(sums3, _mm_madd_epi16(_mm_unpackhi_epi16(row0b, row1b), weightPair));
+        }
+
+        sums0 = _mm_srai_epi32(sums0, Weights::WeightBits);
+        sums1 = _mm_srai_epi32(sums1, Weights::WeightBits);
+        sums2 = _mm_srai_epi32(sums2, Weights::WeightBits);
+        sums3 = _mm_srai_epi32(sums3, Weights::WeightBits);
+
+        _mm_storeu_si128((__m128i*) (pDstRow + x), _mm_max_epi16(_mm_packs_epi32(sums0, sums1), zero));
+        _mm_storeu_si128((__m128i*) (pDstRow + x + 2), _mm_max_epi16(_mm_packs_epi32(sums2, sums3), zero));
+    }
+
+    VerticalLinearScalarPixels(weights, dstRow, pRows, x, width, pDstRow);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  AVX2 kernels
+//
+//  Same as the SSE2 kernels, but twice as wide. AVX2 unpacks and packs
+//  within each 128-bit half, so pixels come out in the order they went in.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+TARGET_AVX2
+static void HorizontalAVX2(const Weights& weights, const uint32_t* pSrcRow, uint32_t* pDstRow)
+{
+    // B0 B1 G0 G1 R0 R1 A0 A1 B2 B3 G2 G3 R2 R3 A2 A3
+    const __m128i interleave = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+
+    for (int x = 0; x < weights.m_DstSize; x++)
+    {
+        const uint32_t* pSrc = pSrcRow + weights.m_First[x];
+        const int16_t* pWeights = weights.GetWeights(x);
+        int count = weights.m_Count[x];
+
+        // Sums for pixels 0+1 (low half) and 2+3 (high half) of each 4.
+        __m256i sums = _mm256_setzero_si256();
+
+        int k = 0;
+
+        for (/**/; k + 4 <= count; k += 4)
+        {
+            __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (pSrc + k)), interleave);
+
+            int32_t weights01 = WeightPair(pWeights[k], pWeights[k + 1]);
+            int32_t weights23 = WeightPair(pWeights[k + 2], pWeights[k + 3]);
+
+            __m256i weightPairs = _mm256_setr_epi32(weights01, weights01, weights01, weights01,
+                                                    weights23, weights23, weights23, weights23);
+
+            sums = _mm256_add_epi32(sums, _mm256_madd_epi16(_mm256_cvtepu8_epi16(pixels), weightPairs));
+        }
+
+        __m128i sums128 = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+
+        sums128 = HorizontalTapsSSE2(pSrc, pWeights, k, count, sums128);
+
+        pDstRow[x] = PackPixelSSE2(sums128);
+    }
+}
+
+TARGET_AVX2
+static void VerticalAVX2(const Weights& weights, int dstRow, const uint32_t* const* pRows, int width, uint32_t* pDstRow)
+{
+    const uint32_t* const* pSrcRows = pRows + weights.m_First[dstRow];
+    const int16_t* pWeights = weights.GetWeights(dstRow);
+    int count = weights.m_Count[dstRow];
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rounding = _mm256_set1_epi32(Rounding);
+
+    int x = 0;
+
+    for (/**/; x + 8 <= width; x += 8)
+    {
+        __m256i sums0 = rounding;
+        __m256i sums1 = rounding;
+        __m256i sums2 = rounding;
+        __m256i sums3 = rounding;
+
+        for (int k = 0; k < count; k += 2)
+        {
+            bool hasPair = k + 1 < count;
+
+            __m256i row0 = _mm256_loadu_si256((const __m256i*) (pSrcRows[k] + x));
+            __m256i row1 = hasPair ? _mm256_loadu_si256((const __m256i*) (pSrcRows[k + 1] + x)) : row0;
+            __m256i weightPair = _mm256_set1_epi32(WeightPair(pWeights[k], hasPair ? pWeights[k + 1] : 0));
+
+            __m256i low = _mm256_unpacklo_epi8(row0, row1);
+            __m256i high = _mm256_unpackhi_epi8(row0, row1);
+
+            sums0 = _mm256_add_epi32(sums0, _mm256_madd_epi16(_mm256_unpacklo_epi8(low, zero), weightPair));
+            sums1 = _mm256_add_epi32(sums1, _mm256_madd_epi16(_mm256_unpackhi_epi8(low, zero), weightPair));
+            sums2 = _mm256_add_epi32(sums2, _mm256_madd_epi16(_mm256_unpacklo_epi8(high, zero), weightPair));
+            sums3 = _mm256_add_epi32(sums3, _mm256_madd_epi16(_mm256_unpackhi_epi8(high, zero), weightPair));
+        }
+
+        sums0 = _mm256_srai_epi32(sums0, Weights::WeightBits);
+        sums1 = _mm256_srai_epi32(sums1, Weights::WeightBits);
+        sums2 = _mm256_srai_epi32(sums2, Weights::WeightBits);
+        sums3 = _mm256_srai_epi32(sums3, Weights::WeightBits);
+
+        __m256i result = _mm256_packus_epi16(_mm256_packs_epi32(sums0, sums1), _mm256_packs_epi32(sums2, sums3));
+
+        _mm256_storeu_si256((__m256i*) (pDstRow + x), result);
+    }
+
+    x = VerticalPixelsSSE2(weights, dstRow, pRows, x, width, pDstRow);
+
+    VerticalScalarPixels(weights, dstRow, pRows, x, width, pDstRow);
+}
+
+#endif // RESAMPLER_X86
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Bands
+//
+//  The destination image is split into bands of rows, which are resampled
+//  independently (on separate threads). Each band resamples the source rows
+//  its own destination rows need, so the source rows under the filter at
+//  the edge of a band are resampled horizontally by both bands. Every
+//  destination pixel is made from the same weights and the same
+//  intermediate pixels however the image is split, so the output doesn't
+//  depend on the number of bands.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Don't split images smaller than this (in destination pixels) --
+// starting a thread costs more than resampling them.
+static const size_t MinBandPixels = 256 * 1024;
+
+using HorizontalFunction = void (*)(const Weights& weights, const uint32_t* pSrcRow, uint32_t* pDstRow);
+using VerticalFunction = void (*)(const Weights& weights, int dstRow, const uint32_t* const* pRows, int width, uint32_t* pDstRow);
+using HorizontalLinearFunction = void (*)(const Weights& weights, const uint64_t* pSrcRow, uint64_t* pDstRow);
+using VerticalLinearFunction = void (*)(const Weights& weights, int dstRow, const uint64_t* const* pRows, int width, uint64_t* pDstRow);
+
+// Everything needed to resample a band.
+struct ResampleJob
+{
+    const Weights* m_pHorizontal;
+    const Weights* m_pVertical;
+    HorizontalFunction m_HorizontalFunction;
+    VerticalFunction m_VerticalFunction;
+    bool m_LinearLight;
+    HorizontalLinearFunction m_HorizontalLinearFunction;
+    VerticalLinearFunction m_VerticalLinearFunction;
+    const uint32_t* m_pSrc;
+    ptrdiff_t m_SrcStride;
+    int m_SrcHeight;
+    uint32_t* m_pDst;
+    ptrdiff_t m_DstStride;
+    int m_DstWidth;
+};
+
+// Get the source rows that destination rows firstDstRow...lastDstRow-1
+// are made from. Only those need to be resampled horizontally.
+static void GetSourceRows(const Weights& vertical, int firstDstRow, int lastDstRow, int* pFirstRow, int* pLastRow)
+{
+    int firstRow = vertical.m_SrcSize;
+    int lastRow = 0;
+
+    for (int dstRow = firstDstRow; dstRow < lastDstRow; dstRow++)
+    {
+        firstRow = std::min(firstRow, vertical.m_First[dstRow]);
+        lastRow = std::max(lastRow, vertical.m_First[dstRow] + vertical.m_Count[dstRow]);
+    }
+
+    *pFirstRow = firstRow;
+    *pLastRow = lastRow;
+}
+
+// Resample destination rows firstDstRow...lastDstRow-1 in linear light.
+static void ResampleBandLinear(const ResampleJob& job, int firstDstRow, int lastDstRow, CResampleBuffers& buffers)
+{
+    int srcWidth = job.m_pHorizontal->m_SrcSize;
+    int dstWidth = job.m_DstWidth;
+
+    int firstRow, lastRow;
+    GetSourceRows(*job.m_pVertical, firstDstRow, lastDstRow, &firstRow, &lastRow);
+
+    // Source rows are converted to linear, then resampled horizontally
+    // (if needed). Destination rows are resampled vertically, then
+    // converted back.
+    buffers.m_LinearIntermediate.resize((size_t) (lastRow - firstRow) * dstWidth);
+    buffers.m_LinearRows.assign(job.m_SrcHeight, nullptr);
+    buffers.m_LinearRow.resize(std::max(srcWidth, dstWidth));
+
+    uint64_t* pLinearRow = buffers.m_LinearRow.data();
+
+    for (int row = firstRow; row < lastRow; row++)
+    {
+        uint64_t* pRow = buffers.m_LinearIntermediate.data() + (size_t) (row - firstRow) * dstWidth;
+
+        if (srcWidth == dstWidth)
+        {
+            ToLinearRow(job.m_pSrc + row * job.m_SrcStride, srcWidth, pRow);
+        }
+        else
+        {
+            ToLinearRow(job.m_pSrc + row * job.m_SrcStride, srcWidth, pLinearRow);
+            job.m_HorizontalLinearFunction(*job.m_pHorizontal, pLinearRow, pRow);
+        }
+
+        buffers.m_LinearRows[row] = pRow;
+    }
+
+    for (int dstRow = firstDstRow; dstRow < lastDstRow; dstRow++)
+    {
+        job.m_VerticalLinearFunction(*job.m_pVertical, dstRow, buffers.m_LinearRows.data(), dstWidth, pLinearRow);
+        FromLinearRow(pLinearRow, dstWidth, job.m_pDst + dstRow * job.m_DstStride);
+    }
+}
+
+// Resample destination rows firstDstRow...lastDstRow-1.
+static void ResampleBand(const ResampleJob& job, int firstDstRow, int lastDstRow, CResampleBuffers& buffers)
+{
+    if (job.m_LinearLight)
+    {
+        ResampleBandLinear(job, firstDstRow, lastDstRow, buffers);
+        return;
+    }
+
+    int firstRow, lastRow;
+    GetSourceRows(*job.m_pVertical, firstDstRow, lastDstRow, &firstRow, &lastRow);
+
+    buffers.m_Rows.assign(job.m_SrcHeight, nullptr);
+
+    if (job.m_pHorizontal->m_SrcSize == job.m_DstWidth)
+    {
+        // Nothing to do horizontally.
+        for (int row = firstRow; row < lastRow; row++)
+            buffers.m_Rows[row] = job.m_pSrc + row * job.m_SrcStride;
+    }
+    else
+    {
+        buffers.m_Intermediate.resize((size_t) (lastRow - firstRow) * job.m_DstWidth);
+
+        for (int row = firstRow; row < lastRow; row++)
+        {
+            uint32_t* pRow = buffers.m_Intermediate.data() + (size_t) (row - firstRow) * job.m_DstWidth;
+
+            job.m_HorizontalFunction(*job.m_pHorizontal, job.m_pSrc + row * job.m_SrcStride, pRow);
+            buffers.m_Rows[row] = pRow;
+        }
+    }
+
+    for (int dstRow = firstDstRow; dstRow < lastDstRow; dstRow++)
+        job.m_VerticalFunction(*job.m_pVertical, dstRow, buffers.m_Rows.data(), job.m_DstWidth, job.m_pDst + dstRow * job.m_DstStride);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler::CResampler
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CResampler::CResampler(
+    ResampleFilter filter /*= FILTER_Lanczos3*/,
+    unsigned concurrency /*= 1*/
+)
+    :
+    m_Filter(filter),
+    m_Kernel(GetBestKernel()),
+    m_Concurrency(concurrency),
+    m_LinearLight(false),
+    m_Horizontal(),
+    m_Vertical(),
+    m_Buffers()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler::SetKernel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CResampler::SetKernel(
+    ResampleKernel kernel
+)
+{
+    m_Kernel = std::min(kernel, GetBestKernel());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler::GetThreadCount
+//
+//////////////////////////////////////////////////////////////////////////////
+
+unsigned
+CResampler::GetThreadCount() const
+{
+    if (m_Concurrency != 0)
+        return m_Concurrency;
+
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler::GetBestKernel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+ResampleKernel
+CResampler::GetBestKernel()
+{
+    static const ResampleKernel bestKernel = /*LAMBDA*/ [] ()
+    {
+#if defined(RESAMPLER_X86) && defined(_MSC_VER)
+
+        int info[4];
+
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        bool hasSSE2 = (info[3] & (1 << 26)) != 0;
+
+        // AVX needs the OS to save the YMM registers (OSXSAVE and XCR0).
+        bool hasAVX = (info[2] & (1 << 27)) != 0 &&
+                      (info[2] & (1 << 28)) != 0 &&
+                      (_xgetbv(0) & 6) == 6;
+
+        bool hasAVX2 = false;
+
+        if (hasAVX && maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            hasAVX2 = (info[1] & (1 << 5)) != 0;
+        }
+
+#elif defined(RESAMPLER_X86)
+
+        __builtin_cpu_init();
+
+        bool hasSSE2 = __builtin_cpu_supports("sse2");
+        bool hasAVX2 = __builtin_cpu_supports("avx2");
+
+#else
+
+        bool hasSSE2 = false;
+        bool hasAVX2 = false;
+
+#endif
+
+        return hasAVX2 ? KERNEL_AVX2 : hasSSE2 ? KERNEL_SSE2 : KERNEL_Scalar;
+    }();
+
+    return bestKernel;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler::UpdateWeights
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+void
+CResampler::UpdateWeights(
+    CResampleWeights& weights,
+    int srcSize,
+    int dstSize,
+    ResampleFilter filter
+)
+{
+    if (!weights.m_First.empty() &&
+        weights.m_SrcSize == srcSize &&
+        weights.m_DstSize == dstSize &&
+        weights.m_Filter == filter)
+    {
+        return;
+    }
+
+    const FilterInfo& filterInfo = Filters[filter];
+
+    // When shrinking, the filter is widened to cover all the source
+    // pixels under each destination pixel.
+    double scale = (double) srcSize / dstSize;
+    double filterScale = std::max(scale, 1.0);
+    double support = filterInfo.m_Support * filterScale;
+
+    // One extra pixel at either end of the window, so the filter (not
+    // rounding in the window calculation) decides whether pixels right at
+    // the edge of its support count. Zero weights are dropped below.
+    int maxTaps = (int) std::ceil(support) * 2 + 3;
+
+    weights.m_SrcSize = srcSize;
+    weights.m_DstSize = dstSize;
+    weights.m_Filter = filter;
+    weights.m_MaxTaps = maxTaps;
+    weights.m_First.assign(dstSize, 0);
+    weights.m_Count.assign(dstSize, 0);
+    weights.m_Weights.assign((size_t) dstSize * maxTaps, 0);
+
+    std::vector<double> values(maxTaps);
+
+    const int one = 1 << Weights::WeightBits;
+
+    for (int dst = 0; dst < dstSize; dst++)
+    {
+        // Pixel centers are at +0.5.
+        double center = (dst + 0.5) * scale;
+
+        int first = std::max((int) (center - support + 0.5) - 1, 0);
+        int last = std::min((int) (center + support + 0.5) + 1, srcSize);
+        int count = std::max(last - first, 1);
+
+        first = std::min(first, srcSize - count);
+
+        ATLASSERT(count <= maxTaps);
+
+        double total = 0.0;
+
+        for (int k = 0; k < count; k++)
+        {
+            values[k] = filterInfo.m_Function((first + k + 0.5 - center) / filterScale);
+            total += values[k];
+        }
+
+        // Convert to fixed point. Rounding errors go to the biggest
+        // weight, so the weights add up to exactly 1.0.
+        int16_t* pWeights = weights.m_Weights.data() + (size_t) dst * maxTaps;
+        int sum = 0;
+        int biggest = 0;
+
+        for (int k = 0; k < count; k++)
+        {
+            double value = (total != 0.0) ? values[k] / total : (k == count / 2) ? 1.0 : 0.0;
+
+            pWeights[k] = (int16_t) std::lround(value * one);
+            sum += pWeights[k];
+
+            if (std::abs(pWeights[k]) > std::abs(pWeights[biggest]))
+                biggest = k;
+        }
+
+        pWeights[biggest] = (int16_t) (pWeights[biggest] + one - sum);
+
+        // Drop zero weights at either end.
+        int skip = 0;
+        while (count > 1 && pWeights[skip] == 0)
+        {
+            skip++;
+            count--;
+        }
+
+        while (count > 1 && pWeights[skip + count - 1] == 0)
+            count--;
+
+        if (skip != 0)
+            std::copy(pWeights + skip, pWeights + skip + count, pWeights);
+
+        std::fill(pWeights + count, pWeights + maxTaps, (int16_t) 0);
+
+        weights.m_First[dst] = first + skip;
+        weights.m_Count[dst] = count;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler::Resample
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CResampler::Resample(
+    const uint32_t* pSrc,
+    ptrdiff_t srcStride,
+    int srcWidth,
+    int srcHeight,
+    uint32_t* pDst,
+    ptrdiff_t dstStride,
+    int dstWidth,
+    int dstHeight
+)
+{
+    if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0)
+        return;
+
+    UpdateWeights(m_Horizontal, srcWidth, dstWidth, m_Filter);
+    UpdateWeights(m_Vertical, srcHeight, dstHeight, m_Filter);
+
+    HorizontalFunction horizontal = HorizontalScalar;
+    VerticalFunction vertical = VerticalScalar;
+    HorizontalLinearFunction horizontalLinear = HorizontalLinearScalar;
+    VerticalLinearFunction verticalLinear = VerticalLinearScalar;
+
+#ifdef RESAMPLER_X86
+    if (m_Kernel == KERNEL_AVX2)
+    {
+        // The AVX2 horizontal kernel does 4 taps at a time, which only
+        // pays off for the wider filters.
+        horizontal = (m_Horizontal.m_MaxTaps >= 8) ? HorizontalAVX2 : HorizontalSSE2;
+        vertical = VerticalAVX2;
+    }
+    else if (m_Kernel == KERNEL_SSE2)
+    {
+        horizontal = HorizontalSSE2;
+        vertical = VerticalSSE2;
+    }
+
+    // There are no AVX2 linear light kernels.
+    if (m_Kernel != KERNEL_Scalar)
+    {
+        horizontalLinear = HorizontalLinearSSE2;
+        verticalLinear = VerticalLinearSSE2;
+    }
+#endif
+
+    ResampleJob job = { &m_Horizontal,
+                        &m_Vertical,
+                        horizontal,
+                        vertical,
+                        m_LinearLight,
+                        horizontalLinear,
+                        verticalLinear,
+                        pSrc,
+                        srcStride,
+                        srcHeight,
+                        pDst,
+                        dstStride,
+                        dstWidth };
+
+    // One band per thread, but not so many that the bands get small.
+    size_t bandCount = std::min({ (size_t) GetThreadCount(),
+                                  (size_t) dstWidth * dstHeight / MinBandPixels,
+                                  (size_t) dstHeight });
+
+    if (bandCount <= 1)
+    {
+        ResampleBand(job, 0, dstHeight, m_Buffers);
+        return;
+    }
+
+    // Band 0 is done on this thread, the rest on their own threads.
+    auto bandRow = [&] (size_t band) { return (int) (dstHeight * band / bandCount); };
+
+    std::vector<std::thread> workers;
+    workers.reserve(bandCount - 1);
+
+    for (size_t band = 1; band < bandCount; band++)
+    {
+        workers.emplace_back(/*LAMBDA*/ [&job, firstDstRow = bandRow(band), lastDstRow = bandRow(band + 1)] ()
+        {
+            CResampleBuffers buffers;
+
+            ResampleBand(job, firstDstRow, lastDstRow, buffers);
+        });
+    }
+
+    ResampleBand(job, 0, bandRow(1), m_Buffers);
+
+    for (std::thread& worker: workers)
+        worker.join();
+}
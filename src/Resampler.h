@@ -0,0 +1,251 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Resampler.h
+//
+//  CResampler class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Resampling filter.
+enum ResampleFilter
+{
+    // Average of the source pixels under each destination pixel
+    // (nearest neighbor when enlarging).
+    FILTER_Box = 0,
+
+    // Linear interpolation (triangle filter).
+    FILTER_Bilinear = 1,
+
+    // Cubic convolution (Catmull-Rom). Sharper than bilinear.
+    FILTER_Bicubic = 2,
+
+    // Windowed sinc with 3 lobes. Sharpest, and slowest.
+    FILTER_Lanczos3 = 3
+};
+
+// Instruction set used to resample.
+enum ResampleKernel
+{
+    KERNEL_Scalar = 0,
+    KERNEL_SSE2 = 1,
+    KERNEL_AVX2 = 2
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampleWeights
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Filter weights for resampling in one direction (horizontal or vertical).
+struct CResampleWeights
+{
+    // Weights are fixed point: 1.0 = 1 << WeightBits.
+    static constexpr int WeightBits = 14;
+
+    int m_SrcSize;
+    int m_DstSize;
+    ResampleFilter m_Filter;
+
+    // Number of weights stored for each destination pixel.
+    int m_MaxTaps;
+
+    // First source pixel for each destination pixel.
+    std::vector<int> m_First;
+
+    // Number of source pixels for each destination pixel.
+    std::vector<int> m_Count;
+
+    // m_MaxTaps weights for each destination pixel.
+    std::vector<int16_t> m_Weights;
+
+    const int16_t*
+    GetWeights(
+        int dstIndex
+    ) const
+    {
+        return m_Weights.data() + (size_t) dstIndex * m_MaxTaps;
+    }
+};
+
+// Working memory for resampling (one for each thread).
+struct CResampleBuffers
+{
+    // Horizontally resampled source rows.
+    std::vector<uint32_t> m_Intermediate;
+
+    // Row pointers into m_Intermediate (or the source), by source row.
+    std::vector<const uint32_t*> m_Rows;
+
+    // Linear light versions of m_Intermediate and m_Rows.
+    std::vector<uint64_t> m_LinearIntermediate;
+    std::vector<const uint64_t*> m_LinearRows;
+
+    // One row of linear light pixels.
+    std::vector<uint64_t> m_LinearRow;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CResampler
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Resizes 32bpp images (raw pixel buffers) with a choice of filters.
+//
+// Images are resampled in two passes: horizontally into an intermediate
+// image, then vertically. Each pass uses a table of filter weights (which
+// source pixels make up each destination pixel, and how much each one
+// counts), computed once for a given source size, destination size, and
+// filter, and reused until one of those changes. The weights are 14-bit
+// fixed point, so the SSE2 and AVX2 kernels produce exactly the same
+// result as the scalar kernel.
+//
+// All four channels are filtered the same way, so the channel order
+// doesn't matter -- except in linear light mode, where the first three
+// channels are converted from sRGB to linear intensities (through lookup
+// tables) before filtering, and back afterwards. Filtering gamma-encoded
+// values darkens fine detail and high-contrast edges, especially when
+// shrinking a lot; linear light doesn't.
+//
+// Large images can be split into bands of rows that are resampled on
+// several threads at once (see SetConcurrency), giving exactly the same
+// result as resampling on one thread.
+//
+// Doesn't use any Windows APIs. Not thread-safe -- use one resampler
+// per thread.
+class CResampler
+{
+    public:
+
+        // concurrency is the most threads to use (0 = one per processor).
+        CResampler(
+            ResampleFilter filter = FILTER_Lanczos3,
+            unsigned concurrency = 1
+        );
+
+        // No copy ctor.
+        CResampler(const CResampler&) = delete;
+
+        // No copy assignment.
+        CResampler& operator=(const CResampler&) = delete;
+
+        ResampleFilter
+        GetFilter() const
+        {
+            return m_Filter;
+        }
+
+        void
+        SetFilter(
+            ResampleFilter filter
+        )
+        {
+            m_Filter = filter;
+        }
+
+        bool
+        GetLinearLight() const
+        {
+            return m_LinearLight;
+        }
+
+        // Filter in linear light instead of sRGB.
+        void
+        SetLinearLight(
+            bool linearLight
+        )
+        {
+            m_LinearLight = linearLight;
+        }
+
+        ResampleKernel
+        GetKernel() const
+        {
+            return m_Kernel;
+        }
+
+        // Use a particular kernel (e.g. to compare them). Kernels
+        // the CPU doesn't support are replaced by the best one it does.
+        void
+        SetKernel(
+            ResampleKernel kernel
+        );
+
+        unsigned
+        GetConcurrency() const
+        {
+            return m_Concurrency;
+        }
+
+        // Set the most threads to use (0 = one per processor).
+        // Small images are always done on the calling thread.
+        void
+        SetConcurrency(
+            unsigned concurrency
+        )
+        {
+            m_Concurrency = concurrency;
+        }
+
+        // Get the best kernel the CPU supports.
+        static
+        ResampleKernel
+        GetBestKernel();
+
+        // Resize a srcWidth x srcHeight image to dstWidth x dstHeight.
+        // Strides are in pixels.
+        void
+        Resample(
+            const uint32_t* pSrc,
+            ptrdiff_t srcStride,
+            int srcWidth,
+            int srcHeight,
+            uint32_t* pDst,
+            ptrdiff_t dstStride,
+            int dstWidth,
+            int dstHeight
+        );
+
+    private:
+
+        // Get the number of threads to use.
+        unsigned
+        GetThreadCount() const;
+
+        // Compute the weights, unless they're already up to date.
+        static
+        void
+        UpdateWeights(
+            CResampleWeights& weights,
+            int srcSize,
+            int dstSize,
+            ResampleFilter filter
+        );
+
+        ResampleFilter m_Filter;
+
+        ResampleKernel m_Kernel;
+
+        unsigned m_Concurrency;
+
+        bool m_LinearLight;
+
+        CResampleWeights m_Horizontal;
+
+        CResampleWeights m_Vertical;
+
+        // For the calling thread's band (other threads have their own).
+        CResampleBuffers m_Buffers;
+};
@@ -19,13 +19,69 @@
 
 #include "Resize.h"
 
+// Fill in a BITMAPINFO for 32bpp top-down pixels.
+static void InitBitmapInfo(BITMAPINFO* pInfo, int width, int height)
+{
+    memset(pInfo, 0, sizeof(*pInfo));
+    pInfo->bmiHeader.biSize        = sizeof(pInfo->bmiHeader);
+    pInfo->bmiHeader.biWidth       = width;
+    pInfo->bmiHeader.biHeight      = -height;   // Top-down.
+    pInfo->bmiHeader.biPlanes      = 1;
+    pInfo->bmiHeader.biBitCount    = 32;
+    pInfo->bmiHeader.biCompression = BI_RGB;
+}
+
+// Get the pixels of a bitmap as 32bpp top-down.
+bool
+GetBitmapPixels(
+    HBITMAP hBitmap,
+    SIZE size,
+    uint32_t* pPixels
+)
+{
+    BITMAPINFO bitmapInfo;
+    InitBitmapInfo(&bitmapInfo, size.cx, size.cy);
+
+    HDC hScreenDC = ::GetDC(NULL);
+    int linesCopied = ::GetDIBits(hScreenDC,
+                                  hBitmap,
+                                  0,
+                                  size.cy,
+                                  pPixels,
+                                  &bitmapInfo,
+                                  DIB_RGB_COLORS);
+    ::ReleaseDC(NULL, hScreenDC);
+
+    return linesCopied == size.cy;
+}
+
+// Create a 32bpp top-down DIB section.
+HBITMAP
+CreatePixelBitmap(
+    SIZE size,
+    uint32_t** ppPixels
+)
+{
+    BITMAPINFO bitmapInfo;
+    InitBitmapInfo(&bitmapInfo, size.cx, size.cy);
+
+    void* pBits = nullptr;
+    HBITMAP hBitmap = ::CreateDIBSection(NULL, &bitmapInfo, DIB_RGB_COLORS, &pBits, NULL, 0);
+
+    *ppPixels = hBitmap ? (uint32_t*) pBits : nullptr;
+
+    return hBitmap;
+}
+
 // Resize wallpaper bitmap.
 bool
 ResizeWallpaperBitmap(
     HBITMAP* phBitmap,              // IN: Original bitmap, OUT: Resized bitmap.
     SIZE dstSize,                   // New bitmap size.
     WallpaperResizeMode resizeMode, // Resize mode.
-    COLORREF backgroundColor        // Background color.
+    COLORREF backgroundColor,       // Background color.
+    ResampleFilter filter,          // Resampling filter.
+    bool linearLight                // Filter in linear light (see CResampler).
 )
 {
     //
@@ -49,262 +105,35 @@ ResizeWallpaperBitmap(
         return false;
 
     //
-    // Create DC for source bitmap.
-    //
-
-    CDCHandle srcDC;
-    srcDC.CreateCompatibleDC();
-    srcDC.SelectBitmap(*phBitmap);
-
+    // Get the source pixels.
     //
-    // Create DC and BITMAP for resized bitmap.
-    //
-
-    CBitmapHandle dstBitmap;
-    dstBitmap.CreateCompatibleBitmap(srcDC, dstSize.cx, dstSize.cy);
-
-    CDCHandle dstDC;
-    dstDC.CreateCompatibleDC();
-    dstDC.SelectBitmap(dstBitmap);
-    dstDC.SetStretchBltMode(HALFTONE);
-    dstDC.SetBrushOrg(0, 0);
 
-    //
-    // Initialize the resized bitmap background (if needed).
-    //
+    std::vector<uint32_t> srcPixels((size_t) srcSize.cx * srcSize.cy);
 
-    if (resizeMode == RESIZE_Center || resizeMode == RESIZE_Fit)
+    if (!GetBitmapPixels(*phBitmap, srcSize, srcPixels.data()))
     {
-        CBrush backgroundBrush = ::CreateSolidBrush(backgroundColor);
-        RECT dstRect = { 0, 0, dstSize.cx, dstSize.cy };
-        dstDC.FillRect(&dstRect, backgroundBrush);
+        ATLASSERT(false);
+        return false;
     }
 
     //
-    // Resize the bitmap.
+    // Create the resized bitmap.
     //
 
-    int srcX = 0,
-        srcY = 0,
-        srcWidth = srcSize.cx,
-        srcHeight = srcSize.cy;
-
-    int dstX = 0,
-        dstY = 0,
-        dstWidth = dstSize.cx,
-        dstHeight = dstSize.cy;
-
-    int diffWidth = dstWidth - srcWidth;
-    int diffHeight = dstHeight - srcHeight;
-
-    switch (resizeMode)
-    {
-        case RESIZE_Center:
-        {
-            // Center the wallpaper image in its original size, filling the remaining
-            // area with a solid background color if image is smaller than screen or
-            // cropping image if image is larger.
-
-            if (diffWidth < 0)
-            {
-                // Crop left/right
-                diffWidth = abs(diffWidth);
-                srcX += diffWidth / 2;
-                srcWidth -= diffWidth;
-            }
-            else if (diffWidth > 0)
-            {
-                // Center left/right
-                diffWidth = abs(diffWidth);
-                dstX += diffWidth / 2;
-            }
-
-            if (diffHeight < 0)
-            {
-                // Crop top/bottom
-                diffHeight = abs(diffHeight);
-                srcY += diffHeight / 2;
-                srcHeight -= diffHeight;
-            }
-            else if (diffHeight > 0)
-            {
-                // Center top/bottom
-                diffHeight = abs(diffHeight);
-                dstY += diffHeight / 2;
-            }
-
-            ::BitBlt(dstDC,
-                     dstX, dstY,
-                     srcWidth, srcHeight,
-                     srcDC,
-                     srcX, srcY,
-                     SRCCOPY);
-
-            break;
-        }
-
-        case RESIZE_Tile:
-        {
-            // Tile the wallpaper image, starting in the upper left corner of the screen.
-            // This uses the image in its original size. If image is larger than screen,
-            // it will be cropped on the right and bottom.
-
-            if (srcWidth > dstWidth && srcHeight > dstHeight)
-            {
-                // Image is larger than screen -- just crop it.
-                ::BitBlt(dstDC,
-                         0, 0,
-                         dstWidth, dstHeight,
-                         srcDC,
-                         0, 0,
-                         SRCCOPY);
-                break;
-            }
-
-            // Tile the image.
-            for (;;)
-            {
-                if (dstX >= dstWidth)
-                {
-                    // Next row
-                    dstX = 0;
-                    dstY += srcHeight;
-                }
-
-                if (dstY >= dstHeight)
-                    break;  // We're done!
-
-                int drawWidth = std::min(srcWidth, dstWidth - dstX);
-                int drawHeight = std::min(srcHeight, dstHeight - dstY);
-
-                ATLASSERT(drawWidth > 0);
-                ATLASSERT(drawHeight > 0);
-
-                ::BitBlt(dstDC,
-                         dstX, dstY,
-                         drawWidth, drawHeight,
-                         srcDC,
-                         0, 0,
-                         SRCCOPY);
-
-                dstX += srcWidth;
-            }
-
-            break;
-        }
+    uint32_t* pDstPixels = nullptr;
+    CBitmapHandle dstBitmap = CreatePixelBitmap(dstSize, &pDstPixels);
 
-        case RESIZE_Stretch:
-        {
-            // Stretch the image to cover the full screen. This can result in distortion
-            // of the image as the image's aspect ratio is not retained.
-
-            ::StretchBlt(dstDC,
-                         0, 0,
-                         dstWidth, dstHeight,
-                         srcDC,
-                         0, 0,
-                         srcWidth, srcHeight,
-                         SRCCOPY);
-            break;
-        }
-
-        default:
-        case RESIZE_Fit:
-        case RESIZE_Fill:
-        case RESIZE_Span:
-        {
-            double srcAspect = (double) srcWidth  / (double) srcHeight;
-            double dstAspect = (double) dstWidth  / (double) dstHeight;
-
-            if (srcAspect == dstAspect)
-            {
-                // Source and destination have the same aspect ratio.
-                // Nothing to adjust.
-            }
-            else
-            {
-                double widthRatio  = (double) dstWidth  / (double) srcWidth;
-                double heightRatio = (double) dstHeight / (double) srcHeight;
-
-                if (resizeMode == RESIZE_Fit)
-                {
-                    //
-                    // RESIZE_Fit
-                    //
-                    // Enlarge or shrink the image to fill the screen, retaining the aspect
-                    // ratio of the original image. If necessary, the image is padded either
-                    // on the top and bottom or on the right and left with the background
-                    // color to fill any screen area not covered by the image.
-                    //
-
-                    double resizeRatio = std::min(widthRatio, heightRatio);
-
-                    if (resizeRatio == widthRatio)
-                    {
-                        // Stretch full width.
-                        // Borders on top and bottom.
-
-                        dstY = (int) std::round((dstHeight - (srcHeight * resizeRatio)) / 2.0);
-                        dstHeight = (int) std::round(srcHeight * resizeRatio);
-                    }
-                    else if (resizeRatio == heightRatio)
-                    {
-                        // Stretch full height.
-                        // Borders on left and right.
-
-                        dstX = (int) std::round((dstWidth - (srcWidth * resizeRatio)) / 2.0);
-                        dstWidth = (int) std::round(srcWidth * resizeRatio);
-                    }
-                }
-                else
-                {
-                    //
-                    // RESIZE_Fill
-                    //
-                    // Enlarge or shrink the image to fill the screen, retaining the aspect
-                    // ratio of the original image. If necessary, the image is cropped either
-                    // on the top and bottom or on the left and right to fit the screen.
-                    //
-
-                    if (widthRatio < heightRatio)
-                    {
-                        // Stretch full height.
-                        // Crop on left and right.
-
-                        double resizeRatio = heightRatio;
-                        int drawWidth = (int) std::round(srcWidth * resizeRatio);
-                        int excessWidth = (int) ((drawWidth - dstWidth) / resizeRatio);
-                        srcX += excessWidth / 2;
-                        srcWidth -= excessWidth;
-                    }
-                    else if (widthRatio > heightRatio)
-                    {
-                        // Stretch full width.
-                        // Crop on top and bottom.
-
-                        double resizeRatio = widthRatio;
-                        int drawHeight = (int) std::round(srcHeight * resizeRatio);
-                        int excessHeight = (int) ((drawHeight - dstHeight) / resizeRatio);
-                        srcY += excessHeight / 2;
-                        srcHeight -= excessHeight;
-                    }
-                }
-            }
-
-            ::StretchBlt(dstDC,
-                         dstX, dstY,
-                         dstWidth, dstHeight,
-                         srcDC,
-                         srcX, srcY,
-                         srcWidth, srcHeight,
-                         SRCCOPY);
-            break;
-        }
-    }
+    if (dstBitmap.IsNull())
+        return false;
 
-    // Delete DC's
-    srcDC.DeleteDC();
-    dstDC.DeleteDC();
+    ResizeWallpaperPixels(srcPixels.data(),
+                          srcSize,
+                          pDstPixels,
+                          dstSize,
+                          resizeMode,
+                          backgroundColor,
+                          filter,
+                          linearLight);
 
     // Delete original bitmap
     ::DeleteObject(*phBitmap);
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "Resampler.h"
+
 // Wallpaper bitmap resize mode.
 enum WallpaperResizeMode
 {
@@ -62,5 +64,58 @@ ResizeWallpaperBitmap(
     HBITMAP* phBitmap,                              // IN: Original bitmap, OUT: Resized bitmap.
     SIZE dstSize,                                   // New bitmap size.
     WallpaperResizeMode resizeMode = RESIZE_Fill,   // Resize mode.
-    COLORREF backgroundColor = 0                    // Background color.
+    COLORREF backgroundColor = 0,                   // Background color.
+    ResampleFilter filter = FILTER_Lanczos3,        // Resampling filter.
+    bool linearLight = false                        // Filter in linear light (see CResampler).
+);
+
+// Resize wallpaper pixels (32bpp top-down, no row padding), the same way
+// as ResizeWallpaperBitmap(). Doesn't use any Windows APIs.
+void
+ResizeWallpaperPixels(
+    const uint32_t* pSrcPixels,                     // Original pixels.
+    SIZE srcSize,                                   // Original size.
+    uint32_t* pDstPixels,                           // OUT: Resized pixels.
+    SIZE dstSize,                                   // New size.
+    WallpaperResizeMode resizeMode,                 // Resize mode.
+    COLORREF backgroundColor,                       // Background color.
+    ResampleFilter filter = FILTER_Lanczos3,        // Resampling filter.
+    bool linearLight = false                        // Filter in linear light (see CResampler).
+);
+
+// Halve the width and height of pixels (32bpp, no row padding), averaging
+// each 2x2 block and rounding to nearest. The width and height must be
+// even. Doesn't use any Windows APIs.
+void
+DownsamplePixels2x(
+    const uint32_t* pSrcPixels,                     // Original pixels.
+    SIZE srcSize,                                   // Original size.
+    uint32_t* pDstPixels                            // OUT: Pixels at half the size.
+);
+
+// Make levels 1...levelCount-1 of a pyramid (see CThumbnailPyramid) from
+// level 0. Each level is half the width and height of the one before, made
+// by DownsamplePixels2x(), and stored right after it. The size must be a
+// multiple of 2^(levelCount-1). Doesn't use any Windows APIs.
+void
+DownsamplePixelLevels(
+    uint32_t* pPixels,                              // IN: Level 0, OUT: All levels, back to back.
+    SIZE size,                                      // Size of level 0.
+    int levelCount                                  // Number of levels, including level 0.
+);
+
+// Get the pixels of a bitmap as 32bpp top-down (BGRA, no row padding).
+// pPixels must have room for size.cx * size.cy pixels.
+bool
+GetBitmapPixels(
+    HBITMAP hBitmap,
+    SIZE size,
+    uint32_t* pPixels
+);
+
+// Create a 32bpp top-down DIB section, and get a pointer to its pixels.
+HBITMAP
+CreatePixelBitmap(
+    SIZE size,
+    uint32_t** ppPixels
 );
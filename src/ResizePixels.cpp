@@ -0,0 +1,399 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ResizePixels.cpp
+//
+//  Wallpaper pixel resize implementation. Doesn't use any Windows APIs,
+//  unlike the rest of Resize.h (see Resize.cpp).
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "Resize.h"
+
+// SSE2 is always there on x64, and MSVC assumes it on x86 too.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #define RESIZE_SSE2
+  #include <emmintrin.h>
+#endif
+
+// Copy a width x height block of pixels. Strides are in pixels.
+static void CopyPixels(const uint32_t* pSrc, ptrdiff_t srcStride, uint32_t* pDst, ptrdiff_t dstStride, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+        memcpy(pDst + y * dstStride, pSrc + y * srcStride, (size_t) width * sizeof(uint32_t));
+}
+
+// Resize wallpaper pixels.
+void
+ResizeWallpaperPixels(
+    const uint32_t* pSrcPixels,     // Original pixels.
+    SIZE srcSize,                   // Original size.
+    uint32_t* pDstPixels,           // OUT: Resized pixels.
+    SIZE dstSize,                   // New size.
+    WallpaperResizeMode resizeMode, // Resize mode.
+    COLORREF backgroundColor,       // Background color.
+    ResampleFilter filter,          // Resampling filter.
+    bool linearLight                // Filter in linear light (see CResampler).
+)
+{
+    //
+    // Initialize the background (if needed).
+    //
+
+    if (resizeMode == RESIZE_Center || resizeMode == RESIZE_Fit)
+    {
+        // COLORREF is 0x00BBGGRR; DIB pixels are 0xAARRGGBB.
+        uint32_t backgroundPixel = (uint32_t) GetRValue(backgroundColor) << 16 |
+                                   (uint32_t) GetGValue(backgroundColor) << 8 |
+                                   (uint32_t) GetBValue(backgroundColor);
+
+        std::fill(pDstPixels, pDstPixels + (size_t) dstSize.cx * dstSize.cy, backgroundPixel);
+    }
+
+    //
+    // Resize the image.
+    //
+
+    int srcX = 0,
+        srcY = 0,
+        srcWidth = srcSize.cx,
+        srcHeight = srcSize.cy;
+
+    int dstX = 0,
+        dstY = 0,
+        dstWidth = dstSize.cx,
+        dstHeight = dstSize.cy;
+
+    int diffWidth = dstWidth - srcWidth;
+    int diffHeight = dstHeight - srcHeight;
+
+    CResampler resampler(filter, 0);
+    resampler.SetLinearLight(linearLight);
+
+    switch (resizeMode)
+    {
+        case RESIZE_Center:
+        {
+            // Center the wallpaper image in its original size, filling the remaining
+            // area with a solid background color if image is smaller than screen or
+            // cropping image if image is larger.
+
+            if (diffWidth < 0)
+            {
+                // Crop left/right
+                diffWidth = abs(diffWidth);
+                srcX += diffWidth / 2;
+                srcWidth -= diffWidth;
+            }
+            else if (diffWidth > 0)
+            {
+                // Center left/right
+                diffWidth = abs(diffWidth);
+                dstX += diffWidth / 2;
+            }
+
+            if (diffHeight < 0)
+            {
+                // Crop top/bottom
+                diffHeight = abs(diffHeight);
+                srcY += diffHeight / 2;
+                srcHeight -= diffHeight;
+            }
+            else if (diffHeight > 0)
+            {
+                // Center top/bottom
+                diffHeight = abs(diffHeight);
+                dstY += diffHeight / 2;
+            }
+
+            CopyPixels(pSrcPixels + (size_t) srcY * srcSize.cx + srcX,
+                       srcSize.cx,
+                       pDstPixels + (size_t) dstY * dstSize.cx + dstX,
+                       dstSize.cx,
+                       std::min(srcWidth, dstWidth - dstX),
+                       std::min(srcHeight, dstHeight - dstY));
+
+            break;
+        }
+
+        case RESIZE_Tile:
+        {
+            // Tile the wallpaper image, starting in the upper left corner of the screen.
+            // This uses the image in its original size. If image is larger than screen,
+            // it will be cropped on the right and bottom.
+
+            if (srcWidth > dstWidth && srcHeight > dstHeight)
+            {
+                // Image is larger than screen -- just crop it.
+                CopyPixels(pSrcPixels,
+                           srcSize.cx,
+                           pDstPixels,
+                           dstSize.cx,
+                           dstWidth,
+                           dstHeight);
+                break;
+            }
+
+            // Tile the image.
+            for (;;)
+            {
+                if (dstX >= dstWidth)
+                {
+                    // Next row
+                    dstX = 0;
+                    dstY += srcHeight;
+                }
+
+                if (dstY >= dstHeight)
+                    break;  // We're done!
+
+                int drawWidth = std::min(srcWidth, dstWidth - dstX);
+                int drawHeight = std::min(srcHeight, dstHeight - dstY);
+
+                ATLASSERT(drawWidth > 0);
+                ATLASSERT(drawHeight > 0);
+
+                CopyPixels(pSrcPixels,
+                           srcSize.cx,
+                           pDstPixels + (size_t) dstY * dstSize.cx + dstX,
+                           dstSize.cx,
+                           drawWidth,
+                           drawHeight);
+
+                dstX += srcWidth;
+            }
+
+            break;
+        }
+
+        case RESIZE_Stretch:
+        {
+            // Stretch the image to cover the full screen. This can result in distortion
+            // of the image as the image's aspect ratio is not retained.
+
+            resampler.Resample(pSrcPixels,
+                               srcSize.cx,
+                               srcWidth,
+                               srcHeight,
+                               pDstPixels,
+                               dstSize.cx,
+                               dstWidth,
+                               dstHeight);
+            break;
+        }
+
+        default:
+        case RESIZE_Fit:
+        case RESIZE_Fill:
+        case RESIZE_Span:
+        {
+            double srcAspect = (double) srcWidth  / (double) srcHeight;
+            double dstAspect = (double) dstWidth  / (double) dstHeight;
+
+            if (srcAspect == dstAspect)
+            {
+                // Source and destination have the same aspect ratio.
+                // Nothing to adjust.
+            }
+            else
+            {
+                double widthRatio  = (double) dstWidth  / (double) srcWidth;
+                double heightRatio = (double) dstHeight / (double) srcHeight;
+
+                if (resizeMode == RESIZE_Fit)
+                {
+                    //
+                    // RESIZE_Fit
+                    //
+                    // Enlarge or shrink the image to fill the screen, retaining the aspect
+                    // ratio of the original image. If necessary, the image is padded either
+                    // on the top and bottom or on the right and left with the background
+                    // color to fill any screen area not covered by the image.
+                    //
+
+                    double resizeRatio = std::min(widthRatio, heightRatio);
+
+                    if (resizeRatio == widthRatio)
+                    {
+                        // Stretch full width.
+                        // Borders on top and bottom.
+
+                        dstY = (int) std::round((dstHeight - (srcHeight * resizeRatio)) / 2.0);
+                        dstHeight = (int) std::round(srcHeight * resizeRatio);
+                    }
+                    else if (resizeRatio == heightRatio)
+                    {
+                        // Stretch full height.
+                        // Borders on left and right.
+
+                        dstX = (int) std::round((dstWidth - (srcWidth * resizeRatio)) / 2.0);
+                        dstWidth = (int) std::round(srcWidth * resizeRatio);
+                    }
+                }
+                else
+                {
+                    //
+                    // RESIZE_Fill
+                    //
+                    // Enlarge or shrink the image to fill the screen, retaining the aspect
+                    // ratio of the original image. If necessary, the image is cropped either
+                    // on the top and bottom or on the left and right to fit the screen.
+                    //
+
+                    if (widthRatio < heightRatio)
+                    {
+                        // Stretch full height.
+                        // Crop on left and right.
+
+                        double resizeRatio = heightRatio;
+                        int drawWidth = (int) std::round(srcWidth * resizeRatio);
+                        int excessWidth = (int) ((drawWidth - dstWidth) / resizeRatio);
+                        srcX += excessWidth / 2;
+                        srcWidth -= excessWidth;
+                    }
+                    else if (widthRatio > heightRatio)
+                    {
+                        // Stretch full width.
+                        // Crop on top and bottom.
+
+                        double resizeRatio = widthRatio;
+                        int drawHeight = (int) std::round(srcHeight * resizeRatio);
+                        int excessHeight = (int) ((drawHeight - dstHeight) / resizeRatio);
+                        srcY += excessHeight / 2;
+                        srcHeight -= excessHeight;
+                    }
+                }
+            }
+
+            if (srcWidth > 0 && srcHeight > 0 && dstWidth > 0 && dstHeight > 0)
+            {
+                resampler.Resample(pSrcPixels + (size_t) srcY * srcSize.cx + srcX,
+                                   srcSize.cx,
+                                   srcWidth,
+                                   srcHeight,
+                                   pDstPixels + (size_t) dstY * dstSize.cx + dstX,
+                                   dstSize.cx,
+                                   dstWidth,
+                                   dstHeight);
+            }
+            break;
+        }
+    }
+
+    // The source may not have had meaningful alpha (GDI leaves it zero),
+    // so make the result opaque.
+    for (size_t i = 0, count = (size_t) dstSize.cx * dstSize.cy; i < count; i++)
+        pDstPixels[i] |= 0xFF000000;
+}
+
+// Halve pixels.
+void
+DownsamplePixels2x(
+    const uint32_t* pSrcPixels,     // Original pixels.
+    SIZE srcSize,                   // Original size.
+    uint32_t* pDstPixels            // OUT: Pixels at half the size.
+)
+{
+    ATLASSERT(srcSize.cx % 2 == 0 && srcSize.cy % 2 == 0);
+
+    const int srcWidth = srcSize.cx;
+    const int dstWidth = srcSize.cx / 2;
+    const int dstHeight = srcSize.cy / 2;
+
+#ifdef RESIZE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+#endif
+
+    for (int y = 0; y < dstHeight; y++)
+    {
+        const uint32_t* pRow0 = pSrcPixels + (size_t) (2 * y) * srcWidth;
+        const uint32_t* pRow1 = pRow0 + srcWidth;
+        uint32_t* pDstRow = pDstPixels + (size_t) y * dstWidth;
+
+        int x = 0;
+
+#ifdef RESIZE_SSE2
+        // 4 destination pixels (8 source pixels from each row) at a time.
+        // The channels are widened to 16 bits, so the sum of four can't
+        // overflow.
+        for (/**/; x + 4 <= dstWidth; x += 4)
+        {
+            __m128i top0    = _mm_loadu_si128((const __m128i*) (pRow0 + 2 * x));
+            __m128i top1    = _mm_loadu_si128((const __m128i*) (pRow0 + 2 * x + 4));
+            __m128i bottom0 = _mm_loadu_si128((const __m128i*) (pRow1 + 2 * x));
+            __m128i bottom1 = _mm_loadu_si128((const __m128i*) (pRow1 + 2 * x + 4));
+
+            // Add the rows. Each register holds two source pixels.
+            __m128i sum01 = _mm_add_epi16(_mm_unpacklo_epi8(top0, zero), _mm_unpacklo_epi8(bottom0, zero));
+            __m128i sum23 = _mm_add_epi16(_mm_unpackhi_epi8(top0, zero), _mm_unpackhi_epi8(bottom0, zero));
+            __m128i sum45 = _mm_add_epi16(_mm_unpacklo_epi8(top1, zero), _mm_unpacklo_epi8(bottom1, zero));
+            __m128i sum67 = _mm_add_epi16(_mm_unpackhi_epi8(top1, zero), _mm_unpackhi_epi8(bottom1, zero));
+
+            // Add neighboring pixels: even pixels + odd pixels.
+            __m128i dst01 = _mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23), _mm_unpackhi_epi64(sum01, sum23));
+            __m128i dst23 = _mm_add_epi16(_mm_unpacklo_epi64(sum45, sum67), _mm_unpackhi_epi64(sum45, sum67));
+
+            // Divide by 4, rounding to nearest.
+            dst01 = _mm_srli_epi16(_mm_add_epi16(dst01, rounding), 2);
+            dst23 = _mm_srli_epi16(_mm_add_epi16(dst23, rounding), 2);
+
+            _mm_storeu_si128((__m128i*) (pDstRow + x), _mm_packus_epi16(dst01, dst23));
+        }
+#endif
+
+        // Leftover pixels at the end of the row (or all of them, without SSE2).
+        for (/**/; x < dstWidth; x++)
+        {
+            uint32_t pixels[4] = { pRow0[2 * x], pRow0[2 * x + 1], pRow1[2 * x], pRow1[2 * x + 1] };
+            uint32_t result = 0;
+
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                uint32_t sum = 2;
+
+                for (uint32_t pixel: pixels)
+                    sum += (pixel >> shift) & 0xFF;
+
+                result |= (sum >> 2) << shift;
+            }
+
+            pDstRow[x] = result;
+        }
+    }
+}
+
+// Make pyramid levels.
+void
+DownsamplePixelLevels(
+    uint32_t* pPixels,              // IN: Level 0, OUT: All levels, back to back.
+    SIZE size,                      // Size of level 0.
+    int levelCount                  // Number of levels, including level 0.
+)
+{
+    ATLASSERT(levelCount >= 1);
+    ATLASSERT(size.cx % (1 << (levelCount - 1)) == 0 && size.cy % (1 << (levelCount - 1)) == 0);
+
+    // Each level is made from the one before it.
+    uint32_t* pLevel = pPixels;
+
+    for (int level = 1; level < levelCount; level++)
+    {
+        uint32_t* pNextLevel = pLevel + (size_t) size.cx * size.cy;
+
+        DownsamplePixels2x(pLevel, size, pNextLevel);
+
+        pLevel = pNextLevel;
+        size = { size.cx / 2, size.cy / 2 };
+    }
+}
@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ScrollPredictor.cpp
+//
+//  CScrollPredictor class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "ScrollPredictor.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CScrollPredictor::CScrollPredictor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CScrollPredictor::CScrollPredictor()
+{
+    Reset();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CScrollPredictor::Reset
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CScrollPredictor::Reset()
+{
+    m_HasPosition = false;
+    m_FirstVisible = 0;
+    m_VisibleCount = 0;
+    m_LastUpdateMs = 0;
+    m_Velocity = 0.0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CScrollPredictor::Update
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CScrollPredictor::Update(
+    size_t firstVisible,
+    size_t visibleCount,
+    uint64_t timeMs
+)
+{
+    if (m_HasPosition)
+    {
+        uint64_t elapsedMs = timeMs - m_LastUpdateMs;
+
+        // Same sample again (e.g. two updates in the same timer tick).
+        if (elapsedMs == 0)
+            return;
+
+        if (elapsedMs > MaxSampleIntervalMs)
+        {
+            // Too long ago to say anything about how fast the list is
+            // moving now. Start over from this sample.
+            m_Velocity = 0.0;
+        }
+        else
+        {
+            double instantVelocity = ((double) firstVisible - (double) m_FirstVisible) * 1000.0 / (double) elapsedMs;
+
+            // Exponential smoothing, weighted by the time since the
+            // last sample, so irregular updates are handled properly.
+            double weight = 1.0 - std::exp(-(double) elapsedMs / SmoothingTimeMs);
+            m_Velocity += (instantVelocity - m_Velocity) * weight;
+        }
+    }
+
+    m_HasPosition = true;
+    m_FirstVisible = firstVisible;
+    m_VisibleCount = visibleCount;
+    m_LastUpdateMs = timeMs;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CScrollPredictor::GetPrefetchItems
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CScrollPredictor::GetPrefetchItems(
+    size_t itemCount,
+    size_t maxItems,
+    std::vector<size_t>& items
+) const
+{
+    items.clear();
+
+    if (!m_HasPosition || m_VisibleCount == 0 || maxItems == 0)
+        return;
+
+    size_t firstVisible = std::min(m_FirstVisible, itemCount);
+    size_t endVisible = std::min(m_FirstVisible + m_VisibleCount, itemCount);
+
+    double screensPerSecond = std::abs(m_Velocity) / (double) m_VisibleCount;
+
+    if (screensPerSecond < IdleScreensPerSecond)
+    {
+        // Idle. Could go either way, so take the items on both sides
+        // of the visible range, alternating, nearest first.
+        size_t count = std::min(maxItems, m_VisibleCount);
+
+        for (size_t distance = 0; items.size() < count; distance++)
+        {
+            bool inRange = false;
+
+            if (endVisible + distance < itemCount)
+            {
+                items.push_back(endVisible + distance);
+                inRange = true;
+            }
+
+            if (items.size() < count && distance < firstVisible)
+            {
+                items.push_back(firstVisible - 1 - distance);
+                inRange = true;
+            }
+
+            if (!inRange)
+                break;
+        }
+
+        return;
+    }
+
+    // Scrolling. Look ahead as far as the list will travel in the
+    // lookahead time, but at least one screenful and at most two.
+    double screensAhead = std::clamp(screensPerSecond * LookaheadTimeMs / 1000.0, 1.0, 2.0);
+    size_t count = std::min(maxItems, (size_t) (screensAhead * (double) m_VisibleCount));
+
+    if (m_Velocity > 0)
+    {
+        for (size_t item = endVisible; item < itemCount && items.size() < count; item++)
+            items.push_back(item);
+    }
+    else
+    {
+        for (size_t item = firstVisible; item > 0 && items.size() < count; item--)
+            items.push_back(item - 1);
+    }
+}
@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ScrollPredictor.h
+//
+//  CScrollPredictor class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CScrollPredictor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Predicts which list items are about to be scrolled into view, so their
+// thumbnails can be loaded before they're needed.
+//
+// Feed it the visible item range every so often while the list scrolls.
+// It keeps a smoothed scroll velocity (items per second), and picks items
+// past the visible range in the direction of travel: one screenful when
+// scrolling slowly, up to two when scrolling fast. When the list is idle,
+// it picks the items just before and just after the visible range.
+//
+// Doesn't know anything about windows or thumbnails. Positions and times
+// are passed in, so it can be tested on its own.
+class CScrollPredictor
+{
+    public:
+
+        CScrollPredictor();
+
+        // Forget the scroll position and velocity
+        // (e.g. the list has been repopulated).
+        void
+        Reset();
+
+        // Record the visible item range.
+        void
+        Update(
+            size_t firstVisible,        // First visible item.
+            size_t visibleCount,        // Number of visible items.
+            uint64_t timeMs             // Current time in milliseconds.
+        );
+
+        // Get smoothed scroll velocity in items per second.
+        // Positive is towards the end of the list.
+        double
+        GetVelocity() const
+        {
+            return m_Velocity;
+        }
+
+        // Get items to prefetch, nearest to the visible range first.
+        void
+        GetPrefetchItems(
+            size_t itemCount,           // Number of items in the list.
+            size_t maxItems,            // Budget.
+            std::vector<size_t>& items
+        ) const;
+
+    private:
+
+        // Velocity smoothing time constant (ms). Longer is smoother,
+        // but slower to notice a change of direction.
+        static constexpr double SmoothingTimeMs = 150.0;
+
+        // How far ahead to look (ms of travel at the current velocity).
+        static constexpr double LookaheadTimeMs = 1000.0;
+
+        // Below this many screenfuls per second, the list is idle.
+        static constexpr double IdleScreensPerSecond = 0.25;
+
+        // Samples further apart than this restart the velocity (ms).
+        static const uint64_t MaxSampleIntervalMs = 500;
+
+        // Has a position been recorded?
+        bool m_HasPosition;
+
+        // Visible range when last updated.
+        size_t m_FirstVisible;
+        size_t m_VisibleCount;
+
+        // Time of the last update (ms).
+        uint64_t m_LastUpdateMs;
+
+        // Smoothed velocity (items per second).
+        double m_Velocity;
+};
@@ -0,0 +1,198 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  SequenceDiff.cpp
+//
+//  CSequenceDiff class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "SequenceDiff.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CSequenceDiff::CSequenceDiff
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CSequenceDiff::CSequenceDiff() :
+    m_NewIndexes(),
+    m_OldIndexes(),
+    m_Operations(),
+    m_DeleteCount(0),
+    m_InsertCount(0),
+    m_MoveCount(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CSequenceDiff::Compute
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CSequenceDiff::Compute(
+    const std::vector<uint64_t>& oldKeys,
+    const std::vector<uint64_t>& newKeys
+)
+{
+    m_Operations.clear();
+    m_DeleteCount = 0;
+    m_InsertCount = 0;
+    m_MoveCount = 0;
+
+    MatchKeys(oldKeys, newKeys);
+
+    std::vector<bool> isUnmoved;
+    FindUnmovedEntries(isUnmoved);
+
+    // Deletes, highest old index first.
+    for (size_t oldIndex = oldKeys.size(); oldIndex-- > 0; /**/)
+    {
+        if (m_NewIndexes[oldIndex] == InvalidIndex)
+        {
+            m_Operations.push_back({ DIFF_Delete, oldIndex, InvalidIndex });
+            m_DeleteCount++;
+        }
+    }
+
+    // Moves, then inserts, lowest new index first.
+    for (size_t newIndex = 0; newIndex < newKeys.size(); newIndex++)
+    {
+        size_t oldIndex = m_OldIndexes[newIndex];
+
+        if (oldIndex != InvalidIndex && !isUnmoved[newIndex])
+        {
+            m_Operations.push_back({ DIFF_Move, oldIndex, newIndex });
+            m_MoveCount++;
+        }
+    }
+
+    for (size_t newIndex = 0; newIndex < newKeys.size(); newIndex++)
+    {
+        if (m_OldIndexes[newIndex] == InvalidIndex)
+        {
+            m_Operations.push_back({ DIFF_Insert, InvalidIndex, newIndex });
+            m_InsertCount++;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CSequenceDiff::MatchKeys
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CSequenceDiff::MatchKeys(
+    const std::vector<uint64_t>& oldKeys,
+    const std::vector<uint64_t>& newKeys
+)
+{
+    m_NewIndexes.assign(oldKeys.size(), InvalidIndex);
+    m_OldIndexes.assign(newKeys.size(), InvalidIndex);
+
+    // Sort each sequence's (key, index) pairs, so repeated keys
+    // are matched up in order, and merge.
+
+    using KeyIndex = std::pair<uint64_t, size_t>;
+
+    auto sortByKey = [] (const std::vector<uint64_t>& keys) -> std::vector<KeyIndex>
+    {
+        std::vector<KeyIndex> sorted(keys.size());
+
+        for (size_t index = 0; index < keys.size(); index++)
+            sorted[index] = { keys[index], index };
+
+        std::sort(sorted.begin(), sorted.end());
+
+        return sorted;
+    };
+
+    std::vector<KeyIndex> oldSorted = sortByKey(oldKeys);
+    std::vector<KeyIndex> newSorted = sortByKey(newKeys);
+
+    size_t iOld = 0;
+    size_t iNew = 0;
+
+    while (iOld < oldSorted.size() && iNew < newSorted.size())
+    {
+        if (oldSorted[iOld].first < newSorted[iNew].first)
+        {
+            iOld++;
+        }
+        else if (newSorted[iNew].first < oldSorted[iOld].first)
+        {
+            iNew++;
+        }
+        else
+        {
+            m_NewIndexes[oldSorted[iOld].second] = newSorted[iNew].second;
+            m_OldIndexes[newSorted[iNew].second] = oldSorted[iOld].second;
+            iOld++;
+            iNew++;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CSequenceDiff::FindUnmovedEntries
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CSequenceDiff::FindUnmovedEntries(
+    std::vector<bool>& isUnmoved
+) const
+{
+    isUnmoved.assign(m_OldIndexes.size(), false);
+
+    // Longest increasing subsequence of old indexes, in new order
+    // (patience sorting). tails[k] is the new index of the entry that ends
+    // the best subsequence of length k + 1 found so far, and previous[]
+    // links each entry to the one before it in its subsequence.
+
+    std::vector<size_t> tails;
+    std::vector<size_t> previous(m_OldIndexes.size(), InvalidIndex);
+
+    for (size_t newIndex = 0; newIndex < m_OldIndexes.size(); newIndex++)
+    {
+        size_t oldIndex = m_OldIndexes[newIndex];
+
+        if (oldIndex == InvalidIndex)
+            continue;
+
+        auto it = std::lower_bound(tails.begin(), tails.end(), oldIndex,
+                                   /*LAMBDA*/ [this] (size_t tailNewIndex, size_t value)
+                                   {
+                                       return m_OldIndexes[tailNewIndex] < value;
+                                   });
+
+        if (it != tails.begin())
+            previous[newIndex] = *(it - 1);
+
+        if (it == tails.end())
+            tails.push_back(newIndex);
+        else
+            *it = newIndex;
+    }
+
+    if (tails.empty())
+        return;
+
+    for (size_t newIndex = tails.back(); newIndex != InvalidIndex; newIndex = previous[newIndex])
+        isUnmoved[newIndex] = true;
+}
@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  SequenceDiff.h
+//
+//  CSequenceDiff class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CSequenceDiff
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Difference between two orderings of a list, as a minimal set of
+// delete, insert, and move operations.
+//
+// Entries are identified by key (e.g. a path hash). Keys that are only in
+// the old sequence are deleted, keys that are only in the new sequence are
+// inserted, and keys that are in both are either left where they are or
+// moved. The entries that are left where they are form the longest
+// increasing subsequence of old positions, taken in new order, so the
+// number of moves is as small as it can be. Computing the difference is
+// O(n log n).
+//
+// If a key appears more than once, its occurrences are matched up in
+// order.
+//
+// To turn the old sequence into the new one: remove the entries of the
+// Delete and Move operations, from the highest old index down, then insert
+// the entries of the Move and Insert operations, from the lowest new index
+// up.
+//
+// Doesn't know anything about windows or playlists, so it can be tested
+// on its own.
+class CSequenceDiff
+{
+    public:
+
+        enum OperationType
+        {
+            DIFF_Delete = 0,
+            DIFF_Insert = 1,
+            DIFF_Move = 2,
+        };
+
+        struct Operation
+        {
+            OperationType m_Type;
+
+            // Index in the old sequence. InvalidIndex for inserts.
+            size_t m_OldIndex;
+
+            // Index in the new sequence. InvalidIndex for deletes.
+            size_t m_NewIndex;
+        };
+
+        // Invalid index (entry isn't in that sequence).
+        static constexpr size_t InvalidIndex = (size_t) -1;
+
+        CSequenceDiff();
+
+        // Compute the difference between two sequences of keys.
+        void
+        Compute(
+            const std::vector<uint64_t>& oldKeys,
+            const std::vector<uint64_t>& newKeys
+        );
+
+        // Get the operations: deletes (highest old index first),
+        // then moves and inserts (each lowest new index first).
+        const std::vector<Operation>&
+        GetOperations() const
+        {
+            return m_Operations;
+        }
+
+        // Are the sequences the same?
+        bool
+        empty() const
+        {
+            return m_Operations.empty();
+        }
+
+        size_t
+        GetDeleteCount() const
+        {
+            return m_DeleteCount;
+        }
+
+        size_t
+        GetInsertCount() const
+        {
+            return m_InsertCount;
+        }
+
+        size_t
+        GetMoveCount() const
+        {
+            return m_MoveCount;
+        }
+
+        // Get the new index of the entry at oldIndex in the old
+        // sequence. Returns InvalidIndex if it was deleted.
+        size_t
+        GetNewIndex(
+            size_t oldIndex
+        ) const
+        {
+            return (oldIndex < m_NewIndexes.size()) ? m_NewIndexes[oldIndex] : InvalidIndex;
+        }
+
+        // Get the old index of the entry at newIndex in the new
+        // sequence. Returns InvalidIndex if it was inserted.
+        size_t
+        GetOldIndex(
+            size_t newIndex
+        ) const
+        {
+            return (newIndex < m_OldIndexes.size()) ? m_OldIndexes[newIndex] : InvalidIndex;
+        }
+
+    private:
+
+        // Match up the keys in the two sequences.
+        void
+        MatchKeys(
+            const std::vector<uint64_t>& oldKeys,
+            const std::vector<uint64_t>& newKeys
+        );
+
+        // Flag the matched entries that stay where they are.
+        void
+        FindUnmovedEntries(
+            std::vector<bool>& isUnmoved
+        ) const;
+
+        // New index of each entry in the old sequence.
+        std::vector<size_t> m_NewIndexes;
+
+        // Old index of each entry in the new sequence.
+        std::vector<size_t> m_OldIndexes;
+
+        std::vector<Operation> m_Operations;
+
+        size_t m_DeleteCount;
+        size_t m_InsertCount;
+        size_t m_MoveCount;
+};
@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ShuffleOrder.cpp
+//
+//  CShuffleOrder class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "ShuffleOrder.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Mix
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Scramble the bits of a 64-bit value (SplitMix64 finalizer).
+static FORCEINLINE uint64_t Mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder::CShuffleOrder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CShuffleOrder::CShuffleOrder()
+    :
+    CShuffleOrder(0, 0)
+{
+}
+
+CShuffleOrder::CShuffleOrder(
+    uint64_t size,
+    uint64_t seed
+)
+{
+    Reset(size, seed);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder::Reset
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CShuffleOrder::Reset(
+    uint64_t size,
+    uint64_t seed
+)
+{
+    m_Size = size;
+    m_Seed = seed;
+
+    // Smallest even number of bits that covers 0...size-1,
+    // with at least one bit in each half.
+    m_HalfBits = 1;
+    while (m_HalfBits < 32 && (size - 1) >> (m_HalfBits * 2) != 0)
+        m_HalfBits++;
+
+    m_HalfMask = (1ull << m_HalfBits) - 1;
+
+    for (int round = 0; round < Rounds; round++)
+        m_Keys[round] = Mix(seed + (round + 1) * 0x9E3779B97F4A7C15ull);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder::Encrypt
+//  CShuffleOrder::Decrypt
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CShuffleOrder::Encrypt(
+    uint64_t value
+)
+const
+{
+    uint64_t left = value >> m_HalfBits;
+    uint64_t right = value & m_HalfMask;
+
+    for (int round = 0; round < Rounds; round++)
+    {
+        uint64_t next = left ^ (Mix(right ^ m_Keys[round]) & m_HalfMask);
+        left = right;
+        right = next;
+    }
+
+    return (left << m_HalfBits) | right;
+}
+
+uint64_t
+CShuffleOrder::Decrypt(
+    uint64_t value
+)
+const
+{
+    uint64_t left = value >> m_HalfBits;
+    uint64_t right = value & m_HalfMask;
+
+    for (int round = Rounds - 1; round >= 0; round--)
+    {
+        uint64_t prev = right ^ (Mix(left ^ m_Keys[round]) & m_HalfMask);
+        right = left;
+        left = prev;
+    }
+
+    return (left << m_HalfBits) | right;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder::GetPosition
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CShuffleOrder::GetPosition(
+    uint64_t index
+)
+const
+{
+    ATLASSERT(index < m_Size);
+
+    // Encrypt() is a permutation of the whole domain, so following it
+    // from a value inside 0...size-1 always gets back inside eventually.
+    uint64_t position = index;
+    do
+    {
+        position = Encrypt(position);
+    }
+    while (position >= m_Size);
+
+    return position;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder::GetIndex
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CShuffleOrder::GetIndex(
+    uint64_t position
+)
+const
+{
+    ATLASSERT(position < m_Size);
+
+    uint64_t index = position;
+    do
+    {
+        index = Decrypt(index);
+    }
+    while (index >= m_Size);
+
+    return index;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder::MakeSeed
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+uint64_t
+CShuffleOrder::MakeSeed()
+{
+    std::random_device seed;
+    return ((uint64_t) seed() << 32) | seed();
+}
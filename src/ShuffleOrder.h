@@ -0,0 +1,164 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ShuffleOrder.h
+//
+//  CShuffleOrder class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CShuffleOrder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Pseudo-random permutation of 0...size-1, computed on the fly.
+//
+// Nothing is shuffled and no table is stored: the permutation is a keyed
+// Feistel network over the smallest power-of-four domain that covers size,
+// and values that land outside 0...size-1 are fed back in until one lands
+// inside ("cycle walking"). The domain is less than four times size, so
+// that takes a couple of rounds on average.
+//
+// The whole permutation is determined by (size, seed), so it can be saved
+// and restored by saving the seed. Both directions are O(1):
+// GetPosition() maps an index in the shuffled order to a position in the
+// list, and GetIndex() maps it back.
+//
+// The positions don't have to all be in use. A list whose items come and
+// go can be shuffled over a fixed range that covers them (e.g. its handle
+// range), and FindNext() and FindPrevious() step over the positions that
+// aren't in use, so the rest of the order stays the same.
+class CShuffleOrder
+{
+    public:
+
+        CShuffleOrder();
+
+        CShuffleOrder(
+            uint64_t size,
+            uint64_t seed
+        );
+
+        // Change the size and/or seed.
+        void
+        Reset(
+            uint64_t size,
+            uint64_t seed
+        );
+
+        // Number of items being shuffled.
+        uint64_t
+        size() const
+        {
+            return m_Size;
+        }
+
+        // Seed the permutation was made from.
+        uint64_t
+        GetSeed() const
+        {
+            return m_Seed;
+        }
+
+        // Get the position of the index'th item in the shuffled order.
+        uint64_t
+        GetPosition(
+            uint64_t index
+        ) const;
+
+        // Get the index in the shuffled order of the item at position.
+        // Inverse of GetPosition().
+        uint64_t
+        GetIndex(
+            uint64_t position
+        ) const;
+
+        // Get the first index at or after first whose position is in use
+        // (isUsed(position) returns true), skipping the rest (e.g. the
+        // positions of items that have been removed). Returns size() if
+        // there isn't one.
+        template <typename Predicate>
+        uint64_t
+        FindNext(
+            uint64_t first,
+            Predicate isUsed
+        ) const
+        {
+            for (uint64_t index = first; index < m_Size; index++)
+            {
+                if (isUsed(GetPosition(index)))
+                    return index;
+            }
+
+            return m_Size;
+        }
+
+        // Get the last index at or before last whose position is in use.
+        // Returns size() if there isn't one.
+        template <typename Predicate>
+        uint64_t
+        FindPrevious(
+            uint64_t last,
+            Predicate isUsed
+        ) const
+        {
+            if (m_Size == 0)
+                return m_Size;
+
+            for (uint64_t index = std::min(last, m_Size - 1) + 1; index-- > 0; )
+            {
+                if (isUsed(GetPosition(index)))
+                    return index;
+            }
+
+            return m_Size;
+        }
+
+        // Make a new random seed.
+        static
+        uint64_t
+        MakeSeed();
+
+    private:
+
+        // Number of Feistel rounds.
+        static const int Rounds = 6;
+
+        // One pass through the Feistel network, and its inverse.
+        uint64_t
+        Encrypt(
+            uint64_t value
+        ) const;
+
+        uint64_t
+        Decrypt(
+            uint64_t value
+        ) const;
+
+        // Number of items.
+        uint64_t m_Size;
+
+        // Seed the round keys were made from.
+        uint64_t m_Seed;
+
+        // Number of bits in each half of a value.
+        int m_HalfBits;
+
+        // Mask for one half of a value.
+        uint64_t m_HalfMask;
+
+        // Round keys.
+        uint64_t m_Keys[Rounds];
+};
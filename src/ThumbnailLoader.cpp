@@ -0,0 +1,372 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailLoader.cpp
+//
+//  CThumbnailLoader class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "ThumbnailLoader.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::CThumbnailLoader
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CThumbnailLoader::CThumbnailLoader(
+    LoadFunction load,
+    NotifyFunction notify,
+    unsigned concurrency /*= 0*/
+)
+    :
+    m_Load(std::move(load)),
+    m_Notify(std::move(notify)),
+    m_Mutex(),
+    m_WorkAvailable(),
+    m_Requests(),
+    m_PrefetchRequests(),
+    m_Pending(),
+    m_Generation(0),
+    m_Stop(false),
+    m_pCompleted(nullptr),
+    m_Workers()
+{
+    // Thumbnail extraction is mostly waiting on the disk and decoding,
+    // so a few threads are plenty. Leave some processors for the UI.
+    if (concurrency == 0)
+        concurrency = std::clamp(std::thread::hardware_concurrency() / 2, 2U, 4U);
+
+    for (unsigned idx = 0; idx < concurrency; idx++)
+        m_Workers.emplace_back(&CThumbnailLoader::WorkerThread, this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::~CThumbnailLoader
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CThumbnailLoader::~CThumbnailLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Requests.clear();
+        m_PrefetchRequests.clear();
+        m_Stop = true;
+    }
+
+    m_WorkAvailable.notify_all();
+
+    for (std::thread& worker: m_Workers)
+        worker.join();
+
+    FreeResults(m_pCompleted.exchange(nullptr));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::Request
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::Request(
+    FileHandle hFile,
+    const fs::path& path,
+    const CThumbnailKey& key
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (!m_Pending.insert(hFile).second)
+        {
+            // Already requested. If it's still waiting, move it to the
+            // front of the queue, since it's wanted right now.
+            auto it = std::find_if(m_Requests.begin(),
+                                   m_Requests.end(),
+                                   [hFile] (const WorkItem& item) { return item.m_hFile == hFile; });
+
+            if (it != m_Requests.end())
+            {
+                std::rotate(it, it + 1, m_Requests.end());
+                return;
+            }
+
+            // If it's waiting to be prefetched, it's wanted sooner than
+            // that now. Move it to the front of the regular queue.
+            auto prefetchIt = std::find_if(m_PrefetchRequests.begin(),
+                                           m_PrefetchRequests.end(),
+                                           [hFile] (const WorkItem& item) { return item.m_hFile == hFile; });
+
+            if (prefetchIt != m_PrefetchRequests.end())
+            {
+                m_Requests.push_back(std::move(*prefetchIt));
+                m_PrefetchRequests.erase(prefetchIt);
+            }
+
+            return;
+        }
+
+        m_Requests.push_back({ hFile, path, key });
+    }
+
+    m_WorkAvailable.notify_one();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::ClearPrefetch
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::ClearPrefetch()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (const WorkItem& item: m_PrefetchRequests)
+        m_Pending.erase(item.m_hFile);
+
+    m_PrefetchRequests.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::Prefetch
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::Prefetch(
+    FileHandle hFile,
+    const fs::path& path,
+    const CThumbnailKey& key
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (!m_Pending.insert(hFile).second)
+            return;
+
+        m_PrefetchRequests.push_back({ hFile, path, key });
+    }
+
+    m_WorkAvailable.notify_one();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::Cancel
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::Cancel(
+    const std::function<bool (FileHandle hFile)>& shouldCancel
+)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto cancelItem =
+        /*LAMBDA*/ [this, &shouldCancel] (const WorkItem& item)
+        {
+            if (!shouldCancel(item.m_hFile))
+                return false;
+
+            m_Pending.erase(item.m_hFile);
+            return true;
+        };
+
+    m_Requests.erase(std::remove_if(m_Requests.begin(), m_Requests.end(), cancelItem),
+                     m_Requests.end());
+
+    m_PrefetchRequests.erase(std::remove_if(m_PrefetchRequests.begin(), m_PrefetchRequests.end(), cancelItem),
+                             m_PrefetchRequests.end());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::CancelAll
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::CancelAll()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Requests.clear();
+        m_PrefetchRequests.clear();
+        m_Pending.clear();
+        m_Generation++;
+    }
+
+    // Results that are already finished are stale too.
+    FreeResults(m_pCompleted.exchange(nullptr));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::TakeResults
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::TakeResults(
+    std::vector<Result>& results
+)
+{
+    results.clear();
+
+    // Take the whole stack at once, then reverse it so the
+    // results come out in the order they were finished.
+    ResultNode* pNode = m_pCompleted.exchange(nullptr, std::memory_order_acquire);
+
+    ResultNode* pReversed = nullptr;
+    while (pNode)
+    {
+        ResultNode* pNext = pNode->m_pNext;
+        pNode->m_pNext = pReversed;
+        pReversed = pNode;
+        pNode = pNext;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    while (pReversed)
+    {
+        ResultNode* pNext = pReversed->m_pNext;
+
+        if (pReversed->m_Generation == m_Generation)
+        {
+            m_Pending.erase(pReversed->m_Result.m_hFile);
+            results.push_back(std::move(pReversed->m_Result));
+        }
+        else if (pReversed->m_Result.m_hBitmap)
+        {
+            // Requested before CancelAll().
+            ::DeleteObject(pReversed->m_Result.m_hBitmap);
+        }
+
+        delete pReversed;
+        pReversed = pNext;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::WorkerThread
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::WorkerThread()
+{
+#ifdef _WIN32
+    // The shell's thumbnail extractors are COM objects.
+    HRESULT hrInit = ::CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+#endif
+
+    for (;;)
+    {
+        WorkItem item;
+        uint32_t generation;
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+
+            m_WorkAvailable.wait(lock, [this] { return m_Stop || !m_Requests.empty() || !m_PrefetchRequests.empty(); });
+
+            if (m_Stop)
+                break;
+
+            // Prefetch only when there's nothing more urgent.
+            if (!m_Requests.empty())
+            {
+                item = std::move(m_Requests.back());
+                m_Requests.pop_back();
+            }
+            else
+            {
+                item = std::move(m_PrefetchRequests.front());
+                m_PrefetchRequests.pop_front();
+            }
+            generation = m_Generation;
+        }
+
+        HBITMAP hBitmap = m_Load(item.m_Path, &item.m_Key);
+
+        PostResult(new ResultNode{ { item.m_hFile, std::move(item.m_Path), item.m_Key, hBitmap }, generation, nullptr });
+    }
+
+#ifdef _WIN32
+    if (SUCCEEDED(hrInit))
+        ::CoUninitialize();
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::PostResult
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailLoader::PostResult(
+    ResultNode* pNode
+)
+{
+    ResultNode* pHead = m_pCompleted.load(std::memory_order_relaxed);
+
+    do
+    {
+        pNode->m_pNext = pHead;
+    }
+    while (!m_pCompleted.compare_exchange_weak(pHead,
+                                               pNode,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+
+    // The UI thread empties the whole queue each time it's notified, so
+    // only the first result after that needs to notify it again.
+    if (pHead == nullptr)
+        m_Notify();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader::FreeResults
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+void
+CThumbnailLoader::FreeResults(
+    ResultNode* pNode
+)
+{
+    while (pNode)
+    {
+        ResultNode* pNext = pNode->m_pNext;
+
+        if (pNode->m_Result.m_hBitmap)
+            ::DeleteObject(pNode->m_Result.m_hBitmap);
+
+        delete pNode;
+        pNode = pNext;
+    }
+}
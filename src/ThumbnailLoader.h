@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailLoader.h
+//
+//  CThumbnailLoader class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileHandle.h"
+#include "ImageListCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailLoader
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Loads thumbnails on a pool of background threads.
+//
+// The UI thread calls Request() for each thumbnail it wants (e.g. from
+// LVN_GETDISPINFO) and shows a placeholder in the meantime. The most recent
+// request is loaded first, because that's what was just scrolled into view.
+// Requests for the same file are merged. Requests that haven't started yet
+// can be cancelled (e.g. the item has been scrolled out of view).
+//
+// Prefetch requests (thumbnails that will probably be wanted soon) have
+// their own queue, which is only worked on when there are no other
+// requests waiting. The whole queue is replaced with each new prediction.
+//
+// Finished thumbnails are pushed onto a lock-free completion queue, and the
+// notify function is called when the queue goes from empty to non-empty,
+// so there's one notification per batch rather than one per thumbnail.
+// The UI thread then calls TakeResults() to collect the batch.
+class CThumbnailLoader
+{
+    public:
+
+        // Loads a thumbnail. Called on the worker threads, so it must be
+        // thread-safe. Returns NULL if the thumbnail couldn't be loaded.
+        // The key passed to Request() may be out of date (the file has
+        // changed since it was last stat'ed), so the load function
+        // updates *pKey with the file's current size and time.
+        using LoadFunction = std::function<HBITMAP (const fs::path& path, CThumbnailKey* pKey)>;
+
+        // Called on a worker thread when results are ready to collect
+        // (e.g. posts a message to the UI thread). Must be thread-safe.
+        using NotifyFunction = std::function<void ()>;
+
+        // Finished thumbnail.
+        struct Result
+        {
+            FileHandle m_hFile;
+            fs::path m_Path;
+            CThumbnailKey m_Key;    // As updated by the load function.
+            HBITMAP m_hBitmap;      // Caller owns the bitmap. NULL if load failed.
+        };
+
+        CThumbnailLoader(
+            LoadFunction load,
+            NotifyFunction notify,
+            unsigned concurrency = 0    // Number of worker threads (0 = default).
+        );
+
+        // Cancels outstanding requests and waits for the workers to exit.
+        ~CThumbnailLoader();
+
+        // No copy ctor.
+        CThumbnailLoader(const CThumbnailLoader&) = delete;
+
+        // No copy assignment.
+        CThumbnailLoader& operator=(const CThumbnailLoader&) = delete;
+
+        // Ask for a thumbnail. Does nothing if the file's thumbnail is
+        // already being loaded, except to move a waiting request to the
+        // front of the queue.
+        void
+        Request(
+            FileHandle hFile,
+            const fs::path& path,
+            const CThumbnailKey& key
+        );
+
+        // Replace the waiting prefetch requests.
+        // Call Prefetch() for each new request afterwards.
+        void
+        ClearPrefetch();
+
+        // Ask for a thumbnail that will probably be wanted soon. Loaded
+        // in the order asked for, after all other requests. Does nothing
+        // if the file's thumbnail has already been requested.
+        void
+        Prefetch(
+            FileHandle hFile,
+            const fs::path& path,
+            const CThumbnailKey& key
+        );
+
+        // Cancel waiting requests that match a predicate.
+        // Thumbnails that are already being loaded still finish.
+        void
+        Cancel(
+            const std::function<bool (FileHandle hFile)>& shouldCancel
+        );
+
+        // Cancel all requests. Results of requests already being loaded
+        // are thrown away, so FileHandles can be reused afterwards (e.g.
+        // a new playlist is loaded).
+        void
+        CancelAll();
+
+        // Collect finished thumbnails (oldest first).
+        // Must be called on the thread that calls Request().
+        void
+        TakeResults(
+            std::vector<Result>& results
+        );
+
+    private:
+
+        // Waiting request.
+        struct WorkItem
+        {
+            FileHandle m_hFile;
+            fs::path m_Path;
+            CThumbnailKey m_Key;
+        };
+
+        // Completion queue node.
+        struct ResultNode
+        {
+            Result m_Result;
+            uint32_t m_Generation;
+            ResultNode* m_pNext;
+        };
+
+        // Worker thread main loop.
+        void
+        WorkerThread();
+
+        // Push a finished thumbnail onto the completion queue.
+        void
+        PostResult(
+            ResultNode* pNode
+        );
+
+        // Delete the completion queue nodes, and their bitmaps.
+        static
+        void
+        FreeResults(
+            ResultNode* pNode
+        );
+
+        LoadFunction m_Load;
+
+        NotifyFunction m_Notify;
+
+        // Guards m_Requests, m_PrefetchRequests, m_Pending,
+        // m_Generation, and m_Stop.
+        std::mutex m_Mutex;
+
+        // Signalled when a request is added, or the workers should exit.
+        std::condition_variable m_WorkAvailable;
+
+        // Waiting requests. Newest at the back, which is taken first.
+        std::vector<WorkItem> m_Requests;
+
+        // Waiting prefetch requests. Taken from the front.
+        std::deque<WorkItem> m_PrefetchRequests;
+
+        // Files that have been requested, but whose results haven't been
+        // collected yet (waiting, being loaded, or in the completion queue).
+        std::unordered_set<FileHandle> m_Pending;
+
+        // Incremented by CancelAll(). Results from an older
+        // generation are thrown away.
+        uint32_t m_Generation;
+
+        // Set when the workers should exit.
+        bool m_Stop;
+
+        // Completion queue. Lock-free stack of finished thumbnails,
+        // newest first. Workers push, the UI thread takes everything.
+        std::atomic<ResultNode*> m_pCompleted;
+
+        std::vector<std::thread> m_Workers;
+};
@@ -0,0 +1,370 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPack.cpp
+//
+//  CThumbnailPack class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "ThumbnailPack.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::CThumbnailPack
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CThumbnailPack::CThumbnailPack()
+    :
+    m_Mutex(),
+    m_PackPath(),
+    m_MaximumSize(0),
+    m_OpenAttempted(false),
+    m_IsOpen(false),
+    m_Map(),
+    m_hAppendFile(INVALID_HANDLE_VALUE),
+    m_Index()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::~CThumbnailPack
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CThumbnailPack::~CThumbnailPack()
+{
+    Close();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::Initialize
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailPack::Initialize(
+    const fs::path& packPath,
+    uint64_t maximumSize
+)
+{
+    Close();
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_PackPath = maximumSize ? packPath : fs::path();
+    m_MaximumSize = maximumSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::Close
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailPack::Close()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Map.Close();
+
+    if (m_hAppendFile != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(m_hAppendFile);
+        m_hAppendFile = INVALID_HANDLE_VALUE;
+    }
+
+    m_Index.Clear();
+    m_OpenAttempted = false;
+    m_IsOpen = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::Read
+//
+//////////////////////////////////////////////////////////////////////////////
+
+HBITMAP
+CThumbnailPack::Read(
+    const CThumbnailKey& key,
+    SIZE baseSize,
+    int level,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    COLORREF backgroundColor
+)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (!EnsureOpen())
+        return NULL;
+
+    const CThumbnailPackIndex::Entry* pEntry = m_Index.Find(key.m_PathHash);
+
+    if (!pEntry)
+        return NULL;
+
+    // The record may have been written since the pack was mapped.
+    if (pEntry->m_Offset + pEntry->m_RecordSize > m_Map.GetSize())
+    {
+        if (!m_Map.Open(m_PackPath.c_str()) ||
+            pEntry->m_Offset + pEntry->m_RecordSize > m_Map.GetSize())
+        {
+            return NULL;
+        }
+    }
+
+    const PackRecord* pRecord = (const PackRecord*) ((const BYTE*) m_Map.GetData() + pEntry->m_Offset);
+
+    const uint32_t* pPixels = GetPackRecordPixels(pRecord, key, baseSize, level, resizeMode, linearLight, backgroundColor);
+
+    if (!pPixels)
+        return NULL;
+
+    return CreateThumbnailBitmap(pPixels, CThumbnailPyramid::GetLevelSize(baseSize, level));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::Write
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPack::Write(
+    const CThumbnailKey& key,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    COLORREF backgroundColor,
+    const CThumbnailPyramid& pyramid
+)
+{
+    if (pyramid.empty())
+        return false;
+
+    // Build the record (outside the lock).
+
+    std::vector<BYTE> recordData;
+
+    if (!MakePackRecord(key,
+                        pyramid.GetBaseSize(),
+                        pyramid.GetFirstLevel(),
+                        resizeMode,
+                        linearLight,
+                        backgroundColor,
+                        pyramid.data(),
+                        pyramid.GetDataSize(),
+                        recordData))
+    {
+        return false;
+    }
+
+    // Append it.
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (!EnsureOpen())
+        return false;
+
+    // Full. Stop adding thumbnails until the pack is compacted.
+    if (m_Index.GetFileSize() + recordData.size() > m_MaximumSize)
+        return false;
+
+    LARGE_INTEGER offset;
+    offset.QuadPart = (LONGLONG) m_Index.GetFileSize();
+
+    DWORD dwWritten = 0;
+    if (!::SetFilePointerEx(m_hAppendFile, offset, NULL, FILE_BEGIN) ||
+        !::WriteFile(m_hAppendFile, recordData.data(), (DWORD) recordData.size(), &dwWritten, NULL) ||
+        dwWritten != recordData.size())
+    {
+        // Anything that was written is past the end of the valid
+        // records, so it's overwritten by the next record.
+        return false;
+    }
+
+    m_Index.Append(key.m_PathHash, recordData.size());
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::EnsureOpen
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPack::EnsureOpen()
+{
+    if (m_OpenAttempted)
+        return m_IsOpen;
+
+    m_OpenAttempted = true;
+
+    if (m_PackPath.empty())
+        return false;
+
+    bool loaded = Load();
+
+    if (loaded && m_Index.NeedsCompaction(m_MaximumSize))
+    {
+        // If compaction fails, the old pack is loaded again.
+        Compact();
+        loaded = m_Index.GetFileSize() != 0;
+    }
+
+    m_hAppendFile = ::CreateFileW(m_PackPath.c_str(),
+                                  GENERIC_WRITE,
+                                  FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                  NULL,
+                                  OPEN_ALWAYS,
+                                  0,
+                                  NULL);
+
+    if (m_hAppendFile == INVALID_HANDLE_VALUE)
+    {
+        DebugPrint(L"CThumbnailPack: Can't open: %s\n", m_PackPath.c_str());
+        m_Map.Close();
+        m_Index.Clear();
+        return false;
+    }
+
+    LARGE_INTEGER actualSize = {};
+    ::GetFileSizeEx(m_hAppendFile, &actualSize);
+
+    if (!loaded)
+    {
+        // Missing, or not a pack file we understand (e.g. written by a
+        // different version). Start a new one.
+        m_Index.Clear();
+
+        PackHeader header = { PackMagic, PackVersion };
+
+        DWORD dwWritten = 0;
+        if (::SetEndOfFile(m_hAppendFile) &&
+            ::WriteFile(m_hAppendFile, &header, sizeof(header), &dwWritten, NULL) &&
+            dwWritten == sizeof(header))
+        {
+            m_Index.Reset();
+        }
+        else
+        {
+            ::CloseHandle(m_hAppendFile);
+            m_hAppendFile = INVALID_HANDLE_VALUE;
+            return false;
+        }
+    }
+    else if ((uint64_t) actualSize.QuadPart != m_Index.GetFileSize())
+    {
+        // Cut off a torn record at the end. A mapped file can't be
+        // truncated, so unmap it. It's mapped again when it's read.
+        m_Map.Close();
+
+        LARGE_INTEGER offset;
+        offset.QuadPart = (LONGLONG) m_Index.GetFileSize();
+
+        ::SetFilePointerEx(m_hAppendFile, offset, NULL, FILE_BEGIN);
+        ::SetEndOfFile(m_hAppendFile);
+    }
+
+    m_IsOpen = true;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::Load
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPack::Load()
+{
+    m_Index.Clear();
+
+    if (!m_Map.Open(m_PackPath.c_str()))
+        return false;
+
+    if (!m_Index.Load(m_Map.GetData(), m_Map.GetSize()))
+    {
+        DebugPrint(L"CThumbnailPack: Invalid pack: %s\n", m_PackPath.c_str());
+        m_Map.Close();
+        return false;
+    }
+
+    DebugPrint(L"CThumbnailPack::Load: %zu thumbnails, %llu bytes (%llu live)\n",
+               m_Index.size(),
+               m_Index.GetFileSize(),
+               m_Index.GetLiveSize());
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack::Compact
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPack::Compact()
+{
+    // Live records, oldest first, less the oldest if there's too much.
+    std::vector<CThumbnailPackIndex::Entry> records = m_Index.GetCompactedRecords(m_MaximumSize);
+
+    uint64_t newFileSize = sizeof(PackHeader);
+    for (const CThumbnailPackIndex::Entry& entry: records)
+        newFileSize += entry.m_RecordSize;
+
+    // Write the new pack to a temporary file, then replace the old one.
+
+    fs::path tempPath = fs::path(m_PackPath) += L".tmp";
+
+    FILE* fp = _wfopen(tempPath.c_str(), L"wb");
+
+    if (!fp)
+        return false;
+
+    const BYTE* pData = (const BYTE*) m_Map.GetData();
+
+    PackHeader header = { PackMagic, PackVersion };
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    for (size_t idx = 0; ok && idx < records.size(); idx++)
+        ok = fwrite(pData + records[idx].m_Offset, (size_t) records[idx].m_RecordSize, 1, fp) == 1;
+
+    if (fclose(fp) != 0)
+        ok = false;
+
+    DebugPrint(L"CThumbnailPack::Compact: %llu bytes -> %llu bytes\n", m_Index.GetFileSize(), newFileSize);
+
+    m_Map.Close();
+
+    if (!ok || !::MoveFileExW(tempPath.c_str(), m_PackPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DebugPrint(L"CThumbnailPack::Compact: Failed to replace: %s\n", m_PackPath.c_str());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        Load();
+        return false;
+    }
+
+    return Load();
+}
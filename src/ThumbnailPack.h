@@ -0,0 +1,147 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPack.h
+//
+//  CThumbnailPack class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageListCache.h"
+#include "Resize.h"
+#include "ThumbnailPackFormat.h"
+#include "ThumbnailPyramid.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPack
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Persistent thumbnail cache ("Thumbnails.pack").
+//
+// Thumbnails are stored as ready to use 32bpp pixels, already resized, so
+// a thumbnail that's in the pack doesn't have to be extracted by the shell,
+// decoded, or resized again. Each thumbnail is stored as a pyramid of
+// sizes (see CThumbnailPyramid), so changing the thumbnail size doesn't
+// mean making the thumbnails again. The pack is a single append-only file: new
+// thumbnails are appended to the end, and the file is memory mapped for
+// reading. A torn record at the end (e.g. the app crashed part way through
+// a write) is ignored, and overwritten by the next write.
+//
+// The index isn't stored in the file. It's rebuilt when the pack is
+// opened, by walking the record headers (see CThumbnailPackIndex, which
+// has the file format too). Each path keeps only its newest
+// record, so writing a new thumbnail for a file (because it was changed,
+// or the thumbnail size or resize mode changed) leaves the old record
+// behind as dead space. When there's enough dead space, or the pack is
+// over its size limit, the pack is compacted the next time it's opened:
+// live records are copied to a new file (oldest dropped first if over the
+// size limit), which replaces the old one.
+//
+// Thread-safe. The pack is opened on first use, so opening and compacting
+// happen on whichever thread uses it first (the thumbnail loader threads),
+// not the UI thread.
+class CThumbnailPack
+{
+    public:
+
+        CThumbnailPack();
+
+        ~CThumbnailPack();
+
+        // No copy ctor.
+        CThumbnailPack(const CThumbnailPack&) = delete;
+
+        // No copy assignment.
+        CThumbnailPack& operator=(const CThumbnailPack&) = delete;
+
+        // Set the pack file and its size limit. Doesn't open the file.
+        // A size limit of zero disables the pack.
+        void
+        Initialize(
+            const fs::path& packPath,
+            uint64_t maximumSize        // Bytes.
+        );
+
+        // Close the pack file.
+        void
+        Close();
+
+        // Get one level of a thumbnail from the pack. Returns a 32bpp DIB
+        // section, or NULL if there's no up to date thumbnail with that
+        // level of a pyramid of that base size.
+        HBITMAP
+        Read(
+            const CThumbnailKey& key,
+            SIZE baseSize,
+            int level,
+            WallpaperResizeMode resizeMode,
+            bool linearLight,
+            COLORREF backgroundColor
+        );
+
+        // Add a thumbnail pyramid to the pack, replacing
+        // any older thumbnail of the same file.
+        bool
+        Write(
+            const CThumbnailKey& key,
+            WallpaperResizeMode resizeMode,
+            bool linearLight,
+            COLORREF backgroundColor,
+            const CThumbnailPyramid& pyramid
+        );
+
+    private:
+
+        // Open the pack file (if not already open), and compact
+        // it if needed. Caller must hold m_Mutex.
+        bool
+        EnsureOpen();
+
+        // Map the pack file and rebuild the index.
+        // Caller must hold m_Mutex.
+        bool
+        Load();
+
+        // Write live records to a new pack file, replacing the old one.
+        // Caller must hold m_Mutex.
+        bool
+        Compact();
+
+        // Guards everything below.
+        std::mutex m_Mutex;
+
+        // Pack file path. Empty if the pack is disabled.
+        fs::path m_PackPath;
+
+        // Size limit in bytes.
+        uint64_t m_MaximumSize;
+
+        // Has opening the pack been attempted?
+        bool m_OpenAttempted;
+
+        // Is the pack usable? False if it couldn't be opened or created.
+        bool m_IsOpen;
+
+        // Read-only view of the pack. May not include the latest
+        // records, in which case it's remapped when they're read.
+        CMappedFile m_Map;
+
+        // Handle for appending records.
+        HANDLE m_hAppendFile;
+
+        // Newest record for each path, and the size of the valid
+        // part of the pack file.
+        CThumbnailPackIndex m_Index;
+};
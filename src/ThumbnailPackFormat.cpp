@@ -0,0 +1,335 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPackFormat.cpp
+//
+//  Thumbnail pack file format, and CThumbnailPackIndex class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "ThumbnailPackFormat.h"
+#include "ThumbnailPyramid.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ChecksumPackRecord
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint32_t
+ChecksumPackRecord(
+    const PackRecord& record
+)
+{
+    const BYTE* pBytes = (const BYTE*) &record;
+
+    uint32_t hash = 2166136261U;
+
+    for (size_t idx = 0; idx < offsetof(PackRecord, m_Checksum); idx++)
+    {
+        hash ^= pBytes[idx];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  MakePackRecord
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+MakePackRecord(
+    const CThumbnailKey& key,
+    SIZE baseSize,
+    int firstLevel,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    COLORREF backgroundColor,
+    const uint32_t* pPixels,
+    size_t dataSize,
+    std::vector<BYTE>& recordData
+)
+{
+    if (baseSize.cx <= 0 ||
+        baseSize.cy <= 0 ||
+        baseSize.cx > UINT16_MAX ||
+        baseSize.cy > UINT16_MAX ||
+        firstLevel < 0 ||
+        firstLevel >= CThumbnailPyramid::LevelCount ||
+        dataSize > UINT32_MAX)
+    {
+        return false;
+    }
+
+    recordData.assign(sizeof(PackRecord) + AlignPackSize(dataSize), 0);
+
+    memcpy(recordData.data() + sizeof(PackRecord), pPixels, dataSize);
+
+    PackRecord record = {};
+    record.m_Magic           = RecordMagic;
+    record.m_Compression     = COMPRESSION_None;
+    record.m_PathHash        = key.m_PathHash;
+    record.m_LastWriteTime   = key.m_LastWriteTime;
+    record.m_FileSize        = key.m_FileSize;
+    record.m_Width           = (uint16_t) baseSize.cx;
+    record.m_Height          = (uint16_t) baseSize.cy;
+    record.m_ResizeMode      = (uint16_t) resizeMode;
+    record.m_ResizeFlags     = (uint16_t) (linearLight ? RESIZEFLAG_LinearLight : 0);
+    record.m_BackgroundColor = backgroundColor;
+    record.m_DataSize        = (uint32_t) dataSize;
+    record.m_FirstLevel      = (uint16_t) firstLevel;
+    record.m_LevelCount      = (uint16_t) (CThumbnailPyramid::LevelCount - firstLevel);
+    record.m_Checksum        = ChecksumPackRecord(record);
+
+    memcpy(recordData.data(), &record, sizeof(record));
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  GetPackRecordPixels
+//
+//////////////////////////////////////////////////////////////////////////////
+
+const uint32_t*
+GetPackRecordPixels(
+    const PackRecord* pRecord,
+    const CThumbnailKey& key,
+    SIZE baseSize,
+    int level,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    COLORREF backgroundColor
+)
+{
+    // Is the thumbnail up to date, and the size and style wanted?
+    if (pRecord->m_PathHash != key.m_PathHash ||
+        pRecord->m_LastWriteTime != key.m_LastWriteTime ||
+        pRecord->m_FileSize != key.m_FileSize ||
+        pRecord->m_Width != baseSize.cx ||
+        pRecord->m_Height != baseSize.cy ||
+        pRecord->m_ResizeMode != (uint16_t) resizeMode ||
+        pRecord->m_ResizeFlags != (linearLight ? RESIZEFLAG_LinearLight : 0) ||
+        pRecord->m_BackgroundColor != backgroundColor ||
+        pRecord->m_Compression != COMPRESSION_None)
+    {
+        return nullptr;
+    }
+
+    // Does it have the level wanted?
+    int firstLevel = pRecord->m_FirstLevel;
+    int lastLevel = firstLevel + pRecord->m_LevelCount;
+
+    if (level < firstLevel ||
+        level >= lastLevel ||
+        lastLevel > CThumbnailPyramid::LevelCount ||
+        pRecord->m_DataSize != CThumbnailPyramid::GetPixelCount(baseSize, firstLevel, lastLevel) * 4)
+    {
+        return nullptr;
+    }
+
+    const uint32_t* pPixels = (const uint32_t*) (pRecord + 1);
+    return pPixels + CThumbnailPyramid::GetPixelCount(baseSize, firstLevel, level);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::CThumbnailPackIndex
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CThumbnailPackIndex::CThumbnailPackIndex()
+    :
+    m_Entries(),
+    m_FileSize(0),
+    m_LiveSize(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::Clear
+//  CThumbnailPackIndex::Reset
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailPackIndex::Clear()
+{
+    m_Entries.clear();
+    m_FileSize = 0;
+    m_LiveSize = 0;
+}
+
+void
+CThumbnailPackIndex::Reset()
+{
+    Clear();
+    m_FileSize = sizeof(PackHeader);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::Load
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPackIndex::Load(
+    const void* pData,
+    uint64_t dataSize
+)
+{
+    Clear();
+
+    const BYTE* pBytes = (const BYTE*) pData;
+    const PackHeader* pHeader = (const PackHeader*) pBytes;
+
+    if (dataSize < sizeof(PackHeader) ||
+        pHeader->m_Magic != PackMagic ||
+        pHeader->m_Version != PackVersion)
+    {
+        return false;
+    }
+
+    // Walk the records. Stop at the first one that's invalid
+    // or incomplete -- that's where the next record goes.
+
+    m_FileSize = sizeof(PackHeader);
+
+    while (dataSize - m_FileSize >= sizeof(PackRecord))
+    {
+        const PackRecord* pRecord = (const PackRecord*) (pBytes + m_FileSize);
+
+        if (pRecord->m_Magic != RecordMagic ||
+            pRecord->m_Checksum != ChecksumPackRecord(*pRecord))
+        {
+            break;
+        }
+
+        uint64_t recordSize = sizeof(PackRecord) + AlignPackSize(pRecord->m_DataSize);
+
+        if (recordSize > dataSize - m_FileSize)
+            break;
+
+        Append(pRecord->m_PathHash, recordSize);
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::Append
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailPackIndex::Append(
+    uint64_t pathHash,
+    uint64_t recordSize
+)
+{
+    ATLASSERT(m_FileSize >= sizeof(PackHeader));
+
+    Entry newEntry = { m_FileSize, recordSize };
+
+    auto result = m_Entries.try_emplace(pathHash, newEntry);
+    if (!result.second)
+    {
+        // Older record for the same file is now dead space.
+        m_LiveSize -= result.first->second.m_RecordSize;
+        result.first->second = newEntry;
+    }
+
+    m_LiveSize += recordSize;
+    m_FileSize += recordSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::Find
+//
+//////////////////////////////////////////////////////////////////////////////
+
+const CThumbnailPackIndex::Entry*
+CThumbnailPackIndex::Find(
+    uint64_t pathHash
+) const
+{
+    auto it = m_Entries.find(pathHash);
+
+    return (it != m_Entries.end()) ? &it->second : nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::NeedsCompaction
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPackIndex::NeedsCompaction(
+    uint64_t maximumSize
+) const
+{
+    // Mostly dead space?
+    if (m_FileSize >= MinCompactionSize && m_LiveSize < m_FileSize / 2)
+        return true;
+
+    // Nearly full? Make room for new thumbnails.
+    return m_FileSize > maximumSize / 100 * FullPercent;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex::GetCompactedRecords
+//
+//////////////////////////////////////////////////////////////////////////////
+
+std::vector<CThumbnailPackIndex::Entry>
+CThumbnailPackIndex::GetCompactedRecords(
+    uint64_t maximumSize
+) const
+{
+    // Collect the live records, oldest first.
+
+    std::vector<Entry> liveRecords;
+    liveRecords.reserve(m_Entries.size());
+
+    for (const auto& indexEntry: m_Entries)
+        liveRecords.push_back(indexEntry.second);
+
+    std::sort(liveRecords.begin(),
+              liveRecords.end(),
+              [] (const Entry& entry1, const Entry& entry2) { return entry1.m_Offset < entry2.m_Offset; });
+
+    // If there's too much, drop the oldest thumbnails. (The pack is
+    // read-only mapped, so there's no record of when a thumbnail was
+    // last used. Oldest written is the next best thing.)
+
+    uint64_t targetSize = maximumSize / 100 * CompactionTargetPercent;
+    uint64_t newFileSize = sizeof(PackHeader) + m_LiveSize;
+
+    size_t firstRecord = 0;
+    while (firstRecord < liveRecords.size() && newFileSize > targetSize)
+        newFileSize -= liveRecords[firstRecord++].m_RecordSize;
+
+    liveRecords.erase(liveRecords.begin(), liveRecords.begin() + firstRecord);
+
+    return liveRecords;
+}
@@ -0,0 +1,258 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPackFormat.h
+//
+//  Thumbnail pack file format, and CThumbnailPackIndex class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageListCache.h"
+#include "Resize.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Pack file format
+//
+//  Header, followed by records. Each record is a record header followed
+//  by the thumbnail's pixels (32bpp BGRA, top-down, no row padding), and
+//  padded to a multiple of 8 bytes. The pixels are levels firstLevel...
+//  of a CThumbnailPyramid, back to back. Records are never modified once
+//  written. A newer record for the same path replaces an older one.
+//
+//  Nothing here touches files, so it doesn't use any Windows APIs.
+//  CThumbnailPack does the file handling.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static const uint32_t PackMagic = 0x50545057;       // "WPTP"
+static const uint32_t PackVersion = 2;
+
+static const uint32_t RecordMagic = 0x424D4854;     // "THMB"
+
+// Record compression.
+enum PackCompression
+{
+    // Raw pixels.
+    COMPRESSION_None = 0,
+};
+
+enum PackResizeFlags
+{
+    // Resized in linear light. (This was the high half of a 32-bit
+    // m_ResizeMode, so older records read as sRGB.)
+    RESIZEFLAG_LinearLight = 0x0001,
+};
+
+struct PackHeader
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    uint64_t m_Reserved[3];
+};
+
+struct PackRecord
+{
+    uint32_t m_Magic;
+    uint32_t m_Compression;     // PackCompression.
+
+    // File the thumbnail was made from (see CThumbnailKey).
+    uint64_t m_PathHash;
+    int64_t m_LastWriteTime;
+    uint64_t m_FileSize;
+
+    // How the thumbnail was made. The size is the size of level 0,
+    // even if the record doesn't include it.
+    uint16_t m_Width;
+    uint16_t m_Height;
+    uint16_t m_ResizeMode;
+    uint16_t m_ResizeFlags;     // PackResizeFlags.
+    uint32_t m_BackgroundColor;
+
+    // Size of the pixel data following the header (not including padding).
+    uint32_t m_DataSize;
+
+    // Pyramid levels in the record.
+    uint16_t m_FirstLevel;
+    uint16_t m_LevelCount;
+
+    // Checksum of the fields above. Catches torn or garbage records.
+    uint32_t m_Checksum;
+};
+
+static_assert(sizeof(PackHeader) == 32, "PackHeader has unexpected size");
+static_assert(sizeof(PackRecord) == 56, "PackRecord has unexpected size");
+
+// Checksum (FNV-1a) of a record header.
+uint32_t
+ChecksumPackRecord(
+    const PackRecord& record
+);
+
+// Round size up to a multiple of 8.
+inline
+uint64_t
+AlignPackSize(
+    uint64_t size
+)
+{
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+// Make a record (header, pixels, and padding) for a thumbnail pyramid
+// with levels firstLevel...LevelCount-1. Returns false if the pyramid
+// can't be stored (e.g. it's too big).
+bool
+MakePackRecord(
+    const CThumbnailKey& key,
+    SIZE baseSize,
+    int firstLevel,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    COLORREF backgroundColor,
+    const uint32_t* pPixels,    // All levels, back to back.
+    size_t dataSize,            // Bytes.
+    std::vector<BYTE>& recordData
+);
+
+// Get the pixels of one level of a thumbnail from a record. Returns
+// nullptr if the record isn't up to date (the file's time or size don't
+// match the key), wasn't made the same way, or doesn't have that level
+// of a pyramid of that base size.
+const uint32_t*
+GetPackRecordPixels(
+    const PackRecord* pRecord,
+    const CThumbnailKey& key,
+    SIZE baseSize,
+    int level,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    COLORREF backgroundColor
+);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPackIndex
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Index of a pack's records: where the newest record for each path is.
+//
+// The index isn't stored in the pack. Load() rebuilds it by walking the
+// record headers, and stops at the first record that's invalid or
+// incomplete (e.g. torn by a crash part way through a write), which is
+// where the next record is written.
+class CThumbnailPackIndex
+{
+    public:
+
+        // Location of the newest record for a path.
+        struct Entry
+        {
+            uint64_t m_Offset;          // Start of record in file.
+            uint64_t m_RecordSize;      // Including header and padding.
+        };
+
+        CThumbnailPackIndex();
+
+        // Forget everything (no pack).
+        void
+        Clear();
+
+        // Start an empty pack (just the header).
+        void
+        Reset();
+
+        // Rebuild the index from a pack's contents. Returns false (and
+        // clears the index) if it isn't a pack file this version can
+        // read.
+        bool
+        Load(
+            const void* pData,
+            uint64_t dataSize
+        );
+
+        // Record a record that's been written at the end of the pack
+        // (at GetFileSize()), replacing any older record for the path.
+        void
+        Append(
+            uint64_t pathHash,
+            uint64_t recordSize
+        );
+
+        // Find the newest record for a path.
+        // Returns nullptr if there isn't one.
+        const Entry*
+        Find(
+            uint64_t pathHash
+        ) const;
+
+        // Get the number of paths with records.
+        size_t
+        size() const
+        {
+            return m_Entries.size();
+        }
+
+        // Get the size of the valid part of the pack (bytes). Anything
+        // after this is a torn record, and is overwritten. Zero if there's
+        // no pack.
+        uint64_t
+        GetFileSize() const
+        {
+            return m_FileSize;
+        }
+
+        // Get the bytes used by the newest record of each path.
+        uint64_t
+        GetLiveSize() const
+        {
+            return m_LiveSize;
+        }
+
+        // Is there enough dead space, or is the pack full enough, to
+        // compact?
+        bool
+        NeedsCompaction(
+            uint64_t maximumSize        // Bytes.
+        ) const;
+
+        // Get the records to copy to a compacted pack, in file order
+        // (oldest first). If the live records don't fit in the compaction
+        // target, the oldest are left out.
+        std::vector<Entry>
+        GetCompactedRecords(
+            uint64_t maximumSize        // Bytes.
+        ) const;
+
+        // Don't compact until the pack is at least this big (bytes).
+        static const uint64_t MinCompactionSize = 4 * 1024 * 1024;
+
+        // Compact when the pack is this full (percent of the size limit).
+        static const uint64_t FullPercent = 90;
+
+        // When compacting a pack that's over its size limit,
+        // shrink it to this fraction of the limit (percent).
+        static const uint64_t CompactionTargetPercent = 75;
+
+    private:
+
+        // Newest record for each path, by path hash.
+        std::unordered_map<uint64_t, Entry> m_Entries;
+
+        // Size of the valid part of the pack file (bytes).
+        uint64_t m_FileSize;
+
+        // Bytes used by records in the index.
+        uint64_t m_LiveSize;
+};
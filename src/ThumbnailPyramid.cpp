@@ -0,0 +1,169 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPyramid.cpp
+//
+//  CThumbnailPyramid class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+#include "Resize.h"
+#include "ThumbnailPyramid.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CreateThumbnailBitmap
+//
+//////////////////////////////////////////////////////////////////////////////
+
+HBITMAP
+CreateThumbnailBitmap(
+    const void* pPixels,
+    SIZE size
+)
+{
+    uint32_t* pBits = nullptr;
+    HBITMAP hBitmap = CreatePixelBitmap(size, &pBits);
+
+    if (hBitmap)
+        memcpy(pBits, pPixels, (size_t) size.cx * size.cy * 4);
+
+    return hBitmap;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid::CThumbnailPyramid
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CThumbnailPyramid::CThumbnailPyramid()
+    :
+    m_BaseSize(),
+    m_FirstLevel(0),
+    m_Pixels()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid::GetBaseSize
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+SIZE
+CThumbnailPyramid::GetBaseSize(
+    double aspectRatio
+)
+{
+    const int multiple = 1 << (LevelCount - 1);
+
+    int width = (int) std::round(BaseHeight * aspectRatio / multiple) * multiple;
+
+    return { std::max(width, multiple), BaseHeight };
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid::Create
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CThumbnailPyramid::Create(
+    HBITMAP hBitmap,
+    SIZE baseSize,
+    int firstLevel
+)
+{
+    Clear();
+
+    ATLASSERT(firstLevel >= 0 && firstLevel < LevelCount);
+
+    SIZE firstSize = GetLevelSize(baseSize, firstLevel);
+
+    BITMAP bitmap;
+    if (::GetObject(hBitmap, sizeof(bitmap), &bitmap) != sizeof(bitmap) ||
+        bitmap.bmWidth != firstSize.cx ||
+        bitmap.bmHeight != firstSize.cy)
+    {
+        return false;
+    }
+
+    m_Pixels.resize(GetPixelCount(baseSize, firstLevel));
+
+    if (!GetBitmapPixels(hBitmap, firstSize, m_Pixels.data()))
+    {
+        m_Pixels.clear();
+        return false;
+    }
+
+    m_BaseSize = baseSize;
+    m_FirstLevel = firstLevel;
+
+    // Each level is made from the one before it.
+    DownsamplePixelLevels(m_Pixels.data(), firstSize, LevelCount - firstLevel);
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid::Clear
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CThumbnailPyramid::Clear()
+{
+    m_BaseSize = {};
+    m_FirstLevel = 0;
+    m_Pixels.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid::GetPixels
+//
+//////////////////////////////////////////////////////////////////////////////
+
+const uint32_t*
+CThumbnailPyramid::GetPixels(
+    int level
+) const
+{
+    if (m_Pixels.empty() || level < m_FirstLevel || level >= LevelCount)
+        return nullptr;
+
+    return m_Pixels.data() + GetPixelCount(m_BaseSize, m_FirstLevel, level);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid::CreateBitmap
+//
+//////////////////////////////////////////////////////////////////////////////
+
+HBITMAP
+CThumbnailPyramid::CreateBitmap(
+    int level
+) const
+{
+    const uint32_t* pPixels = GetPixels(level);
+
+    if (!pPixels)
+        return NULL;
+
+    return CreateThumbnailBitmap(pPixels, GetLevelSize(m_BaseSize, level));
+}
@@ -0,0 +1,166 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPyramid.h
+//
+//  CThumbnailPyramid class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CThumbnailPyramid
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// A thumbnail at several sizes ("mipmap" levels).
+//
+// Level 0 is the largest (BaseHeight pixels high), and each level after it
+// is half the width and height of the one before. The levels are made from
+// a single decoded image by repeatedly averaging 2x2 blocks of pixels, so
+// switching thumbnail sizes doesn't need the image to be decoded again.
+//
+// A pyramid doesn't have to start at level 0: it can hold levels
+// firstLevel...LevelCount-1, which is all that's needed to show thumbnails
+// at firstLevel or smaller.
+//
+// Pixels are 32bpp BGRA, top-down, with no row padding, and all the levels
+// are kept back to back in one buffer (which is how CThumbnailPack stores
+// them).
+class CThumbnailPyramid
+{
+    public:
+
+        // Number of levels (BaseHeight, 1/2, 1/4, and 1/8 size).
+        static constexpr int LevelCount = 4;
+
+        // Height of level 0.
+        static constexpr int BaseHeight = 256;
+
+        CThumbnailPyramid();
+
+        // Get the size of level 0 for a display aspect ratio (width/height).
+        // The width is a multiple of 2^(LevelCount-1), so every level is
+        // exactly half the size of the one before.
+        static
+        SIZE
+        GetBaseSize(
+            double aspectRatio
+        );
+
+        // Get the size of a level.
+        static
+        SIZE
+        GetLevelSize(
+            SIZE baseSize,
+            int level
+        )
+        {
+            return { baseSize.cx >> level, baseSize.cy >> level };
+        }
+
+        // Build levels firstLevel...LevelCount-1 from a bitmap,
+        // which must be the size of firstLevel.
+        bool
+        Create(
+            HBITMAP hBitmap,
+            SIZE baseSize,
+            int firstLevel
+        );
+
+        // Remove all levels.
+        void
+        Clear();
+
+        bool
+        empty() const
+        {
+            return m_Pixels.empty();
+        }
+
+        SIZE
+        GetBaseSize() const
+        {
+            return m_BaseSize;
+        }
+
+        int
+        GetFirstLevel() const
+        {
+            return m_FirstLevel;
+        }
+
+        // Get the pixels of a level.
+        // Returns nullptr if the pyramid doesn't have that level.
+        const uint32_t*
+        GetPixels(
+            int level
+        ) const;
+
+        // Get all the levels' pixels (firstLevel first).
+        const uint32_t*
+        data() const
+        {
+            return m_Pixels.data();
+        }
+
+        // Get the size of all the levels' pixels, in bytes.
+        size_t
+        GetDataSize() const
+        {
+            return m_Pixels.size() * sizeof(uint32_t);
+        }
+
+        // Get the number of pixels in levels firstLevel...lastLevel-1.
+        static
+        size_t
+        GetPixelCount(
+            SIZE baseSize,
+            int firstLevel,
+            int lastLevel = LevelCount
+        )
+        {
+            size_t pixelCount = 0;
+
+            for (int level = firstLevel; level < lastLevel; level++)
+            {
+                SIZE levelSize = GetLevelSize(baseSize, level);
+                pixelCount += (size_t) levelSize.cx * levelSize.cy;
+            }
+
+            return pixelCount;
+        }
+
+        // Make a 32bpp DIB section from a level.
+        // Returns NULL if the pyramid doesn't have that level.
+        HBITMAP
+        CreateBitmap(
+            int level
+        ) const;
+
+    private:
+
+        SIZE m_BaseSize;
+
+        int m_FirstLevel;
+
+        // Levels firstLevel...LevelCount-1, back to back.
+        std::vector<uint32_t> m_Pixels;
+};
+
+// Make a 32bpp DIB section from pixels (BGRA, top-down, no row padding).
+HBITMAP
+CreateThumbnailBitmap(
+    const void* pPixels,
+    SIZE size
+);
@@ -171,6 +171,167 @@ IsValidImageFile(
     return false;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  GetImageFileDimensions
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Read bytes from a file at the given offset.
+static bool ReadFileAt(HANDLE hFile, uint64_t offset, void* pBuffer, DWORD size)
+{
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG) offset;
+
+    DWORD bytesRead = 0;
+
+    return ::SetFilePointerEx(hFile, position, NULL, FILE_BEGIN) &&
+           ::ReadFile(hFile, pBuffer, size, &bytesRead, NULL) &&
+           bytesRead == size;
+}
+
+// Get 16 and 32 bit big and little endian values.
+static FORCEINLINE UINT GetBE16(const BYTE* p) { return (p[0] << 8) | p[1]; }
+static FORCEINLINE UINT GetBE32(const BYTE* p) { return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static FORCEINLINE UINT GetLE16(const BYTE* p) { return p[0] | (p[1] << 8); }
+static FORCEINLINE UINT GetLE32(const BYTE* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24); }
+
+// Find the JPEG frame header (SOFn) and get the image dimensions from it.
+// Segments before the frame header (e.g. EXIF data) are skipped without
+// being read.
+static bool GetJpegDimensions(HANDLE hFile, UINT* pWidth, UINT* pHeight)
+{
+    uint64_t offset = 2;    // Skip SOI marker.
+
+    for (int segmentCount = 0; segmentCount < 1000; segmentCount++)
+    {
+        BYTE segment[4];
+        if (!ReadFileAt(hFile, offset, segment, sizeof(segment)) || segment[0] != 0xFF)
+            return false;
+
+        BYTE marker = segment[1];
+
+        // Fill byte.
+        if (marker == 0xFF)
+        {
+            offset += 1;
+            continue;
+        }
+
+        // Markers without a length.
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+        {
+            offset += 2;
+            continue;
+        }
+
+        // End of image or start of scan before the frame header.
+        if (marker == 0xD9 || marker == 0xDA)
+            return false;
+
+        UINT length = GetBE16(&segment[2]);
+        if (length < 2)
+            return false;
+
+        // SOF0...SOF15, except DHT (C4), JPG (C8), and DAC (CC).
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            BYTE frame[5];  // Precision, height, width.
+            if (!ReadFileAt(hFile, offset + 4, frame, sizeof(frame)))
+                return false;
+
+            *pHeight = GetBE16(&frame[1]);
+            *pWidth = GetBE16(&frame[3]);
+            return true;
+        }
+
+        offset += 2 + length;
+    }
+
+    return false;
+}
+
+// Get image dimensions from the file header.
+static bool GetImageDimensions(HANDLE hFile, UINT* pWidth, UINT* pHeight)
+{
+    BYTE header[26];
+    if (!ReadFileAt(hFile, 0, header, sizeof(header)))
+        return false;
+
+    static const BYTE pngSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+    if (memcmp(header, pngSignature, sizeof(pngSignature)) == 0)
+    {
+        // PNG: IHDR is always the first chunk.
+        if (memcmp(&header[12], "IHDR", 4) != 0)
+            return false;
+
+        *pWidth = GetBE32(&header[16]);
+        *pHeight = GetBE32(&header[20]);
+        return true;
+    }
+
+    if (header[0] == 'B' && header[1] == 'M')
+    {
+        // BMP: BITMAPFILEHEADER, then BITMAPCOREHEADER or BITMAPINFOHEADER.
+        if (GetLE32(&header[14]) == sizeof(BITMAPCOREHEADER))
+        {
+            *pWidth = GetLE16(&header[18]);
+            *pHeight = GetLE16(&header[20]);
+        }
+        else
+        {
+            // Height is negative for top-down bitmaps.
+            *pWidth = (UINT) std::abs((int) GetLE32(&header[18]));
+            *pHeight = (UINT) std::abs((int) GetLE32(&header[22]));
+        }
+        return true;
+    }
+
+    if (memcmp(header, "GIF87a", 6) == 0 || memcmp(header, "GIF89a", 6) == 0)
+    {
+        // GIF: logical screen size follows the signature.
+        *pWidth = GetLE16(&header[6]);
+        *pHeight = GetLE16(&header[8]);
+        return true;
+    }
+
+    if (header[0] == 0xFF && header[1] == 0xD8)
+        return GetJpegDimensions(hFile, pWidth, pHeight);
+
+    return false;
+}
+
+bool
+GetImageFileDimensions(
+    ConstWString imageFile,
+    UINT* pWidth,
+    UINT* pHeight
+)
+{
+    bool ok = false;
+
+    *pWidth = 0;
+    *pHeight = 0;
+
+    HANDLE hFile = ::CreateFile(imageFile,
+                                GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                0,
+                                NULL);
+
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        ok = GetImageDimensions(hFile, pWidth, pHeight) && *pWidth != 0 && *pHeight != 0;
+
+        ::CloseHandle(hFile);
+    }
+
+    return ok;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  ExpandEnvironmentVariables
@@ -419,6 +580,70 @@ WriteDataToFile(
     return (dwWritten == dataSize);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CMappedFile::Open
+//  CMappedFile::Close
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CMappedFile::Open(
+    ConstWString path
+)
+{
+    Close();
+
+    // FILE_SHARE_DELETE so the file can still be renamed or
+    // replaced while mapped (e.g. when rewriting it).
+    HANDLE hFile = ::CreateFileW(path,
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 0,
+                                 NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    size_t fileSize = GetOpenFileSize(hFile);
+
+    // Can't map an empty file.
+    if (fileSize != 0)
+    {
+        HANDLE hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (hMapping != NULL)
+        {
+            // The view keeps the mapping (and file) open,
+            // so the handles can be closed right away.
+            m_pData = ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+            if (m_pData != nullptr)
+                m_Size = fileSize;
+
+            ::CloseHandle(hMapping);
+        }
+    }
+
+    ::CloseHandle(hFile);
+
+    return m_pData != nullptr;
+}
+
+void
+CMappedFile::Close()
+noexcept
+{
+    if (m_pData != nullptr)
+    {
+        ::UnmapViewOfFile(m_pData);
+        m_pData = nullptr;
+        m_Size = 0;
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  ForEachLineOfFile
@@ -195,6 +195,16 @@ IsValidImageFile(
     ConstWString imageFile
 );
 
+// Get image dimensions from the header of a BMP, JPEG, or PNG file,
+// without decoding the image. Returns false if the file can't be read
+// or isn't one of those formats.
+bool
+GetImageFileDimensions(
+    ConstWString imageFile,
+    UINT* pWidth,
+    UINT* pHeight
+);
+
 // Expand environment variables in a string.
 std::wstring
 ExpandEnvironmentVariables(
@@ -277,6 +287,85 @@ bool WriteDataToFile(ConstWString path, const std::vector<T>& buffer)
     return WriteDataToFile(path, &buffer[0], buffer.size() * sizeof(T));
 }
 
+// Read-only memory mapped file.
+// The whole file is mapped, and stays mapped until Close() or destruction.
+class CMappedFile
+{
+    public:
+
+        CMappedFile()
+            :
+            m_pData(nullptr),
+            m_Size(0)
+        {
+        }
+
+        ~CMappedFile()
+        {
+            Close();
+        }
+
+        // No copy ctor.
+        CMappedFile(const CMappedFile&) = delete;
+
+        // No copy assignment.
+        CMappedFile& operator=(const CMappedFile&) = delete;
+
+        // Move ctor.
+        CMappedFile(CMappedFile&& that) noexcept
+            :
+            m_pData(that.m_pData),
+            m_Size(that.m_Size)
+        {
+            that.m_pData = nullptr;
+            that.m_Size = 0;
+        }
+
+        // Move assignment.
+        CMappedFile& operator=(CMappedFile&& that) noexcept
+        {
+            if (this != &that)
+            {
+                Close();
+                m_pData = that.m_pData;
+                m_Size = that.m_Size;
+                that.m_pData = nullptr;
+                that.m_Size = 0;
+            }
+            return *this;
+        }
+
+        // Map file into memory.
+        // Returns false if file can't be opened, or is empty.
+        bool
+        Open(
+            ConstWString path
+        );
+
+        // Unmap file.
+        void
+        Close() noexcept;
+
+        // Get pointer to file data (nullptr if not open).
+        const void*
+        GetData() const
+        {
+            return m_pData;
+        }
+
+        // Get file size.
+        size_t
+        GetSize() const
+        {
+            return m_Size;
+        }
+
+    private:
+
+        const void* m_pData;
+        size_t m_Size;
+};
+
 // Call a function for every line in a text file.
 // File contents are expected to be in UTF-8 format,
 // which is converted to UTF-16 (std::wstring) before
@@ -0,0 +1,931 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperCache.cpp
+//
+//  CWallpaperCache class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include <fstream>
+#include "WallpaperCache.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Hashing
+//
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    const uint64_t HashBasis = 0xcbf29ce484222325ull;
+    const uint64_t HashPrime = 0x00000100000001b3ull;
+
+    // FNV-1a.
+    uint64_t
+    HashBytes(
+        uint64_t hash,
+        const void* pData,
+        size_t size
+    )
+    {
+        const uint8_t* pBytes = (const uint8_t*) pData;
+
+        for (size_t idx = 0; idx < size; idx++)
+        {
+            hash ^= pBytes[idx];
+            hash *= HashPrime;
+        }
+
+        return hash;
+    }
+
+    template <typename T>
+    uint64_t
+    HashValue(
+        uint64_t hash,
+        const T& value
+    )
+    {
+        return HashBytes(hash, &value, sizeof(value));
+    }
+
+    // Parse a rendered file name ("<settings hash>-<key>.bmp", in hex).
+    bool
+    ParseFileName(
+        const std::string& name,
+        uint64_t* pSettingsHash,
+        uint64_t* pKey
+    )
+    {
+        if (name.size() != 16 + 1 + 16 + 4 || name[16] != '-' || name.compare(33, 4, ".bmp") != 0)
+            return false;
+
+        uint64_t values[2] = {};
+
+        for (size_t idx = 0; idx < 2; idx++)
+        {
+            for (size_t pos = idx * 17; pos < idx * 17 + 16; pos++)
+            {
+                char ch = name[pos];
+                int digit;
+
+                if (ch >= '0' && ch <= '9')
+                    digit = ch - '0';
+                else if (ch >= 'a' && ch <= 'f')
+                    digit = ch - 'a' + 10;
+                else
+                    return false;
+
+                values[idx] = (values[idx] << 4) | digit;
+            }
+        }
+
+        *pSettingsHash = values[0];
+        *pKey = values[1];
+
+        return true;
+    }
+
+    void
+    PutLittleEndian(
+        uint8_t* pDest,
+        uint32_t value,
+        int size
+    )
+    {
+        for (int idx = 0; idx < size; idx++)
+            pDest[idx] = (uint8_t) (value >> (idx * 8));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperRenderSettings::GetHash
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CWallpaperRenderSettings::GetHash() const
+{
+    // Hash the fields one by one (the struct has padding).
+
+    uint64_t hash = HashBasis;
+
+    hash = HashValue(hash, (int32_t) m_Size.cx);
+    hash = HashValue(hash, (int32_t) m_Size.cy);
+    hash = HashValue(hash, (int32_t) m_ResizeMode);
+    hash = HashValue(hash, (uint32_t) m_BackgroundColor);
+    hash = HashValue(hash, (uint8_t) m_LinearLight);
+
+    // Zero means "no settings" in CWallpaperCache.
+
+    return hash != 0 ? hash : 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::CWallpaperCache
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CWallpaperCache::CWallpaperCache(
+    DecodeFunction decode
+) :
+    m_Decode(std::move(decode)),
+    m_MaximumSize(0),
+    m_Settings(),
+    m_SettingsHash(0),
+    m_PrepareRender(false),
+    m_PrepareState(PREPARE_None),
+    m_PrepareGeneration(0),
+    m_Rendering(false),
+    m_Stop(false),
+    m_TotalSize(0)
+{
+    m_RenderThread = std::thread(&CWallpaperCache::RenderThread, this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::~CWallpaperCache
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CWallpaperCache::~CWallpaperCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queue.clear();
+        m_PrepareCandidates.clear();
+        m_Stop = true;
+    }
+
+    m_WorkAvailable.notify_all();
+
+    m_RenderThread.join();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::Initialize
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::Initialize(
+    const fs::path& cacheDirectory,
+    uint64_t maximumSize
+)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_CacheDirectory = cacheDirectory;
+    m_MaximumSize = maximumSize;
+    m_Queue.clear();
+    m_Entries.clear();
+    m_Index.clear();
+    m_TotalSize = 0;
+
+    if (m_MaximumSize == 0)
+        return;
+
+    std::error_code ec;
+    fs::create_directories(m_CacheDirectory, ec);
+
+    // Find the files rendered in earlier sessions. The last write time of
+    // a rendered file is updated when it's used, so sorting by it gives
+    // the least recently used order.
+
+    struct FoundFile
+    {
+        Entry m_Entry;
+        fs::file_time_type m_LastWriteTime;
+    };
+
+    std::vector<FoundFile> foundFiles;
+
+    for (fs::directory_iterator it(m_CacheDirectory, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+    {
+        const fs::path& path = it->path();
+
+        // Left behind by a render that was interrupted.
+        if (path.extension() == ".tmp")
+        {
+            std::error_code removeEc;
+            fs::remove(path, removeEc);
+            continue;
+        }
+
+        FoundFile foundFile = {};
+
+        if (!ParseFileName(path.filename().u8string(), &foundFile.m_Entry.m_SettingsHash, &foundFile.m_Entry.m_Key))
+            continue;
+
+        std::error_code statEc;
+        foundFile.m_Entry.m_FileSize = it->file_size(statEc);
+        foundFile.m_LastWriteTime = it->last_write_time(statEc);
+
+        if (!statEc)
+            foundFiles.push_back(foundFile);
+    }
+
+    std::sort(foundFiles.begin(),
+              foundFiles.end(),
+              [] (const FoundFile& file1, const FoundFile& file2) { return file1.m_LastWriteTime > file2.m_LastWriteTime; });
+
+    for (const FoundFile& foundFile : foundFiles)
+    {
+        m_Entries.push_back(foundFile.m_Entry);
+        m_Index[foundFile.m_Entry.m_Key] = std::prev(m_Entries.end());
+        m_TotalSize += foundFile.m_Entry.m_FileSize;
+    }
+
+    while (m_TotalSize > m_MaximumSize)
+        RemoveEntry(std::prev(m_Entries.end()));
+
+    DebugPrint(L"CWallpaperCache::Initialize: %zu files, %llu bytes\n", m_Entries.size(), m_TotalSize);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::SetRenderSettings
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::SetRenderSettings(
+    const CWallpaperRenderSettings& settings
+)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_SettingsHash != 0 && settings == m_Settings)
+        return;
+
+    m_Settings = settings;
+    m_SettingsHash = settings.GetHash();
+
+    // The waiting renders were for the old settings.
+
+    m_Queue.clear();
+
+    // Files rendered with other settings won't be used again (until the
+    // settings change back, but then they're cheap enough to render).
+
+    for (EntryList::iterator it = m_Entries.begin(); it != m_Entries.end(); )
+    {
+        EntryList::iterator next = std::next(it);
+
+        if (it->m_SettingsHash != m_SettingsHash)
+            RemoveEntry(it);
+
+        it = next;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::RenderAhead
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::RenderAhead(
+    const std::vector<fs::path>& sourcePaths
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_MaximumSize == 0 || m_SettingsHash == 0)
+            return;
+
+        m_Queue.assign(sourcePaths.begin(), sourcePaths.end());
+    }
+
+    m_WorkAvailable.notify_all();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::Prepare
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::Prepare(
+    const std::vector<fs::path>& candidatePaths,
+    bool render
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_PrepareGeneration++;
+        m_PrepareCandidates = candidatePaths;
+        m_PrepareRequest = candidatePaths;
+        m_PrepareRender = render;
+        m_PrepareState = candidatePaths.empty() ? PREPARE_None : PREPARE_Pending;
+        m_PreparedPath.clear();
+    }
+
+    m_WorkAvailable.notify_all();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::GetPrepared
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CWallpaperCache::PrepareState
+CWallpaperCache::GetPrepared(
+    fs::path* pSourcePath
+)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    *pSourcePath = m_PreparedPath;
+
+    return m_PrepareState;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::WaitForPrepared
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperCache::WaitForPrepared(
+    const fs::path& sourcePath
+)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    if (std::find(m_PrepareRequest.begin(), m_PrepareRequest.end(), sourcePath) == m_PrepareRequest.end())
+        return false;
+
+    m_RenderDone.wait(lock, [this] () { return m_PrepareState != PREPARE_Pending || m_Stop; });
+
+    return m_PrepareState == PREPARE_Ready && m_PreparedPath == sourcePath;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::CancelPrepare
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::CancelPrepare()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_PrepareGeneration++;
+    m_PrepareCandidates.clear();
+    m_PrepareRequest.clear();
+    m_PrepareState = PREPARE_None;
+    m_PreparedPath.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::Lookup
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+CWallpaperCache::Lookup(
+    const fs::path& sourcePath
+)
+{
+    uint64_t settingsHash;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_MaximumSize == 0 || m_SettingsHash == 0)
+            return fs::path();
+
+        settingsHash = m_SettingsHash;
+    }
+
+    uint64_t key;
+
+    if (!GetKey(sourcePath, settingsHash, &key))
+        return fs::path();
+
+    fs::path renderedPath = GetFilePath(settingsHash, key);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto indexEntry = m_Index.find(key);
+
+    if (indexEntry == m_Index.end())
+        return fs::path();
+
+    // Somebody may have cleaned out the cache directory.
+
+    std::error_code ec;
+
+    if (!fs::is_regular_file(renderedPath, ec))
+    {
+        RemoveEntry(indexEntry->second);
+        return fs::path();
+    }
+
+    // Now the most recently used (in this session, and the next).
+
+    m_Entries.splice(m_Entries.begin(), m_Entries, indexEntry->second);
+    fs::last_write_time(renderedPath, fs::file_time_type::clock::now(), ec);
+
+    return renderedPath;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::Render
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+CWallpaperCache::Render(
+    const fs::path& sourcePath
+)
+{
+    fs::path renderedPath = Lookup(sourcePath);
+
+    if (!renderedPath.empty())
+        return renderedPath;
+
+    CWallpaperRenderSettings settings;
+    uint64_t settingsHash;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_MaximumSize == 0 || m_SettingsHash == 0)
+            return fs::path();
+
+        settings = m_Settings;
+        settingsHash = m_SettingsHash;
+    }
+
+    if (!RenderEntry(sourcePath, settings, settingsHash))
+        return fs::path();
+
+    return Lookup(sourcePath);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::WaitForRenders
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::WaitForRenders()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    m_RenderDone.wait(lock, [this] () { return m_Queue.empty() && m_PrepareCandidates.empty() && !m_Rendering; });
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::IsIdle
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperCache::IsIdle()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_Queue.empty() && m_PrepareCandidates.empty() && !m_Rendering;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::GetSize
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CWallpaperCache::GetSize()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_TotalSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::WriteBitmapFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CWallpaperCache::WriteBitmapFile(
+    const fs::path& path,
+    const uint32_t* pPixels,
+    SIZE size
+)
+{
+    // BITMAPFILEHEADER (14 bytes) + BITMAPINFOHEADER (40 bytes), written
+    // byte by byte so this doesn't depend on the Windows headers.
+
+    const uint32_t headerSize = 14 + 40;
+    const uint32_t rowSize = ((uint32_t) size.cx * 3 + 3) & ~3u;
+    const uint32_t imageSize = rowSize * (uint32_t) size.cy;
+
+    uint8_t header[headerSize] = {};
+
+    header[0] = 'B';
+    header[1] = 'M';
+    PutLittleEndian(header + 2, headerSize + imageSize, 4);     // bfSize
+    PutLittleEndian(header + 10, headerSize, 4);                // bfOffBits
+    PutLittleEndian(header + 14, 40, 4);                        // biSize
+    PutLittleEndian(header + 18, (uint32_t) size.cx, 4);        // biWidth
+    PutLittleEndian(header + 22, (uint32_t) size.cy, 4);        // biHeight (bottom-up)
+    PutLittleEndian(header + 26, 1, 2);                         // biPlanes
+    PutLittleEndian(header + 28, 24, 2);                        // biBitCount
+    PutLittleEndian(header + 34, imageSize, 4);                 // biSizeImage
+    PutLittleEndian(header + 38, 2835, 4);                      // biXPelsPerMeter (72 DPI)
+    PutLittleEndian(header + 42, 2835, 4);                      // biYPelsPerMeter
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file)
+        return false;
+
+    file.write((const char*) header, sizeof(header));
+
+    std::vector<uint8_t> row(rowSize, 0);
+
+    for (LONG y = size.cy - 1; y >= 0 && file; y--)
+    {
+        const uint32_t* pSrc = pPixels + (size_t) y * size.cx;
+        uint8_t* pDest = row.data();
+
+        for (LONG x = 0; x < size.cx; x++)
+        {
+            uint32_t pixel = pSrc[x];
+            *pDest++ = (uint8_t) pixel;             // Blue
+            *pDest++ = (uint8_t) (pixel >> 8);      // Green
+            *pDest++ = (uint8_t) (pixel >> 16);     // Red
+        }
+
+        file.write((const char*) row.data(), rowSize);
+    }
+
+    file.close();
+
+    return !file.fail();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::GetKey
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CWallpaperCache::GetKey(
+    const fs::path& sourcePath,
+    uint64_t settingsHash,
+    uint64_t* pKey
+)
+{
+    std::error_code ec;
+
+    uint64_t fileSize = fs::file_size(sourcePath, ec);
+
+    if (ec)
+        return false;
+
+    auto lastWriteTime = fs::last_write_time(sourcePath, ec).time_since_epoch().count();
+
+    if (ec)
+        return false;
+
+    const fs::path::string_type& name = sourcePath.native();
+
+    uint64_t hash = HashValue(HashBasis, settingsHash);
+    hash = HashBytes(hash, name.data(), name.size() * sizeof(name[0]));
+    hash = HashValue(hash, fileSize);
+    hash = HashValue(hash, (int64_t) lastWriteTime);
+
+    *pKey = hash;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::GetFilePath
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+CWallpaperCache::GetFilePath(
+    uint64_t settingsHash,
+    uint64_t key
+) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%016llx.bmp", (unsigned long long) settingsHash, (unsigned long long) key);
+
+    return m_CacheDirectory / name;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::RenderEntry
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperCache::RenderEntry(
+    const fs::path& sourcePath,
+    const CWallpaperRenderSettings& settings,
+    uint64_t settingsHash
+)
+{
+    uint64_t key;
+
+    if (!GetKey(sourcePath, settingsHash, &key))
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_Index.count(key) != 0)
+            return true;
+    }
+
+    fs::path renderedPath = GetFilePath(settingsHash, key);
+
+    uint64_t fileSize = RenderFile(sourcePath, settings, renderedPath);
+
+    if (fileSize == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_SettingsHash != settingsHash)
+    {
+        // Rendered for the wrong screen.
+        std::error_code ec;
+        fs::remove(renderedPath, ec);
+        return false;
+    }
+
+    if (m_Index.count(key) == 0)
+        AddEntry({ key, settingsHash, fileSize });
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::PrepareCandidates
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::PrepareCandidates(
+    const std::vector<fs::path>& candidatePaths,
+    bool render,
+    const CWallpaperRenderSettings& settings,
+    uint64_t settingsHash,
+    uint32_t generation
+)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_MaximumSize == 0 || settingsHash == 0)
+            render = false;
+    }
+
+    for (const fs::path& sourcePath : candidatePaths)
+    {
+        bool ok;
+
+        if (render)
+        {
+            ok = RenderEntry(sourcePath, settings, settingsHash);
+        }
+        else
+        {
+            std::vector<uint32_t> pixels;
+            SIZE size = {};
+            std::error_code ec;
+
+            ok = fs::is_regular_file(sourcePath, ec) && m_Decode(sourcePath, &pixels, &size);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        // Replaced by another request?
+        if (m_PrepareGeneration != generation)
+            return;
+
+        if (ok)
+        {
+            m_PrepareState = PREPARE_Ready;
+            m_PreparedPath = sourcePath;
+            return;
+        }
+
+        DebugPrint(L"CWallpaperCache::PrepareCandidates: Skipping %s\n", sourcePath.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_PrepareGeneration == generation)
+        m_PrepareState = PREPARE_Failed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::RenderFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+uint64_t
+CWallpaperCache::RenderFile(
+    const fs::path& sourcePath,
+    const CWallpaperRenderSettings& settings,
+    const fs::path& renderedPath
+)
+{
+    std::vector<uint32_t> srcPixels;
+    SIZE srcSize = {};
+
+    if (!m_Decode(sourcePath, &srcPixels, &srcSize) ||
+        srcSize.cx <= 0 ||
+        srcSize.cy <= 0 ||
+        srcPixels.size() < (size_t) srcSize.cx * srcSize.cy)
+    {
+        DebugPrint(L"CWallpaperCache::RenderFile: Can't decode: %s\n", sourcePath.c_str());
+        return 0;
+    }
+
+    std::vector<uint32_t> dstPixels((size_t) settings.m_Size.cx * settings.m_Size.cy);
+
+    ResizeWallpaperPixels(srcPixels.data(),
+                          srcSize,
+                          dstPixels.data(),
+                          settings.m_Size,
+                          settings.m_ResizeMode,
+                          settings.m_BackgroundColor,
+                          FILTER_Lanczos3,
+                          settings.m_LinearLight);
+
+    std::vector<uint32_t>().swap(srcPixels);
+
+    // Write to a temporary file, then rename it, so Windows never sees a
+    // partly written file. (The file may be rendered on the render thread
+    // and by Render() at the same time, so the temporary names differ.)
+
+    static std::atomic<uint32_t> tempCounter(0);
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%u.tmp", (unsigned) tempCounter++);
+
+    fs::path tempPath = fs::path(renderedPath) += suffix;
+
+    std::error_code ec;
+
+    if (!WriteBitmapFile(tempPath, dstPixels.data(), settings.m_Size))
+    {
+        fs::remove(tempPath, ec);
+        return 0;
+    }
+
+    fs::rename(tempPath, renderedPath, ec);
+
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return 0;
+    }
+
+    uint64_t fileSize = fs::file_size(renderedPath, ec);
+
+    return ec ? 0 : fileSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::AddEntry
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::AddEntry(
+    const Entry& entry
+)
+{
+    m_Entries.push_front(entry);
+    m_Index[entry.m_Key] = m_Entries.begin();
+    m_TotalSize += entry.m_FileSize;
+
+    // Never delete the file just added, even if it's over the limit by
+    // itself -- it's about to be used.
+
+    while (m_TotalSize > m_MaximumSize && m_Entries.size() > 1)
+        RemoveEntry(std::prev(m_Entries.end()));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::RemoveEntry
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::RemoveEntry(
+    EntryList::iterator it
+)
+{
+    std::error_code ec;
+    fs::remove(GetFilePath(it->m_SettingsHash, it->m_Key), ec);
+
+    m_TotalSize -= it->m_FileSize;
+    m_Index.erase(it->m_Key);
+    m_Entries.erase(it);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache::RenderThread
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperCache::RenderThread()
+{
+    for (;;)
+    {
+        std::vector<fs::path> candidatePaths;
+        bool render = false;
+        uint32_t generation = 0;
+        fs::path sourcePath;
+        CWallpaperRenderSettings settings;
+        uint64_t settingsHash;
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+
+            m_Rendering = false;
+            m_RenderDone.notify_all();
+
+            m_WorkAvailable.wait(lock, [this] () { return m_Stop || !m_PrepareCandidates.empty() || !m_Queue.empty(); });
+
+            if (m_Stop)
+                break;
+
+            // The next wallpaper comes before the ones after it.
+            if (!m_PrepareCandidates.empty())
+            {
+                candidatePaths.swap(m_PrepareCandidates);
+                render = m_PrepareRender;
+                generation = m_PrepareGeneration;
+            }
+            else
+            {
+                sourcePath = std::move(m_Queue.front());
+                m_Queue.pop_front();
+            }
+
+            m_Rendering = true;
+            settings = m_Settings;
+            settingsHash = m_SettingsHash;
+        }
+
+        if (!candidatePaths.empty())
+            PrepareCandidates(candidatePaths, render, settings, settingsHash, generation);
+        else
+            RenderEntry(sourcePath, settings, settingsHash);
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Rendering = false;
+    m_RenderDone.notify_all();
+}
@@ -0,0 +1,348 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperCache.h
+//
+//  CWallpaperCache class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Resize.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperRenderSettings
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// How wallpapers are rendered. A rendered file is only used with the
+// settings it was rendered with.
+struct CWallpaperRenderSettings
+{
+    // Screen size (the virtual screen for RESIZE_Span).
+    SIZE m_Size;
+
+    WallpaperResizeMode m_ResizeMode;
+
+    COLORREF m_BackgroundColor;
+
+    bool m_LinearLight;
+
+    bool
+    operator==(
+        const CWallpaperRenderSettings& that
+    ) const
+    {
+        return m_Size.cx == that.m_Size.cx &&
+               m_Size.cy == that.m_Size.cy &&
+               m_ResizeMode == that.m_ResizeMode &&
+               m_BackgroundColor == that.m_BackgroundColor &&
+               m_LinearLight == that.m_LinearLight;
+    }
+
+    bool
+    operator!=(
+        const CWallpaperRenderSettings& that
+    ) const
+    {
+        return !(*this == that);
+    }
+
+    // Get a hash of the settings (part of rendered file names).
+    uint64_t
+    GetHash() const;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperCache
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Wallpapers rendered ahead of time at the exact screen size.
+//
+// Windows decodes and scales the wallpaper file every time it changes,
+// which is slow for large photos (and takes a lot of memory in explorer).
+// The cache renders the next few wallpapers on a background thread --
+// decodes them, resizes them for the screen with the current resize mode,
+// and writes them as .bmp files -- so a wallpaper change can give Windows
+// a file that's ready to display.
+//
+// Rendered files are named after a hash of the render settings and a hash
+// of the source file's path, size, and last write time, so a file that has
+// changed is rendered again. Changing the render settings (e.g. screen
+// resolution or resize mode) deletes the files rendered with the old ones.
+// The cache has a size limit; the least recently used files are deleted
+// to stay under it. Files rendered in earlier sessions are reused.
+//
+// Doesn't use any Windows APIs (images are decoded by the caller's decode
+// function).
+class CWallpaperCache
+{
+    public:
+
+        // Decodes an image file to 32bpp pixels (top-down, no row padding).
+        // Called on the render thread. Returns false if the file couldn't
+        // be decoded.
+        using DecodeFunction = std::function<bool (const fs::path& path, std::vector<uint32_t>* pPixels, SIZE* pSize)>;
+
+        // State of the wallpaper being prepared (see Prepare()).
+        enum PrepareState
+        {
+            PREPARE_None,       // Nothing is being prepared.
+            PREPARE_Pending,    // Still working on it.
+            PREPARE_Ready,      // Ready (see GetPrepared()).
+            PREPARE_Failed      // None of the candidates could be decoded.
+        };
+
+        CWallpaperCache(
+            DecodeFunction decode
+        );
+
+        // Cancels waiting renders and waits for the render thread to exit.
+        ~CWallpaperCache();
+
+        // No copy ctor.
+        CWallpaperCache(const CWallpaperCache&) = delete;
+
+        // No copy assignment.
+        CWallpaperCache& operator=(const CWallpaperCache&) = delete;
+
+        // Set the cache directory and its size limit, and find the files
+        // rendered in earlier sessions. A size limit of zero disables
+        // the cache.
+        void
+        Initialize(
+            const fs::path& cacheDirectory,
+            uint64_t maximumSize        // Bytes.
+        );
+
+        // Set how wallpapers are rendered. If the settings have changed,
+        // waiting renders are cancelled and files rendered with the old
+        // settings are deleted.
+        void
+        SetRenderSettings(
+            const CWallpaperRenderSettings& settings
+        );
+
+        // Replace the waiting renders. The files are rendered in the
+        // order given, skipping any that are already rendered.
+        void
+        RenderAhead(
+            const std::vector<fs::path>& sourcePaths
+        );
+
+        // Prepare the next wallpaper, ahead of any waiting renders: render
+        // the first of the candidates that exists and can be decoded,
+        // skipping the others. If render is false or the cache is disabled,
+        // the candidates are only decoded (which also reads them into the
+        // file system cache). Replaces any earlier request.
+        void
+        Prepare(
+            const std::vector<fs::path>& candidatePaths,
+            bool render = true
+        );
+
+        // Get the state of the wallpaper being prepared, and if it's ready,
+        // which of the candidates it is.
+        PrepareState
+        GetPrepared(
+            fs::path* pSourcePath
+        );
+
+        // If a source file is one of the candidates being prepared, wait
+        // until the prepare is done. Returns true if it's the candidate
+        // that was prepared (so it's rendered, if it was to be).
+        bool
+        WaitForPrepared(
+            const fs::path& sourcePath
+        );
+
+        // Forget the prepared wallpaper (or stop preparing it).
+        void
+        CancelPrepare();
+
+        // Get the rendered file for a source file. Returns an empty path if
+        // it hasn't been rendered with the current settings (or the source
+        // file has changed since it was).
+        fs::path
+        Lookup(
+            const fs::path& sourcePath
+        );
+
+        // Render a file on the calling thread, unless it's already
+        // rendered. Returns the rendered file, or an empty path if the
+        // source file couldn't be decoded or the cache is disabled.
+        fs::path
+        Render(
+            const fs::path& sourcePath
+        );
+
+        // Wait until there are no renders waiting or in progress.
+        void
+        WaitForRenders();
+
+        // Are there no renders waiting or in progress?
+        bool
+        IsIdle();
+
+        // Get the total size of the rendered files (bytes).
+        uint64_t
+        GetSize();
+
+        // Write 32bpp pixels (top-down, no row padding) to a 24bpp .bmp file.
+        static
+        bool
+        WriteBitmapFile(
+            const fs::path& path,
+            const uint32_t* pPixels,
+            SIZE size
+        );
+
+    private:
+
+        // A rendered file.
+        struct Entry
+        {
+            uint64_t m_Key;             // See GetKey().
+            uint64_t m_SettingsHash;    // Settings it was rendered with.
+            uint64_t m_FileSize;        // Bytes.
+        };
+
+        using EntryList = std::list<Entry>;
+
+        // Get the key of a source file: a hash of its path, size, last
+        // write time, and the render settings. Returns false if the
+        // source file doesn't exist.
+        static
+        bool
+        GetKey(
+            const fs::path& sourcePath,
+            uint64_t settingsHash,
+            uint64_t* pKey
+        );
+
+        // Get the name of a rendered file.
+        fs::path
+        GetFilePath(
+            uint64_t settingsHash,
+            uint64_t key
+        ) const;
+
+        // Render a file and add it to the index, unless it's already
+        // rendered. Returns false if it couldn't be rendered, or the
+        // settings changed while rendering.
+        bool
+        RenderEntry(
+            const fs::path& sourcePath,
+            const CWallpaperRenderSettings& settings,
+            uint64_t settingsHash
+        );
+
+        // Work on a Prepare() request (on the render thread).
+        void
+        PrepareCandidates(
+            const std::vector<fs::path>& candidatePaths,
+            bool render,
+            const CWallpaperRenderSettings& settings,
+            uint64_t settingsHash,
+            uint32_t generation
+        );
+
+        // Decode, resize, and write a file. Returns the size of the
+        // rendered file, or zero if it failed.
+        uint64_t
+        RenderFile(
+            const fs::path& sourcePath,
+            const CWallpaperRenderSettings& settings,
+            const fs::path& renderedPath
+        );
+
+        // Add a rendered file to the index (as the most recently used),
+        // and delete the least recently used files if the cache is over
+        // its size limit. Caller must hold m_Mutex.
+        void
+        AddEntry(
+            const Entry& entry
+        );
+
+        // Remove a file from the index and delete it.
+        // Caller must hold m_Mutex.
+        void
+        RemoveEntry(
+            EntryList::iterator it
+        );
+
+        // Render thread. Works on Prepare() requests and renders files
+        // from m_Queue until m_Stop is set.
+        void
+        RenderThread();
+
+        DecodeFunction m_Decode;
+
+        fs::path m_CacheDirectory;
+
+        uint64_t m_MaximumSize;
+
+        // Guards everything below.
+        std::mutex m_Mutex;
+
+        // Signalled when m_Queue or m_PrepareCandidates gets work, or
+        // m_Stop is set.
+        std::condition_variable m_WorkAvailable;
+
+        // Signalled when the render thread finishes a file.
+        std::condition_variable m_RenderDone;
+
+        CWallpaperRenderSettings m_Settings;
+
+        uint64_t m_SettingsHash;
+
+        // Files waiting to be rendered.
+        std::deque<fs::path> m_Queue;
+
+        // Waiting Prepare() request.
+        std::vector<fs::path> m_PrepareCandidates;
+
+        // The candidates of the last Prepare() request (still there after
+        // the render thread takes m_PrepareCandidates).
+        std::vector<fs::path> m_PrepareRequest;
+
+        // Render the candidates (see Prepare())?
+        bool m_PrepareRender;
+
+        PrepareState m_PrepareState;
+
+        // The candidate that was prepared (PREPARE_Ready).
+        fs::path m_PreparedPath;
+
+        // Incremented by Prepare() and CancelPrepare(), so the render
+        // thread can tell its request has been replaced.
+        uint32_t m_PrepareGeneration;
+
+        // Is the render thread rendering a file?
+        bool m_Rendering;
+
+        bool m_Stop;
+
+        // Rendered files, most recently used first.
+        EntryList m_Entries;
+
+        // Rendered files by key.
+        std::unordered_map<uint64_t, EntryList::iterator> m_Index;
+
+        // Total size of the rendered files.
+        uint64_t m_TotalSize;
+
+        std::thread m_RenderThread;
+};
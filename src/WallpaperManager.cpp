@@ -16,26 +16,46 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "precomp.h"
+#include <wincodec.h>
 
 #include "WallpaperChangerApp.h"
 
 #include "DesktopWallpaper.h"
 #include "WallpaperManager.h"
 
+#pragma comment(lib, "windowscodecs")
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CWallpaperManager ctor/dtor
 //
 //////////////////////////////////////////////////////////////////////////////
 
-CWallpaperManager::CWallpaperManager()
+CWallpaperManager::CWallpaperManager(
+    std::unique_ptr<CWallpaperBackend> pBackend
+)
     :
     m_CurrentWallpaperFile(),
     m_BackgroundColor(0x404040),
     m_ResizeMode(RESIZE_Fill),
-    m_IsWallpaperEnabled(false)
+    m_IsWallpaperEnabled(false),
+    m_pSession(new CWallpaperSession(pBackend ? std::move(pBackend) : std::make_unique<CDesktopWallpaperBackend>())),
+    m_pRenderCache(new CWallpaperCache(DecodeImageFile)),
+    m_IsPerMonitor(GetAppOptions()->m_PerMonitorWallpaper),
+    m_Monitors()
 {
     LoadFromRegistry();
+
+    // With per-monitor wallpapers, each monitor has a cache of its own
+    // instead (see UpdateMonitors()).
+    m_pRenderCache->Initialize(GetApp()->GetAppDataFilePath(L"WallpaperCache"),
+                               m_IsPerMonitor ? 0 : (uint64_t) GetAppOptions()->m_WallpaperCacheSize * 1024 * 1024);
+
+    if (m_IsPerMonitor)
+    {
+        std::vector<size_t> resizedMonitors;
+        UpdateMonitors(&resizedMonitors);
+    }
 }
 
 CWallpaperManager::~CWallpaperManager()
@@ -58,28 +78,23 @@ CWallpaperManager::SetWallpaper(
 
     if (!fullPath.empty() && fs::is_regular_file(fullPath))
     {
-        CDesktopWallpaper* pDesktopWallpaper = new CDesktopWallpaper;
-
-        // Get the background color that Windows is currently using.
-        COLORREF currentBackgroundColor = 0;
-        bool ok = SUCCEEDED(pDesktopWallpaper->GetBackgroundColor(&currentBackgroundColor));
-
-        // Get the resize mode that Windows is currently using.
-        DESKTOP_WALLPAPER_POSITION currentWallpaperPosition = DWPOS_CENTER;
-        ok = ok && SUCCEEDED(pDesktopWallpaper->GetPosition(&currentWallpaperPosition));
-
-        // Set the background color (if needed)
-        if (ok && currentBackgroundColor != m_BackgroundColor)
-            ok = ok && SUCCEEDED(pDesktopWallpaper->SetBackgroundColor(m_BackgroundColor));
-
-        // Set the wallpaper image.
-        ok = ok && SUCCEEDED(pDesktopWallpaper->SetWallpaper(fullPath));
+        // Use the pre-rendered wallpaper if there is one. It's already the
+        // size of the screen, so the resize mode doesn't change it, but
+        // Windows doesn't have to decode and scale the original.
+        fs::path displayPath = fullPath;
+        CWallpaperRenderSettings renderSettings;
+        if (GetRenderSettings(&renderSettings))
+        {
+            m_pRenderCache->SetRenderSettings(renderSettings);
 
-        // Set the image resize mode (if needed).
-        if (ok && currentWallpaperPosition != (DESKTOP_WALLPAPER_POSITION)GetResizeMode())
-            ok = ok && SUCCEEDED(pDesktopWallpaper->SetPosition((DESKTOP_WALLPAPER_POSITION)GetResizeMode()));
+            fs::path renderedPath = m_pRenderCache->Lookup(fullPath);
+            if (!renderedPath.empty())
+                displayPath = renderedPath;
+        }
 
-        delete pDesktopWallpaper;
+        // Set the background color, wallpaper image, and resize mode
+        // (only the ones that have changed).
+        bool ok = m_pSession->SetWallpaper(displayPath, GetResizeMode(), m_BackgroundColor);
 
         if (ok)
         {
@@ -104,6 +119,121 @@ CWallpaperManager::SetWallpaper(
     }
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::SetMonitorWallpapers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperManager::SetMonitorWallpapers(
+    const std::vector<fs::path>& fullPaths
+)
+{
+    ATLASSERT(fullPaths.size() <= m_Monitors.size());
+
+    // Spanning can't show a different image on each monitor.
+    WallpaperResizeMode position = (m_ResizeMode == RESIZE_Span) ? RESIZE_Fill : m_ResizeMode;
+
+    std::map<std::wstring, std::wstring> displayPaths;
+
+    bool ok = true;
+
+    for (size_t monitorIndex = 0; monitorIndex < fullPaths.size(); monitorIndex++)
+    {
+        const fs::path& fullPath = fullPaths[monitorIndex];
+
+        if (fullPath.empty())
+            continue;
+
+        DebugPrint(L"Set wallpaper on monitor %zu: %s\n", monitorIndex, fullPath.c_str());
+
+        // The monitor keeps the wallpaper it has.
+        if (!fs::is_regular_file(fullPath))
+        {
+            ok = false;
+            continue;
+        }
+
+        displayPaths[m_Monitors[monitorIndex].m_MonitorID] = GetDisplayPath(monitorIndex, fullPath, position);
+    }
+
+    if (displayPaths.empty())
+        return ok;
+
+    // Set the background color, the monitors' wallpaper images, and the
+    // resize mode (only the ones that have changed).
+    if (m_pSession->SetMonitorWallpapers(displayPaths, position, m_BackgroundColor))
+    {
+        for (size_t monitorIndex = 0; monitorIndex < fullPaths.size(); monitorIndex++)
+        {
+            if (displayPaths.count(m_Monitors[monitorIndex].m_MonitorID) != 0)
+                m_Monitors[monitorIndex].m_CurrentWallpaperFile = fullPaths[monitorIndex];
+        }
+
+        m_IsWallpaperEnabled = true;
+        m_CurrentWallpaperFile = m_Monitors[0].m_CurrentWallpaperFile;
+        SaveToRegistry();
+    }
+    else
+    {
+        DebugPrint("Failed to set wallpaper!\n");
+        ok = false;
+    }
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::ShowRenderedWallpapers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperManager::ShowRenderedWallpapers()
+{
+    WallpaperResizeMode position = (m_ResizeMode == RESIZE_Span) ? RESIZE_Fill : m_ResizeMode;
+
+    std::map<std::wstring, std::wstring> displayPaths;
+
+    bool moreToRender = false;
+
+    for (Monitor& monitor : m_Monitors)
+    {
+        if (monitor.m_UnrenderedWallpaperFile.empty())
+            continue;
+
+        fs::path renderedPath = monitor.m_pRenderCache->Lookup(monitor.m_UnrenderedWallpaperFile);
+
+        // The render may finish between Lookup() and IsIdle(), so once
+        // the cache is idle, look again before giving up on it.
+        bool isIdle = renderedPath.empty() && monitor.m_pRenderCache->IsIdle();
+        if (isIdle)
+            renderedPath = monitor.m_pRenderCache->Lookup(monitor.m_UnrenderedWallpaperFile);
+
+        if (!renderedPath.empty())
+        {
+            displayPaths[monitor.m_MonitorID] = renderedPath;
+            monitor.m_UnrenderedWallpaperFile.clear();
+        }
+        else if (isIdle)
+        {
+            // Couldn't be rendered. It stays as it is.
+            monitor.m_UnrenderedWallpaperFile.clear();
+        }
+        else
+        {
+            moreToRender = true;
+        }
+    }
+
+    if (!displayPaths.empty() && !m_pSession->SetMonitorWallpapers(displayPaths, position, m_BackgroundColor))
+        DebugPrint("Failed to set wallpaper!\n");
+
+    return moreToRender;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CWallpaperManager::SetWallpaperToColor
@@ -120,16 +250,438 @@ CWallpaperManager::SetWallpaperToColor(
 
     m_BackgroundColor = color;
 
-    CDesktopWallpaper* pDesktopWallpaper = new CDesktopWallpaper;
-    pDesktopWallpaper->SetBackgroundColor(color);
-    pDesktopWallpaper->Disable();
-    delete pDesktopWallpaper;
+    m_pSession->SetSolidColor(color);
 
     m_IsWallpaperEnabled = false;
 
+    // Don't show them when they're rendered.
+    for (Monitor& monitor : m_Monitors)
+        monitor.m_UnrenderedWallpaperFile.clear();
+
     SaveToRegistry();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::RenderAhead
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperManager::RenderAhead(
+    const std::vector<fs::path>& fullPaths
+)
+{
+    CWallpaperRenderSettings renderSettings;
+    if (!GetRenderSettings(&renderSettings))
+        return;
+
+    // Changing the settings (e.g. the screen resolution) throws out the
+    // files rendered with the old ones.
+    m_pRenderCache->SetRenderSettings(renderSettings);
+    m_pRenderCache->RenderAhead(fullPaths);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::PrepareWallpaper
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperManager::PrepareWallpaper(
+    const std::vector<fs::path>& candidatePaths
+)
+{
+    // If wallpapers can't be pre-rendered, the candidates are still
+    // checked (and read into the file system cache).
+    CWallpaperRenderSettings renderSettings;
+    bool render = GetRenderSettings(&renderSettings);
+    if (render)
+        m_pRenderCache->SetRenderSettings(renderSettings);
+
+    m_pRenderCache->Prepare(candidatePaths, render);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::RenderAhead (monitor)
+//  CWallpaperManager::PrepareWallpaper (monitor)
+//  CWallpaperManager::CancelPrepare
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperManager::RenderAhead(
+    size_t monitorIndex,
+    const std::vector<fs::path>& fullPaths
+)
+{
+    CWallpaperRenderSettings renderSettings;
+    if (!GetRenderSettings(monitorIndex, &renderSettings))
+        return;
+
+    const Monitor& monitor = m_Monitors[monitorIndex];
+
+    monitor.m_pRenderCache->SetRenderSettings(renderSettings);
+
+    // The wallpaper it's showing comes first, if it still needs rendering.
+    if (!monitor.m_UnrenderedWallpaperFile.empty())
+    {
+        std::vector<fs::path> renderPaths;
+        renderPaths.reserve(fullPaths.size() + 1);
+        renderPaths.push_back(monitor.m_UnrenderedWallpaperFile);
+        renderPaths.insert(renderPaths.end(), fullPaths.begin(), fullPaths.end());
+
+        monitor.m_pRenderCache->RenderAhead(renderPaths);
+        return;
+    }
+
+    monitor.m_pRenderCache->RenderAhead(fullPaths);
+}
+
+void
+CWallpaperManager::PrepareWallpaper(
+    size_t monitorIndex,
+    const std::vector<fs::path>& candidatePaths
+)
+{
+    CWallpaperRenderSettings renderSettings;
+    bool render = GetRenderSettings(monitorIndex, &renderSettings);
+
+    CWallpaperCache* pRenderCache = m_Monitors[monitorIndex].m_pRenderCache.get();
+
+    if (render)
+        pRenderCache->SetRenderSettings(renderSettings);
+
+    pRenderCache->Prepare(candidatePaths, render);
+}
+
+void
+CWallpaperManager::CancelPrepare()
+{
+    m_pRenderCache->CancelPrepare();
+
+    for (Monitor& monitor : m_Monitors)
+        monitor.m_pRenderCache->CancelPrepare();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::OnDisplayChange
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperManager::OnDisplayChange()
+{
+    m_pSession->InvalidateMonitors();
+
+    if (!m_IsPerMonitor)
+    {
+        // Set the wallpaper again, so Windows doesn't resize one that was
+        // rendered for the old layout. (Nothing changes if it wasn't.)
+        if (m_IsWallpaperEnabled && !m_CurrentWallpaperFile.empty())
+            SetWallpaper(fs::path(m_CurrentWallpaperFile));
+
+        return false;
+    }
+
+    std::vector<size_t> resizedMonitors;
+    bool monitorsChanged = UpdateMonitors(&resizedMonitors);
+
+    // Same for the monitors whose resolution changed.
+    if (m_IsWallpaperEnabled && !resizedMonitors.empty())
+    {
+        std::vector<fs::path> fullPaths(m_Monitors.size());
+        for (size_t monitorIndex : resizedMonitors)
+            fullPaths[monitorIndex] = m_Monitors[monitorIndex].m_CurrentWallpaperFile;
+
+        SetMonitorWallpapers(fullPaths);
+    }
+
+    return monitorsChanged;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::UpdateMonitors
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperManager::UpdateMonitors(
+    std::vector<size_t>* pResizedMonitors
+)
+{
+    std::vector<CWallpaperMonitor> backendMonitors;
+    if (!m_pSession->GetMonitors(&backendMonitors) || backendMonitors.empty())
+        return false;
+
+    std::vector<Monitor> oldMonitors;
+    oldMonitors.swap(m_Monitors);
+
+    bool monitorsChanged = backendMonitors.size() != oldMonitors.size();
+
+    // The monitors share the cache size limit.
+    uint64_t cacheSize = (uint64_t) GetAppOptions()->m_WallpaperCacheSize * 1024 * 1024 / backendMonitors.size();
+
+    for (const CWallpaperMonitor& backendMonitor : backendMonitors)
+    {
+        SIZE size = CRect(backendMonitor.m_Rect).Size();
+
+        auto it = std::find_if(oldMonitors.begin(),
+                               oldMonitors.end(),
+                               [&] (const Monitor& monitor) { return monitor.m_MonitorID == backendMonitor.m_MonitorID; });
+
+        if (it != oldMonitors.end())
+        {
+            // Still here. Its wallpapers are still good unless its
+            // resolution changed.
+
+            if ((size_t) (it - oldMonitors.begin()) != m_Monitors.size())
+                monitorsChanged = true;
+
+            m_Monitors.push_back(std::move(*it));
+
+            Monitor& monitor = m_Monitors.back();
+
+            if (monitor.m_Size.cx != size.cx || monitor.m_Size.cy != size.cy)
+            {
+                DebugPrint(L"CWallpaperManager::UpdateMonitors: %s is now %ld x %ld\n",
+                           monitor.m_MonitorID.c_str(),
+                           size.cx,
+                           size.cy);
+
+                monitor.m_Size = size;
+
+                // Throw out the files rendered for the old resolution.
+                CWallpaperRenderSettings renderSettings;
+                if (GetRenderSettings(m_Monitors.size() - 1, &renderSettings))
+                    monitor.m_pRenderCache->SetRenderSettings(renderSettings);
+
+                pResizedMonitors->push_back(m_Monitors.size() - 1);
+            }
+        }
+        else
+        {
+            // A new monitor (or the first time).
+
+            monitorsChanged = true;
+
+            Monitor monitor = {};
+            monitor.m_MonitorID = backendMonitor.m_MonitorID;
+            monitor.m_Size = size;
+            monitor.m_ResizeMode = RESIZE_Fill;
+
+            CRegistryKey monitorKey = GetMonitorRegistryKey(monitor.m_MonitorID);
+
+            monitor.m_HasResizeMode = monitorKey.ReadEnum(L"ResizeMode", monitor.m_ResizeMode) &&
+                                      monitor.m_ResizeMode >= RESIZE_Center &&
+                                      monitor.m_ResizeMode <= RESIZE_Span;
+
+            monitorKey.Read(L"CurrentWallpaper", monitor.m_CurrentWallpaperFile);
+
+            monitor.m_pRenderCache = std::make_unique<CWallpaperCache>(DecodeImageFile);
+            monitor.m_pRenderCache->Initialize(GetApp()->GetAppDataFilePath(L"WallpaperCache") / GetMonitorKeyName(monitor.m_MonitorID),
+                                               cacheSize);
+
+            m_Monitors.push_back(std::move(monitor));
+        }
+    }
+
+    // The monitors that are gone take their caches' render threads with
+    // them. Their files stay, in case they come back.
+
+    return monitorsChanged;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::GetRenderSettings
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperManager::GetRenderSettings(
+    CWallpaperRenderSettings* pSettings
+)
+{
+    pSettings->m_ResizeMode = m_ResizeMode;
+    pSettings->m_BackgroundColor = m_BackgroundColor;
+    pSettings->m_LinearLight = (GetAppOptions()->m_LinearLightResizeModes & (1 << m_ResizeMode)) != 0;
+
+    std::vector<CWallpaperMonitor> monitors;
+
+    if (!m_pSession->GetMonitors(&monitors) || monitors.empty())
+        return false;
+
+    if (m_ResizeMode == RESIZE_Span)
+    {
+        // One image across the bounding rectangle of the monitors.
+
+        CRect virtualRect = monitors[0].m_Rect;
+        for (const CWallpaperMonitor& monitor : monitors)
+            virtualRect.UnionRect(virtualRect, &monitor.m_Rect);
+
+        pSettings->m_Size = virtualRect.Size();
+    }
+    else
+    {
+        // Windows resizes the wallpaper for each monitor separately, so one
+        // rendered file only fits if every monitor is the same size.
+
+        pSettings->m_Size = CRect(monitors[0].m_Rect).Size();
+
+        for (const CWallpaperMonitor& monitor : monitors)
+        {
+            if (CRect(monitor.m_Rect).Size() != pSettings->m_Size)
+                return false;
+        }
+    }
+
+    return pSettings->m_Size.cx > 0 && pSettings->m_Size.cy > 0;
+}
+
+bool
+CWallpaperManager::GetRenderSettings(
+    size_t monitorIndex,
+    CWallpaperRenderSettings* pSettings
+)
+{
+    // Rendered at the monitor's resolution. (RESIZE_Span renders the same
+    // as RESIZE_Fill.)
+    WallpaperResizeMode resizeMode = GetResizeMode(monitorIndex);
+
+    pSettings->m_Size = m_Monitors[monitorIndex].m_Size;
+    pSettings->m_ResizeMode = resizeMode;
+    pSettings->m_BackgroundColor = m_BackgroundColor;
+    pSettings->m_LinearLight = (GetAppOptions()->m_LinearLightResizeModes & (1 << resizeMode)) != 0;
+
+    return pSettings->m_Size.cx > 0 && pSettings->m_Size.cy > 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::GetDisplayPath
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+CWallpaperManager::GetDisplayPath(
+    size_t monitorIndex,
+    const fs::path& fullPath,
+    WallpaperResizeMode position
+)
+{
+    CWallpaperRenderSettings renderSettings;
+    if (!GetRenderSettings(monitorIndex, &renderSettings))
+        return fullPath;
+
+    Monitor& monitor = m_Monitors[monitorIndex];
+    CWallpaperCache* pRenderCache = monitor.m_pRenderCache.get();
+
+    monitor.m_UnrenderedWallpaperFile.clear();
+
+    pRenderCache->SetRenderSettings(renderSettings);
+
+    fs::path renderedPath = pRenderCache->Lookup(fullPath);
+
+    // Windows positions every monitor's wallpaper the same way, so if this
+    // monitor has a different resize mode, only a rendered file shows it
+    // right. If it's being prepared, it's nearly done. If not, rendering
+    // it here would hold up the UI for the whole decode and resize, so
+    // it's shown the others' way until it's rendered in the background
+    // (see ShowRenderedWallpapers()). (If it can't be rendered, e.g. the
+    // cache is disabled, it stays that way.)
+    if (renderedPath.empty() && renderSettings.m_ResizeMode != position)
+    {
+        if (pRenderCache->WaitForPrepared(fullPath))
+            renderedPath = pRenderCache->Lookup(fullPath);
+
+        if (renderedPath.empty())
+        {
+            monitor.m_UnrenderedWallpaperFile = fullPath;
+            pRenderCache->RenderAhead({ fullPath });
+        }
+    }
+
+    return renderedPath.empty() ? fullPath : renderedPath;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::DecodeImageFile
+//
+//  Called on the render cache's thread. (GDI+ isn't linked, and the shell
+//  thumbnail APIs won't give a full size image.)
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CWallpaperManager::DecodeImageFile(
+    const fs::path& fullPath,
+    std::vector<uint32_t>* pPixels,
+    SIZE* pSize
+)
+{
+    HRESULT hrInit = ::CoInitializeEx(NULL, COINIT_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+
+    bool ok = false;
+
+    {
+        CComPtr<IWICImagingFactory> pFactory;
+        CComPtr<IWICBitmapDecoder> pDecoder;
+        CComPtr<IWICBitmapFrameDecode> pFrame;
+        CComPtr<IWICFormatConverter> pConverter;
+        UINT width = 0;
+        UINT height = 0;
+
+        HRESULT hr = pFactory.CoCreateInstance(CLSID_WICImagingFactory);
+
+        if (SUCCEEDED(hr))
+            hr = pFactory->CreateDecoderFromFilename(fullPath.c_str(), NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &pDecoder);
+
+        if (SUCCEEDED(hr))
+            hr = pDecoder->GetFrame(0, &pFrame);
+
+        if (SUCCEEDED(hr))
+            hr = pFactory->CreateFormatConverter(&pConverter);
+
+        if (SUCCEEDED(hr))
+            hr = pConverter->Initialize(pFrame, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
+
+        if (SUCCEEDED(hr))
+            hr = pConverter->GetSize(&width, &height);
+
+        // CopyPixels() takes a 32-bit buffer size.
+        if (SUCCEEDED(hr) && (width == 0 || height == 0 || (uint64_t) width * height > 0x10000000))
+            hr = E_FAIL;
+
+        if (SUCCEEDED(hr))
+        {
+            pPixels->resize((size_t) width * height);
+            hr = pConverter->CopyPixels(NULL, width * 4, (UINT) (pPixels->size() * 4), (BYTE*) pPixels->data());
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            *pSize = { (LONG) width, (LONG) height };
+            ok = true;
+        }
+        else
+        {
+            DebugPrint(L"CWallpaperManager::DecodeImageFile: 0x%08X %s\n", hr, fullPath.c_str());
+        }
+    }
+
+    if (SUCCEEDED(hrInit))
+        ::CoUninitialize();
+
+    return ok;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CWallpaperManager::GetCurrentWindowsWallpaperFile
@@ -145,13 +697,77 @@ CWallpaperManager::GetCurrentWindowsWallpaperFile()
 {
     std::wstring wallpaperFile;
 
-    CDesktopWallpaper* pDesktopWallpaper = new CDesktopWallpaper;
-    pDesktopWallpaper->GetWallpaper(&wallpaperFile);
-    delete pDesktopWallpaper;
+    CDesktopWallpaperBackend backend;
+    if (backend.Connect())
+        backend.GetWallpaper(&wallpaperFile);
+
+    // A rendered file is named after a hash, so it can't be mapped back
+    // to its source file. But it's the wallpaper we set last, which is
+    // in the registry.
+    if (!wallpaperFile.empty() && IsRenderedWallpaperFile(wallpaperFile))
+    {
+        wallpaperFile.clear();
+        GetApp()->GetAppRegistryKey().Read(L"CurrentWallpaper", wallpaperFile);
+
+        if (!wallpaperFile.empty() && IsRenderedWallpaperFile(wallpaperFile))
+            wallpaperFile.clear();
+    }
 
     return wallpaperFile;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::IsRenderedWallpaperFile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool
+CWallpaperManager::IsRenderedWallpaperFile(
+    const fs::path& fullPath
+)
+{
+    // The per-monitor caches are subdirectories of this one.
+    std::wstring cacheDirectory = GetApp()->GetAppDataFilePath(L"WallpaperCache").wstring() + L"\\";
+
+    return _wcsnicmp(fullPath.c_str(), cacheDirectory.c_str(), cacheDirectory.size()) == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperManager::GetMonitorRegistryKey
+//  CWallpaperManager::GetMonitorKeyName
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+CRegistryKey
+CWallpaperManager::GetMonitorRegistryKey(
+    const std::wstring& monitorID
+)
+{
+    return GetApp()->GetAppRegistrySubKey((std::wstring(L"Monitors\\") + GetMonitorKeyName(monitorID)).c_str());
+}
+
+/*static*/
+std::wstring
+CWallpaperManager::GetMonitorKeyName(
+    const std::wstring& monitorID
+)
+{
+    // Monitor IDs are device paths (e.g. "\\?\DISPLAY#DEL40F5#...#{...}"),
+    // which won't do as registry key or file names.
+    std::wstring keyName = monitorID;
+
+    std::replace_if(keyName.begin(),
+                    keyName.end(),
+                    [] (wchar_t ch) { return !iswalnum(ch); },
+                    L'_');
+
+    return keyName;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  CWallpaperManager::LoadFromRegistry
@@ -163,34 +779,31 @@ CWallpaperManager::LoadFromRegistry()
 {
     // Set defaults based on what Windows is doing.
 
-    CDesktopWallpaper* pDesktopWallpaper = new CDesktopWallpaper;
-
     std::wstring wallpaperFile;
-    if (SUCCEEDED(pDesktopWallpaper->GetWallpaper(&wallpaperFile)) &&
-        !wallpaperFile.empty())
+    if (m_pSession->GetWallpaper(&wallpaperFile) &&
+        !wallpaperFile.empty() &&
+        !IsRenderedWallpaperFile(wallpaperFile))
     {
         m_CurrentWallpaperFile = wallpaperFile;
     }
 
     COLORREF backgroundColor;
-    if (SUCCEEDED(pDesktopWallpaper->GetBackgroundColor(&backgroundColor)) &&
+    if (m_pSession->GetBackgroundColor(&backgroundColor) &&
         backgroundColor != 0)
     {
         m_BackgroundColor = backgroundColor;
     }
 
-    DESKTOP_WALLPAPER_POSITION position;
-    if (SUCCEEDED(pDesktopWallpaper->GetPosition(&position)) &&
-        (WallpaperResizeMode) position >= RESIZE_Center &&
-        (WallpaperResizeMode) position <= RESIZE_Fill)
+    WallpaperResizeMode position;
+    if (m_pSession->GetPosition(&position) &&
+        position >= RESIZE_Center &&
+        position <= RESIZE_Fill)
     {
-        m_ResizeMode = (WallpaperResizeMode) position;
+        m_ResizeMode = position;
     }
 
     m_IsWallpaperEnabled = !m_CurrentWallpaperFile.empty();
 
-    delete pDesktopWallpaper;
-
     // Load our settings from the registry.
 
     CRegistryKey appRegKey = GetApp()->GetAppRegistryKey();
@@ -216,4 +829,7 @@ CWallpaperManager::SaveToRegistry()
     appRegKey.Write(L"BackgroundColor", m_BackgroundColor);
     appRegKey.Write(L"ResizeMode", m_ResizeMode);
     appRegKey.Write(L"WallpaperEnabled", m_IsWallpaperEnabled);
+
+    for (const Monitor& monitor : m_Monitors)
+        GetMonitorRegistryKey(monitor.m_MonitorID).Write(L"CurrentWallpaper", monitor.m_CurrentWallpaperFile);
 }
@@ -17,14 +17,28 @@
 
 #pragma once
 
+#include "Registry.h"
 #include "Resize.h"
+#include "WallpaperCache.h"
+#include "WallpaperSession.h"
 
 // Wallpaper manager.
+//
+// Shows the same wallpaper on every monitor, or with per-monitor wallpapers
+// (CWallpaperChangerOptions::m_PerMonitorWallpaper), a different one on
+// each. Windows positions every monitor's wallpaper the same way, so for a
+// monitor to have its own resize mode, its wallpapers are pre-rendered at
+// its resolution. Each monitor has its own render cache (and thread), so
+// the monitors' wallpapers are rendered in parallel.
 class CWallpaperManager
 {
     public:
 
-        CWallpaperManager();
+        // Displays wallpapers with the given backend, or the shell's
+        // (CDesktopWallpaperBackend) if there isn't one.
+        CWallpaperManager(
+            std::unique_ptr<CWallpaperBackend> pBackend = nullptr
+        );
 
         ~CWallpaperManager();
 
@@ -92,7 +106,9 @@ class CWallpaperManager
             return m_CurrentWallpaperFile;
         }
 
-        // Get the current wallpaper file that Windows is using
+        // Get the current wallpaper file that Windows is using. If it's
+        // one we rendered, gets the file it was rendered from (or an empty
+        // path if that isn't known).
         static
         fs::path
         GetCurrentWindowsWallpaperFile();
@@ -101,8 +117,225 @@ class CWallpaperManager
         void
         SaveToRegistry();
 
+        // The desktop wallpaper settings have changed (possibly by somebody
+        // else, e.g. the Settings app).
+        void
+        OnWallpaperSettingsChanged()
+        {
+            m_pSession->NotifyChanged();
+        }
+
+        // Pre-render the wallpapers that will be displayed next (in the
+        // order given), so SetWallpaper() can give Windows a file that's
+        // already at the screen size. Replaces any earlier request.
+        void
+        RenderAhead(
+            const std::vector<fs::path>& fullPaths
+        );
+
+        // Prepare the next wallpaper ahead of time: the first of the
+        // candidates (in order) that exists and can be decoded is
+        // pre-rendered, and the others are skipped. Replaces any earlier
+        // request.
+        void
+        PrepareWallpaper(
+            const std::vector<fs::path>& candidatePaths
+        );
+
+        // Get the state of the wallpaper being prepared, and if it's ready,
+        // which of the candidates it is.
+        CWallpaperCache::PrepareState
+        GetPreparedWallpaper(
+            fs::path* pFullPath
+        )
+        {
+            return m_pRenderCache->GetPrepared(pFullPath);
+        }
+
+        // Forget the prepared wallpapers (or stop preparing them), on
+        // every monitor.
+        void
+        CancelPrepare();
+
+        // The monitor layout (or a monitor's resolution) has changed.
+        // Monitors whose resolution changed get their wallpaper rendered
+        // again; the others keep theirs. Returns true if monitors were
+        // added, removed, or reordered (see GetMonitorCount()).
+        bool
+        OnDisplayChange();
+
+        //
+        //  Per-monitor wallpapers
+        //
+
+        // Show a different wallpaper on each monitor?
+        bool
+        IsPerMonitor()
+        {
+            return m_IsPerMonitor;
+        }
+
+        // Get the number of monitors (none unless IsPerMonitor()). The
+        // per-monitor functions take the index of a monitor.
+        size_t
+        GetMonitorCount()
+        {
+            return m_Monitors.size();
+        }
+
+        const std::wstring&
+        GetMonitorID(
+            size_t monitorIndex
+        )
+        {
+            return m_Monitors[monitorIndex].m_MonitorID;
+        }
+
+        // Get a monitor's resize mode: its own (set in the registry), or
+        // if it doesn't have one, GetResizeMode().
+        WallpaperResizeMode
+        GetResizeMode(
+            size_t monitorIndex
+        )
+        {
+            const Monitor& monitor = m_Monitors[monitorIndex];
+            return monitor.m_HasResizeMode ? monitor.m_ResizeMode : m_ResizeMode;
+        }
+
+        // Get the current wallpaper file on a monitor (that we set).
+        const fs::path&
+        GetCurrentWallpaperFile(
+            size_t monitorIndex
+        )
+        {
+            return m_Monitors[monitorIndex].m_CurrentWallpaperFile;
+        }
+
+        // Change the wallpaper image on each monitor: one path for each
+        // monitor, or an empty path to leave it as it is.
+        bool
+        SetMonitorWallpapers(
+            const std::vector<fs::path>& fullPaths
+        );
+
+        // Show the monitors' wallpapers that have been rendered since
+        // SetMonitorWallpapers() (see GetDisplayPath()). Returns true if
+        // there are more still being rendered.
+        bool
+        ShowRenderedWallpapers();
+
+        // Same as RenderAhead(), PrepareWallpaper(), and
+        // GetPreparedWallpaper(), for one monitor.
+        void
+        RenderAhead(
+            size_t monitorIndex,
+            const std::vector<fs::path>& fullPaths
+        );
+
+        void
+        PrepareWallpaper(
+            size_t monitorIndex,
+            const std::vector<fs::path>& candidatePaths
+        );
+
+        CWallpaperCache::PrepareState
+        GetPreparedWallpaper(
+            size_t monitorIndex,
+            fs::path* pFullPath
+        )
+        {
+            return m_Monitors[monitorIndex].m_pRenderCache->GetPrepared(pFullPath);
+        }
+
+        // Get the registry key for a monitor's settings. Other classes
+        // keep their per-monitor settings there too.
+        static
+        CRegistryKey
+        GetMonitorRegistryKey(
+            const std::wstring& monitorID
+        );
+
     private:
 
+        // A monitor (per-monitor wallpapers).
+        struct Monitor
+        {
+            std::wstring m_MonitorID;
+
+            SIZE m_Size;
+
+            // Does it have its own resize mode?
+            bool m_HasResizeMode;
+            WallpaperResizeMode m_ResizeMode;
+
+            fs::path m_CurrentWallpaperFile;
+
+            // The wallpaper file it's showing without its own resize mode,
+            // until it's rendered (see GetDisplayPath()).
+            fs::path m_UnrenderedWallpaperFile;
+
+            // Wallpapers pre-rendered at this monitor's resolution.
+            std::unique_ptr<CWallpaperCache> m_pRenderCache;
+        };
+
+        // Get the backend's monitors, keeping the monitors that are still
+        // there. Adds the indexes of the monitors whose resolution changed
+        // to pResizedMonitors. Returns true if monitors were added,
+        // removed, or reordered.
+        bool
+        UpdateMonitors(
+            std::vector<size_t>* pResizedMonitors
+        );
+
+        // Get the settings to pre-render wallpapers with for a monitor.
+        // Returns false if wallpapers can't be pre-rendered.
+        bool
+        GetRenderSettings(
+            size_t monitorIndex,
+            CWallpaperRenderSettings* pSettings
+        );
+
+        // Get the file to give Windows for a monitor's wallpaper. Doesn't
+        // render it (on the calling thread); see ShowRenderedWallpapers().
+        fs::path
+        GetDisplayPath(
+            size_t monitorIndex,
+            const fs::path& fullPath,
+            WallpaperResizeMode position
+        );
+
+        // Get the name of a monitor's registry key and cache directory.
+        static
+        std::wstring
+        GetMonitorKeyName(
+            const std::wstring& monitorID
+        );
+
+        // Is a file one of our rendered wallpapers (in a CWallpaperCache
+        // directory)?
+        static
+        bool
+        IsRenderedWallpaperFile(
+            const fs::path& fullPath
+        );
+
+        // Get the settings to pre-render wallpapers with, for the backend's
+        // monitor layout. Returns false if wallpapers can't be pre-rendered
+        // (monitors of different sizes).
+        bool
+        GetRenderSettings(
+            CWallpaperRenderSettings* pSettings
+        );
+
+        // Decode an image file with WIC (CWallpaperCache::DecodeFunction).
+        static
+        bool
+        DecodeImageFile(
+            const fs::path& fullPath,
+            std::vector<uint32_t>* pPixels,
+            SIZE* pSize
+        );
+
         // Load wallpaper information from registry.
         void
         LoadFromRegistry();
@@ -116,4 +349,16 @@ class CWallpaperManager
         WallpaperResizeMode m_ResizeMode;
 
         bool m_IsWallpaperEnabled;
+
+        // Connection to the shell's wallpaper.
+        std::unique_ptr<CWallpaperSession> m_pSession;
+
+        // Pre-rendered wallpapers.
+        std::unique_ptr<CWallpaperCache> m_pRenderCache;
+
+        // Per-monitor wallpapers?
+        bool m_IsPerMonitor;
+
+        // Monitors, in the backend's order (per-monitor wallpapers).
+        std::vector<Monitor> m_Monitors;
 };
@@ -0,0 +1,387 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperSession.cpp
+//
+//  CWallpaperSession class.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "WallpaperSession.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::CWallpaperSession
+//
+//////////////////////////////////////////////////////////////////////////////
+
+CWallpaperSession::CWallpaperSession(
+    std::unique_ptr<CWallpaperBackend> pBackend
+) :
+    m_pBackend(std::move(pBackend)),
+    m_Connected(false),
+    m_KnownWallpaperFile(false),
+    m_WallpaperFile(),
+    m_MonitorWallpaperFiles(),
+    m_KnownBackgroundColor(false),
+    m_BackgroundColor(0),
+    m_KnownPosition(false),
+    m_Position(RESIZE_Fill),
+    m_KnownEnabled(false),
+    m_Enabled(false),
+    m_KnownMonitors(false),
+    m_Monitors(),
+    m_LastChangeTime()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::SetWallpaper
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::SetWallpaper(
+    const std::wstring& wallpaperFile,
+    WallpaperResizeMode position,
+    COLORREF backgroundColor
+)
+{
+    return Call([&] () { return ApplyWallpaper(wallpaperFile, position, backgroundColor); });
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::SetMonitorWallpapers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::SetMonitorWallpapers(
+    const std::map<std::wstring, std::wstring>& wallpaperFiles,
+    WallpaperResizeMode position,
+    COLORREF backgroundColor
+)
+{
+    return Call([&] () { return ApplyMonitorWallpapers(wallpaperFiles, position, backgroundColor); });
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::SetSolidColor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::SetSolidColor(
+    COLORREF color
+)
+{
+    return Call([&] () { return ApplySolidColor(color); });
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::GetWallpaper
+//  CWallpaperSession::GetBackgroundColor
+//  CWallpaperSession::GetPosition
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::GetWallpaper(
+    std::wstring* pWallpaperFile
+)
+{
+    if (!m_KnownWallpaperFile)
+    {
+        if (!Call([this] () { return m_pBackend->GetWallpaper(&m_WallpaperFile); }))
+            return false;
+
+        m_KnownWallpaperFile = true;
+    }
+
+    *pWallpaperFile = m_WallpaperFile;
+
+    return true;
+}
+
+bool
+CWallpaperSession::GetBackgroundColor(
+    COLORREF* pColor
+)
+{
+    if (!m_KnownBackgroundColor)
+    {
+        if (!Call([this] () { return m_pBackend->GetBackgroundColor(&m_BackgroundColor); }))
+            return false;
+
+        m_KnownBackgroundColor = true;
+    }
+
+    *pColor = m_BackgroundColor;
+
+    return true;
+}
+
+bool
+CWallpaperSession::GetPosition(
+    WallpaperResizeMode* pPosition
+)
+{
+    if (!m_KnownPosition)
+    {
+        if (!Call([this] () { return m_pBackend->GetPosition(&m_Position); }))
+            return false;
+
+        m_KnownPosition = true;
+    }
+
+    *pPosition = m_Position;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::GetMonitors
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::GetMonitors(
+    std::vector<CWallpaperMonitor>* pMonitors
+)
+{
+    if (!m_KnownMonitors)
+    {
+        if (!Call([this] () { return m_pBackend->GetMonitors(&m_Monitors); }))
+            return false;
+
+        m_KnownMonitors = true;
+    }
+
+    *pMonitors = m_Monitors;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::NotifyChanged
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperSession::NotifyChanged()
+{
+    if (std::chrono::steady_clock::now() - m_LastChangeTime < OwnChangeInterval)
+        return;
+
+    DebugPrint(L"CWallpaperSession::NotifyChanged: Changed by somebody else\n");
+
+    Invalidate();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::Invalidate
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CWallpaperSession::Invalidate()
+{
+    m_KnownWallpaperFile = false;
+    m_MonitorWallpaperFiles.clear();
+    m_KnownBackgroundColor = false;
+    m_KnownPosition = false;
+    m_KnownEnabled = false;
+    m_KnownMonitors = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::Call
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::Call(
+    const std::function<bool ()>& call
+)
+{
+    if (!m_Connected)
+        m_Connected = m_pBackend->Connect();
+
+    if (m_Connected && call())
+        return true;
+
+    // The connection may be dead (e.g. explorer restarted), and whatever
+    // the backend was doing when it failed, we don't know its state now.
+
+    DebugPrint(L"CWallpaperSession::Call: Failed, reconnecting\n");
+
+    Invalidate();
+
+    m_pBackend->Disconnect();
+    m_Connected = m_pBackend->Connect();
+
+    return m_Connected && call();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::ApplyWallpaper
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::ApplyWallpaper(
+    const std::wstring& wallpaperFile,
+    WallpaperResizeMode position,
+    COLORREF backgroundColor
+)
+{
+    // Same order as always: background color, image, position. Each value
+    // is remembered as soon as it's set, so a retry after a failure part
+    // way through starts over (Call() forgets everything).
+
+    if (!m_KnownBackgroundColor || m_BackgroundColor != backgroundColor)
+    {
+        if (!m_pBackend->SetBackgroundColor(backgroundColor))
+            return false;
+
+        m_KnownBackgroundColor = true;
+        m_BackgroundColor = backgroundColor;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    if (!m_KnownEnabled || !m_Enabled || !m_KnownWallpaperFile || m_WallpaperFile != wallpaperFile)
+    {
+        if (!m_pBackend->SetWallpaper(wallpaperFile))
+            return false;
+
+        m_KnownWallpaperFile = true;
+        m_WallpaperFile = wallpaperFile;
+        m_MonitorWallpaperFiles.clear();
+        m_KnownEnabled = true;
+        m_Enabled = true;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    if (!m_KnownPosition || m_Position != position)
+    {
+        if (!m_pBackend->SetPosition(position))
+            return false;
+
+        m_KnownPosition = true;
+        m_Position = position;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::ApplyMonitorWallpapers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::ApplyMonitorWallpapers(
+    const std::map<std::wstring, std::wstring>& wallpaperFiles,
+    WallpaperResizeMode position,
+    COLORREF backgroundColor
+)
+{
+    // Same as ApplyWallpaper(), one monitor at a time.
+
+    if (!m_KnownBackgroundColor || m_BackgroundColor != backgroundColor)
+    {
+        if (!m_pBackend->SetBackgroundColor(backgroundColor))
+            return false;
+
+        m_KnownBackgroundColor = true;
+        m_BackgroundColor = backgroundColor;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    // If the wallpaper is disabled, the first monitor's image enables it
+    // again, but we can't be sure what the others show, so set them all.
+    bool setAll = !m_KnownEnabled || !m_Enabled;
+
+    for (const auto& [monitorID, wallpaperFile] : wallpaperFiles)
+    {
+        auto it = m_MonitorWallpaperFiles.find(monitorID);
+
+        if (setAll || it == m_MonitorWallpaperFiles.end() || it->second != wallpaperFile)
+        {
+            if (!m_pBackend->SetMonitorWallpaper(monitorID, wallpaperFile))
+                return false;
+
+            m_MonitorWallpaperFiles[monitorID] = wallpaperFile;
+            m_KnownWallpaperFile = false;
+            m_KnownEnabled = true;
+            m_Enabled = true;
+            m_LastChangeTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (!m_KnownPosition || m_Position != position)
+    {
+        if (!m_pBackend->SetPosition(position))
+            return false;
+
+        m_KnownPosition = true;
+        m_Position = position;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession::ApplySolidColor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+CWallpaperSession::ApplySolidColor(
+    COLORREF color
+)
+{
+    if (!m_KnownBackgroundColor || m_BackgroundColor != color)
+    {
+        if (!m_pBackend->SetBackgroundColor(color))
+            return false;
+
+        m_KnownBackgroundColor = true;
+        m_BackgroundColor = color;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    if (!m_KnownEnabled || m_Enabled)
+    {
+        if (!m_pBackend->Enable(false))
+            return false;
+
+        m_KnownEnabled = true;
+        m_Enabled = false;
+        m_LastChangeTime = std::chrono::steady_clock::now();
+    }
+
+    return true;
+}
@@ -0,0 +1,296 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperSession.h
+//
+//  CWallpaperBackend and CWallpaperSession classes.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Resize.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperMonitor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// A monitor, as a wallpaper backend sees it.
+struct CWallpaperMonitor
+{
+    // Identifies the monitor to the backend. (For the shell, the
+    // monitor's device path.)
+    std::wstring m_MonitorID;
+
+    // Desktop coordinates.
+    RECT m_Rect;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperBackend
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Whatever actually displays the wallpaper: the shell's IDesktopWallpaper
+// (CDesktopWallpaperBackend), a frame written to a file
+// (CHeadlessWallpaperBackend), or a stand-in (CMockWallpaperBackend).
+// All functions return false if they fail.
+class CWallpaperBackend
+{
+    public:
+
+        virtual
+        ~CWallpaperBackend()
+        {
+        }
+
+        // Connect (again). Called before anything else, and after a
+        // failure in case the connection was lost.
+        virtual
+        bool
+        Connect() = 0;
+
+        virtual
+        void
+        Disconnect() = 0;
+
+        virtual
+        bool
+        GetWallpaper(
+            std::wstring* pWallpaperFile
+        ) = 0;
+
+        // Set the wallpaper on every monitor. Also enables the wallpaper
+        // (see Enable()).
+        virtual
+        bool
+        SetWallpaper(
+            const std::wstring& wallpaperFile
+        ) = 0;
+
+        virtual
+        bool
+        GetMonitorWallpaper(
+            const std::wstring& monitorID,
+            std::wstring* pWallpaperFile
+        ) = 0;
+
+        // Set the wallpaper on one monitor. Also enables the wallpaper
+        // (on every monitor).
+        virtual
+        bool
+        SetMonitorWallpaper(
+            const std::wstring& monitorID,
+            const std::wstring& wallpaperFile
+        ) = 0;
+
+        virtual
+        bool
+        GetBackgroundColor(
+            COLORREF* pColor
+        ) = 0;
+
+        virtual
+        bool
+        SetBackgroundColor(
+            COLORREF color
+        ) = 0;
+
+        virtual
+        bool
+        GetPosition(
+            WallpaperResizeMode* pPosition
+        ) = 0;
+
+        virtual
+        bool
+        SetPosition(
+            WallpaperResizeMode position
+        ) = 0;
+
+        // Show the wallpaper image, or just the background color.
+        virtual
+        bool
+        Enable(
+            bool enable
+        ) = 0;
+
+        // Get the monitors that are part of the desktop.
+        virtual
+        bool
+        GetMonitors(
+            std::vector<CWallpaperMonitor>* pMonitors
+        ) = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CWallpaperSession
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// A long-lived connection to a wallpaper backend.
+//
+// Remembers what it last set (or read), and only makes the calls that
+// change something. With the shell's backend every call is a round trip to
+// explorer, and connecting is an out-of-process CoCreateInstance(), so
+// this takes most of the work out of a wallpaper change.
+//
+// If a call fails, the session reconnects (explorer may have restarted)
+// and tries once more, forgetting everything it knew about the state.
+//
+// Doesn't use any Windows APIs.
+class CWallpaperSession
+{
+    public:
+
+        CWallpaperSession(
+            std::unique_ptr<CWallpaperBackend> pBackend
+        );
+
+        // No copy ctor.
+        CWallpaperSession(const CWallpaperSession&) = delete;
+
+        // No copy assignment.
+        CWallpaperSession& operator=(const CWallpaperSession&) = delete;
+
+        // Show an image file.
+        bool
+        SetWallpaper(
+            const std::wstring& wallpaperFile,
+            WallpaperResizeMode position,
+            COLORREF backgroundColor
+        );
+
+        // Show an image file on each of the given monitors (by monitor ID).
+        // Monitors that aren't given keep the image they had.
+        bool
+        SetMonitorWallpapers(
+            const std::map<std::wstring, std::wstring>& wallpaperFiles,
+            WallpaperResizeMode position,
+            COLORREF backgroundColor
+        );
+
+        // Show a solid color instead of an image.
+        bool
+        SetSolidColor(
+            COLORREF color
+        );
+
+        // Get the wallpaper file. (Asks the backend, unless it's known.)
+        bool
+        GetWallpaper(
+            std::wstring* pWallpaperFile
+        );
+
+        // Get the background color. (Asks the backend, unless it's known.)
+        bool
+        GetBackgroundColor(
+            COLORREF* pColor
+        );
+
+        // Get the position. (Asks the backend, unless it's known.)
+        bool
+        GetPosition(
+            WallpaperResizeMode* pPosition
+        );
+
+        // Get the monitors. (Asks the backend, unless they're known.)
+        bool
+        GetMonitors(
+            std::vector<CWallpaperMonitor>* pMonitors
+        );
+
+        // The monitor layout has changed: forget the monitors.
+        void
+        InvalidateMonitors()
+        {
+            m_KnownMonitors = false;
+        }
+
+        // Something may have changed the wallpaper behind our back (e.g.
+        // the Settings app). Forgets the state, unless we just changed it
+        // ourselves: the shell notifies everybody of our own changes too.
+        void
+        NotifyChanged();
+
+        // Forget the state (and the monitors), so the next change sets
+        // everything.
+        void
+        Invalidate();
+
+    private:
+
+        // Call the backend, connecting first if needed. If the call fails,
+        // reconnect and call it once more.
+        bool
+        Call(
+            const std::function<bool ()>& call
+        );
+
+        // Make the calls for SetWallpaper().
+        bool
+        ApplyWallpaper(
+            const std::wstring& wallpaperFile,
+            WallpaperResizeMode position,
+            COLORREF backgroundColor
+        );
+
+        // Make the calls for SetMonitorWallpapers().
+        bool
+        ApplyMonitorWallpapers(
+            const std::map<std::wstring, std::wstring>& wallpaperFiles,
+            WallpaperResizeMode position,
+            COLORREF backgroundColor
+        );
+
+        // Make the calls for SetSolidColor().
+        bool
+        ApplySolidColor(
+            COLORREF color
+        );
+
+        // Changes notified within this long after one of ours are assumed
+        // to be ours (see NotifyChanged()).
+        static constexpr std::chrono::milliseconds OwnChangeInterval = std::chrono::milliseconds(2000);
+
+        std::unique_ptr<CWallpaperBackend> m_pBackend;
+
+        bool m_Connected;
+
+        // Known backend state. Each value is only valid if its m_Known
+        // flag is set.
+
+        // The same on every monitor.
+        bool m_KnownWallpaperFile;
+        std::wstring m_WallpaperFile;
+
+        // Known for the monitors that are in it.
+        std::map<std::wstring, std::wstring> m_MonitorWallpaperFiles;
+
+        bool m_KnownBackgroundColor;
+        COLORREF m_BackgroundColor;
+
+        bool m_KnownPosition;
+        WallpaperResizeMode m_Position;
+
+        bool m_KnownEnabled;
+        bool m_Enabled;
+
+        bool m_KnownMonitors;
+        std::vector<CWallpaperMonitor> m_Monitors;
+
+        // When we last changed something.
+        std::chrono::steady_clock::time_point m_LastChangeTime;
+};
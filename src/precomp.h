@@ -17,6 +17,12 @@
 
 #pragma once
 
+// The classes that don't use any Windows APIs are also built on other
+// platforms, for the tests and benchmarks (see Portable.h).
+#ifndef _WIN32
+  #include "Portable.h"
+#else
+
 // Requires Windows 10.
 #define WINVER		    0x0A00
 #define _WIN32_WINNT	WINVER
@@ -103,7 +109,20 @@ extern CAppModule _Module;
 #include <string>
 #include <random>
 #include <algorithm>
+#include <execution>
+#include <numeric>
 #include <functional>
+#include <memory>
+#include <deque>
+#include <list>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
 
 namespace fs = std::filesystem;
@@ -150,3 +169,5 @@ namespace fs = std::filesystem;
 //----------------------------------------------------------------------------
 
 #pragma comment(linker, "/manifestdependency:\"type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
+
+#endif // _WIN32
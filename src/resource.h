@@ -9,6 +9,9 @@
 #define ID_COUNTDOWN_TIMER              20
 #define ID_UI_UPDATE_TIMER              21
 #define ID_PLAYLIST_VIEW                22
+#define ID_PREFETCH_TIMER               23
+#define ID_PREPARE_TIMER                24
+#define ID_RENDER_TIMER                 25
 #define IDD_ABOUTBOX                    100
 #define IDD_OPTIONS                     101
 #define IDD_PLAYLIST_MANAGER            102
@@ -67,12 +70,20 @@
 #define ID_PLAYLIST_RECENT_3            3107
 #define ID_PLAYLIST_RECENT_4            3108
 #define ID_PLAYLIST_RECENT_5            3109
+#define ID_PLAYLIST_SORT_NAME           3110
+#define ID_PLAYLIST_SORT_PATH           3111
+#define ID_PLAYLIST_SORT_DATE           3112
+#define ID_PLAYLIST_SORT_SIZE           3113
+#define ID_PLAYLIST_SORT_DIMENSIONS     3114
+#define ID_PLAYLIST_STOP_ADDING         3115
 #define ID_WALLPAPER_CHANGE             3200
 #define ID_WALLPAPER_NEXT               3201
 #define ID_WALLPAPER_PREV               3202
 #define ID_WALLPAPER_RANDOM             3203
 #define ID_WALLPAPER_SAFE               3204
 #define ID_WALLPAPER_PAUSE              3205
+#define ID_VIEW_ZOOM_IN                 3300
+#define ID_VIEW_ZOOM_OUT                3301
 
 // Next default values for new objects
 // 
@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Bench.h
+//
+//  Benchmark registration and timing.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Benchmarks are functions defined with BENCHMARK(). WallpaperChangerBench
+// runs them all (or the ones named on the command line) and they print
+// their own results. With --quick, each one runs at its smallest size, just
+// to check it still works (that's what ctest runs).
+
+// Define a benchmark.
+#define BENCHMARK(name)                                                     \
+    static void Bench_##name();                                             \
+    static CBenchRegistration s_Register_##name(#name, Bench_##name);       \
+    static void Bench_##name()
+
+// Adds a benchmark to the list of benchmarks.
+class CBenchRegistration
+{
+    public:
+
+        using BenchFunction = void (*)();
+
+        struct CBenchCase
+        {
+            const char* m_Name;
+            BenchFunction m_Function;
+        };
+
+        CBenchRegistration(
+            const char* name,
+            BenchFunction function
+        )
+        {
+            GetBenchCases().push_back({ name, function });
+        }
+
+        static
+        std::vector<CBenchCase>&
+        GetBenchCases()
+        {
+            static std::vector<CBenchCase> benchCases;
+            return benchCases;
+        }
+};
+
+// Was --quick given?
+bool
+IsQuickRun();
+
+// Pick the sizes to run: just the first with --quick, all of them otherwise.
+template <typename T>
+std::vector<T>
+GetBenchSizes(
+    std::initializer_list<T> sizes
+)
+{
+    if (IsQuickRun())
+        return { *sizes.begin() };
+
+    return sizes;
+}
+
+// Pick a repeat count: one with --quick.
+size_t
+GetBenchRepeatCount(
+    size_t count
+);
+
+// Get an empty directory for a benchmark's files (in the temp directory).
+fs::path
+GetBenchDirectory(
+    const char* name
+);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CStopwatch
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Measures elapsed time.
+class CStopwatch
+{
+    public:
+
+        CStopwatch()
+            :
+            m_Start(std::chrono::steady_clock::now())
+        {
+        }
+
+        void
+        Restart()
+        {
+            m_Start = std::chrono::steady_clock::now();
+        }
+
+        // Get the elapsed time in milliseconds.
+        double
+        GetElapsedMs() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+        }
+
+    private:
+
+        std::chrono::steady_clock::time_point m_Start;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CLatencyStats
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Collects timings and reports their distribution.
+class CLatencyStats
+{
+    public:
+
+        CLatencyStats()
+            :
+            m_Samples()
+        {
+        }
+
+        void
+        Add(
+            double ms
+        )
+        {
+            m_Samples.push_back(ms);
+        }
+
+        size_t
+        size() const
+        {
+            return m_Samples.size();
+        }
+
+        // Get a percentile (0...100), in milliseconds.
+        double
+        GetPercentile(
+            double percentile
+        ) const;
+
+        double
+        GetMean() const;
+
+        // Print a line: name, count, mean, p50, p99, and max.
+        void
+        Report(
+            const char* name
+        ) const;
+
+    private:
+
+        std::vector<double> m_Samples;
+};
@@ -0,0 +1,164 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  BenchMain.cpp
+//
+//  Runs the benchmarks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include <cmath>
+
+static bool s_IsQuickRun = false;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  IsQuickRun
+//  GetBenchRepeatCount
+//
+//////////////////////////////////////////////////////////////////////////////
+
+bool
+IsQuickRun()
+{
+    return s_IsQuickRun;
+}
+
+size_t
+GetBenchRepeatCount(
+    size_t count
+)
+{
+    return s_IsQuickRun ? 1 : count;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  GetBenchDirectory
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+GetBenchDirectory(
+    const char* name
+)
+{
+    fs::path directory = fs::temp_directory_path() / "WallpaperChangerBench" / name;
+
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+    fs::create_directories(directory);
+
+    return directory;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CLatencyStats::GetPercentile
+//
+//////////////////////////////////////////////////////////////////////////////
+
+double
+CLatencyStats::GetPercentile(
+    double percentile
+) const
+{
+    if (m_Samples.empty())
+        return 0.0;
+
+    // Nearest rank.
+    std::vector<double> sorted(m_Samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    size_t rank = (size_t) std::ceil(percentile / 100.0 * (double) sorted.size());
+    return sorted[std::clamp(rank, (size_t) 1, sorted.size()) - 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CLatencyStats::GetMean
+//
+//////////////////////////////////////////////////////////////////////////////
+
+double
+CLatencyStats::GetMean() const
+{
+    if (m_Samples.empty())
+        return 0.0;
+
+    return std::accumulate(m_Samples.begin(), m_Samples.end(), 0.0) / (double) m_Samples.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CLatencyStats::Report
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void
+CLatencyStats::Report(
+    const char* name
+) const
+{
+    printf("  %-36s n=%-6zu mean=%10.3f ms  p50=%10.3f ms  p99=%10.3f ms  max=%10.3f ms\n",
+           name,
+           m_Samples.size(),
+           GetMean(),
+           GetPercentile(50.0),
+           GetPercentile(99.0),
+           GetPercentile(100.0));
+    fflush(stdout);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  main
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Usage: WallpaperChangerBench [--quick] [benchmark name...]
+int main(int argc, char* argv[])
+{
+    std::vector<const char*> names;
+
+    for (int idx = 1; idx < argc; idx++)
+    {
+        if (strcmp(argv[idx], "--quick") == 0)
+            s_IsQuickRun = true;
+        else
+            names.push_back(argv[idx]);
+    }
+
+    size_t benchCount = 0;
+
+    for (const CBenchRegistration::CBenchCase& benchCase : CBenchRegistration::GetBenchCases())
+    {
+        if (!names.empty() &&
+            std::none_of(names.begin(), names.end(), [&benchCase] (const char* name) { return strcmp(name, benchCase.m_Name) == 0; }))
+        {
+            continue;
+        }
+
+        printf("%s\n", benchCase.m_Name);
+        fflush(stdout);
+
+        benchCase.m_Function();
+
+        benchCount++;
+    }
+
+    printf("%zu benchmarks\n", benchCount);
+
+    return benchCount != 0 ? 0 : 1;
+}
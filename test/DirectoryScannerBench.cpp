@@ -0,0 +1,171 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryScannerBench.cpp
+//
+//  CDirectoryScanner benchmarks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include <fstream>
+
+#include "DirectoryScanner.h"
+
+static
+bool
+IsImageFile(
+    const fs::path& path
+)
+{
+    fs::path extension = path.extension();
+    return extension == ".jpg" || extension == ".png";
+}
+
+// Make a tree of empty files, 100 to a directory, three levels deep (like
+// photos sorted by year, month, and day). One file in ten isn't an image.
+// Returns the number of images.
+static
+size_t
+MakeFileTree(
+    const fs::path& rootPath,
+    size_t fileCount
+)
+{
+    const size_t filesPerDirectory = 100;
+
+    size_t imageCount = 0;
+
+    for (size_t dirNum = 0; dirNum * filesPerDirectory < fileCount; dirNum++)
+    {
+        fs::path dirPath = rootPath /
+                           ("year" + std::to_string(dirNum / 100)) /
+                           ("month" + std::to_string(dirNum / 10 % 10)) /
+                           ("day" + std::to_string(dirNum % 10));
+
+        fs::create_directories(dirPath);
+
+        for (size_t fileNum = 0; fileNum < filesPerDirectory && dirNum * filesPerDirectory + fileNum < fileCount; fileNum++)
+        {
+            bool isImage = (fileNum % 10 != 0);
+            std::ofstream(dirPath / ((isImage ? "image" : "notes") + std::to_string(fileNum) + (isImage ? ".jpg" : ".txt")));
+
+            if (isImage)
+                imageCount++;
+        }
+    }
+
+    return imageCount;
+}
+
+// Find the images in a tree with CDirectoryScanner, on 1, 2, 4... threads
+// up to the number of processors, in both orders, against a plain
+// sequential walk. The tree is in the file system cache (the first walk
+// isn't timed), so this is the CPU side of adding a folder.
+BENCHMARK(DirectoryScan)
+{
+    unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+        threadCounts.push_back(threadCount);
+
+    threadCounts.push_back(maxThreads);
+
+    for (size_t fileCount: GetBenchSizes<size_t>({ 2000, 50000, 500000 }))
+    {
+        fs::path rootPath = GetBenchDirectory("DirectoryScan");
+
+        CStopwatch makeStopwatch;
+        size_t imageCount = MakeFileTree(rootPath, fileCount);
+
+        printf(" %zu files, %zu images (made in %.1f s)\n", fileCount, imageCount, makeStopwatch.GetElapsedMs() / 1000.0);
+
+        double sequentialMs;
+
+        // Sequential.
+        {
+            CLatencyStats stats;
+
+            for (size_t repeat = 0; repeat <= GetBenchRepeatCount(3); repeat++)
+            {
+                CStopwatch stopwatch;
+                size_t foundCount = 0;
+
+                for (const fs::directory_entry& entry: fs::recursive_directory_iterator(rootPath))
+                {
+                    if (entry.is_regular_file() && IsImageFile(entry.path()))
+                        foundCount++;
+                }
+
+                if (repeat != 0)
+                    stats.Add(stopwatch.GetElapsedMs());
+
+                if (foundCount != imageCount)
+                    printf("  Sequential walk found %zu images!\n", foundCount);
+            }
+
+            sequentialMs = stats.GetPercentile(50.0);
+            stats.Report("sequential");
+        }
+
+        // CDirectoryScanner.
+        for (bool deterministicOrder: { false, true })
+        {
+            for (unsigned threadCount: threadCounts)
+            {
+                CLatencyStats stats;
+                CLatencyStats firstBatchStats;
+
+                for (size_t repeat = 0; repeat < GetBenchRepeatCount(3); repeat++)
+                {
+                    CDirectoryScanner scanner(threadCount, deterministicOrder);
+                    scanner.SetFileFilter(IsImageFile);
+
+                    CStopwatch stopwatch;
+                    size_t foundCount = 0;
+
+                    scanner.Scan(rootPath,
+                                 true,
+                                 /*LAMBDA*/ [&] (CDirectoryScanner::FileBatch& batch)
+                                 {
+                                     if (foundCount == 0)
+                                         firstBatchStats.Add(stopwatch.GetElapsedMs());
+
+                                     foundCount += batch.size();
+                                     return true;
+                                 });
+
+                    stats.Add(stopwatch.GetElapsedMs());
+
+                    if (foundCount != imageCount)
+                        printf("  Scanner found %zu images!\n", foundCount);
+                }
+
+                char name[64];
+                snprintf(name,
+                         sizeof(name),
+                         "%s, threads=%u (%.2fx)",
+                         deterministicOrder ? "in order" : "any order",
+                         threadCount,
+                         sequentialMs / stats.GetPercentile(50.0));
+                stats.Report(name);
+
+                firstBatchStats.Report("  first batch");
+            }
+        }
+
+        std::error_code ec;
+        fs::remove_all(rootPath, ec);
+    }
+}
@@ -0,0 +1,316 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryScannerTests.cpp
+//
+//  CDirectoryScanner and CDirectoryImport tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+
+#include "DirectoryImport.h"
+
+// Make a tree of empty files: some in the root, and some in each of
+// five directories, three subdirectories each. One file in four isn't an
+// image, and one subdirectory of each is empty.
+static
+void
+MakeFileTree(
+    const fs::path& rootPath
+)
+{
+    auto MakeFiles = /*LAMBDA*/ [] (const fs::path& dirPath, size_t fileCount)
+    {
+        fs::create_directories(dirPath);
+
+        // Not made in name order, so the order found isn't sorted.
+        for (size_t fileNum = fileCount; fileNum-- > 0;)
+            std::ofstream(dirPath / ("file" + std::to_string(fileNum) + ((fileNum % 4 == 0) ? ".txt" : ".jpg")));
+    };
+
+    MakeFiles(rootPath, 12);
+
+    for (int dirNum = 4; dirNum >= 0; dirNum--)
+    {
+        fs::path dirPath = rootPath / ("dir" + std::to_string(dirNum));
+        MakeFiles(dirPath, 10 + dirNum);
+
+        for (int subdirNum = 0; subdirNum < 3; subdirNum++)
+            MakeFiles(dirPath / ("sub" + std::to_string(subdirNum)), (subdirNum == 1) ? 0 : 25);
+    }
+}
+
+// Find the images in a tree the simple way, in the order the scanner's
+// deterministic mode promises: a directory's files sorted by name, then
+// each of its subdirectories, sorted by name.
+static
+void
+SortedWalk(
+    const fs::path& dirPath,
+    bool recurseIntoSubdirs,
+    std::vector<fs::path>& files
+)
+{
+    std::vector<fs::path> dirFiles;
+    std::vector<fs::path> subdirs;
+
+    for (const fs::directory_entry& entry: fs::directory_iterator(dirPath))
+    {
+        if (entry.is_directory())
+            subdirs.push_back(entry.path());
+        else if (IsValidImageFile(entry.path()))
+            dirFiles.push_back(entry.path());
+    }
+
+    std::sort(dirFiles.begin(), dirFiles.end());
+    std::sort(subdirs.begin(), subdirs.end());
+
+    files.insert(files.end(), dirFiles.begin(), dirFiles.end());
+
+    if (recurseIntoSubdirs)
+    {
+        for (const fs::path& subdir: subdirs)
+            SortedWalk(subdir, true, files);
+    }
+}
+
+// Scan a tree, and get the files in the order they were delivered.
+static
+std::vector<fs::path>
+ScanTree(
+    CDirectoryScanner& scanner,
+    const fs::path& rootPath,
+    bool recurseIntoSubdirs,
+    size_t* pBatchCount = nullptr
+)
+{
+    std::vector<fs::path> files;
+    size_t batchCount = 0;
+
+    scanner.SetFileFilter([] (const fs::path& filePath) { return IsValidImageFile(filePath); });
+
+    scanner.Scan(rootPath,
+                 recurseIntoSubdirs,
+                 /*LAMBDA*/ [&] (CDirectoryScanner::FileBatch& batch)
+                 {
+                     files.insert(files.end(), batch.begin(), batch.end());
+                     batchCount++;
+                     return true;
+                 });
+
+    if (pBatchCount)
+        *pBatchCount = batchCount;
+
+    return files;
+}
+
+TEST(DirectoryScanner_DeterministicOrderMatchesSortedWalk)
+{
+    fs::path rootPath = GetTestDirectory("DirectoryScanner_DeterministicOrderMatchesSortedWalk");
+    MakeFileTree(rootPath);
+
+    std::vector<fs::path> expected;
+    SortedWalk(rootPath, true, expected);
+    REQUIRE(expected.size() == 9 + (7 + 8 + 9 + 9 + 10) + 5 * 2 * 18);
+
+    for (unsigned concurrency: { 1U, 3U, 8U })
+    {
+        CDirectoryScanner scanner(concurrency, true);
+
+        // One batch per directory with images.
+        size_t batchCount;
+        CHECK(ScanTree(scanner, rootPath, true, &batchCount) == expected);
+        CHECK(batchCount == 1 + 5 * 3);
+    }
+
+    // Without subdirectories, just the root's files.
+    std::vector<fs::path> rootFiles;
+    SortedWalk(rootPath, false, rootFiles);
+    REQUIRE(rootFiles.size() == 9);
+
+    CDirectoryScanner scanner(4, true);
+    CHECK(ScanTree(scanner, rootPath, false) == rootFiles);
+}
+
+TEST(DirectoryScanner_ConcurrencyFindsSameFiles)
+{
+    fs::path rootPath = GetTestDirectory("DirectoryScanner_ConcurrencyFindsSameFiles");
+    MakeFileTree(rootPath);
+
+    std::vector<fs::path> expected;
+    SortedWalk(rootPath, true, expected);
+    std::sort(expected.begin(), expected.end());
+
+    for (unsigned concurrency: { 1U, 2U, 8U })
+    {
+        CDirectoryScanner scanner(concurrency, false);
+        scanner.SetBatchSize(7);
+
+        std::vector<fs::path> files;
+        size_t largestBatch = 0;
+
+        scanner.SetFileFilter([] (const fs::path& filePath) { return IsValidImageFile(filePath); });
+
+        CHECK(scanner.Scan(rootPath,
+                           true,
+                           /*LAMBDA*/ [&] (CDirectoryScanner::FileBatch& batch)
+                           {
+                               files.insert(files.end(), batch.begin(), batch.end());
+                               largestBatch = std::max(largestBatch, batch.size());
+                               return true;
+                           }));
+
+        // Each file once, whatever the order.
+        std::sort(files.begin(), files.end());
+        CHECK(files == expected);
+        CHECK(largestBatch <= 7);
+    }
+}
+
+TEST(DirectoryScanner_CancelStopsEarly)
+{
+    fs::path rootPath = GetTestDirectory("DirectoryScanner_CancelStopsEarly");
+    MakeFileTree(rootPath);
+
+    std::vector<fs::path> expected;
+    SortedWalk(rootPath, true, expected);
+
+    // Returning false from the callback.
+    {
+        CDirectoryScanner scanner(4, true);
+        size_t deliveredCount = 0;
+        size_t batchCount = 0;
+
+        CHECK(!scanner.Scan(rootPath,
+                            true,
+                            /*LAMBDA*/ [&] (CDirectoryScanner::FileBatch& batch)
+                            {
+                                deliveredCount += batch.size();
+                                return ++batchCount < 2;
+                            }));
+
+        CHECK(batchCount == 2);
+        CHECK(deliveredCount < expected.size());
+        CHECK(scanner.IsCancelled());
+    }
+
+    // Cancel() from the callback.
+    {
+        CDirectoryScanner scanner(4, false);
+        scanner.SetBatchSize(5);
+        size_t batchCount = 0;
+
+        CHECK(!scanner.Scan(rootPath,
+                            true,
+                            /*LAMBDA*/ [&] (CDirectoryScanner::FileBatch& /*batch*/)
+                            {
+                                if (++batchCount == 3)
+                                    scanner.Cancel();
+                                return true;
+                            }));
+
+        CHECK(batchCount == 3);
+    }
+
+    // Cancel() before the scan starts (e.g. from another thread).
+    {
+        CDirectoryScanner scanner(4, true);
+        scanner.Cancel();
+
+        size_t batchCount;
+        CHECK(ScanTree(scanner, rootPath, true, &batchCount).empty());
+        CHECK(batchCount == 0);
+    }
+}
+
+// Collect an import's files until it has finished.
+static
+bool
+WaitForImport(
+    CDirectoryImport& import,
+    std::vector<fs::path>& files
+)
+{
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+    while (import.TakeResults(files))
+    {
+        if (std::chrono::steady_clock::now() > timeout)
+            return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+TEST(DirectoryImport_FindsFilesInBackground)
+{
+    fs::path rootPath = GetTestDirectory("DirectoryImport_FindsFilesInBackground");
+    MakeFileTree(rootPath);
+
+    std::atomic<size_t> notifyCount(0);
+    CDirectoryImport import([&notifyCount] () { notifyCount++; }, 4);
+
+    CHECK(!import.IsBusy());
+
+    // Directories are scanned in the order they're added.
+    import.Add(rootPath / "dir3", true);
+    import.Add(rootPath, false);
+    import.Add(rootPath / "dir0", true);
+
+    std::vector<fs::path> expected;
+    SortedWalk(rootPath / "dir3", true, expected);
+    SortedWalk(rootPath, false, expected);
+    SortedWalk(rootPath / "dir0", true, expected);
+
+    std::vector<fs::path> files;
+    REQUIRE(WaitForImport(import, files));
+
+    CHECK(files == expected);
+    CHECK(!import.IsBusy());
+    CHECK(notifyCount >= 1);
+}
+
+TEST(DirectoryImport_CancelDropsFiles)
+{
+    fs::path rootPath = GetTestDirectory("DirectoryImport_CancelDropsFiles");
+    MakeFileTree(rootPath);
+
+    CDirectoryImport import([] () {}, 4);
+
+    import.Add(rootPath, true);
+    import.Add(rootPath / "dir1", true);
+    import.Cancel();
+
+    // Nothing is delivered after Cancel(), even if the scan was under way.
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+    while (import.IsBusy() && std::chrono::steady_clock::now() < timeout)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<fs::path> files;
+    CHECK(!import.TakeResults(files));
+    CHECK(files.empty());
+
+    // And it can be used again.
+    import.Add(rootPath / "dir2", true);
+
+    std::vector<fs::path> expected;
+    SortedWalk(rootPath / "dir2", true, expected);
+
+    REQUIRE(WaitForImport(import, files));
+    CHECK(files == expected);
+}
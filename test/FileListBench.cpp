@@ -0,0 +1,261 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileListBench.cpp
+//
+//  CFileList benchmarks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include <fstream>
+#include <malloc.h>
+
+#include "FileList.h"
+
+// A file list the way it was before the hash index: each file a separate
+// record holding its full path and display name, found by comparing
+// paths all the way down the list. Loading N files is O(N^2).
+class CLinearFileList
+{
+    public:
+
+        struct FileInfo
+        {
+            fs::path m_FullPath;
+            std::wstring m_DisplayName;
+        };
+
+        bool
+        Add(
+            const fs::path& path
+        )
+        {
+            if (!fs::is_regular_file(path))
+                return false;
+
+            for (const std::unique_ptr<FileInfo>& pFile: m_Files)
+            {
+                if (pFile->m_FullPath == path)
+                    return false;
+            }
+
+            m_Files.push_back(std::unique_ptr<FileInfo>(new FileInfo{ path, path.stem().wstring() }));
+            return true;
+        }
+
+        size_t
+        size() const
+        {
+            return m_Files.size();
+        }
+
+    private:
+
+        std::vector<std::unique_ptr<FileInfo>> m_Files;
+};
+
+// A file record the way it was before the string arena: separately
+// allocated, with heap strings for the full path and the display name
+// (on Windows, fs::path holds a wstring).
+struct HeapFileInfo
+{
+    std::wstring m_FullPath;
+    std::wstring m_DisplayName;
+};
+
+// Get the number of bytes allocated from the heap, including the
+// allocator's overhead and the blocks big enough to be mapped on their own.
+static
+size_t
+GetHeapUsage()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Make a tree of empty image files, 100 to a directory, three levels
+// deep (like photos sorted by year, month, and day). Returns their paths
+// in the order a playlist would have them.
+static
+std::vector<fs::path>
+MakeImageFiles(
+    const fs::path& rootPath,
+    size_t fileCount
+)
+{
+    const size_t filesPerDirectory = 100;
+
+    std::vector<fs::path> paths;
+    paths.reserve(fileCount);
+
+    for (size_t dirNum = 0; paths.size() < fileCount; dirNum++)
+    {
+        fs::path dirPath = rootPath /
+                           ("year" + std::to_string(dirNum / 100)) /
+                           ("month" + std::to_string(dirNum / 10 % 10)) /
+                           ("day" + std::to_string(dirNum % 10));
+
+        fs::create_directories(dirPath);
+
+        for (size_t fileNum = 0; fileNum < filesPerDirectory && paths.size() < fileCount; fileNum++)
+        {
+            paths.push_back(dirPath / ("IMG_" + std::to_string(dirNum * filesPerDirectory + fileNum) + ".jpg"));
+            std::ofstream(paths.back());
+        }
+    }
+
+    return paths;
+}
+
+// Loading a playlist: each file is added by path (what CPlayList::Load()
+// does with each line when there's no index), so every add is a stat and
+// a duplicate check. Then the same files again (all duplicates), and
+// lookups by path. The stat alone is timed too, to show what's left for
+// the list.
+//
+// The linear list (before the hash index) is only run up to 10k files;
+// at 100k it would take minutes.
+//
+// Also reports the memory per file, as the heap sees it, against
+// separately allocated records with heap strings (before the string
+// arena). Strings are wchar_t in both, which is 4 bytes here and 2 on
+// Windows.
+BENCHMARK(FileListLoad)
+{
+    const size_t maxLinearFileCount = 10000;
+
+    for (size_t fileCount: GetBenchSizes<size_t>({ 1000, 10000, 100000, 1000000 }))
+    {
+        fs::path rootPath = GetBenchDirectory("FileListLoad");
+
+        CStopwatch makeStopwatch;
+        std::vector<fs::path> paths = MakeImageFiles(rootPath, fileCount);
+
+        printf(" %zu files (made in %.1f s)\n", fileCount, makeStopwatch.GetElapsedMs() / 1000.0);
+
+        CLatencyStats statStats;
+        CLatencyStats loadStats;
+        CLatencyStats reloadStats;
+        CLatencyStats lookupStats;
+
+        for (size_t repeat = 0; repeat <= GetBenchRepeatCount(3); repeat++)
+        {
+            CStopwatch stopwatch;
+            size_t foundCount = 0;
+
+            for (const fs::path& path: paths)
+            {
+                if (fs::is_regular_file(path))
+                    foundCount++;
+            }
+
+            // The first pass warms the file system cache.
+            if (repeat == 0)
+                continue;
+
+            statStats.Add(stopwatch.GetElapsedMs());
+
+            CFileList list;
+
+            stopwatch.Restart();
+            for (const fs::path& path: paths)
+                list.Add(path);
+            loadStats.Add(stopwatch.GetElapsedMs());
+
+            stopwatch.Restart();
+            for (const fs::path& path: paths)
+                list.Add(path);
+            reloadStats.Add(stopwatch.GetElapsedMs());
+
+            stopwatch.Restart();
+            for (const fs::path& path: paths)
+            {
+                if (list.Contains(path))
+                    foundCount++;
+            }
+            lookupStats.Add(stopwatch.GetElapsedMs());
+
+            if (list.size() != fileCount || foundCount != 2 * fileCount)
+                printf("  Loaded %zu files, found %zu!\n", list.size(), foundCount - fileCount);
+        }
+
+        statStats.Report("stat only");
+        loadStats.Report("load");
+        reloadStats.Report("load again (all duplicates)");
+        lookupStats.Report("lookup");
+
+        printf("  %.0f ns per file to load, %.0f ns of it the stat\n",
+               loadStats.GetPercentile(50.0) * 1e6 / (double) fileCount,
+               statStats.GetPercentile(50.0) * 1e6 / (double) fileCount);
+
+        // Memory per file.
+        {
+            size_t heapBefore = GetHeapUsage();
+
+            CFileList list;
+            for (const fs::path& path: paths)
+                list.Add(path);
+
+            double listBytes = (double) (GetHeapUsage() - heapBefore) / (double) fileCount;
+            double reportedBytes = (double) list.GetMemoryUsage() / (double) fileCount;
+
+            heapBefore = GetHeapUsage();
+
+            std::vector<std::unique_ptr<HeapFileInfo>> heapFiles;
+            for (const fs::path& path: paths)
+                heapFiles.push_back(std::unique_ptr<HeapFileInfo>(new HeapFileInfo{ path.wstring(), path.stem().wstring() }));
+
+            double heapFilesBytes = (double) (GetHeapUsage() - heapBefore) / (double) fileCount;
+
+            printf("  %.0f bytes per file (GetMemoryUsage() says %.0f), %.0f with heap records (%.1fx)\n",
+                   listBytes,
+                   reportedBytes,
+                   heapFilesBytes,
+                   heapFilesBytes / listBytes);
+        }
+
+        // Before the hash index.
+        if (fileCount <= maxLinearFileCount)
+        {
+            CLatencyStats linearStats;
+
+            for (size_t repeat = 0; repeat < GetBenchRepeatCount(3); repeat++)
+            {
+                CLinearFileList list;
+
+                CStopwatch stopwatch;
+                for (const fs::path& path: paths)
+                    list.Add(path);
+                linearStats.Add(stopwatch.GetElapsedMs());
+
+                if (list.size() != fileCount)
+                    printf("  Linear list loaded %zu files!\n", list.size());
+            }
+
+            char name[64];
+            snprintf(name,
+                     sizeof(name),
+                     "load, linear list (%.1fx slower)",
+                     linearStats.GetPercentile(50.0) / loadStats.GetPercentile(50.0));
+            linearStats.Report(name);
+        }
+        else
+        {
+            printf("  load, linear list: skipped\n");
+        }
+
+        std::error_code ec;
+        fs::remove_all(rootPath, ec);
+    }
+}
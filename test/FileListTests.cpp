@@ -0,0 +1,375 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  FileListTests.cpp
+//
+//  CFileList tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+#include <set>
+
+#include "FileList.h"
+
+// Make empty image files, spread over a few directories.
+static
+std::vector<fs::path>
+MakeImageFiles(
+    const fs::path& directory,
+    size_t fileCount
+)
+{
+    std::vector<fs::path> paths;
+
+    for (size_t fileNum = 0; fileNum < fileCount; fileNum++)
+    {
+        fs::path dirPath = directory / ("dir" + std::to_string(fileNum % 7));
+        fs::create_directories(dirPath);
+
+        paths.push_back(dirPath / ("img" + std::to_string(fileNum) + ".jpg"));
+        std::ofstream(paths.back());
+    }
+
+    return paths;
+}
+
+// Add a file (or directory), and tell if anything was added. (Comparing
+// Add()'s result with end() in one expression is unsafe: end() may be
+// evaluated first, and Add() can move the list.)
+static
+bool
+AddFile(
+    CFileList& list,
+    const fs::path& path
+)
+{
+    CFileList::iterator it = list.Add(path);
+    return it != list.end();
+}
+
+// Change the case of a path (the list doesn't care).
+static
+fs::path
+ToUpperCase(
+    const fs::path& path
+)
+{
+    std::wstring upperPath = path.wstring();
+    for (WCHAR& ch: upperPath)
+        ch = towupper(ch);
+
+    return fs::path(upperPath);
+}
+
+TEST(FileList_AddAndLookup)
+{
+    fs::path directory = GetTestDirectory("FileList_AddAndLookup");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 3);
+
+    CFileList list;
+
+    for (const fs::path& path: paths)
+        CHECK(AddFile(list, path));
+
+    CHECK(list.size() == 3);
+
+    // Duplicates aren't added.
+    CHECK(!AddFile(list, paths[1]));
+    CHECK(list.size() == 3);
+
+    // Neither are missing files.
+    CHECK(!AddFile(list, directory / "missing.jpg"));
+    CHECK(list.size() == 3);
+
+    for (size_t index = 0; index < paths.size(); index++)
+    {
+        FileHandle hFile = list.Lookup(paths[index]);
+        REQUIRE(hFile != InvalidFileHandle);
+        CHECK(list.GetPosition(hFile) == index);
+        CHECK(list.GetFullPath(hFile) == paths[index]);
+        CHECK(list.GetDisplayName(hFile) == paths[index].stem().wstring());
+
+        // Case and separators don't matter.
+        CHECK(list.Lookup(ToUpperCase(paths[index])) == hFile);
+
+        std::wstring backslashPath = paths[index].wstring();
+        std::replace(backslashPath.begin(), backslashPath.end(), L'/', L'\\');
+        CHECK(list.Lookup(fs::path(backslashPath)) == hFile);
+    }
+
+    CHECK(!list.Contains(directory / "dir0" / "img1.jpg"));
+    CHECK(!list.Contains(directory / "other" / "img0.jpg"));
+
+    // Removing by another case of the path.
+    CHECK(list.Remove(ToUpperCase(paths[0])));
+    CHECK(!list.Contains(paths[0]));
+    CHECK(list.Contains(paths[1]));
+    CHECK(list.size() == 2);
+
+    // A directory adds the images in it, but not the files it already has.
+    std::ofstream(directory / "dir1" / "notes.txt");
+    CHECK(!AddFile(list, directory / "dir1"));
+
+    CHECK(AddFile(list, directory / "dir0"));
+    CHECK(list.Contains(paths[0]));
+    CHECK(!list.Contains(directory / "dir1" / "notes.txt"));
+}
+
+// Removing a file shifts the later files in its probe sequence back into
+// the hole. Check that every file is still found after each removal, with
+// enough files that a good many of them share probe sequences.
+TEST(FileList_RemoveKeepsProbeChains)
+{
+    fs::path directory = GetTestDirectory("FileList_RemoveKeepsProbeChains");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 3000);
+
+    CFileList list;
+    std::set<size_t> inList;
+
+    for (size_t index = 0; index < paths.size(); index++)
+    {
+        list.Add(paths[index]);
+        inList.insert(index);
+    }
+
+    std::mt19937 random(1);
+
+    for (int round = 0; round < 40; round++)
+    {
+        // Remove a batch of files one at a time, and add a few back.
+        for (int change = 0; change < 100; change++)
+        {
+            size_t index = random() % paths.size();
+
+            if (inList.count(index) != 0 && change % 4 != 0)
+            {
+                CHECK(list.Remove(paths[index]));
+                inList.erase(index);
+            }
+            else if (inList.count(index) == 0)
+            {
+                CHECK(AddFile(list, paths[index]));
+                inList.insert(index);
+            }
+        }
+
+        // Every so often, remove a batch in one go.
+        if (round % 10 == 9)
+        {
+            std::vector<FileHandle> files;
+            for (size_t index = round; index < paths.size(); index += 37)
+            {
+                if (inList.erase(index) != 0)
+                    files.push_back(list.Lookup(paths[index]));
+            }
+
+            CHECK(list.RemoveMany(files) == files.size());
+        }
+
+        REQUIRE(list.size() == inList.size());
+
+        for (size_t index = 0; index < paths.size(); index++)
+            REQUIRE(list.Contains(paths[index]) == (inList.count(index) != 0));
+    }
+}
+
+TEST(FileList_HandleReuse)
+{
+    fs::path directory = GetTestDirectory("FileList_HandleReuse");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 3);
+
+    CFileList list;
+    list.Add(paths[0]);
+    list.Add(paths[1]);
+
+    FileHandle hFirst = list.Lookup(paths[0]);
+    FileHandle hSecond = list.Lookup(paths[1]);
+    CHECK(hFirst != hSecond);
+
+    list.SetCurrentFile(hFirst);
+    CHECK(list.GetCurrentFile() == hFirst);
+
+    // A removed file's handle is invalid, and isn't current any more.
+    CHECK(list.Remove(hFirst));
+    CHECK(!list.IsValid(hFirst));
+    CHECK(list.GetCurrentFile() == InvalidFileHandle);
+    CHECK(list.GetPosition(hSecond) == 0);
+
+    // The next file gets the handle, and a later add stamp.
+    uint32_t addCount = list.GetAddCount();
+
+    list.Add(paths[2]);
+    CHECK(list.Lookup(paths[2]) == hFirst);
+    CHECK(list.GetFullPath(hFirst) == paths[2]);
+    CHECK(list.GetAddStamp(hFirst) == addCount);
+    CHECK(list.GetAddStamp(hSecond) < addCount);
+    CHECK(list.GetHandleLimit() == 2);
+
+    CHECK(!list.Contains(paths[0]));
+
+    // Adding the first file again gets a new handle.
+    list.Add(paths[0]);
+    CHECK(list.Lookup(paths[0]) != hFirst);
+    CHECK(list.Lookup(paths[0]) != hSecond);
+    CHECK(list.size() == 3);
+}
+
+// Get the display names of the files in a list, in list order.
+static
+std::vector<std::wstring>
+GetDisplayNames(
+    const CFileList& list
+)
+{
+    std::vector<std::wstring> names;
+
+    for (FileHandle hFile: list)
+        names.push_back(std::wstring(list.GetDisplayName(hFile)));
+
+    return names;
+}
+
+// Make files with the given names, add them to a list in that order,
+// and sort it by display name.
+static
+std::vector<std::wstring>
+SortNames(
+    const fs::path& directory,
+    const std::vector<std::wstring>& names,
+    bool naturalOrder = true
+)
+{
+    CFileList list;
+
+    for (const std::wstring& name: names)
+    {
+        fs::path path = directory / (name + L".jpg");
+        std::ofstream file(path);
+        list.Add(path);
+    }
+
+    list.Sort(SORT_DisplayName, naturalOrder);
+
+    std::error_code ec;
+    for (const std::wstring& name: names)
+        fs::remove(directory / (name + L".jpg"), ec);
+
+    return GetDisplayNames(list);
+}
+
+TEST(FileList_SortByName)
+{
+    fs::path directory = GetTestDirectory("FileList_SortByName");
+
+    // Numbers by value.
+    CHECK(SortNames(directory, { L"img10", L"img2", L"img1" }) ==
+          std::vector<std::wstring>({ L"img1", L"img2", L"img10" }));
+
+    // Numbers sort where digits do: after space and punctuation, before
+    // letters.
+    CHECK(SortNames(directory, { L"imga", L"img1", L"img.a", L"img-1", L"img 1" }) ==
+          std::vector<std::wstring>({ L"img 1", L"img-1", L"img.a", L"img1", L"imga" }));
+
+    // Leading zeros don't count. Names that are the same apart from them
+    // stay in list order.
+    CHECK(SortNames(directory, { L"img8", L"img007", L"img6", L"img7" }) ==
+          std::vector<std::wstring>({ L"img6", L"img007", L"img7", L"img8" }));
+
+    CHECK(SortNames(directory, { L"a0100", L"a99", L"a000" }) ==
+          std::vector<std::wstring>({ L"a000", L"a99", L"a0100" }));
+
+    // Case doesn't count either.
+    CHECK(SortNames(directory, { L"IMG3", L"b", L"img10", L"A", L"img2" }) ==
+          std::vector<std::wstring>({ L"A", L"b", L"img2", L"IMG3", L"img10" }));
+
+    CHECK(SortNames(directory, { L"photo2", L"PHOTO3", L"Photo1" }) ==
+          std::vector<std::wstring>({ L"Photo1", L"photo2", L"PHOTO3" }));
+
+    // Without natural order, digits are characters.
+    CHECK(SortNames(directory, { L"img10", L"img2", L"img1" }, false) ==
+          std::vector<std::wstring>({ L"img1", L"img10", L"img2" }));
+}
+
+TEST(FileList_SortByPath)
+{
+    fs::path directory = GetTestDirectory("FileList_SortByPath");
+
+    std::vector<fs::path> paths =
+    {
+        directory / "dir10" / "a.jpg",
+        directory / "dir2" / "sub" / "a.jpg",
+        directory / "dir2" / "b.png",
+        directory / "Dir1" / "z.jpg",
+        directory / "dir2" / "b.jpg",
+        directory / "dir2" / "a10.jpg",
+        directory / "dir2" / "a9.jpg",
+    };
+
+    CFileList list;
+
+    for (const fs::path& path: paths)
+    {
+        fs::create_directories(path.parent_path());
+        std::ofstream file(path);
+        list.Add(path);
+    }
+
+    list.Sort(SORT_FullPath);
+
+    // Directories in natural order, a directory's files before its
+    // subdirectories', and the same name sorted by extension.
+    std::vector<fs::path> expected =
+    {
+        directory / "Dir1" / "z.jpg",
+        directory / "dir2" / "a9.jpg",
+        directory / "dir2" / "a10.jpg",
+        directory / "dir2" / "b.jpg",
+        directory / "dir2" / "b.png",
+        directory / "dir2" / "sub" / "a.jpg",
+        directory / "dir10" / "a.jpg",
+    };
+
+    std::vector<fs::path> sorted;
+    for (FileHandle hFile: list)
+        sorted.push_back(list.GetFullPath(hFile));
+
+    CHECK(sorted == expected);
+}
+
+TEST(FileList_SortByFileInfo)
+{
+    fs::path directory = GetTestDirectory("FileList_SortByFileInfo");
+
+    CFileList list;
+    fs::file_time_type now = fs::file_time_type::clock::now();
+
+    // Bigger files are older.
+    for (int fileNum = 0; fileNum < 4; fileNum++)
+    {
+        fs::path path = directory / ("img" + std::to_string(fileNum) + ".jpg");
+        std::ofstream(path) << std::string((size_t) (fileNum * 3 % 4) * 100, 'x');
+        fs::last_write_time(path, now - std::chrono::hours(fileNum * 3 % 4));
+        list.Add(path);
+    }
+
+    list.Sort(SORT_FileSize);
+    CHECK(GetDisplayNames(list) == std::vector<std::wstring>({ L"img0", L"img3", L"img2", L"img1" }));
+
+    list.Sort(SORT_LastWriteTime);
+    CHECK(GetDisplayNames(list) == std::vector<std::wstring>({ L"img1", L"img2", L"img3", L"img0" }));
+
+    list.Sort(SORT_DisplayName);
+    CHECK(GetDisplayNames(list) == std::vector<std::wstring>({ L"img0", L"img1", L"img2", L"img3" }));
+}
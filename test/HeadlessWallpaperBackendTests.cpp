@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  HeadlessWallpaperBackendTests.cpp
+//
+//  CHeadlessWallpaperBackend tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "HeadlessWallpaperBackend.h"
+
+// "Decodes" red.img and blue.img to solid images, without reading them.
+// Anything else can't be decoded.
+static
+bool
+DecodeColorImage(
+    const fs::path& path,
+    std::vector<uint32_t>* pPixels,
+    SIZE* pSize
+)
+{
+    uint32_t pixel;
+
+    if (path.filename() == "red.img")
+        pixel = 0xFFFF0000;
+    else if (path.filename() == "blue.img")
+        pixel = 0xFF0000FF;
+    else
+        return false;
+
+    *pSize = { 16, 12 };
+    pPixels->assign(16 * 12, pixel);
+
+    return true;
+}
+
+// Get the frame's top left pixel.
+static
+uint32_t
+GetFramePixel(
+    const CHeadlessWallpaperBackend& backend
+)
+{
+    SIZE frameSize;
+    return backend.GetFrame(&frameSize)[0];
+}
+
+TEST(HeadlessWallpaperBackend_FailedChangeKeepsFrame)
+{
+    fs::path directory = GetTestDirectory("HeadlessWallpaperBackend_FailedChangeKeepsFrame");
+    fs::path outputDirectory = directory / "Output";
+    fs::create_directories(outputDirectory);
+
+    std::vector<CWallpaperMonitor> monitors = { CWallpaperMonitor{ L"HEADLESS#0", { 0, 0, 32, 24 } } };
+    CHeadlessWallpaperBackend backend(monitors, DecodeColorImage, outputDirectory / "Desktop.bmp");
+
+    CHECK(backend.SetWallpaper(L"red.img"));
+    CHECK(GetFramePixel(backend) == 0xFFFF0000);
+    CHECK(fs::is_regular_file(outputDirectory / "Desktop.bmp"));
+
+    std::wstring wallpaperFile;
+
+    // Can't be decoded.
+    CHECK(!backend.SetWallpaper(L"broken.txt"));
+    CHECK(GetFramePixel(backend) == 0xFFFF0000);
+    CHECK(backend.GetWallpaper(&wallpaperFile) && wallpaperFile == L"red.img");
+
+    // Decoded and composed, but the frame can't be written.
+    fs::remove_all(outputDirectory);
+
+    CHECK(!backend.SetWallpaper(L"blue.img"));
+    CHECK(GetFramePixel(backend) == 0xFFFF0000);
+    CHECK(backend.GetWallpaper(&wallpaperFile) && wallpaperFile == L"red.img");
+
+    // And once it can, it is.
+    fs::create_directories(outputDirectory);
+
+    CHECK(backend.SetWallpaper(L"blue.img"));
+    CHECK(GetFramePixel(backend) == 0xFF0000FF);
+}
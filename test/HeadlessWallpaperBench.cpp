@@ -0,0 +1,199 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  HeadlessWallpaperBench.cpp
+//
+//  Wallpaper change benchmarks with CHeadlessWallpaperBackend.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include <fstream>
+
+#include "HeadlessWallpaperBackend.h"
+#include "ShuffleOrder.h"
+
+// Read a 24bpp bottom-up .bmp file (what CWallpaperCache::WriteBitmapFile()
+// writes). Stands in for WIC, which decodes the app's images.
+static
+bool
+ReadBitmapFile(
+    const fs::path& path,
+    std::vector<uint32_t>* pPixels,
+    SIZE* pSize
+)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    BYTE header[54];
+    if (!file.read((char*) header, sizeof(header)) || header[0] != 'B' || header[1] != 'M')
+        return false;
+
+    int32_t width, height;
+    memcpy(&width, header + 18, sizeof(width));
+    memcpy(&height, header + 22, sizeof(height));
+
+    if (width <= 0 || height <= 0 || header[28] != 24)
+        return false;
+
+    size_t rowSize = ((size_t) width * 3 + 3) & ~(size_t) 3;
+
+    std::vector<BYTE> rows(rowSize * height);
+    if (!file.read((char*) rows.data(), rows.size()))
+        return false;
+
+    pSize->cx = width;
+    pSize->cy = height;
+    pPixels->resize((size_t) width * height);
+
+    for (int y = 0; y < height; y++)
+    {
+        const BYTE* pSrc = rows.data() + (size_t) (height - 1 - y) * rowSize;
+        uint32_t* pDst = pPixels->data() + (size_t) y * width;
+
+        for (int x = 0; x < width; x++)
+            pDst[x] = 0xFF000000 | pSrc[x * 3] | pSrc[x * 3 + 1] << 8 | pSrc[x * 3 + 2] << 16;
+    }
+
+    return true;
+}
+
+// How many changes, and how big the images are (give or take a quarter).
+struct HeadlessChanges
+{
+    size_t m_ChangeCount;
+    SIZE m_ImageSize;
+};
+
+// The whole wallpaper change, without a desktop: move the playlist
+// cursor, check the file exists, and give it to the session, which has
+// the headless backend decode it, resize it for each monitor, and write
+// the desktop frame to a file.
+//
+// Two monitors side by side (1280x720 and 1024x768), a shuffled playlist
+// of 24 images, two of them missing and one that isn't an image (those
+// changes fall back to the background color). Every fourth change spans
+// the image across both monitors.
+BENCHMARK(HeadlessWallpaperChange)
+{
+    for (const HeadlessChanges& changes: GetBenchSizes<HeadlessChanges>({ { 20, { 320, 200 } },
+                                                                          { 2000, { 1600, 1100 } } }))
+    {
+        printf(" %zu changes, images about %dx%d\n", changes.m_ChangeCount, changes.m_ImageSize.cx, changes.m_ImageSize.cy);
+
+        fs::path benchDirectory = GetBenchDirectory("HeadlessWallpaper");
+
+        std::mt19937 random(1);
+        std::vector<fs::path> imagePaths;
+
+        for (int imageNum = 0; imageNum < 24; imageNum++)
+        {
+            fs::path imagePath = benchDirectory / ("image" + std::to_string(imageNum) + ".bmp");
+            imagePaths.push_back(imagePath);
+
+            if (imageNum == 5 || imageNum == 17)
+                continue;
+
+            if (imageNum == 11)
+            {
+                std::ofstream(imagePath) << "Not an image";
+                continue;
+            }
+
+            SIZE imageSize = { changes.m_ImageSize.cx * 3 / 4 + (int) (random() % (changes.m_ImageSize.cx / 2)),
+                               changes.m_ImageSize.cy * 3 / 4 + (int) (random() % (changes.m_ImageSize.cy / 2)) };
+
+            std::vector<uint32_t> pixels((size_t) imageSize.cx * imageSize.cy);
+            for (uint32_t& pixel: pixels)
+                pixel = (uint32_t) random();
+
+            CWallpaperCache::WriteBitmapFile(imagePath, pixels.data(), imageSize);
+        }
+
+        std::vector<CWallpaperMonitor> monitors = { CWallpaperMonitor{ L"HEADLESS#0", { 0, 0, 1280, 720 } },
+                                                    CWallpaperMonitor{ L"HEADLESS#1", { 1280, 0, 2304, 768 } } };
+
+        CHeadlessWallpaperBackend* pBackend = new CHeadlessWallpaperBackend(monitors, ReadBitmapFile, benchDirectory / "Desktop.bmp");
+        CWallpaperSession session((std::unique_ptr<CWallpaperBackend>(pBackend)));
+
+        CShuffleOrder shuffleOrder(imagePaths.size(), 1);
+        uint64_t cursor = 0;
+
+        CLatencyStats cursorStats;
+        CLatencyStats validateStats;
+        CLatencyStats decodeStats;
+        CLatencyStats resizeStats;
+        CLatencyStats writeStats;
+        CLatencyStats applyStats;
+        CLatencyStats totalStats;
+        size_t solidColorCount = 0;
+
+        for (size_t change = 0; change < changes.m_ChangeCount; change++)
+        {
+            CStopwatch totalStopwatch;
+            CStopwatch stopwatch;
+
+            // Next in the playlist (a new shuffle at the end).
+            if (++cursor >= shuffleOrder.size())
+            {
+                cursor = 0;
+                shuffleOrder.Reset(imagePaths.size(), change + 2);
+            }
+
+            const fs::path& imagePath = imagePaths[(size_t) shuffleOrder.GetPosition(cursor)];
+
+            cursorStats.Add(stopwatch.GetElapsedMs());
+            stopwatch.Restart();
+
+            std::error_code ec;
+            bool exists = fs::is_regular_file(imagePath, ec);
+
+            validateStats.Add(stopwatch.GetElapsedMs());
+            stopwatch.Restart();
+
+            WallpaperResizeMode position = (change % 4 == 0) ? RESIZE_Span : RESIZE_Fill;
+
+            bool ok = exists && session.SetWallpaper(imagePath.wstring(), position, RGB(64, 64, 64));
+            if (!ok)
+            {
+                session.SetSolidColor(RGB(64, 64, 64));
+                solidColorCount++;
+            }
+
+            applyStats.Add(stopwatch.GetElapsedMs());
+            totalStats.Add(totalStopwatch.GetElapsedMs());
+
+            if (ok)
+            {
+                const CHeadlessWallpaperBackend::ComposeTimes& composeTimes = pBackend->GetComposeTimes();
+
+                decodeStats.Add(composeTimes.m_Decode.count() / 1000.0);
+                resizeStats.Add(composeTimes.m_Resize.count() / 1000.0);
+                writeStats.Add(composeTimes.m_Write.count() / 1000.0);
+            }
+        }
+
+        printf("  %zu changes fell back to the background color\n", solidColorCount);
+
+        cursorStats.Report("cursor");
+        validateStats.Report("validate");
+        decodeStats.Report("decode");
+        resizeStats.Report("resize");
+        writeStats.Report("write");
+        applyStats.Report("apply (decode, resize, write)");
+        totalStats.Report("end to end");
+
+        std::error_code ec;
+        fs::remove_all(benchDirectory, ec);
+    }
+}
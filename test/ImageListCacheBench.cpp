@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ImageListCacheBench.cpp
+//
+//  CImageListCache benchmark.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include "ImageListCache.h"
+
+// Bytes per thumbnail (a 96x96 32 bpp bitmap, the default size).
+static const size_t ThumbnailBytes = 96 * 96 * 4;
+
+// Do what CMainFrame does with each item that's drawn: find its
+// thumbnail, and insert it (once it's been loaded) if it isn't cached.
+static
+void
+Draw(
+    CImageListCache& cache,
+    const CThumbnailKey& key
+)
+{
+    int imageListIndex;
+
+    if (!cache.Find(key, &imageListIndex))
+    {
+        int* pImageListIndex = cache.Insert(key, ThumbnailBytes);
+        if (*pImageListIndex == -1)
+            *pImageListIndex = (int) cache.size();
+    }
+}
+
+// Time the thumbnail LRU cache lookups and inserts for the list view's
+// access patterns, with the cache holding all or some of the playlist,
+// and report the hit, miss, and eviction counts.
+BENCHMARK(ImageListCache)
+{
+    std::mt19937_64 random(1);
+
+    for (size_t entryCount: GetBenchSizes<size_t>({ 1000, 10000, 100000 }))
+    {
+        printf(" %zu entries\n", entryCount);
+
+        std::vector<CThumbnailKey> keys(entryCount);
+        for (CThumbnailKey& key: keys)
+            key = { random(), (int64_t) (random() >> 1), random() % 10000000 };
+
+        // Scrolling from top to bottom, and jumping to random items (long
+        // enough to touch nearly every item, so the hit rate is about the
+        // fraction cached).
+        std::vector<size_t> scrollOrder(entryCount);
+        std::iota(scrollOrder.begin(), scrollOrder.end(), 0);
+
+        std::vector<size_t> randomOrder(entryCount * 4);
+        for (size_t& item: randomOrder)
+            item = random() % entryCount;
+
+        struct Scenario
+        {
+            const char* m_Name;
+            size_t m_CachedCount;
+            const std::vector<size_t>& m_Items;
+        };
+
+        Scenario scenarios[] =
+        {
+            { "scroll, all cached", entryCount, scrollOrder },
+            { "scroll, half cached", entryCount / 2, scrollOrder },
+            { "random, all cached", entryCount, randomOrder },
+            { "random, 3/4 cached", entryCount * 3 / 4, randomOrder },
+            { "random, 1/10 cached", entryCount / 10, randomOrder },
+        };
+
+        for (const Scenario& scenario: scenarios)
+        {
+            CLatencyStats stats;
+            CImageListCache cache(scenario.m_CachedCount * ThumbnailBytes);
+
+            // The first pass fills the cache, and isn't timed.
+            for (size_t item: scenario.m_Items)
+                Draw(cache, keys[item]);
+
+            CImageListCache::CStats firstStats = cache.GetStats();
+            size_t repeatCount = GetBenchRepeatCount(10);
+
+            for (size_t repeat = 0; repeat < repeatCount; repeat++)
+            {
+                CStopwatch stopwatch;
+
+                for (size_t item: scenario.m_Items)
+                    Draw(cache, keys[item]);
+
+                stats.Add(stopwatch.GetElapsedMs());
+            }
+
+            stats.Report(scenario.m_Name);
+
+            const CImageListCache::CStats& cacheStats = cache.GetStats();
+            uint64_t hits = cacheStats.m_Hits - firstStats.m_Hits;
+            uint64_t misses = cacheStats.m_Misses - firstStats.m_Misses;
+            uint64_t evictions = cacheStats.m_Evictions - firstStats.m_Evictions;
+            uint64_t lookups = hits + misses;
+
+            printf("  %-36s %.1f ns/lookup  hits=%llu  misses=%llu  evictions=%llu  hit rate=%.1f%%\n",
+                   "",
+                   stats.GetMean() * 1000000.0 / (double) scenario.m_Items.size(),
+                   (unsigned long long) hits,
+                   (unsigned long long) misses,
+                   (unsigned long long) evictions,
+                   lookups != 0 ? 100.0 * (double) hits / (double) lookups : 0.0);
+        }
+    }
+}
@@ -0,0 +1,230 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ImageListCacheTests.cpp
+//
+//  CImageListCache tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+
+#include "FileList.h"
+#include "ImageListCache.h"
+
+// Make a key for a made up file.
+static
+CThumbnailKey
+MakeKey(
+    uint64_t fileNum
+)
+{
+    return { fileNum * 0x9E3779B97F4A7C15ull, 1000, 4096 };
+}
+
+// Insert a thumbnail the way the list view does: a new slot (-1) is
+// filled in with the next image list index.
+static
+int
+InsertThumbnail(
+    CImageListCache& cache,
+    const CThumbnailKey& key,
+    size_t bytes,
+    int* pImageListSize
+)
+{
+    int* pSlot = cache.Insert(key, bytes);
+    if (*pSlot == -1)
+        *pSlot = (*pImageListSize)++;
+
+    return *pSlot;
+}
+
+TEST(ImageListCache_EvictsLeastRecentlyUsed)
+{
+    CImageListCache cache(300);
+    int imageListSize = 0;
+
+    InsertThumbnail(cache, MakeKey(1), 100, &imageListSize);
+    InsertThumbnail(cache, MakeKey(2), 100, &imageListSize);
+    InsertThumbnail(cache, MakeKey(3), 100, &imageListSize);
+    CHECK(cache.size() == 3);
+    CHECK(cache.GetMemoryUsage() == 300);
+
+    // 1 is used, so 2 is the oldest.
+    int imageListIndex;
+    CHECK(cache.Find(MakeKey(1), &imageListIndex));
+
+    InsertThumbnail(cache, MakeKey(4), 100, &imageListSize);
+    CHECK(!cache.Contains(MakeKey(2)));
+    CHECK(cache.Contains(MakeKey(1)));
+    CHECK(cache.Contains(MakeKey(3)));
+    CHECK(cache.Contains(MakeKey(4)));
+
+    // A bigger thumbnail takes the place of two: 3, then 1.
+    InsertThumbnail(cache, MakeKey(5), 200, &imageListSize);
+    CHECK(!cache.Contains(MakeKey(3)));
+    CHECK(!cache.Contains(MakeKey(1)));
+    CHECK(cache.Contains(MakeKey(4)));
+    CHECK(cache.Contains(MakeKey(5)));
+    CHECK(cache.GetMemoryUsage() == 300);
+    CHECK(cache.GetStats().m_Evictions == 3);
+
+    // One that's over budget on its own is still kept.
+    InsertThumbnail(cache, MakeKey(6), 1000, &imageListSize);
+    CHECK(cache.size() == 1);
+    CHECK(cache.Contains(MakeKey(6)));
+
+    // Lowering the budget evicts (but still keeps one).
+    CImageListCache smallCache(1000);
+    for (uint64_t fileNum = 1; fileNum <= 10; fileNum++)
+        InsertThumbnail(smallCache, MakeKey(fileNum), 100, &imageListSize);
+
+    smallCache.SetBudget(250);
+    CHECK(smallCache.size() == 2);
+    CHECK(smallCache.Contains(MakeKey(9)));
+    CHECK(smallCache.Contains(MakeKey(10)));
+
+    smallCache.SetBudget(0);
+    CHECK(smallCache.size() == 0);
+    CHECK(smallCache.GetMemoryUsage() == 0);
+}
+
+TEST(ImageListCache_RecyclesSlots)
+{
+    CImageListCache cache(300);
+    int imageListSize = 0;
+
+    CHECK(InsertThumbnail(cache, MakeKey(1), 100, &imageListSize) == 0);
+    CHECK(InsertThumbnail(cache, MakeKey(2), 100, &imageListSize) == 1);
+    CHECK(InsertThumbnail(cache, MakeKey(3), 100, &imageListSize) == 2);
+
+    // Evicted entries hand their slots on, so the image list stops growing.
+    CHECK(InsertThumbnail(cache, MakeKey(4), 100, &imageListSize) == 0);
+    CHECK(InsertThumbnail(cache, MakeKey(5), 100, &imageListSize) == 1);
+    CHECK(imageListSize == 3);
+
+    // The same key again keeps its slot.
+    CHECK(InsertThumbnail(cache, MakeKey(4), 150, &imageListSize) == 0);
+    CHECK(cache.GetMemoryUsage() == 350);
+    CHECK(cache.size() == 3);
+
+    int imageListIndex;
+    CHECK(cache.Find(MakeKey(5), &imageListIndex) && imageListIndex == 1);
+    CHECK(cache.Find(MakeKey(3), &imageListIndex) && imageListIndex == 2);
+
+    // Clear() forgets the thumbnails, but not the slots.
+    cache.Clear();
+    CHECK(cache.size() == 0);
+    CHECK(cache.GetMemoryUsage() == 0);
+
+    std::vector<int> slots;
+    for (uint64_t fileNum = 6; fileNum <= 8; fileNum++)
+        slots.push_back(InsertThumbnail(cache, MakeKey(fileNum), 100, &imageListSize));
+
+    std::sort(slots.begin(), slots.end());
+    CHECK(slots == std::vector<int>({ 0, 1, 2 }));
+    CHECK(imageListSize == 3);
+
+    // Reset() forgets both.
+    cache.Reset();
+    CHECK(*cache.Insert(MakeKey(9), 100) == -1);
+}
+
+// A thumbnail is only found while its file hasn't changed.
+TEST(ImageListCache_KeyChangesWithFile)
+{
+    fs::path directory = GetTestDirectory("ImageListCache_KeyChangesWithFile");
+    fs::path path = directory / "image.jpg";
+
+    std::ofstream(path) << "image";
+
+    CFileList list;
+    list.Add(path);
+    FileHandle hFile = list.Lookup(path);
+
+    auto GetKey = /*LAMBDA*/ [&list, &hFile, &path] ()
+    {
+        CFileStat fileStat = CFileList::StatFile(path);
+        return CThumbnailKey{ list.GetPathHash(hFile), fileStat.m_LastWriteTime, fileStat.m_Size };
+    };
+
+    CImageListCache cache(1000);
+    int imageListSize = 0;
+    int imageListIndex;
+
+    CThumbnailKey key = GetKey();
+    InsertThumbnail(cache, key, 100, &imageListSize);
+    CHECK(cache.Find(GetKey(), &imageListIndex));
+
+    // Same size, new time.
+    fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(10));
+
+    CThumbnailKey newTimeKey = GetKey();
+    CHECK(newTimeKey.m_LastWriteTime != key.m_LastWriteTime);
+    CHECK(!cache.Find(newTimeKey, &imageListIndex));
+
+    // Same time, new size.
+    fs::file_time_type writeTime = fs::last_write_time(path);
+    std::ofstream(path) << "bigger image";
+    fs::last_write_time(path, writeTime);
+
+    CThumbnailKey newSizeKey = GetKey();
+    CHECK(newSizeKey.m_LastWriteTime == newTimeKey.m_LastWriteTime);
+    CHECK(newSizeKey.m_FileSize != newTimeKey.m_FileSize);
+    CHECK(!cache.Find(newSizeKey, &imageListIndex));
+
+    // The path hash doesn't depend on the handle, so the thumbnail is
+    // still found after the file is removed and added back under another
+    // handle (e.g. the playlist is reloaded).
+    InsertThumbnail(cache, newSizeKey, 100, &imageListSize);
+
+    std::ofstream(directory / "other.jpg");
+    list.Remove(hFile);
+    list.Add(directory / "other.jpg");
+    list.Add(path);
+    CHECK(list.Lookup(path) != hFile);
+    hFile = list.Lookup(path);
+
+    CHECK(GetKey() == newSizeKey);
+    CHECK(cache.Find(GetKey(), &imageListIndex));
+}
+
+TEST(ImageListCache_CountsHitsAndMisses)
+{
+    CImageListCache cache(1000);
+    int imageListSize = 0;
+    int imageListIndex;
+
+    CHECK(!cache.Find(MakeKey(1), &imageListIndex));
+    InsertThumbnail(cache, MakeKey(1), 100, &imageListSize);
+    CHECK(cache.Find(MakeKey(1), &imageListIndex));
+    CHECK(cache.Find(MakeKey(1), &imageListIndex));
+    CHECK(!cache.Find(MakeKey(2), &imageListIndex));
+
+    // Contains() isn't a use.
+    CHECK(cache.Contains(MakeKey(1)));
+    CHECK(!cache.Contains(MakeKey(3)));
+
+    CHECK(cache.GetStats().m_Hits == 2);
+    CHECK(cache.GetStats().m_Misses == 2);
+    CHECK(cache.GetStats().m_Evictions == 0);
+
+    // Clearing the cache isn't an eviction, and doesn't reset the counts.
+    cache.Clear();
+    CHECK(!cache.Find(MakeKey(1), &imageListIndex));
+    CHECK(cache.GetStats().m_Hits == 2);
+    CHECK(cache.GetStats().m_Misses == 3);
+    CHECK(cache.GetStats().m_Evictions == 0);
+}
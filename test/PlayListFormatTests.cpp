@@ -0,0 +1,271 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListFormatTests.cpp
+//
+//  Playlist file and journal format tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+#include <set>
+
+#include "PlayListFormat.h"
+
+// Make empty image files.
+static
+std::vector<fs::path>
+MakeImageFiles(
+    const fs::path& directory,
+    size_t fileCount
+)
+{
+    std::vector<fs::path> paths;
+
+    for (size_t fileNum = 0; fileNum < fileCount; fileNum++)
+    {
+        paths.push_back(directory / ("img " + std::to_string(fileNum) + ".jpg"));
+        std::ofstream(paths.back());
+    }
+
+    return paths;
+}
+
+// Get the full paths of the files in a list, in order.
+static
+std::vector<fs::path>
+GetPaths(
+    const CFileList& list
+)
+{
+    std::vector<fs::path> paths;
+
+    for (FileHandle hFile: list)
+        paths.push_back(list.GetFullPath(hFile));
+
+    return paths;
+}
+
+// Make a journal.
+static
+std::string
+MakeJournal(
+    const std::vector<std::pair<char, fs::path>>& records
+)
+{
+    std::string journal;
+
+    for (const auto& record: records)
+        AppendJournalRecord(journal, record.first, record.second);
+
+    return journal;
+}
+
+// Replay a journal.
+static
+CJournalReplayResult
+Replay(
+    const std::string& journal,
+    CFileList& list
+)
+{
+    return ReplayJournal(journal.data(), journal.size(), list);
+}
+
+TEST(PlayListFormat_ParsesPlaylistFile)
+{
+    fs::path directory = GetTestDirectory("PlayListFormat_ParsesPlaylistFile");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 4);
+
+    std::string fileData = "# Comment\r\n"
+                           "; Another comment\n"
+                           "\r\n"
+                           "  " + paths[0].u8string() + "\t\r\n" +
+                           paths[1].u8string() + "\n" +
+                           "\n" +
+                           paths[2].u8string() + "\r" +
+                           paths[3].u8string();
+
+    CFileList list;
+    CHECK(ParsePlaylistFile(fileData.data(), fileData.size(), list));
+    CHECK(GetPaths(list) == paths);
+
+    // A file that's gone, or there twice, isn't added (and is reported).
+    std::string badFileData = paths[0].u8string() + "\r\n" +
+                              (directory / "missing.jpg").u8string() + "\r\n" +
+                              paths[0].u8string() + "\r\n" +
+                              paths[1].u8string() + "\r\n";
+
+    CFileList badList;
+    CHECK(!ParsePlaylistFile(badFileData.data(), badFileData.size(), badList));
+    CHECK(GetPaths(badList) == std::vector<fs::path>({ paths[0], paths[1] }));
+}
+
+TEST(PlayListFormat_TornRecordIsIgnored)
+{
+    fs::path directory = GetTestDirectory("PlayListFormat_TornRecordIsIgnored");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 3);
+
+    std::string journal = MakeJournal({ { JournalAddRecord, paths[0] },
+                                        { JournalAddRecord, paths[1] } });
+    size_t validSize = journal.size();
+
+    // Cut the third record short at every byte, including part way
+    // through the line ending.
+    std::string thirdRecord = MakeJournal({ { JournalAddRecord, paths[2] } });
+
+    for (size_t tornSize = 0; tornSize < thirdRecord.size(); tornSize++)
+    {
+        std::string tornJournal = journal + thirdRecord.substr(0, tornSize);
+
+        CFileList list;
+        CJournalReplayResult result = Replay(tornJournal, list);
+
+        CHECK(result.m_RecordCount == 2);
+        CHECK(result.m_ValidSize == validSize);
+        CHECK(result.m_AllAdded);
+        CHECK(GetPaths(list) == std::vector<fs::path>({ paths[0], paths[1] }));
+    }
+
+    // Once it's complete, it counts.
+    CFileList list;
+    CJournalReplayResult result = Replay(journal + thirdRecord, list);
+    CHECK(result.m_RecordCount == 3);
+    CHECK(result.m_ValidSize == journal.size() + thirdRecord.size());
+    CHECK(GetPaths(list) == paths);
+}
+
+TEST(PlayListFormat_RecordsReplayInOrder)
+{
+    fs::path directory = GetTestDirectory("PlayListFormat_RecordsReplayInOrder");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 4);
+
+    // On top of a playlist file with the last file in it.
+    CFileList list;
+    list.Add(paths[3]);
+
+    std::string journal = MakeJournal({ { JournalAddRecord, paths[0] },
+                                        { JournalAddRecord, paths[1] },
+                                        { JournalRemoveRecord, paths[0] },
+                                        { JournalAddRecord, paths[2] },
+                                        { JournalRemoveRecord, paths[3] },
+                                        { JournalAddRecord, paths[0] } });
+
+    CJournalReplayResult result = Replay(journal, list);
+
+    CHECK(result.m_RecordCount == 6);
+    CHECK(result.m_ValidSize == journal.size());
+    CHECK(result.m_AllAdded);
+    CHECK(GetPaths(list) == std::vector<fs::path>({ paths[1], paths[2], paths[0] }));
+}
+
+TEST(PlayListFormat_RemoveOfMissingPathIsHarmless)
+{
+    fs::path directory = GetTestDirectory("PlayListFormat_RemoveOfMissingPathIsHarmless");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 3);
+
+    CFileList list;
+    list.Add(paths[0]);
+    list.Add(paths[1]);
+
+    // Removes of files that aren't in the list (never were, or already
+    // gone), an add of one that's already there, and records that aren't
+    // records.
+    std::string journal = MakeJournal({ { JournalRemoveRecord, directory / "never.jpg" },
+                                        { JournalRemoveRecord, paths[0] },
+                                        { JournalRemoveRecord, paths[0] },
+                                        { JournalRemoveRecord, paths[2] },
+                                        { JournalAddRecord, paths[1] } });
+    journal += "\r\n";
+    journal += "+\r\n";
+    journal += "*" + paths[2].u8string() + "\r\n";
+
+    CJournalReplayResult result = Replay(journal, list);
+
+    CHECK(result.m_RecordCount == 6);
+    CHECK(result.m_ValidSize == journal.size());
+    CHECK(result.m_AllAdded);
+    CHECK(GetPaths(list) == std::vector<fs::path>({ paths[1] }));
+
+    // An add of a file that's gone is reported, and the rest still replay.
+    std::string goneJournal = MakeJournal({ { JournalAddRecord, directory / "gone.jpg" },
+                                            { JournalAddRecord, paths[2] } });
+
+    result = Replay(goneJournal, list);
+
+    CHECK(!result.m_AllAdded);
+    CHECK(GetPaths(list) == std::vector<fs::path>({ paths[1], paths[2] }));
+}
+
+// Compaction writes the list (the playlist file plus the journal) as a new
+// playlist file, and keeps the records appended since then.
+TEST(PlayListFormat_CompactionReloadsSameList)
+{
+    fs::path directory = GetTestDirectory("PlayListFormat_CompactionReloadsSameList");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 12);
+
+    auto Load = /*LAMBDA*/ [] (const std::string& playlistFile, const std::string& journal, CFileList& list)
+    {
+        list.clear();
+        CHECK(ParsePlaylistFile(playlistFile.data(), playlistFile.size(), list));
+        CHECK(Replay(journal, list).m_AllAdded);
+    };
+
+    CFileList list;
+    for (size_t fileNum = 0; fileNum < 8; fileNum++)
+        list.Add(paths[fileNum]);
+
+    std::string playlistFile = FormatPlaylistFile(GetPlaylistEntries(list));
+
+    std::string journal = MakeJournal({ { JournalRemoveRecord, paths[2] },
+                                        { JournalAddRecord, paths[8] },
+                                        { JournalRemoveRecord, paths[5] },
+                                        { JournalAddRecord, paths[9] },
+                                        { JournalAddRecord, paths[2] } });
+
+    CFileList loadedList;
+    Load(playlistFile, journal, loadedList);
+
+    // Snapshot for the compaction thread. More edits come in while
+    // it's writing.
+    std::string compactedFile = FormatPlaylistFile(GetPlaylistEntries(loadedList));
+    size_t compactedJournalSize = journal.size();
+
+    journal += MakeJournal({ { JournalRemoveRecord, paths[0] },
+                             { JournalAddRecord, paths[10] } });
+    Replay(journal.substr(compactedJournalSize), loadedList);
+
+    std::vector<fs::path> expected = GetPaths(loadedList);
+    CHECK(expected.size() == 9);
+
+    // Reloads to the same list, in the same order.
+    std::string compactedJournal = journal.substr(compactedJournalSize);
+
+    CFileList reloadedList;
+    Load(compactedFile, compactedJournal, reloadedList);
+    CHECK(GetPaths(reloadedList) == expected);
+
+    // So does the original playlist with the whole journal.
+    Load(playlistFile, journal, reloadedList);
+    CHECK(GetPaths(reloadedList) == expected);
+
+    // A crash after the new playlist file was written, but before the
+    // journal was cut, replays the whole journal on top of it. The same
+    // files, though edits that were already in it can move them.
+    Load(compactedFile, journal, reloadedList);
+
+    std::vector<fs::path> reloadedPaths = GetPaths(reloadedList);
+    CHECK(std::set<fs::path>(reloadedPaths.begin(), reloadedPaths.end()) == std::set<fs::path>(expected.begin(), expected.end()));
+    CHECK(reloadedPaths.size() == expected.size());
+}
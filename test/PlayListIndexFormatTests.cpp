@@ -0,0 +1,288 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListIndexFormatTests.cpp
+//
+//  Playlist index format tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+
+#include "PlayListFormat.h"
+#include "PlayListIndexFormat.h"
+
+// Make a playlist file of empty image files in a few nested directories,
+// with numbers in the names so the sort keys aren't just name order.
+static
+std::string
+MakePlaylistFile(
+    const fs::path& directory
+)
+{
+    CFileList list;
+
+    for (const char* subdir: { "b", "a", "a/deeper", "c" })
+    {
+        fs::path dirPath = directory / subdir;
+        fs::create_directories(dirPath);
+
+        for (int fileNum: { 10, 2, 1, 11, 3 })
+        {
+            fs::path filePath = dirPath / ("img " + std::to_string(fileNum) + ".jpg");
+            std::ofstream file(filePath);
+            list.Add(filePath);
+        }
+    }
+
+    return FormatPlaylistFile(GetPlaylistEntries(list));
+}
+
+// Load a playlist the way CPlayList::Load() does: from the index if it's
+// good, otherwise by parsing the playlist file. Returns true if the index
+// was used.
+static
+bool
+LoadPlaylist(
+    const std::string& playlistFile,
+    const std::vector<BYTE>& indexData,
+    CFileList& list
+)
+{
+    if (CPlayListIndexFormat::Read(indexData.data(), indexData.size(), playlistFile.data(), playlistFile.size(), list))
+        return true;
+
+    // A rejected index leaves nothing behind, so there are no duplicates.
+    CHECK(list.empty());
+    CHECK(ParsePlaylistFile(playlistFile.data(), playlistFile.size(), list));
+    return false;
+}
+
+// Get the full paths of the files in a list, in order.
+static
+std::vector<fs::path>
+GetPaths(
+    const CFileList& list
+)
+{
+    std::vector<fs::path> paths;
+
+    for (FileHandle hFile: list)
+        paths.push_back(list.GetFullPath(hFile));
+
+    return paths;
+}
+
+// Get a copy of the index header.
+static
+IndexHeader
+GetHeader(
+    const std::vector<BYTE>& indexData
+)
+{
+    IndexHeader header;
+    memcpy(&header, indexData.data(), sizeof(header));
+    return header;
+}
+
+TEST(PlayListIndexFormat_StaleChecksumIsRejected)
+{
+    std::string playlistFile = MakePlaylistFile(GetTestDirectory("PlayListIndexFormat_StaleChecksumIsRejected"));
+
+    CFileList parsedList;
+    REQUIRE(ParsePlaylistFile(playlistFile.data(), playlistFile.size(), parsedList));
+
+    std::vector<BYTE> indexData;
+    REQUIRE(CPlayListIndexFormat::Make(playlistFile.data(), playlistFile.size(), parsedList, indexData));
+
+    {
+        CFileList list;
+        CHECK(CPlayListIndexFormat::Read(indexData.data(), indexData.size(), playlistFile.data(), playlistFile.size(), list));
+        CHECK(list.size() == parsedList.size());
+    }
+
+    // The playlist file was edited since, but is still the same size.
+    std::string editedFile = playlistFile;
+    editedFile[2] = 'w';
+    REQUIRE(editedFile.size() == playlistFile.size());
+
+    {
+        CFileList list;
+        CHECK(!CPlayListIndexFormat::Read(indexData.data(), indexData.size(), editedFile.data(), editedFile.size(), list));
+        CHECK(list.empty());
+    }
+
+    // Or has grown.
+    std::string grownFile = playlistFile + "\r\n";
+
+    {
+        CFileList list;
+        CHECK(!CPlayListIndexFormat::Read(indexData.data(), indexData.size(), grownFile.data(), grownFile.size(), list));
+        CHECK(list.empty());
+    }
+
+    // Or the checksum in the index is wrong.
+    std::vector<BYTE> staleIndexData = indexData;
+    IndexHeader header = GetHeader(staleIndexData);
+    header.m_PlaylistChecksum ^= 1;
+    memcpy(staleIndexData.data(), &header, sizeof(header));
+
+    {
+        CFileList list;
+        CHECK(!CPlayListIndexFormat::Read(staleIndexData.data(), staleIndexData.size(), playlistFile.data(), playlistFile.size(), list));
+        CHECK(list.empty());
+    }
+
+    CHECK(header.m_PlaylistChecksum != ChecksumPlaylistFile(playlistFile.data(), playlistFile.size()));
+    CHECK(ChecksumPlaylistFile(editedFile.data(), editedFile.size()) != ChecksumPlaylistFile(playlistFile.data(), playlistFile.size()));
+}
+
+TEST(PlayListIndexFormat_DamagedIndexFallsBackToTextParse)
+{
+    std::string playlistFile = MakePlaylistFile(GetTestDirectory("PlayListIndexFormat_DamagedIndexFallsBackToTextParse"));
+
+    CFileList parsedList;
+    REQUIRE(ParsePlaylistFile(playlistFile.data(), playlistFile.size(), parsedList));
+    std::vector<fs::path> expected = GetPaths(parsedList);
+
+    std::vector<BYTE> indexData;
+    REQUIRE(CPlayListIndexFormat::Make(playlistFile.data(), playlistFile.size(), parsedList, indexData));
+
+    const IndexHeader header = GetHeader(indexData);
+    REQUIRE(header.m_DirectoryCount >= 4);
+    REQUIRE(header.m_FileCount == 20);
+
+    // Truncated anywhere, e.g. by a crash while it was being written.
+    for (size_t indexSize = 0; indexSize < indexData.size(); indexSize++)
+    {
+        std::vector<BYTE> truncatedData(indexData.begin(), indexData.begin() + indexSize);
+
+        CFileList list;
+        if (indexSize % 16 == 0 || indexSize + 1 == indexData.size())
+        {
+            CHECK(!LoadPlaylist(playlistFile, truncatedData, list));
+            CHECK(GetPaths(list) == expected);
+        }
+        else
+        {
+            CHECK(!CPlayListIndexFormat::Read(truncatedData.data(), truncatedData.size(), playlistFile.data(), playlistFile.size(), list));
+            CHECK(list.empty());
+        }
+    }
+
+    // Corrupted in place. Each damages one field of a good index.
+    auto Corrupt = /*LAMBDA*/ [&indexData] (size_t offset, auto value)
+    {
+        std::vector<BYTE> corruptData = indexData;
+        memcpy(corruptData.data() + offset, &value, sizeof(value));
+        return corruptData;
+    };
+
+    auto FileEntry = /*LAMBDA*/ [&header] (size_t fileNum, size_t fieldOffset)
+    {
+        return header.m_FileTableOffset + fileNum * sizeof(IndexFile) + fieldOffset;
+    };
+
+    auto DirectoryEntry = /*LAMBDA*/ [&header] (size_t dirId, size_t fieldOffset)
+    {
+        return header.m_DirectoryTableOffset + dirId * sizeof(IndexDirectory) + fieldOffset;
+    };
+
+    const uint64_t stringTableEnd = header.m_StringTableOffset + header.m_StringTableSize * sizeof(WCHAR);
+
+    std::vector<std::vector<BYTE>> corruptIndexes =
+    {
+        Corrupt(offsetof(IndexHeader, m_Magic), (uint32_t) 0),
+        Corrupt(offsetof(IndexHeader, m_Version), IndexVersion - 1),
+        Corrupt(offsetof(IndexHeader, m_FileCount), header.m_FileCount + 1000),
+        Corrupt(offsetof(IndexHeader, m_FileTableOffset), header.m_FileTableOffset + 4),
+        Corrupt(offsetof(IndexHeader, m_StringTableSize), header.m_StringTableSize + 1),
+        Corrupt(DirectoryEntry(1, offsetof(IndexDirectory, m_ParentId)), (uint32_t) 1),
+        Corrupt(DirectoryEntry(2, offsetof(IndexDirectory, m_PathOffset)), (uint32_t) header.m_StringTableSize),
+        Corrupt(FileEntry(7, offsetof(IndexFile, m_DirectoryId)), header.m_DirectoryCount),
+        Corrupt(FileEntry(19, offsetof(IndexFile, m_NameOffset)), (uint32_t) header.m_StringTableSize - 1),
+        Corrupt(FileEntry(3, offsetof(IndexFile, m_NameLength)), (uint16_t) 3),
+        Corrupt(FileEntry(5, offsetof(IndexFile, m_StemLength)), (uint16_t) 100),
+        Corrupt(stringTableEnd - sizeof(WCHAR), (WCHAR) L'x'),
+    };
+
+    for (const std::vector<BYTE>& corruptData: corruptIndexes)
+    {
+        CFileList list;
+        CHECK(!LoadPlaylist(playlistFile, corruptData, list));
+        CHECK(GetPaths(list) == expected);
+    }
+
+    // The good index is used.
+    CFileList list;
+    CHECK(LoadPlaylist(playlistFile, indexData, list));
+    CHECK(GetPaths(list) == expected);
+}
+
+TEST(PlayListIndexFormat_StringsMatchTextParse)
+{
+    std::string playlistFile = MakePlaylistFile(GetTestDirectory("PlayListIndexFormat_StringsMatchTextParse"));
+
+    CFileList parsedList;
+    REQUIRE(ParsePlaylistFile(playlistFile.data(), playlistFile.size(), parsedList));
+
+    std::vector<BYTE> indexData;
+    REQUIRE(CPlayListIndexFormat::Make(playlistFile.data(), playlistFile.size(), parsedList, indexData));
+
+    CFileList list;
+    REQUIRE(CPlayListIndexFormat::Read(indexData.data(), indexData.size(), playlistFile.data(), playlistFile.size(), list));
+    REQUIRE(list.size() == parsedList.size());
+
+    auto IsInIndex = /*LAMBDA*/ [&indexData] (std::wstring_view str)
+    {
+        const BYTE* pStr = (const BYTE*) str.data();
+        return pStr >= indexData.data() && pStr + str.size() * sizeof(WCHAR) < indexData.data() + indexData.size();
+    };
+
+    auto parsedIt = parsedList.begin();
+
+    for (FileHandle hFile: list)
+    {
+        FileHandle hParsedFile = *parsedIt++;
+
+        const CFileInfo& fileInfo = list.GetFileInfo(hFile);
+        const CFileInfo& parsedInfo = parsedList.GetFileInfo(hParsedFile);
+
+        const CDirectoryInfo& dirInfo = list.GetDirectoryInfo(fileInfo.GetDirectoryId());
+        const CDirectoryInfo& parsedDirInfo = parsedList.GetDirectoryInfo(parsedInfo.GetDirectoryId());
+
+        // Same strings, used in place.
+        CHECK(fileInfo.GetFileName() == parsedInfo.GetFileName());
+        CHECK(fileInfo.GetDisplayName() == parsedInfo.GetDisplayName());
+        CHECK(dirInfo.GetPath() == parsedDirInfo.GetPath());
+        CHECK(list.GetFullPath(hFile) == parsedList.GetFullPath(hParsedFile));
+
+        CHECK(IsInIndex(fileInfo.GetFileName()));
+        CHECK(IsInIndex(dirInfo.GetPath()));
+        CHECK(fileInfo.GetFileName().data()[fileInfo.GetFileName().size()] == L'\0');
+
+        // Same directory tree.
+        CHECK(fileInfo.GetDirectoryId() == parsedInfo.GetDirectoryId());
+        CHECK(dirInfo.GetParentId() == parsedDirInfo.GetParentId());
+    }
+
+    // Files can be found by path (the hash indexes are built on first use).
+    for (FileHandle hFile: parsedList)
+        CHECK(list.Contains(parsedList.GetFullPath(hFile)));
+
+    // The stored sort keys sort the same way as the strings.
+    list.Sort(SORT_DisplayName);
+    parsedList.Sort(SORT_DisplayName);
+    CHECK(GetPaths(list) == GetPaths(parsedList));
+}
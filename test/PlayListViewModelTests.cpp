@@ -0,0 +1,285 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlayListViewModelTests.cpp
+//
+//  CPlayListViewModel tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "PlayListViewModel.h"
+
+#include <set>
+
+using Handle = CPlayListViewModel::Handle;
+
+// Check every row maps to the expected handle and back, and the
+// selection is the expected set of handles.
+static
+bool
+IsExpected(
+    const CPlayListViewModel& viewModel,
+    const std::vector<Handle>& rows,
+    const std::set<Handle>& selected
+)
+{
+    if (viewModel.size() != rows.size() || viewModel.empty() != rows.empty())
+        return false;
+
+    for (size_t row = 0; row < rows.size(); row++)
+    {
+        if (viewModel.GetHandle(row) != rows[row] ||
+            viewModel.GetRow(rows[row]) != row ||
+            viewModel.IsSelected(row) != (selected.count(rows[row]) != 0))
+        {
+            return false;
+        }
+    }
+
+    if (viewModel.GetSelectedCount() != selected.size())
+        return false;
+
+    std::vector<Handle> selectedHandles = viewModel.GetSelectedHandles();
+    if (selectedHandles.size() != selected.size())
+        return false;
+
+    // In row order.
+    size_t row = CPlayListViewModel::InvalidRow;
+    for (Handle handle: selectedHandles)
+    {
+        row = viewModel.GetNextSelected(row);
+        if (row == CPlayListViewModel::InvalidRow || viewModel.GetHandle(row) != handle)
+            return false;
+    }
+
+    return viewModel.GetNextSelected(row) == CPlayListViewModel::InvalidRow;
+}
+
+TEST(PlayListViewModel_Assign)
+{
+    CPlayListViewModel viewModel;
+    std::vector<Handle> source = { 5, 2, 9, 0 };
+
+    CHECK(viewModel.empty());
+    CHECK(viewModel.GetHandle(0) == CPlayListViewModel::InvalidHandle);
+    CHECK(viewModel.GetRow(0) == CPlayListViewModel::InvalidRow);
+
+    viewModel.Assign(source.begin(), source.end());
+    CHECK(IsExpected(viewModel, source, {}));
+
+    CHECK(viewModel.GetHandle(4) == CPlayListViewModel::InvalidHandle);
+    CHECK(viewModel.GetRow(1) == CPlayListViewModel::InvalidRow);
+    CHECK(viewModel.GetRow(100) == CPlayListViewModel::InvalidRow);
+
+    // A new playlist clears the selection.
+    viewModel.SetAllSelected(true);
+    CHECK(viewModel.GetSelectedCount() == 4);
+    viewModel.Assign(source.begin(), source.end());
+    CHECK(viewModel.GetSelectedCount() == 0);
+
+    viewModel.Clear();
+    CHECK(IsExpected(viewModel, {}, {}));
+}
+
+TEST(PlayListViewModel_Selection)
+{
+    CPlayListViewModel viewModel;
+    std::vector<Handle> source(200);
+    std::iota(source.begin(), source.end(), 0);
+    viewModel.Assign(source.begin(), source.end());
+
+    // Across a word boundary.
+    viewModel.SetSelected(60, 70, true);
+    CHECK(viewModel.GetSelectedCount() == 11);
+    CHECK(!viewModel.IsSelected(59));
+    CHECK(viewModel.IsSelected(60));
+    CHECK(viewModel.IsSelected(70));
+    CHECK(!viewModel.IsSelected(71));
+    CHECK(viewModel.GetNextSelected(CPlayListViewModel::InvalidRow) == 60);
+    CHECK(viewModel.GetNextSelected(63) == 64);
+    CHECK(viewModel.GetNextSelected(70) == CPlayListViewModel::InvalidRow);
+
+    // Selecting some again doesn't count them twice.
+    viewModel.SetSelected(65, 130, true);
+    CHECK(viewModel.GetSelectedCount() == 71);
+
+    viewModel.SetSelected(64, 64, false);
+    CHECK(viewModel.GetSelectedCount() == 70);
+    CHECK(!viewModel.IsSelected(64));
+
+    // Past the end is clipped.
+    viewModel.SetSelected(190, 1000, true);
+    CHECK(viewModel.GetSelectedCount() == 80);
+    CHECK(!viewModel.IsSelected(200));
+
+    viewModel.SetAllSelected(false);
+    CHECK(viewModel.GetSelectedCount() == 0);
+    CHECK(viewModel.GetNextSelected(CPlayListViewModel::InvalidRow) == CPlayListViewModel::InvalidRow);
+
+    viewModel.SetAllSelected(true);
+    CHECK(viewModel.GetSelectedCount() == 200);
+    CHECK(viewModel.GetSelectedHandles() == source);
+}
+
+TEST(PlayListViewModel_FilterAndSortKeepSelection)
+{
+    CPlayListViewModel viewModel;
+    std::vector<Handle> source = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    viewModel.Assign(source.begin(), source.end());
+
+    viewModel.SetSelected(2, 5, true);
+
+    // Selection is carried over by handle.
+    viewModel.SetSortOrder([] (Handle a, Handle b) { return a > b; });
+    CHECK(IsExpected(viewModel, { 7, 6, 5, 4, 3, 2, 1, 0 }, { 2, 3, 4, 5 }));
+
+    // Hidden entries are deselected.
+    viewModel.SetFilter([] (Handle handle) { return handle % 2 == 0; });
+    CHECK(IsExpected(viewModel, { 6, 4, 2, 0 }, { 2, 4 }));
+
+    // Equal entries stay in source order.
+    viewModel.SetSortOrder([] (Handle a, Handle b) { return a / 4 < b / 4; });
+    CHECK(IsExpected(viewModel, { 0, 2, 4, 6 }, { 2, 4 }));
+
+    viewModel.SetFilter(nullptr);
+    viewModel.SetSortOrder(nullptr);
+    CHECK(IsExpected(viewModel, source, { 2, 4 }));
+}
+
+TEST(PlayListViewModel_AppendAndRemove)
+{
+    CPlayListViewModel viewModel;
+    std::vector<Handle> source = { 10, 30, 50 };
+    viewModel.Assign(source.begin(), source.end());
+    viewModel.SetSelected(1, 2, true);
+
+    // Sorted views insert the new row in order, and the selection moves.
+    viewModel.SetSortOrder([] (Handle a, Handle b) { return a < b; });
+    CHECK(viewModel.Append(20) == 1);
+    CHECK(IsExpected(viewModel, { 10, 20, 30, 50 }, { 30, 50 }));
+
+    // Filtered out.
+    viewModel.SetFilter([] (Handle handle) { return handle != 40; });
+    CHECK(viewModel.Append(40) == CPlayListViewModel::InvalidRow);
+    CHECK(IsExpected(viewModel, { 10, 20, 30, 50 }, { 30, 50 }));
+
+    // Handles that aren't there, or aren't shown, are ignored.
+    CHECK(viewModel.Remove({ 30, 40, 99, CPlayListViewModel::InvalidHandle }) == 1);
+    CHECK(IsExpected(viewModel, { 10, 20, 50 }, { 50 }));
+
+    viewModel.SetFilter(nullptr);
+    CHECK(IsExpected(viewModel, { 10, 20, 50 }, { 50 }));
+}
+
+// Random operations, checked against a simple model.
+TEST(PlayListViewModel_MatchesModel)
+{
+    std::mt19937 random(7);
+
+    auto filter = [] (Handle handle) { return handle % 3 != 0; };
+    auto compare = [] (Handle a, Handle b) { return a % 5 < b % 5; };
+
+    for (int round = 0; round < 1000; round++)
+    {
+        CPlayListViewModel viewModel;
+        std::vector<Handle> source;
+        std::set<Handle> selected;
+        Handle nextHandle = 0;
+        bool isFiltered = false;
+        bool isSorted = false;
+
+        for (int step = 0; step < 60; step++)
+        {
+            switch (random() % 7)
+            {
+                case 0:
+                case 1:
+                    viewModel.Append(nextHandle);
+                    source.push_back(nextHandle++);
+                    break;
+
+                case 2:
+                    if (!source.empty())
+                    {
+                        std::vector<Handle> removed;
+                        for (int idx = 0; idx < 3; idx++)
+                            removed.push_back(source[random() % source.size()]);
+
+                        viewModel.Remove(removed);
+
+                        for (Handle handle: removed)
+                        {
+                            source.erase(std::remove(source.begin(), source.end(), handle), source.end());
+                            selected.erase(handle);
+                        }
+                    }
+                    break;
+
+                case 3:
+                    isFiltered = !isFiltered;
+                    viewModel.SetFilter(isFiltered ? CPlayListViewModel::FilterFunction(filter) : nullptr);
+                    break;
+
+                case 4:
+                    isSorted = !isSorted;
+                    viewModel.SetSortOrder(isSorted ? CPlayListViewModel::CompareFunction(compare) : nullptr);
+                    break;
+
+                case 5:
+                    if (!viewModel.empty())
+                    {
+                        size_t firstRow = random() % viewModel.size();
+                        size_t lastRow = firstRow + random() % 10;
+                        bool select = random() % 2 != 0;
+
+                        viewModel.SetSelected(firstRow, lastRow, select);
+
+                        for (size_t row = firstRow; row <= std::min(lastRow, viewModel.size() - 1); row++)
+                        {
+                            if (select)
+                                selected.insert(viewModel.GetHandle(row));
+                            else
+                                selected.erase(viewModel.GetHandle(row));
+                        }
+                    }
+                    break;
+
+                case 6:
+                {
+                    bool select = random() % 2 != 0;
+                    viewModel.SetAllSelected(select);
+
+                    selected.clear();
+                    for (size_t row = 0; select && row < viewModel.size(); row++)
+                        selected.insert(viewModel.GetHandle(row));
+                    break;
+                }
+            }
+
+            std::vector<Handle> rows;
+            std::copy_if(source.begin(), source.end(), std::back_inserter(rows),
+                         [&] (Handle handle) { return !isFiltered || filter(handle); });
+
+            if (isSorted)
+                std::stable_sort(rows.begin(), rows.end(), compare);
+
+            // Hidden entries are deselected.
+            std::set<Handle> visible(rows.begin(), rows.end());
+            for (auto it = selected.begin(); it != selected.end(); )
+                it = visible.count(*it) ? std::next(it) : selected.erase(it);
+
+            REQUIRE(IsExpected(viewModel, rows, selected));
+        }
+    }
+}
@@ -0,0 +1,298 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  PlaybackCursorTests.cpp
+//
+//  CPlaybackCursor tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+#include <set>
+
+#include "PlaybackCursor.h"
+
+// Make empty image files.
+static
+std::vector<fs::path>
+MakeImageFiles(
+    const fs::path& directory,
+    size_t fileCount
+)
+{
+    std::vector<fs::path> paths;
+
+    for (size_t fileNum = 0; fileNum < fileCount; fileNum++)
+    {
+        paths.push_back(directory / ("img" + std::to_string(fileNum) + ".jpg"));
+        std::ofstream(paths.back());
+    }
+
+    return paths;
+}
+
+// Load a list the way CPlayList::Load() does: clear it, and add the
+// files in order.
+static
+void
+LoadList(
+    CFileList& list,
+    const std::vector<fs::path>& paths
+)
+{
+    list.clear();
+
+    for (const fs::path& path: paths)
+        list.Add(path);
+}
+
+// Get the full paths of files.
+static
+std::vector<fs::path>
+GetPaths(
+    const CFileList& list,
+    const std::vector<FileHandle>& files
+)
+{
+    std::vector<fs::path> paths;
+
+    for (FileHandle hFile: files)
+        paths.push_back(list.GetFullPath(hFile));
+
+    return paths;
+}
+
+// Move forward count times, and get the files moved to.
+static
+std::vector<FileHandle>
+MoveForward(
+    CPlaybackCursor& cursor,
+    const CFileList& list,
+    size_t count
+)
+{
+    std::vector<FileHandle> files;
+
+    for (size_t move = 0; move < count; move++)
+        files.push_back(cursor.Move(list, true));
+
+    return files;
+}
+
+TEST(PlaybackCursor_VisitsEveryFileOncePerCycle)
+{
+    fs::path directory = GetTestDirectory("PlaybackCursor_VisitsEveryFileOncePerCycle");
+
+    CFileList list;
+    LoadList(list, MakeImageFiles(directory, 50));
+
+    CPlaybackCursor cursor;
+    cursor.Reset(list, 1, 0);
+
+    std::vector<FileHandle> cycle = { cursor.GetFile() };
+    std::vector<FileHandle> upcoming = cursor.GetUpcomingFiles(list, 100);
+    cycle.insert(cycle.end(), upcoming.begin(), upcoming.end());
+
+    CHECK(cycle.size() == 50);
+    CHECK(std::set<FileHandle>(cycle.begin(), cycle.end()).size() == 50);
+
+    // Moving goes through the same files.
+    std::vector<FileHandle> moved = MoveForward(cursor, list, 49);
+    CHECK(moved == upcoming);
+
+    // The next cycle has all of them again, in another order.
+    std::vector<FileHandle> nextCycle = MoveForward(cursor, list, 50);
+    CHECK(std::set<FileHandle>(nextCycle.begin(), nextCycle.end()).size() == 50);
+    CHECK(nextCycle != cycle);
+
+    // The same seed gives the same order.
+    CPlaybackCursor sameCursor;
+    sameCursor.Reset(list, 1, 0);
+    CHECK(sameCursor.GetFile() == cycle[0]);
+    CHECK(sameCursor.GetUpcomingFiles(list, 100) == upcoming);
+}
+
+TEST(PlaybackCursor_SkipsRemovedFiles)
+{
+    fs::path directory = GetTestDirectory("PlaybackCursor_SkipsRemovedFiles");
+
+    CFileList list;
+    LoadList(list, MakeImageFiles(directory, 20));
+
+    CPlaybackCursor cursor;
+    cursor.Reset(list, 2, 0);
+    MoveForward(cursor, list, 5);
+
+    std::vector<FileHandle> upcoming = cursor.GetUpcomingFiles(list, 100);
+    REQUIRE(upcoming.size() == 14);
+
+    // Remove files that are coming up (and the current one).
+    list.Remove(upcoming[0]);
+    list.Remove(upcoming[7]);
+    list.Remove(cursor.GetFile());
+
+    std::vector<FileHandle> expected = upcoming;
+    expected.erase(expected.begin() + 7);
+    expected.erase(expected.begin());
+
+    CHECK(cursor.GetUpcomingFiles(list, 100) == expected);
+    CHECK(MoveForward(cursor, list, expected.size()) == expected);
+
+    // And the next cycle only has the files that are left.
+    std::vector<FileHandle> nextCycle = MoveForward(cursor, list, list.size());
+    CHECK(std::set<FileHandle>(nextCycle.begin(), nextCycle.end()) == std::set<FileHandle>(list.begin(), list.end()));
+}
+
+TEST(PlaybackCursor_AddedFilesWaitForNextCycle)
+{
+    fs::path directory = GetTestDirectory("PlaybackCursor_AddedFilesWaitForNextCycle");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 22);
+
+    CFileList list;
+    LoadList(list, std::vector<fs::path>(paths.begin(), paths.begin() + 20));
+
+    CPlaybackCursor cursor;
+    cursor.Reset(list, 3, 0);
+    MoveForward(cursor, list, 4);
+
+    std::vector<FileHandle> upcoming = cursor.GetUpcomingFiles(list, 100);
+    REQUIRE(upcoming.size() == 15);
+
+    // One new file gets a new handle, and one gets the handle of a file
+    // that's coming up. Neither is in this cycle.
+    list.Add(paths[20]);
+    list.Remove(upcoming[3]);
+    list.Add(paths[21]);
+
+    FileHandle hNewFile = list.Lookup(paths[20]);
+    FileHandle hRecycledFile = list.Lookup(paths[21]);
+    CHECK(hRecycledFile == upcoming[3]);
+
+    upcoming.erase(upcoming.begin() + 3);
+    CHECK(cursor.GetUpcomingFiles(list, 100) == upcoming);
+
+    // Picking a new file plays it, but the cycle carries on where it was.
+    cursor.SetFile(list, hNewFile);
+    CHECK(cursor.GetFile() == hNewFile);
+
+    CHECK(MoveForward(cursor, list, upcoming.size()) == upcoming);
+
+    // The next cycle has them.
+    std::vector<FileHandle> nextCycle = MoveForward(cursor, list, list.size());
+    CHECK(std::set<FileHandle>(nextCycle.begin(), nextCycle.end()) == std::set<FileHandle>(list.begin(), list.end()));
+}
+
+TEST(PlaybackCursor_PreviousWraps)
+{
+    fs::path directory = GetTestDirectory("PlaybackCursor_PreviousWraps");
+
+    CFileList list;
+    LoadList(list, MakeImageFiles(directory, 10));
+
+    CPlaybackCursor cursor;
+    cursor.Reset(list, 4, 0);
+
+    FileHandle hFirstFile = cursor.GetFile();
+    std::vector<FileHandle> upcoming = cursor.GetUpcomingFiles(list, 100);
+    REQUIRE(upcoming.size() == 9);
+
+    // Back and forth.
+    CHECK(cursor.Move(list, true) == upcoming[0]);
+    CHECK(cursor.Move(list, true) == upcoming[1]);
+    CHECK(cursor.Move(list, false) == upcoming[0]);
+    CHECK(cursor.Move(list, false) == hFirstFile);
+
+    // Back from the first file goes to the last file of the same cycle.
+    CHECK(cursor.Move(list, false) == upcoming[8]);
+    CHECK(cursor.Move(list, false) == upcoming[7]);
+
+    // Also when the last file has been removed.
+    cursor.Reset(list, 4, 0);
+    list.Remove(upcoming[8]);
+    CHECK(cursor.Move(list, false) == upcoming[7]);
+}
+
+TEST(PlaybackCursor_PositionSurvivesReload)
+{
+    fs::path directory = GetTestDirectory("PlaybackCursor_PositionSurvivesReload");
+    std::vector<fs::path> paths = MakeImageFiles(directory, 31);
+
+    std::vector<fs::path> loadedPaths(paths.begin(), paths.begin() + 30);
+
+    CFileList list;
+    LoadList(list, loadedPaths);
+
+    // Play some files, and edit the list the way the journal would
+    // replay it: a file removed, and one added mid-cycle.
+    CPlaybackCursor cursor;
+    cursor.Reset(list, 5, 0);
+    MoveForward(cursor, list, 7);
+
+    FileHandle hRemovedFile = cursor.GetUpcomingFiles(list, 1)[0];
+    fs::path removedPath = list.GetFullPath(hRemovedFile);
+    list.Remove(hRemovedFile);
+    list.Add(paths[30]);
+
+    CPlaybackPosition position = cursor.GetPosition(list);
+    CHECK(position.m_Seed == 5);
+    CHECK(position.m_FilePath == list.GetFullPath(cursor.GetFile()).wstring());
+
+    std::vector<fs::path> upcoming = GetPaths(list, cursor.GetUpcomingFiles(list, 100));
+    CHECK(upcoming.size() == 21);
+
+    // Load it again the same way, in another list, and in the same list
+    // (whose add count keeps going).
+    auto Reload = /*LAMBDA*/ [&] (CFileList& reloadedList)
+    {
+        LoadList(reloadedList, loadedPaths);
+        reloadedList.Remove(removedPath);
+        reloadedList.Add(paths[30]);
+    };
+
+    for (bool sameList: { false, true })
+    {
+        CFileList otherList;
+        CFileList& reloadedList = sameList ? list : otherList;
+        Reload(reloadedList);
+
+        CPlaybackCursor reloadedCursor;
+        CHECK(reloadedCursor.SetPosition(reloadedList, position));
+        CHECK(reloadedList.GetFullPath(reloadedCursor.GetFile()) == position.m_FilePath);
+
+        // The rest of the cycle is the same, still without the file added
+        // during it.
+        CHECK(GetPaths(reloadedList, reloadedCursor.GetUpcomingFiles(reloadedList, 100)) == upcoming);
+    }
+
+    // The playlist file is rewritten in another order (e.g. compacted),
+    // so the handles are different. Starts a new cycle at the same file.
+    std::vector<fs::path> rewrittenPaths(list.size());
+    std::transform(list.begin(), list.end(), rewrittenPaths.begin(), [&list] (FileHandle hFile) { return list.GetFullPath(hFile); });
+    std::reverse(rewrittenPaths.begin(), rewrittenPaths.end());
+
+    CFileList rewrittenList;
+    LoadList(rewrittenList, rewrittenPaths);
+
+    CPlaybackCursor rewrittenCursor;
+    CHECK(!rewrittenCursor.SetPosition(rewrittenList, position));
+    CHECK(rewrittenList.GetFullPath(rewrittenCursor.GetFile()) == position.m_FilePath);
+
+    // Not the same handles (nor maybe the file). Starts a new cycle.
+    CFileList smallerList;
+    LoadList(smallerList, std::vector<fs::path>(paths.begin(), paths.begin() + 3));
+
+    CPlaybackCursor smallerCursor;
+    CHECK(!smallerCursor.SetPosition(smallerList, position));
+    CHECK(smallerList.IsValid(smallerCursor.GetFile()));
+}
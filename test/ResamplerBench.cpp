@@ -0,0 +1,218 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ResamplerBench.cpp
+//
+//  CResampler benchmarks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include "Resampler.h"
+
+static const char* const FilterNames[] = { "box", "bilinear", "bicubic", "lanczos3" };
+
+static const char* const KernelNames[] = { "scalar", "sse2", "avx2" };
+
+// Source and destination sizes.
+struct ResampleSizes
+{
+    SIZE m_SrcSize;
+    SIZE m_DstSize;
+};
+
+// An image of noise. (The resampler does the same work whatever the
+// pixels are, so it doesn't need to look like a photo.)
+static
+std::vector<uint32_t>
+MakeBenchImage(
+    SIZE size
+)
+{
+    std::mt19937 random(1);
+    std::vector<uint32_t> image((size_t) size.cx * size.cy);
+
+    for (uint32_t& pixel: image)
+        pixel = (uint32_t) random();
+
+    return image;
+}
+
+// A 24 megapixel photo to a 4K monitor, on one thread, with each filter
+// and each kernel the CPU supports.
+BENCHMARK(Resample6000x4000To3840x2160)
+{
+    for (const ResampleSizes& sizes: GetBenchSizes<ResampleSizes>({ { { 600, 400 }, { 384, 216 } },
+                                                                    { { 6000, 4000 }, { 3840, 2160 } } }))
+    {
+        printf(" %dx%d -> %dx%d\n", sizes.m_SrcSize.cx, sizes.m_SrcSize.cy, sizes.m_DstSize.cx, sizes.m_DstSize.cy);
+
+        std::vector<uint32_t> src = MakeBenchImage(sizes.m_SrcSize);
+        std::vector<uint32_t> dst((size_t) sizes.m_DstSize.cx * sizes.m_DstSize.cy);
+
+        for (ResampleFilter filter: { FILTER_Box, FILTER_Bilinear, FILTER_Bicubic, FILTER_Lanczos3 })
+        {
+            for (int kernel = KERNEL_Scalar; kernel <= CResampler::GetBestKernel(); kernel++)
+            {
+                CResampler resampler(filter, 1);
+                resampler.SetKernel((ResampleKernel) kernel);
+
+                CLatencyStats stats;
+
+                // The first one computes the weights, and isn't timed.
+                for (size_t repeat = 0; repeat <= GetBenchRepeatCount(5); repeat++)
+                {
+                    CStopwatch stopwatch;
+
+                    resampler.Resample(src.data(),
+                                       sizes.m_SrcSize.cx,
+                                       sizes.m_SrcSize.cx,
+                                       sizes.m_SrcSize.cy,
+                                       dst.data(),
+                                       sizes.m_DstSize.cx,
+                                       sizes.m_DstSize.cx,
+                                       sizes.m_DstSize.cy);
+
+                    if (repeat != 0)
+                        stats.Add(stopwatch.GetElapsedMs());
+                }
+
+                char name[64];
+                snprintf(name, sizeof(name), "%s, %s", FilterNames[filter], KernelNames[kernel]);
+                stats.Report(name);
+            }
+        }
+    }
+}
+
+// Resize to a 4K monitor, and to three 4K monitors side by side (a span
+// wallpaper), on 1, 2, 4... threads up to the number of processors.
+BENCHMARK(ResampleThreadScaling)
+{
+    unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+        threadCounts.push_back(threadCount);
+
+    threadCounts.push_back(maxThreads);
+
+    if (IsQuickRun())
+        threadCounts.resize(std::min(threadCounts.size(), (size_t) 2));
+
+    for (const ResampleSizes& sizes: GetBenchSizes<ResampleSizes>({ { { 1200, 800 }, { 1536, 864 } },
+                                                                    { { 6000, 4000 }, { 3840, 2160 } },
+                                                                    { { 12000, 2250 }, { 11520, 2160 } } }))
+    {
+        printf(" %dx%d -> %dx%d, lanczos3\n", sizes.m_SrcSize.cx, sizes.m_SrcSize.cy, sizes.m_DstSize.cx, sizes.m_DstSize.cy);
+
+        std::vector<uint32_t> src = MakeBenchImage(sizes.m_SrcSize);
+        std::vector<uint32_t> dst((size_t) sizes.m_DstSize.cx * sizes.m_DstSize.cy);
+
+        double oneThreadMs = 0.0;
+
+        for (unsigned threadCount: threadCounts)
+        {
+            CResampler resampler(FILTER_Lanczos3, threadCount);
+            CLatencyStats stats;
+
+            // The first one computes the weights, and isn't timed.
+            for (size_t repeat = 0; repeat <= GetBenchRepeatCount(5); repeat++)
+            {
+                CStopwatch stopwatch;
+
+                resampler.Resample(src.data(),
+                                   sizes.m_SrcSize.cx,
+                                   sizes.m_SrcSize.cx,
+                                   sizes.m_SrcSize.cy,
+                                   dst.data(),
+                                   sizes.m_DstSize.cx,
+                                   sizes.m_DstSize.cx,
+                                   sizes.m_DstSize.cy);
+
+                if (repeat != 0)
+                    stats.Add(stopwatch.GetElapsedMs());
+            }
+
+            if (threadCount == 1)
+                oneThreadMs = stats.GetPercentile(50.0);
+
+            char name[64];
+            snprintf(name, sizeof(name), "threads=%u (%.2fx)", threadCount, oneThreadMs / stats.GetPercentile(50.0));
+            stats.Report(name);
+        }
+    }
+}
+
+// What linear light costs: each filter with and without it, on one
+// thread with the best kernel the CPU supports.
+BENCHMARK(ResampleLinearLight)
+{
+    for (const ResampleSizes& sizes: GetBenchSizes<ResampleSizes>({ { { 600, 400 }, { 384, 216 } },
+                                                                    { { 6000, 4000 }, { 3840, 2160 } } }))
+    {
+        printf(" %dx%d -> %dx%d, %s\n",
+               sizes.m_SrcSize.cx,
+               sizes.m_SrcSize.cy,
+               sizes.m_DstSize.cx,
+               sizes.m_DstSize.cy,
+               KernelNames[CResampler::GetBestKernel()]);
+
+        std::vector<uint32_t> src = MakeBenchImage(sizes.m_SrcSize);
+        std::vector<uint32_t> dst((size_t) sizes.m_DstSize.cx * sizes.m_DstSize.cy);
+
+        for (ResampleFilter filter: { FILTER_Box, FILTER_Bilinear, FILTER_Bicubic, FILTER_Lanczos3 })
+        {
+            double gammaMs = 0.0;
+
+            for (bool linearLight: { false, true })
+            {
+                CResampler resampler(filter, 1);
+                resampler.SetLinearLight(linearLight);
+
+                CLatencyStats stats;
+
+                // The first one computes the weights, and isn't timed.
+                for (size_t repeat = 0; repeat <= GetBenchRepeatCount(5); repeat++)
+                {
+                    CStopwatch stopwatch;
+
+                    resampler.Resample(src.data(),
+                                       sizes.m_SrcSize.cx,
+                                       sizes.m_SrcSize.cx,
+                                       sizes.m_SrcSize.cy,
+                                       dst.data(),
+                                       sizes.m_DstSize.cx,
+                                       sizes.m_DstSize.cx,
+                                       sizes.m_DstSize.cy);
+
+                    if (repeat != 0)
+                        stats.Add(stopwatch.GetElapsedMs());
+                }
+
+                char name[64];
+                if (!linearLight)
+                {
+                    gammaMs = stats.GetPercentile(50.0);
+                    snprintf(name, sizeof(name), "%s, sRGB", FilterNames[filter]);
+                }
+                else
+                {
+                    snprintf(name, sizeof(name), "%s, linear (%.2fx)", FilterNames[filter], stats.GetPercentile(50.0) / gammaMs);
+                }
+
+                stats.Report(name);
+            }
+        }
+    }
+}
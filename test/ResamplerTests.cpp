@@ -0,0 +1,435 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ResamplerTests.cpp
+//
+//  CResampler tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <cmath>
+
+#include "Resampler.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Reference resampler
+//
+//  The textbook version: floating point weights for every source pixel,
+//  straight from the filter function, and no fixed point, tables, or SIMD.
+//  The intermediate image is rounded to 8 bits, like CResampler's.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static
+double
+ReferenceFilter(
+    ResampleFilter filter,
+    double x
+)
+{
+    const double pi = 3.14159265358979323846;
+
+    auto sinc = [pi] (double v) { return (v == 0.0) ? 1.0 : std::sin(v * pi) / (v * pi); };
+
+    switch (filter)
+    {
+        case FILTER_Box:
+            return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+
+        case FILTER_Bilinear:
+            return std::max(1.0 - std::abs(x), 0.0);
+
+        case FILTER_Bicubic:
+        {
+            // Catmull-Rom.
+            double t = std::abs(x);
+
+            if (t < 1.0)
+                return 1.5 * t * t * t - 2.5 * t * t + 1.0;
+
+            if (t < 2.0)
+                return -0.5 * t * t * t + 2.5 * t * t - 4.0 * t + 2.0;
+
+            return 0.0;
+        }
+
+        case FILTER_Lanczos3:
+        default:
+            return (std::abs(x) < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+}
+
+// Weights for each destination pixel: a weight for every source pixel.
+static
+std::vector<std::vector<double>>
+GetReferenceWeights(
+    ResampleFilter filter,
+    int srcSize,
+    int dstSize
+)
+{
+    double scale = (double) srcSize / dstSize;
+    double filterScale = std::max(scale, 1.0);
+
+    std::vector<std::vector<double>> weights(dstSize, std::vector<double>(srcSize));
+
+    for (int dst = 0; dst < dstSize; dst++)
+    {
+        double center = (dst + 0.5) * scale;
+        double total = 0.0;
+
+        for (int src = 0; src < srcSize; src++)
+        {
+            weights[dst][src] = ReferenceFilter(filter, (src + 0.5 - center) / filterScale);
+            total += weights[dst][src];
+        }
+
+        for (double& weight: weights[dst])
+            weight /= total;
+    }
+
+    return weights;
+}
+
+static
+uint32_t
+ReferenceChannel(
+    double value
+)
+{
+    return (uint32_t) std::clamp(std::round(value), 0.0, 255.0);
+}
+
+static
+std::vector<uint32_t>
+ReferenceResample(
+    ResampleFilter filter,
+    const std::vector<uint32_t>& src,
+    int srcWidth,
+    int srcHeight,
+    int dstWidth,
+    int dstHeight
+)
+{
+    std::vector<std::vector<double>> horizontal = GetReferenceWeights(filter, srcWidth, dstWidth);
+    std::vector<std::vector<double>> vertical = GetReferenceWeights(filter, srcHeight, dstHeight);
+
+    std::vector<uint32_t> intermediate((size_t) dstWidth * srcHeight);
+    std::vector<uint32_t> dst((size_t) dstWidth * dstHeight);
+
+    for (int y = 0; y < srcHeight; y++)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            uint32_t pixel = 0;
+
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                double sum = 0.0;
+
+                for (int srcX = 0; srcX < srcWidth; srcX++)
+                    sum += horizontal[x][srcX] * ((src[(size_t) y * srcWidth + srcX] >> shift) & 0xFF);
+
+                pixel |= ReferenceChannel(sum) << shift;
+            }
+
+            intermediate[(size_t) y * dstWidth + x] = pixel;
+        }
+    }
+
+    for (int y = 0; y < dstHeight; y++)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            uint32_t pixel = 0;
+
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                double sum = 0.0;
+
+                for (int srcY = 0; srcY < srcHeight; srcY++)
+                    sum += vertical[y][srcY] * ((intermediate[(size_t) srcY * dstWidth + x] >> shift) & 0xFF);
+
+                pixel |= ReferenceChannel(sum) << shift;
+            }
+
+            dst[(size_t) y * dstWidth + x] = pixel;
+        }
+    }
+
+    return dst;
+}
+
+// Largest difference between the channels of two images.
+static
+int
+GetMaxDifference(
+    const std::vector<uint32_t>& image1,
+    const std::vector<uint32_t>& image2
+)
+{
+    int maxDifference = 0;
+
+    for (size_t idx = 0; idx < image1.size(); idx++)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            int difference = std::abs((int) ((image1[idx] >> shift) & 0xFF) - (int) ((image2[idx] >> shift) & 0xFF));
+            maxDifference = std::max(maxDifference, difference);
+        }
+    }
+
+    return maxDifference;
+}
+
+// Random noise, or a smooth image (gradients, which the filters
+// don't overshoot much).
+static
+std::vector<uint32_t>
+MakeImage(
+    std::mt19937& random,
+    int width,
+    int height,
+    bool smooth
+)
+{
+    std::vector<uint32_t> image((size_t) width * height);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            image[(size_t) y * width + x] = smooth ? (uint32_t) ((x * 7 + y * 3) & 0xFF) |
+                                                     (uint32_t) ((x * x + y) & 0xFF) << 8 |
+                                                     (uint32_t) ((y * 5) & 0xFF) << 16 |
+                                                     0xFF000000
+                                                   : (uint32_t) random();
+        }
+    }
+
+    return image;
+}
+
+static
+std::vector<uint32_t>
+Resample(
+    CResampler& resampler,
+    const std::vector<uint32_t>& src,
+    int srcWidth,
+    int srcHeight,
+    int dstWidth,
+    int dstHeight
+)
+{
+    std::vector<uint32_t> dst((size_t) dstWidth * dstHeight);
+
+    resampler.Resample(src.data(), srcWidth, srcWidth, srcHeight, dst.data(), dstWidth, dstWidth, dstHeight);
+
+    return dst;
+}
+
+static const ResampleFilter AllFilters[] = { FILTER_Box, FILTER_Bilinear, FILTER_Bicubic, FILTER_Lanczos3 };
+
+static const ResampleKernel AllKernels[] = { KERNEL_Scalar, KERNEL_SSE2, KERNEL_AVX2 };
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Tests
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Random sizes (shrinking, enlarging, and both at once), every filter
+// and kernel. The only difference from the reference is the 14-bit
+// fixed point weights, which can move an intermediate channel by one.
+// Filters with negative lobes (bicubic and Lanczos) can magnify that in
+// the second pass, since their weights' magnitudes add up to more than
+// one.
+TEST(Resampler_MatchesReference)
+{
+    std::mt19937 random(5);
+
+    for (int round = 0; round < 300; round++)
+    {
+        int srcWidth = 1 + random() % 90;
+        int srcHeight = 1 + random() % 60;
+        int dstWidth = 1 + random() % 90;
+        int dstHeight = 1 + random() % 60;
+        ResampleFilter filter = AllFilters[random() % 4];
+        int tolerance = (filter == FILTER_Box || filter == FILTER_Bilinear) ? 1 : 2;
+
+        std::vector<uint32_t> src = MakeImage(random, srcWidth, srcHeight, random() % 2 != 0);
+        std::vector<uint32_t> expected = ReferenceResample(filter, src, srcWidth, srcHeight, dstWidth, dstHeight);
+
+        for (ResampleKernel kernel: AllKernels)
+        {
+            CResampler resampler(filter);
+            resampler.SetKernel(kernel);
+
+            std::vector<uint32_t> dst = Resample(resampler, src, srcWidth, srcHeight, dstWidth, dstHeight);
+
+            REQUIRE(GetMaxDifference(dst, expected) <= tolerance);
+        }
+    }
+}
+
+// The SIMD kernels give exactly the same result as the scalar kernel.
+TEST(Resampler_KernelsMatch)
+{
+    std::mt19937 random(7);
+
+    for (int round = 0; round < 200; round++)
+    {
+        int srcWidth = 1 + random() % 300;
+        int srcHeight = 1 + random() % 100;
+        int dstWidth = 1 + random() % 300;
+        int dstHeight = 1 + random() % 100;
+        ResampleFilter filter = AllFilters[random() % 4];
+        bool linearLight = random() % 2 != 0;
+
+        std::vector<uint32_t> src = MakeImage(random, srcWidth, srcHeight, false);
+        std::vector<uint32_t> expected;
+
+        for (ResampleKernel kernel: AllKernels)
+        {
+            CResampler resampler(filter);
+            resampler.SetKernel(kernel);
+            resampler.SetLinearLight(linearLight);
+
+            std::vector<uint32_t> dst = Resample(resampler, src, srcWidth, srcHeight, dstWidth, dstHeight);
+
+            if (kernel == KERNEL_Scalar)
+                expected = dst;
+            else
+                REQUIRE(dst == expected);
+        }
+    }
+}
+
+TEST(Resampler_BestKernel)
+{
+    CResampler resampler;
+    CHECK(resampler.GetKernel() == CResampler::GetBestKernel());
+
+    // Unsupported kernels are replaced by the best one there is.
+    resampler.SetKernel(KERNEL_AVX2);
+    CHECK(resampler.GetKernel() <= CResampler::GetBestKernel());
+
+    resampler.SetKernel(KERNEL_Scalar);
+    CHECK(resampler.GetKernel() == KERNEL_Scalar);
+}
+
+// Weights add up to exactly one, so a solid color stays exactly the same.
+TEST(Resampler_SolidColor)
+{
+    const uint32_t color = 0x80C04020;
+
+    std::vector<uint32_t> src(37 * 23, color);
+
+    for (ResampleFilter filter: AllFilters)
+    {
+        for (SIZE dstSize: { SIZE{ 5, 3 }, SIZE{ 36, 24 }, SIZE{ 200, 91 } })
+        {
+            CResampler resampler(filter);
+
+            std::vector<uint32_t> dst = Resample(resampler, src, 37, 23, dstSize.cx, dstSize.cy);
+
+            CHECK(std::all_of(dst.begin(), dst.end(), [color] (uint32_t pixel) { return pixel == color; }));
+        }
+    }
+}
+
+// Resampling to the same size doesn't change anything.
+TEST(Resampler_SameSize)
+{
+    std::mt19937 random(11);
+    std::vector<uint32_t> src = MakeImage(random, 61, 17, false);
+
+    for (ResampleFilter filter: AllFilters)
+    {
+        CResampler resampler(filter);
+        CHECK(Resample(resampler, src, 61, 17, 61, 17) == src);
+    }
+}
+
+// Strides: resampling part of a bigger image into part of another is the
+// same as resampling a copy of that part on its own. The rest of the
+// destination isn't touched.
+TEST(Resampler_Strides)
+{
+    std::mt19937 random(13);
+
+    const int bigWidth = 100;
+    const int bigHeight = 50;
+    std::vector<uint32_t> big = MakeImage(random, bigWidth, bigHeight, false);
+
+    std::vector<uint32_t> part((size_t) 60 * 35);
+    for (int y = 0; y < 35; y++)
+        std::copy_n(big.begin() + (y + 5) * bigWidth + 7, 60, part.begin() + y * 60);
+
+    CResampler resampler;
+    std::vector<uint32_t> expected = Resample(resampler, part, 60, 35, 40, 30);
+
+    std::vector<uint32_t> dst((size_t) 70 * 40, 0x12345678);
+    resampler.Resample(big.data() + 5 * bigWidth + 7, bigWidth, 60, 35, dst.data() + 3 * 70 + 2, 70, 40, 30);
+
+    for (int y = 0; y < 40; y++)
+    {
+        for (int x = 0; x < 70; x++)
+        {
+            uint32_t pixel = dst[(size_t) y * 70 + x];
+
+            if (y >= 3 && y < 33 && x >= 2 && x < 42)
+                REQUIRE(pixel == expected[(size_t) (y - 3) * 40 + (x - 2)]);
+            else
+                REQUIRE(pixel == 0x12345678);
+        }
+    }
+
+    // The weights are reused for the next image of the same size.
+    CHECK(Resample(resampler, part, 60, 35, 40, 30) == expected);
+}
+
+// Splitting the image into bands on several threads gives exactly the
+// same result as one thread, however many bands there are.
+TEST(Resampler_ConcurrencyMatches)
+{
+    std::mt19937 random(17);
+
+    // Big enough for eight bands, shrinking and enlarging.
+    const int dstWidth = 2048;
+    const int dstHeight = 1024;
+
+    for (SIZE srcSize: { SIZE{ 3001, 1607 }, SIZE{ 1499, 803 } })
+    {
+        std::vector<uint32_t> src = MakeImage(random, srcSize.cx, srcSize.cy, false);
+
+        for (ResampleFilter filter: { FILTER_Bilinear, FILTER_Lanczos3 })
+        {
+            for (bool linearLight: { false, true })
+            {
+                CResampler resampler(filter, 1);
+                resampler.SetLinearLight(linearLight);
+
+                std::vector<uint32_t> expected = Resample(resampler, src, srcSize.cx, srcSize.cy, dstWidth, dstHeight);
+
+                for (unsigned concurrency: { 2U, 3U, 8U, 0U })
+                {
+                    resampler.SetConcurrency(concurrency);
+                    REQUIRE(Resample(resampler, src, srcSize.cx, srcSize.cy, dstWidth, dstHeight) == expected);
+                }
+            }
+        }
+    }
+}
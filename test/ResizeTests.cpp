@@ -0,0 +1,486 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ResizeTests.cpp
+//
+//  ResizeWallpaperPixels(), linear light resampling, and thumbnail pyramid
+//  downsampling tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <cmath>
+
+#include "Resize.h"
+#include "ThumbnailPyramid.h"
+
+// A test picture with the things resizing gets wrong: hard black and
+// white edges, one pixel lines, a checkerboard, smooth gradients in each
+// channel, and saturated colors. Odd sized, so nothing divides evenly.
+static
+std::vector<uint32_t>
+MakeTestPicture(
+    SIZE size
+)
+{
+    std::vector<uint32_t> pixels((size_t) size.cx * size.cy);
+
+    for (int y = 0; y < size.cy; y++)
+    {
+        for (int x = 0; x < size.cx; x++)
+        {
+            uint32_t pixel;
+
+            if (x < size.cx / 4)
+            {
+                // Checkerboard.
+                pixel = ((x + y) % 2 != 0) ? 0xFFFFFF : 0x000000;
+            }
+            else if (x < size.cx / 2)
+            {
+                // Thin lines on gray.
+                pixel = (y % 5 == 0) ? 0xFFFFFF : (x % 7 == 0) ? 0x000000 : 0x808080;
+            }
+            else if (y < size.cy / 2)
+            {
+                // Gradients.
+                pixel = (uint32_t) (x * 255 / size.cx) << 16 |
+                        (uint32_t) (y * 255 / size.cy) << 8 |
+                        (uint32_t) ((x + y) * 255 / (size.cx + size.cy));
+            }
+            else
+            {
+                // Saturated color blocks.
+                static const uint32_t colors[] = { 0xFF0000, 0x00FF00, 0x0000FF, 0xFFFF00 };
+                pixel = colors[(x / 6 + y / 6) % 4];
+            }
+
+            pixels[(size_t) y * size.cx + x] = pixel | 0xFF000000;
+        }
+    }
+
+    return pixels;
+}
+
+// FNV-1a hash of an image's pixels.
+static
+uint64_t
+HashPixels(
+    const std::vector<uint32_t>& pixels
+)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint32_t pixel: pixels)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            hash ^= (pixel >> shift) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+static
+std::vector<uint32_t>
+Resize(
+    const std::vector<uint32_t>& src,
+    SIZE srcSize,
+    SIZE dstSize,
+    WallpaperResizeMode resizeMode,
+    bool linearLight,
+    ResampleFilter filter = FILTER_Lanczos3
+)
+{
+    std::vector<uint32_t> dst((size_t) dstSize.cx * dstSize.cy);
+
+    ResizeWallpaperPixels(src.data(), srcSize, dst.data(), dstSize, resizeMode, RGB(40, 80, 120), filter, linearLight);
+
+    return dst;
+}
+
+// Get one channel (0 = blue, 1 = green, 2 = red, 3 = alpha) of a pixel.
+static
+int
+GetChannel(
+    uint32_t pixel,
+    int channel
+)
+{
+    return (int) (pixel >> (channel * 8)) & 0xFF;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Golden images
+//
+//  The test picture resized every way the app resizes wallpapers and
+//  thumbnails, compared to the results of a version that was checked by
+//  eye (as hashes, to keep the images out of the source). If a change is
+//  meant to change the results, look at the new images, and then update
+//  the hashes from the test's output.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+struct GoldenImage
+{
+    WallpaperResizeMode m_ResizeMode;
+    bool m_LinearLight;
+    SIZE m_DstSize;
+    uint64_t m_Hash;
+};
+
+static const SIZE GoldenSrcSize = { 97, 61 };
+
+static const GoldenImage GoldenImages[] =
+{
+    { RESIZE_Center,  false, { 40, 30 },  0xb19e71e4e5a73842ULL },
+    { RESIZE_Center,  false, { 160, 90 }, 0xe9131cbebbfa8d7fULL },
+    { RESIZE_Tile,    false, { 40, 30 },  0xa2267c96eedb3225ULL },
+    { RESIZE_Tile,    false, { 160, 90 }, 0x6fc02cc90b6735c9ULL },
+    { RESIZE_Stretch, false, { 40, 30 },  0x9ae28967af4647d9ULL },
+    { RESIZE_Stretch, false, { 160, 90 }, 0x2d1f6009e5d92845ULL },
+    { RESIZE_Stretch, true,  { 40, 30 },  0x7b2e4997cfe07c5dULL },
+    { RESIZE_Stretch, true,  { 160, 90 }, 0xa3918b9f47c9221bULL },
+    { RESIZE_Fit,     false, { 40, 30 },  0xe1a22a39357cf154ULL },
+    { RESIZE_Fit,     false, { 160, 90 }, 0x9c45a19a03e5ae45ULL },
+    { RESIZE_Fit,     true,  { 40, 30 },  0x23038415201472dbULL },
+    { RESIZE_Fit,     true,  { 160, 90 }, 0x50589f58c0955dc3ULL },
+    { RESIZE_Fill,    false, { 40, 30 },  0x0c3b50d2463f1316ULL },
+    { RESIZE_Fill,    false, { 160, 90 }, 0x064883259cfa2086ULL },
+    { RESIZE_Fill,    true,  { 40, 30 },  0x640653a7cd446c72ULL },
+    { RESIZE_Fill,    true,  { 160, 90 }, 0x1e8c33ed36e1d491ULL },
+    { RESIZE_Span,    false, { 160, 30 }, 0xb9833082ad130943ULL },
+    { RESIZE_Span,    true,  { 160, 30 }, 0x081d01e2efedb23cULL },
+};
+
+TEST(Resize_GoldenImages)
+{
+    std::vector<uint32_t> src = MakeTestPicture(GoldenSrcSize);
+
+    for (const GoldenImage& golden: GoldenImages)
+    {
+        uint64_t hash = HashPixels(Resize(src, GoldenSrcSize, golden.m_DstSize, golden.m_ResizeMode, golden.m_LinearLight));
+
+        if (hash != golden.m_Hash)
+        {
+            printf("  Resize mode %d, linear light %d, %dx%d: hash is 0x%016llxULL\n",
+                   golden.m_ResizeMode,
+                   golden.m_LinearLight,
+                   golden.m_DstSize.cx,
+                   golden.m_DstSize.cy,
+                   (unsigned long long) hash);
+        }
+
+        CHECK(hash == golden.m_Hash);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Linear light
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Halving a black and white checkerboard gives 50% intensity. In sRGB
+// that's 188, not the 128 that averaging the sRGB values gives. Alpha
+// isn't gamma encoded, so it's averaged either way.
+TEST(Resize_LinearLightCheckerboard)
+{
+    const SIZE srcSize = { 64, 48 };
+    const SIZE dstSize = { 32, 24 };
+
+    std::vector<uint32_t> src((size_t) srcSize.cx * srcSize.cy);
+    for (int y = 0; y < srcSize.cy; y++)
+    {
+        for (int x = 0; x < srcSize.cx; x++)
+            src[(size_t) y * srcSize.cx + x] = ((x + y) % 2 != 0) ? 0xFFFFFFFF : 0x00000000;
+    }
+
+    for (ResampleFilter filter: { FILTER_Box, FILTER_Bilinear, FILTER_Lanczos3 })
+    {
+        CResampler resampler(filter);
+        std::vector<uint32_t> gamma((size_t) dstSize.cx * dstSize.cy);
+        std::vector<uint32_t> linear((size_t) dstSize.cx * dstSize.cy);
+
+        resampler.Resample(src.data(), srcSize.cx, srcSize.cx, srcSize.cy, gamma.data(), dstSize.cx, dstSize.cx, dstSize.cy);
+
+        resampler.SetLinearLight(true);
+        resampler.Resample(src.data(), srcSize.cx, srcSize.cx, srcSize.cy, linear.data(), dstSize.cx, dstSize.cx, dstSize.cy);
+
+        // Away from the edges, where the Lanczos ringing is.
+        for (int y = 3; y < dstSize.cy - 3; y++)
+        {
+            for (int x = 3; x < dstSize.cx - 3; x++)
+            {
+                uint32_t gammaPixel = gamma[(size_t) y * dstSize.cx + x];
+                uint32_t linearPixel = linear[(size_t) y * dstSize.cx + x];
+
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    REQUIRE(std::abs(GetChannel(gammaPixel, channel) - 128) <= 1);
+                    REQUIRE(std::abs(GetChannel(linearPixel, channel) - 188) <= 1);
+                }
+
+                REQUIRE(std::abs(GetChannel(gammaPixel, 3) - 128) <= 1);
+                REQUIRE(std::abs(GetChannel(linearPixel, 3) - 128) <= 1);
+            }
+        }
+    }
+}
+
+// Converting to linear light and back doesn't lose anything: resampling
+// every value to the same size gives back exactly what went in.
+TEST(Resize_LinearLightRoundTrip)
+{
+    std::vector<uint32_t> src(256 * 4);
+    for (uint32_t value = 0; value < 256; value++)
+    {
+        src[value]       = value | value << 8 | value << 16 | value << 24;
+        src[256 + value] = value;
+        src[512 + value] = value << 8 | 0xFF000000;
+        src[768 + value] = value << 16 | (255 - value) << 24;
+    }
+
+    CResampler resampler;
+    resampler.SetLinearLight(true);
+
+    std::vector<uint32_t> dst(src.size());
+    resampler.Resample(src.data(), 256, 256, 4, dst.data(), 256, 256, 4);
+
+    CHECK(dst == src);
+}
+
+// Linear light matches a floating point version: exact sRGB conversions
+// and no fixed point. The 15-bit linear values and 14-bit weights can
+// move a channel by a couple of levels.
+TEST(Resize_LinearLightMatchesReference)
+{
+    auto toLinear = [] (int value)
+    {
+        double v = value / 255.0;
+        return (v <= 0.04045) ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    };
+
+    auto fromLinear = [] (double linear)
+    {
+        linear = std::clamp(linear, 0.0, 1.0);
+        double v = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+        return (int) std::lround(v * 255.0);
+    };
+
+    std::mt19937 random(3);
+
+    for (int round = 0; round < 50; round++)
+    {
+        // Shrinking 2-4x with a box filter, so each destination pixel is
+        // the plain average of a block of source pixels.
+        int blockWidth = 2 + random() % 3;
+        int blockHeight = 2 + random() % 3;
+        SIZE dstSize = { 1 + (int) (random() % 20), 1 + (int) (random() % 20) };
+        SIZE srcSize = { dstSize.cx * blockWidth, dstSize.cy * blockHeight };
+
+        std::vector<uint32_t> src((size_t) srcSize.cx * srcSize.cy);
+        for (uint32_t& pixel: src)
+            pixel = (uint32_t) random() | 0xFF000000;
+
+        CResampler resampler(FILTER_Box);
+        resampler.SetLinearLight(true);
+
+        std::vector<uint32_t> dst((size_t) dstSize.cx * dstSize.cy);
+        resampler.Resample(src.data(), srcSize.cx, srcSize.cx, srcSize.cy, dst.data(), dstSize.cx, dstSize.cx, dstSize.cy);
+
+        for (int y = 0; y < dstSize.cy; y++)
+        {
+            for (int x = 0; x < dstSize.cx; x++)
+            {
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    double sum = 0.0;
+
+                    for (int srcY = y * blockHeight; srcY < (y + 1) * blockHeight; srcY++)
+                    {
+                        for (int srcX = x * blockWidth; srcX < (x + 1) * blockWidth; srcX++)
+                            sum += toLinear(GetChannel(src[(size_t) srcY * srcSize.cx + srcX], channel));
+                    }
+
+                    int expected = fromLinear(sum / (blockWidth * blockHeight));
+                    int actual = GetChannel(dst[(size_t) y * dstSize.cx + x], channel);
+
+                    REQUIRE(std::abs(actual - expected) <= 2);
+                }
+            }
+        }
+    }
+}
+
+// Resize modes that don't resample don't change any pixels, so
+// linear light makes no difference to them.
+TEST(Resize_LinearLightOnlyWhenResampling)
+{
+    std::vector<uint32_t> src = MakeTestPicture(GoldenSrcSize);
+
+    for (WallpaperResizeMode resizeMode: { RESIZE_Center, RESIZE_Tile })
+    {
+        for (SIZE dstSize: { SIZE{ 40, 30 }, SIZE{ 160, 90 } })
+        {
+            CHECK(Resize(src, GoldenSrcSize, dstSize, resizeMode, false) ==
+                  Resize(src, GoldenSrcSize, dstSize, resizeMode, true));
+        }
+    }
+
+    // But it does when resampling.
+    CHECK(Resize(src, GoldenSrcSize, { 40, 30 }, RESIZE_Fill, false) !=
+          Resize(src, GoldenSrcSize, { 40, 30 }, RESIZE_Fill, true));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Pyramid downsampling
+//
+//  DownsamplePixels2x() does 4 destination pixels at a time with SSE2, and
+//  the rest one at a time. Both have to agree with a plain 2x2 average.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Halve an image one pixel and one channel at a time.
+static
+std::vector<uint32_t>
+Downsample2xReference(
+    const std::vector<uint32_t>& src,
+    SIZE srcSize
+)
+{
+    SIZE dstSize = { srcSize.cx / 2, srcSize.cy / 2 };
+    std::vector<uint32_t> dst((size_t) dstSize.cx * dstSize.cy);
+
+    for (int y = 0; y < dstSize.cy; y++)
+    {
+        for (int x = 0; x < dstSize.cx; x++)
+        {
+            uint32_t pixel = 0;
+
+            for (int channel = 0; channel < 4; channel++)
+            {
+                int sum = GetChannel(src[(size_t) (2 * y) * srcSize.cx + 2 * x], channel) +
+                          GetChannel(src[(size_t) (2 * y) * srcSize.cx + 2 * x + 1], channel) +
+                          GetChannel(src[(size_t) (2 * y + 1) * srcSize.cx + 2 * x], channel) +
+                          GetChannel(src[(size_t) (2 * y + 1) * srcSize.cx + 2 * x + 1], channel);
+
+                pixel |= (uint32_t) ((sum + 2) / 4) << (channel * 8);
+            }
+
+            dst[(size_t) y * dstSize.cx + x] = pixel;
+        }
+    }
+
+    return dst;
+}
+
+TEST(Resize_Downsample2xMatchesScalar)
+{
+    std::mt19937 random(5);
+
+    // Every width up to a few SSE2 blocks, so the destination width is
+    // every remainder mod 4 (source width not a multiple of 8).
+    for (int srcWidth = 2; srcWidth <= 42; srcWidth += 2)
+    {
+        for (int srcHeight: { 2, 4, 10 })
+        {
+            SIZE srcSize = { srcWidth, srcHeight };
+
+            // Random pixels, with some all black or all white so the
+            // rounding and the saturating pack are both tested.
+            std::vector<uint32_t> src((size_t) srcSize.cx * srcSize.cy);
+            for (uint32_t& pixel: src)
+            {
+                uint32_t kind = random() % 8;
+                pixel = (kind == 0) ? 0x00000000 : (kind == 1) ? 0xFFFFFFFF : (uint32_t) random();
+            }
+
+            // One more pixel, which mustn't be touched.
+            const size_t dstCount = (size_t) (srcWidth / 2) * (srcHeight / 2);
+            std::vector<uint32_t> dst(dstCount + 1, 0x12345678);
+
+            DownsamplePixels2x(src.data(), srcSize, dst.data());
+
+            REQUIRE(dst[dstCount] == 0x12345678);
+            dst.pop_back();
+
+            REQUIRE(dst == Downsample2xReference(src, srcSize));
+        }
+    }
+}
+
+// Each level of a pyramid is close to a box filter (a plain average of the
+// 2^level x 2^level block) of level 0. Each halving rounds, so level n can
+// be up to n/2 off.
+TEST(Resize_PyramidLevelsMatchBoxFilter)
+{
+    const int levelCount = CThumbnailPyramid::LevelCount;
+    const SIZE baseSize = { CThumbnailPyramid::BaseHeight * 3 / 2, CThumbnailPyramid::BaseHeight };
+
+    std::vector<uint32_t> pixels(CThumbnailPyramid::GetPixelCount(baseSize, 0));
+
+    // Level 0: the test picture, plus noise so the blocks aren't flat.
+    std::mt19937 random(7);
+    std::vector<uint32_t> picture = MakeTestPicture(baseSize);
+
+    for (size_t i = 0; i < picture.size(); i++)
+        pixels[i] = picture[i] ^ ((uint32_t) random() & 0x0F0F0F0F);
+
+    DownsamplePixelLevels(pixels.data(), baseSize, levelCount);
+
+    for (int level = 1; level < levelCount; level++)
+    {
+        SIZE levelSize = CThumbnailPyramid::GetLevelSize(baseSize, level);
+        const uint32_t* pLevel = pixels.data() + CThumbnailPyramid::GetPixelCount(baseSize, 0, level);
+        const int blockSize = 1 << level;
+
+        for (int y = 0; y < levelSize.cy; y++)
+        {
+            for (int x = 0; x < levelSize.cx; x++)
+            {
+                for (int channel = 0; channel < 4; channel++)
+                {
+                    int sum = 0;
+
+                    for (int srcY = y * blockSize; srcY < (y + 1) * blockSize; srcY++)
+                    {
+                        for (int srcX = x * blockSize; srcX < (x + 1) * blockSize; srcX++)
+                            sum += GetChannel(pixels[(size_t) srcY * baseSize.cx + srcX], channel);
+                    }
+
+                    double expected = (double) sum / (blockSize * blockSize);
+                    int actual = GetChannel(pLevel[(size_t) y * levelSize.cx + x], channel);
+
+                    REQUIRE(std::abs(actual - expected) <= 0.5 * level);
+                }
+            }
+        }
+    }
+
+    // A pyramid that starts at level 1 (made from a level 1 sized image)
+    // has the same levels.
+    const SIZE firstSize = CThumbnailPyramid::GetLevelSize(baseSize, 1);
+    const uint32_t* pFirstLevel = pixels.data() + CThumbnailPyramid::GetPixelCount(baseSize, 0, 1);
+
+    std::vector<uint32_t> smallPixels(CThumbnailPyramid::GetPixelCount(baseSize, 1));
+    std::copy(pFirstLevel, pFirstLevel + (size_t) firstSize.cx * firstSize.cy, smallPixels.begin());
+
+    DownsamplePixelLevels(smallPixels.data(), firstSize, levelCount - 1);
+
+    CHECK(std::equal(smallPixels.begin(), smallPixels.end(), pFirstLevel));
+}
@@ -0,0 +1,226 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ScrollPredictorTests.cpp
+//
+//  CScrollPredictor tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "ScrollPredictor.h"
+
+// Scroll steadily from one position to another, one sample every 50ms
+// (the list view's scroll timer).
+static
+uint64_t
+Scroll(
+    CScrollPredictor& predictor,
+    size_t from,
+    size_t to,
+    size_t visibleCount,
+    size_t steps,
+    uint64_t timeMs
+)
+{
+    for (size_t step = 1; step <= steps; step++)
+    {
+        size_t position = from + (to - from) * step / steps;
+        if (to < from)
+            position = from - (from - to) * step / steps;
+
+        timeMs += 50;
+        predictor.Update(position, visibleCount, timeMs);
+    }
+
+    return timeMs;
+}
+
+TEST(ScrollPredictor_NothingBeforeFirstUpdate)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items = { 1, 2, 3 };
+
+    predictor.GetPrefetchItems(1000, 100, items);
+    CHECK(items.empty());
+    CHECK(predictor.GetVelocity() == 0.0);
+}
+
+TEST(ScrollPredictor_IdleTakesBothSides)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    predictor.Update(100, 20, 1000);
+    predictor.GetPrefetchItems(1000, 100, items);
+
+    // One screenful, alternating after and before, nearest first.
+    REQUIRE(items.size() == 20);
+    CHECK(items[0] == 120);
+    CHECK(items[1] == 99);
+    CHECK(items[2] == 121);
+    CHECK(items[3] == 98);
+    CHECK(items[19] == 90);
+}
+
+TEST(ScrollPredictor_IdleAtEndsOfList)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    // At the top, there's nothing before.
+    predictor.Update(0, 20, 1000);
+    predictor.GetPrefetchItems(1000, 100, items);
+    REQUIRE(items.size() == 20);
+    for (size_t idx = 0; idx < items.size(); idx++)
+        CHECK(items[idx] == 20 + idx);
+
+    // At the bottom, there's nothing after.
+    predictor.Reset();
+    predictor.Update(980, 20, 1000);
+    predictor.GetPrefetchItems(1000, 100, items);
+    REQUIRE(items.size() == 20);
+    for (size_t idx = 0; idx < items.size(); idx++)
+        CHECK(items[idx] == 979 - idx);
+
+    // Everything's visible.
+    predictor.Reset();
+    predictor.Update(0, 20, 1000);
+    predictor.GetPrefetchItems(15, 100, items);
+    CHECK(items.empty());
+}
+
+TEST(ScrollPredictor_ScrollingForward)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    predictor.Update(100, 20, 1000);
+    Scroll(predictor, 100, 200, 20, 10, 1000);
+
+    // 200 items per second, but smoothed.
+    CHECK(predictor.GetVelocity() > 100.0);
+    CHECK(predictor.GetVelocity() <= 200.0);
+
+    // Fast, so two screenfuls ahead, and nothing behind.
+    predictor.GetPrefetchItems(1000, 100, items);
+    REQUIRE(items.size() == 40);
+    for (size_t idx = 0; idx < items.size(); idx++)
+        CHECK(items[idx] == 220 + idx);
+}
+
+TEST(ScrollPredictor_ScrollingBackward)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    predictor.Update(500, 20, 1000);
+    Scroll(predictor, 500, 400, 20, 10, 1000);
+
+    CHECK(predictor.GetVelocity() < -100.0);
+
+    predictor.GetPrefetchItems(1000, 100, items);
+    REQUIRE(items.size() == 40);
+    for (size_t idx = 0; idx < items.size(); idx++)
+        CHECK(items[idx] == 399 - idx);
+}
+
+TEST(ScrollPredictor_SlowScrollLooksOneScreenAhead)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    // 20 items per second is one screenful per second.
+    predictor.Update(100, 20, 1000);
+    uint64_t timeMs = 1000;
+    for (size_t position = 101; position <= 120; position++)
+    {
+        timeMs += 50;
+        predictor.Update(position, 20, timeMs);
+    }
+
+    CHECK(predictor.GetVelocity() > 5.0);
+    CHECK(predictor.GetVelocity() < 25.0);
+
+    predictor.GetPrefetchItems(1000, 100, items);
+    REQUIRE(items.size() == 20);
+    CHECK(items.front() == 140);
+    CHECK(items.back() == 159);
+}
+
+TEST(ScrollPredictor_ChangeOfDirection)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    predictor.Update(100, 20, 1000);
+    uint64_t timeMs = Scroll(predictor, 100, 200, 20, 10, 1000);
+    Scroll(predictor, 200, 100, 20, 10, timeMs);
+
+    // Heading back up now.
+    CHECK(predictor.GetVelocity() < 0.0);
+
+    predictor.GetPrefetchItems(1000, 100, items);
+    REQUIRE(!items.empty());
+    CHECK(items[0] == 99);
+}
+
+TEST(ScrollPredictor_LongPauseRestarts)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    predictor.Update(100, 20, 1000);
+    uint64_t timeMs = Scroll(predictor, 100, 200, 20, 10, 1000);
+
+    // A jump after a long pause isn't scrolling.
+    predictor.Update(0, 20, timeMs + 5000);
+    CHECK(predictor.GetVelocity() == 0.0);
+
+    predictor.GetPrefetchItems(1000, 100, items);
+    CHECK(items.size() == 20);
+    CHECK(items[0] == 20);
+}
+
+TEST(ScrollPredictor_RepeatedSampleIgnored)
+{
+    CScrollPredictor predictor;
+
+    predictor.Update(100, 20, 1000);
+    predictor.Update(110, 20, 1050);
+    double velocity = predictor.GetVelocity();
+
+    // Same time again (e.g. two updates in one timer tick).
+    predictor.Update(150, 20, 1050);
+    CHECK(predictor.GetVelocity() == velocity);
+}
+
+TEST(ScrollPredictor_Budget)
+{
+    CScrollPredictor predictor;
+    std::vector<size_t> items;
+
+    predictor.Update(100, 20, 1000);
+    Scroll(predictor, 100, 200, 20, 10, 1000);
+
+    predictor.GetPrefetchItems(1000, 15, items);
+    CHECK(items.size() == 15);
+
+    predictor.GetPrefetchItems(1000, 0, items);
+    CHECK(items.empty());
+
+    // Not past the end of the list.
+    predictor.GetPrefetchItems(230, 100, items);
+    REQUIRE(items.size() == 10);
+    CHECK(items.back() == 229);
+}
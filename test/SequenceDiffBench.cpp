@@ -0,0 +1,89 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  SequenceDiffBench.cpp
+//
+//  CSequenceDiff benchmark.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include "SequenceDiff.h"
+
+// Time the list view refresh diff (see CMainFrame::UpdateListView) for
+// the changes that cause one: shuffle, sort, and a reload that adds and
+// removes a few files. Keys are path hashes, so random 64-bit values.
+BENCHMARK(SequenceDiff)
+{
+    std::mt19937_64 random(1);
+
+    for (size_t entryCount: GetBenchSizes<size_t>({ 1000, 10000, 100000 }))
+    {
+        printf(" %zu entries\n", entryCount);
+
+        std::vector<uint64_t> oldKeys(entryCount);
+        for (uint64_t& key: oldKeys)
+            key = random();
+
+        std::vector<uint64_t> shuffled(oldKeys);
+        std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+        std::vector<uint64_t> sorted(oldKeys);
+        std::sort(sorted.begin(), sorted.end());
+
+        // 1% of the files gone, 1% new ones.
+        std::vector<uint64_t> reloaded;
+        for (uint64_t key: oldKeys)
+        {
+            if (random() % 100 != 0)
+                reloaded.push_back(key);
+
+            if (random() % 100 == 0)
+                reloaded.push_back(random());
+        }
+
+        // One file moved to the other end.
+        std::vector<uint64_t> moved(oldKeys);
+        std::rotate(moved.begin(), moved.begin() + 1, moved.end());
+
+        struct Scenario
+        {
+            const char* m_Name;
+            const std::vector<uint64_t>& m_NewKeys;
+        };
+
+        Scenario scenarios[] =
+        {
+            { "unchanged", oldKeys },
+            { "shuffle", shuffled },
+            { "sort", sorted },
+            { "reload (1% removed, 1% added)", reloaded },
+            { "one moved", moved },
+        };
+
+        for (const Scenario& scenario: scenarios)
+        {
+            CLatencyStats stats;
+            CSequenceDiff diff;
+
+            for (size_t repeat = 0; repeat < GetBenchRepeatCount(20); repeat++)
+            {
+                CStopwatch stopwatch;
+                diff.Compute(oldKeys, scenario.m_NewKeys);
+                stats.Add(stopwatch.GetElapsedMs());
+            }
+
+            stats.Report(scenario.m_Name);
+        }
+    }
+}
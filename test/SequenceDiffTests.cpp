@@ -0,0 +1,203 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  SequenceDiffTests.cpp
+//
+//  CSequenceDiff tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "SequenceDiff.h"
+
+// Apply the operations to the old sequence, the way the header says to.
+static
+std::vector<uint64_t>
+Apply(
+    const CSequenceDiff& diff,
+    const std::vector<uint64_t>& oldKeys,
+    const std::vector<uint64_t>& newKeys
+)
+{
+    std::vector<uint64_t> keys(oldKeys);
+
+    std::vector<size_t> removed;
+    std::vector<size_t> inserted;
+
+    for (const CSequenceDiff::Operation& operation: diff.GetOperations())
+    {
+        if (operation.m_Type != CSequenceDiff::DIFF_Insert)
+            removed.push_back(operation.m_OldIndex);
+
+        if (operation.m_Type != CSequenceDiff::DIFF_Delete)
+            inserted.push_back(operation.m_NewIndex);
+    }
+
+    std::sort(removed.rbegin(), removed.rend());
+    for (size_t oldIndex: removed)
+        keys.erase(keys.begin() + oldIndex);
+
+    std::sort(inserted.begin(), inserted.end());
+    for (size_t newIndex: inserted)
+    {
+        if (newIndex > keys.size())
+            return {};
+
+        keys.insert(keys.begin() + newIndex, newKeys[newIndex]);
+    }
+
+    return keys;
+}
+
+// Length of the longest increasing subsequence (the fewest entries that
+// have to move is the number matched minus this).
+static
+size_t
+GetLongestIncreasingLength(
+    const std::vector<size_t>& values
+)
+{
+    std::vector<size_t> tails;
+
+    for (size_t value: values)
+    {
+        auto it = std::lower_bound(tails.begin(), tails.end(), value);
+        if (it == tails.end())
+            tails.push_back(value);
+        else
+            *it = value;
+    }
+
+    return tails.size();
+}
+
+TEST(SequenceDiff_Same)
+{
+    CSequenceDiff diff;
+    std::vector<uint64_t> keys = { 1, 2, 3 };
+
+    diff.Compute(keys, keys);
+    CHECK(diff.empty());
+
+    for (size_t idx = 0; idx < keys.size(); idx++)
+    {
+        CHECK(diff.GetNewIndex(idx) == idx);
+        CHECK(diff.GetOldIndex(idx) == idx);
+    }
+
+    diff.Compute({}, {});
+    CHECK(diff.empty());
+}
+
+TEST(SequenceDiff_InsertAndDelete)
+{
+    CSequenceDiff diff;
+
+    diff.Compute({ 1, 2, 3, 4 }, { 1, 5, 3, 4, 6 });
+    CHECK(diff.GetDeleteCount() == 1);
+    CHECK(diff.GetInsertCount() == 2);
+    CHECK(diff.GetMoveCount() == 0);
+
+    CHECK(diff.GetNewIndex(1) == CSequenceDiff::InvalidIndex);
+    CHECK(diff.GetNewIndex(2) == 2);
+    CHECK(diff.GetOldIndex(1) == CSequenceDiff::InvalidIndex);
+    CHECK(diff.GetOldIndex(4) == CSequenceDiff::InvalidIndex);
+
+    // Deletes first, then inserts lowest index first.
+    const std::vector<CSequenceDiff::Operation>& operations = diff.GetOperations();
+    REQUIRE(operations.size() == 3);
+    CHECK(operations[0].m_Type == CSequenceDiff::DIFF_Delete);
+    CHECK(operations[0].m_OldIndex == 1);
+    CHECK(operations[1].m_Type == CSequenceDiff::DIFF_Insert);
+    CHECK(operations[1].m_NewIndex == 1);
+    CHECK(operations[2].m_NewIndex == 4);
+
+    diff.Compute({}, { 7, 8 });
+    CHECK(diff.GetInsertCount() == 2);
+
+    diff.Compute({ 7, 8 }, {});
+    CHECK(diff.GetDeleteCount() == 2);
+}
+
+TEST(SequenceDiff_FewestMoves)
+{
+    CSequenceDiff diff;
+
+    // One entry moved to the end.
+    diff.Compute({ 1, 2, 3, 4, 5 }, { 2, 3, 4, 5, 1 });
+    CHECK(diff.GetMoveCount() == 1);
+    CHECK(diff.GetDeleteCount() == 0);
+    CHECK(diff.GetInsertCount() == 0);
+    CHECK(diff.GetNewIndex(0) == 4);
+
+    // Reversed: everything but one entry moves.
+    diff.Compute({ 1, 2, 3, 4, 5 }, { 5, 4, 3, 2, 1 });
+    CHECK(diff.GetMoveCount() == 4);
+}
+
+TEST(SequenceDiff_RepeatedKeys)
+{
+    CSequenceDiff diff;
+
+    // Matched up in order.
+    diff.Compute({ 1, 1, 2 }, { 2, 1, 1 });
+    CHECK(diff.GetOldIndex(1) == 0);
+    CHECK(diff.GetOldIndex(2) == 1);
+    CHECK(diff.GetMoveCount() == 1);
+
+    diff.Compute({ 1, 1, 1 }, { 1 });
+    CHECK(diff.GetDeleteCount() == 2);
+    CHECK(diff.GetNewIndex(0) == 0);
+}
+
+// Random sequences (with repeated keys): applying the operations gives
+// the new sequence, the index maps agree, and the moves are minimal.
+TEST(SequenceDiff_MatchesModel)
+{
+    std::mt19937 random(1);
+    CSequenceDiff diff;
+
+    for (int round = 0; round < 20000; round++)
+    {
+        std::vector<uint64_t> oldKeys(random() % 12);
+        std::vector<uint64_t> newKeys(random() % 12);
+
+        for (uint64_t& key: oldKeys)
+            key = random() % 8;
+
+        for (uint64_t& key: newKeys)
+            key = random() % 8;
+
+        diff.Compute(oldKeys, newKeys);
+
+        REQUIRE(Apply(diff, oldKeys, newKeys) == newKeys);
+
+        std::vector<size_t> matchedOldIndexes;
+
+        for (size_t newIndex = 0; newIndex < newKeys.size(); newIndex++)
+        {
+            size_t oldIndex = diff.GetOldIndex(newIndex);
+            if (oldIndex == CSequenceDiff::InvalidIndex)
+                continue;
+
+            REQUIRE(oldKeys[oldIndex] == newKeys[newIndex]);
+            REQUIRE(diff.GetNewIndex(oldIndex) == newIndex);
+            matchedOldIndexes.push_back(oldIndex);
+        }
+
+        size_t matchedCount = matchedOldIndexes.size();
+        REQUIRE(diff.GetDeleteCount() == oldKeys.size() - matchedCount);
+        REQUIRE(diff.GetInsertCount() == newKeys.size() - matchedCount);
+        REQUIRE(diff.GetMoveCount() == matchedCount - GetLongestIncreasingLength(matchedOldIndexes));
+    }
+}
@@ -0,0 +1,156 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ShuffleOrderTests.cpp
+//
+//  CShuffleOrder tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "ShuffleOrder.h"
+
+// Check GetPosition() is a permutation of 0...size-1,
+// and GetIndex() is its inverse.
+static
+bool
+IsBijection(
+    uint64_t size,
+    uint64_t seed
+)
+{
+    CShuffleOrder order(size, seed);
+    std::vector<bool> seen((size_t) size, false);
+
+    for (uint64_t index = 0; index < size; index++)
+    {
+        uint64_t position = order.GetPosition(index);
+
+        if (position >= size || seen[(size_t) position])
+            return false;
+
+        seen[(size_t) position] = true;
+
+        if (order.GetIndex(position) != index)
+            return false;
+    }
+
+    return true;
+}
+
+// Every size from 1 to 2000, then the sizes either side of each
+// power of two (where the Feistel domain changes size) up to 1M,
+// and 1M itself. Fixed seeds, so a failure can be reproduced.
+TEST(ShuffleOrder_Bijection)
+{
+    for (uint64_t size = 1; size <= 2000; size++)
+        REQUIRE(IsBijection(size, size * 7919));
+
+    for (uint64_t power = 2048; power <= (1 << 20); power *= 2)
+    {
+        for (uint64_t size: { power - 1, power, power + 1 })
+            REQUIRE(IsBijection(size, size * 0x9E3779B97F4A7C15ull));
+    }
+
+    REQUIRE(IsBijection(1000000, 1));
+    REQUIRE(IsBijection(1000000, 0xFEEDFACECAFEBEEFull));
+}
+
+TEST(ShuffleOrder_SameSeedSameOrder)
+{
+    CShuffleOrder order1(1000, 42);
+    CShuffleOrder order2;
+    order2.Reset(1000, 42);
+
+    CHECK(order2.size() == 1000);
+    CHECK(order2.GetSeed() == 42);
+
+    size_t differentCount = 0;
+    CShuffleOrder order3(1000, 43);
+
+    for (uint64_t index = 0; index < 1000; index++)
+    {
+        CHECK(order1.GetPosition(index) == order2.GetPosition(index));
+
+        if (order1.GetPosition(index) != order3.GetPosition(index))
+            differentCount++;
+    }
+
+    // A different seed is a different order.
+    CHECK(differentCount > 900);
+}
+
+TEST(ShuffleOrder_IsShuffled)
+{
+    // Not the identity, and not just a rotation or a stride.
+    CShuffleOrder order(10000, 12345);
+
+    size_t fixedCount = 0;
+    size_t ascendingCount = 0;
+
+    for (uint64_t index = 0; index < 10000; index++)
+    {
+        if (order.GetPosition(index) == index)
+            fixedCount++;
+
+        if (index != 0 && order.GetPosition(index) > order.GetPosition(index - 1))
+            ascendingCount++;
+    }
+
+    CHECK(fixedCount < 10);
+    CHECK(ascendingCount > 4500);
+    CHECK(ascendingCount < 5500);
+}
+
+TEST(ShuffleOrder_SkipUnusedPositions)
+{
+    CShuffleOrder order(1000, 99);
+
+    // Remove every third position. The order of the rest doesn't change.
+    auto isUsed = [] (uint64_t position) { return position % 3 != 0; };
+
+    std::vector<uint64_t> expected;
+    for (uint64_t index = 0; index < order.size(); index++)
+    {
+        if (isUsed(order.GetPosition(index)))
+            expected.push_back(order.GetPosition(index));
+    }
+
+    std::vector<uint64_t> forward;
+    for (uint64_t index = order.FindNext(0, isUsed); index != order.size(); index = order.FindNext(index + 1, isUsed))
+        forward.push_back(order.GetPosition(index));
+
+    CHECK(forward == expected);
+
+    std::vector<uint64_t> backward;
+    for (uint64_t index = order.FindPrevious(order.size() - 1, isUsed); index != order.size(); )
+    {
+        backward.push_back(order.GetPosition(index));
+        index = (index == 0) ? order.size() : order.FindPrevious(index - 1, isUsed);
+    }
+
+    std::reverse(backward.begin(), backward.end());
+    CHECK(backward == expected);
+
+    // Nothing in use.
+    auto isNotUsed = [] (uint64_t) { return false; };
+    CHECK(order.FindNext(0, isNotUsed) == order.size());
+    CHECK(order.FindPrevious(order.size() - 1, isNotUsed) == order.size());
+
+    // Past the end.
+    CHECK(order.FindNext(order.size(), isUsed) == order.size());
+
+    CShuffleOrder empty;
+    CHECK(empty.FindNext(0, isUsed) == 0);
+    CHECK(empty.FindPrevious(0, isUsed) == 0);
+}
@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Test.h
+//
+//  Unit test registration and checks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Tests are functions defined with TEST(). Each file's tests register
+// themselves, and WallpaperChangerTests runs them all (or the ones named
+// on the command line). A failed CHECK() reports the expression and
+// carries on with the rest of the test.
+
+// Define a test.
+#define TEST(name)                                                          \
+    static void Test_##name();                                              \
+    static CTestRegistration s_Register_##name(#name, Test_##name);         \
+    static void Test_##name()
+
+// Check a condition.
+#define CHECK(expr)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(expr))                                                        \
+            CTestRegistration::Fail(__FILE__, __LINE__, #expr);             \
+    }                                                                       \
+    while (0)
+
+// Check a condition, and end the test if it's false.
+#define REQUIRE(expr)                                                       \
+    do                                                                      \
+    {                                                                       \
+        if (!(expr))                                                        \
+        {                                                                   \
+            CTestRegistration::Fail(__FILE__, __LINE__, #expr);             \
+            return;                                                         \
+        }                                                                   \
+    }                                                                       \
+    while (0)
+
+// Adds a test to the list of tests.
+class CTestRegistration
+{
+    public:
+
+        using TestFunction = void (*)();
+
+        struct CTestCase
+        {
+            const char* m_Name;
+            TestFunction m_Function;
+        };
+
+        CTestRegistration(
+            const char* name,
+            TestFunction function
+        )
+        {
+            GetTestCases().push_back({ name, function });
+        }
+
+        static
+        std::vector<CTestCase>&
+        GetTestCases()
+        {
+            static std::vector<CTestCase> testCases;
+            return testCases;
+        }
+
+        // Report a failed check.
+        static
+        void
+        Fail(
+            const char* file,
+            int line,
+            const char* expr
+        );
+
+        // Get the number of failed checks so far.
+        static
+        size_t
+        GetFailureCount();
+};
+
+// Get a new empty directory for a test's files (under the system's
+// temporary directory).
+fs::path
+GetTestDirectory(
+    const char* name
+);
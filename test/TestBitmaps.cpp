@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  TestBitmaps.cpp
+//
+//  Stand-in bitmaps for the tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "TestBitmaps.h"
+
+struct HBITMAP__
+{
+    int m_Id;
+};
+
+static std::atomic<size_t> s_LiveBitmapCount(0);
+
+HBITMAP
+CreateTestBitmap(
+    int id
+)
+{
+    s_LiveBitmapCount++;
+    return new HBITMAP__{ id };
+}
+
+int
+GetTestBitmapId(
+    HBITMAP hBitmap
+)
+{
+    return hBitmap->m_Id;
+}
+
+size_t
+GetLiveTestBitmapCount()
+{
+    return s_LiveBitmapCount;
+}
+
+BOOL
+DeleteObject(
+    HBITMAP hBitmap
+)
+{
+    if (!hBitmap)
+        return FALSE;
+
+    s_LiveBitmapCount--;
+    delete hBitmap;
+    return TRUE;
+}
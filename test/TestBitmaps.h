@@ -0,0 +1,38 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  TestBitmaps.h
+//
+//  Stand-in bitmaps for the tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// HBITMAP is opaque on other platforms (see Portable.h). These bitmaps
+// carry an id, and are counted, so a test can tell which bitmap it got
+// and that every bitmap was freed (with DeleteObject()).
+
+// Make a bitmap.
+HBITMAP
+CreateTestBitmap(
+    int id
+);
+
+// Get the id a bitmap was made with.
+int
+GetTestBitmapId(
+    HBITMAP hBitmap
+);
+
+// Get the number of bitmaps that haven't been freed.
+size_t
+GetLiveTestBitmapCount();
@@ -0,0 +1,40 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  TestImageFiles.cpp
+//
+//  Stand-ins for the image file checks in Util.cpp.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+
+// The tests' and benchmarks' image files are empty, so these go by the
+// extension (see Portable.h).
+
+bool
+IsValidImageFile(
+    const fs::path& imageFile
+)
+{
+    fs::path extension = imageFile.extension();
+    return extension == ".jpg" || extension == ".png";
+}
+
+bool
+GetImageFileDimensions(
+    const fs::path& /*imageFile*/,
+    UINT* /*pWidth*/,
+    UINT* /*pHeight*/
+)
+{
+    return false;
+}
@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  TestMain.cpp
+//
+//  Runs the unit tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+static size_t s_FailureCount = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CTestRegistration::Fail
+//  CTestRegistration::GetFailureCount
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/*static*/
+void
+CTestRegistration::Fail(
+    const char* file,
+    int line,
+    const char* expr
+)
+{
+    printf("  %s(%d): CHECK failed: %s\n", file, line, expr);
+    s_FailureCount++;
+}
+
+/*static*/
+size_t
+CTestRegistration::GetFailureCount()
+{
+    return s_FailureCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  GetTestDirectory
+//
+//////////////////////////////////////////////////////////////////////////////
+
+fs::path
+GetTestDirectory(
+    const char* name
+)
+{
+    fs::path directory = fs::temp_directory_path() / "WallpaperChangerTests" / name;
+
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+    fs::create_directories(directory);
+
+    return directory;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  main
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Usage: WallpaperChangerTests [test name...]
+int main(int argc, char* argv[])
+{
+    size_t testCount = 0;
+    size_t failedTestCount = 0;
+
+    for (const CTestRegistration::CTestCase& testCase : CTestRegistration::GetTestCases())
+    {
+        if (argc > 1 &&
+            std::none_of(argv + 1, argv + argc, [&testCase] (const char* arg) { return strcmp(arg, testCase.m_Name) == 0; }))
+        {
+            continue;
+        }
+
+        printf("%s\n", testCase.m_Name);
+        fflush(stdout);
+
+        size_t failureCount = CTestRegistration::GetFailureCount();
+
+        testCase.m_Function();
+
+        testCount++;
+
+        if (CTestRegistration::GetFailureCount() != failureCount)
+            failedTestCount++;
+    }
+
+    printf("%zu tests, %zu failed\n", testCount, failedTestCount);
+
+    return failedTestCount == 0 && testCount != 0 ? 0 : 1;
+}
@@ -0,0 +1,494 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailLoaderTests.cpp
+//
+//  CThumbnailLoader tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+#include "TestBitmaps.h"
+
+#include "ThumbnailLoader.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CFakeThumbnailSource
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Stands in for the shell's thumbnail extraction. Each thumbnail is a test
+// bitmap whose id is the FileHandle (passed in the key's path hash), and
+// the order they were loaded in is recorded. The key's time is updated to
+// the file's "current" one, GetCurrentTime(). While the source is closed,
+// loads wait, so a test can fill the queues with a single worker busy and
+// then see what order the rest come out in.
+class CFakeThumbnailSource
+{
+    public:
+
+        CFakeThumbnailSource(
+            bool open = true
+        )
+            :
+            m_Mutex(),
+            m_Changed(),
+            m_Open(open),
+            m_StartedCount(0),
+            m_LoadOrder()
+        {
+        }
+
+        CThumbnailLoader::LoadFunction
+        GetLoadFunction()
+        {
+            return
+                /*LAMBDA*/ [this] (const fs::path& /*path*/, CThumbnailKey* pKey) -> HBITMAP
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+
+                    m_StartedCount++;
+                    m_Changed.notify_all();
+
+                    m_Changed.wait(lock, [this] { return m_Open; });
+
+                    pKey->m_LastWriteTime = GetCurrentTime((FileHandle) pKey->m_PathHash);
+
+                    // A file size of 1 stands for a file that can't be loaded.
+                    if (pKey->m_FileSize != 0)
+                        return NULL;
+
+                    m_LoadOrder.push_back((FileHandle) pKey->m_PathHash);
+                    return CreateTestBitmap((int) pKey->m_PathHash);
+                };
+        }
+
+        static
+        int64_t
+        GetCurrentTime(
+            FileHandle hFile
+        )
+        {
+            return 1000 + (int64_t) hFile;
+        }
+
+        void
+        Open()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Open = true;
+            m_Changed.notify_all();
+        }
+
+        // Wait until a number of loads have started.
+        bool
+        WaitForStarted(
+            size_t count
+        )
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            return m_Changed.wait_for(lock, std::chrono::seconds(10), [this, count] { return m_StartedCount >= count; });
+        }
+
+        std::vector<FileHandle>
+        GetLoadOrder()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_LoadOrder;
+        }
+
+    private:
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Changed;
+        bool m_Open;
+        size_t m_StartedCount;
+        std::vector<FileHandle> m_LoadOrder;
+};
+
+static
+CThumbnailKey
+GetKey(
+    FileHandle hFile,
+    bool loadFails = false
+)
+{
+    return { hFile, 0, loadFails ? 1U : 0U };
+}
+
+static
+void
+Request(
+    CThumbnailLoader& loader,
+    FileHandle hFile
+)
+{
+    loader.Request(hFile, fs::path("file" + std::to_string(hFile)), GetKey(hFile));
+}
+
+static
+void
+Prefetch(
+    CThumbnailLoader& loader,
+    FileHandle hFile
+)
+{
+    loader.Prefetch(hFile, fs::path("file" + std::to_string(hFile)), GetKey(hFile));
+}
+
+// Collect results until there are a number of them (or it takes too long).
+static
+std::vector<CThumbnailLoader::Result>
+TakeResults(
+    CThumbnailLoader& loader,
+    size_t count
+)
+{
+    std::vector<CThumbnailLoader::Result> results;
+    std::vector<CThumbnailLoader::Result> batch;
+
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (results.size() < count && std::chrono::steady_clock::now() < timeout)
+    {
+        loader.TakeResults(batch);
+        std::move(batch.begin(), batch.end(), std::back_inserter(results));
+
+        if (results.size() < count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return results;
+}
+
+static
+void
+FreeResults(
+    std::vector<CThumbnailLoader::Result>& results
+)
+{
+    for (CThumbnailLoader::Result& result: results)
+        ::DeleteObject(result.m_hBitmap);
+
+    results.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Tests
+//
+//////////////////////////////////////////////////////////////////////////////
+
+TEST(ThumbnailLoader_LoadsEveryRequest)
+{
+    size_t liveBitmapCount = GetLiveTestBitmapCount();
+
+    CFakeThumbnailSource source;
+    std::atomic<size_t> notifyCount(0);
+
+    {
+        CThumbnailLoader loader(source.GetLoadFunction(), [&notifyCount] { notifyCount++; }, 4);
+
+        for (FileHandle hFile = 0; hFile < 100; hFile++)
+            Request(loader, hFile);
+
+        std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 100);
+        REQUIRE(results.size() == 100);
+
+        std::vector<bool> loaded(100);
+        for (const CThumbnailLoader::Result& result: results)
+        {
+            REQUIRE(result.m_hFile < 100);
+            CHECK(!loaded[result.m_hFile]);
+            loaded[result.m_hFile] = true;
+
+            REQUIRE(result.m_hBitmap);
+            CHECK(GetTestBitmapId(result.m_hBitmap) == (int) result.m_hFile);
+            CHECK(result.m_Path == fs::path("file" + std::to_string(result.m_hFile)));
+        }
+
+        // One notification per batch, not per thumbnail.
+        CHECK(notifyCount >= 1);
+        CHECK(notifyCount <= 100);
+
+        FreeResults(results);
+    }
+
+    CHECK(GetLiveTestBitmapCount() == liveBitmapCount);
+}
+
+TEST(ThumbnailLoader_NewestRequestFirst)
+{
+    CFakeThumbnailSource source(false);
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    // The worker takes the first one and waits. The rest queue up.
+    Request(loader, 0);
+    REQUIRE(source.WaitForStarted(1));
+
+    for (FileHandle hFile = 1; hFile <= 5; hFile++)
+        Request(loader, hFile);
+
+    source.Open();
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 6);
+    CHECK(results.size() == 6);
+    CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 5, 4, 3, 2, 1 }));
+
+    // Results come out in the order they were finished.
+    for (size_t idx = 0; idx < results.size(); idx++)
+        CHECK(results[idx].m_hFile == source.GetLoadOrder()[idx]);
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_RepeatedRequestIsMerged)
+{
+    CFakeThumbnailSource source(false);
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    Request(loader, 0);
+    REQUIRE(source.WaitForStarted(1));
+
+    Request(loader, 1);
+    Request(loader, 2);
+    Request(loader, 3);
+
+    // Asking again moves it to the front, without loading it twice.
+    Request(loader, 1);
+
+    // Already being loaded.
+    Request(loader, 0);
+
+    source.Open();
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 4);
+    CHECK(results.size() == 4);
+    CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 1, 3, 2 }));
+
+    // Nothing more turns up.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::vector<CThumbnailLoader::Result> more;
+    loader.TakeResults(more);
+    CHECK(more.empty());
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_PrefetchAfterRequests)
+{
+    CFakeThumbnailSource source(false);
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    Request(loader, 0);
+    REQUIRE(source.WaitForStarted(1));
+
+    // Prefetches are loaded in the order asked for, after the requests,
+    // even the requests made later.
+    Prefetch(loader, 10);
+    Prefetch(loader, 11);
+    Prefetch(loader, 12);
+    Request(loader, 1);
+    Request(loader, 2);
+
+    // Already requested.
+    Prefetch(loader, 1);
+
+    source.Open();
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 6);
+    CHECK(results.size() == 6);
+    CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 2, 1, 10, 11, 12 }));
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_RequestPromotesPrefetch)
+{
+    CFakeThumbnailSource source(false);
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    Request(loader, 0);
+    REQUIRE(source.WaitForStarted(1));
+
+    Prefetch(loader, 10);
+    Prefetch(loader, 11);
+    Prefetch(loader, 12);
+    Request(loader, 1);
+
+    // Wanted now, so it goes ahead of everything.
+    Request(loader, 12);
+
+    source.Open();
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 5);
+    CHECK(results.size() == 5);
+    CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 12, 1, 10, 11 }));
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_ClearPrefetch)
+{
+    CFakeThumbnailSource source(false);
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    Request(loader, 0);
+    REQUIRE(source.WaitForStarted(1));
+
+    Prefetch(loader, 10);
+    Prefetch(loader, 11);
+    Request(loader, 1);
+
+    // A new prediction replaces the old one. Files that were dropped
+    // can be prefetched again.
+    loader.ClearPrefetch();
+    Prefetch(loader, 20);
+    Prefetch(loader, 10);
+
+    source.Open();
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 4);
+    CHECK(results.size() == 4);
+    CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 1, 20, 10 }));
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_Cancel)
+{
+    CFakeThumbnailSource source(false);
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    Request(loader, 0);
+    REQUIRE(source.WaitForStarted(1));
+
+    for (FileHandle hFile = 1; hFile <= 6; hFile++)
+        Request(loader, hFile);
+
+    Prefetch(loader, 10);
+    Prefetch(loader, 11);
+
+    // Scrolled out of view. The one that's being loaded still finishes.
+    loader.Cancel([] (FileHandle hFile) { return (hFile < 10 && hFile % 2 == 0) || hFile == 11; });
+
+    source.Open();
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 5);
+    CHECK(results.size() == 5);
+    CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 5, 3, 1, 10 }));
+    FreeResults(results);
+
+    // Cancelled files can be asked for again.
+    Request(loader, 2);
+    results = TakeResults(loader, 1);
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].m_hFile == 2);
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_CancelAllDropsStaleResults)
+{
+    size_t liveBitmapCount = GetLiveTestBitmapCount();
+
+    CFakeThumbnailSource source(false);
+
+    {
+        CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+        Request(loader, 0);
+        REQUIRE(source.WaitForStarted(1));
+
+        Request(loader, 1);
+        Prefetch(loader, 2);
+
+        // A new playlist. The FileHandles mean different files now, so
+        // the thumbnail that's being loaded must not turn up.
+        loader.CancelAll();
+
+        Request(loader, 0);
+
+        source.Open();
+
+        std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 1);
+        REQUIRE(results.size() == 1);
+        CHECK(results[0].m_hFile == 0);
+        CHECK(source.GetLoadOrder() == std::vector<FileHandle>({ 0, 0 }));
+        FreeResults(results);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        loader.TakeResults(results);
+        CHECK(results.empty());
+    }
+
+    // The stale thumbnail was freed.
+    CHECK(GetLiveTestBitmapCount() == liveBitmapCount);
+}
+
+TEST(ThumbnailLoader_FailedLoad)
+{
+    CFakeThumbnailSource source;
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 1);
+
+    loader.Request(7, fs::path("broken"), GetKey(7, true));
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 1);
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].m_hFile == 7);
+    CHECK(results[0].m_hBitmap == NULL);
+
+    // The file's time is still passed back, so it isn't stat'ed again.
+    CHECK(results[0].m_Key.m_LastWriteTime == CFakeThumbnailSource::GetCurrentTime(7));
+}
+
+// Results carry the key as the load function left it, not the
+// (possibly stale) one the request was made with.
+TEST(ThumbnailLoader_ResultHasUpdatedKey)
+{
+    CFakeThumbnailSource source;
+    CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 2);
+
+    for (FileHandle hFile = 0; hFile < 10; hFile++)
+        Request(loader, hFile);
+
+    std::vector<CThumbnailLoader::Result> results = TakeResults(loader, 10);
+    REQUIRE(results.size() == 10);
+
+    for (const CThumbnailLoader::Result& result: results)
+    {
+        CHECK(result.m_Key.m_PathHash == result.m_hFile);
+        CHECK(result.m_Key.m_LastWriteTime == CFakeThumbnailSource::GetCurrentTime(result.m_hFile));
+        CHECK(GetTestBitmapId(result.m_hBitmap) == (int) result.m_hFile);
+    }
+
+    FreeResults(results);
+}
+
+TEST(ThumbnailLoader_UncollectedResultsAreFreed)
+{
+    size_t liveBitmapCount = GetLiveTestBitmapCount();
+
+    CFakeThumbnailSource source;
+
+    {
+        CThumbnailLoader loader(source.GetLoadFunction(), [] {}, 2);
+
+        for (FileHandle hFile = 0; hFile < 50; hFile++)
+            Request(loader, hFile);
+
+        source.WaitForStarted(50);
+    }
+
+    CHECK(GetLiveTestBitmapCount() == liveBitmapCount);
+}
@@ -0,0 +1,423 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ThumbnailPackFormatTests.cpp
+//
+//  Thumbnail pack file format and CThumbnailPackIndex tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "ThumbnailPackFormat.h"
+#include "ThumbnailPyramid.h"
+
+// Level 0 size used by the tests. Small, but every level has pixels.
+static const SIZE TestBaseSize = { 32, 16 };
+
+static const COLORREF TestBackground = RGB(10, 20, 30);
+
+// Pixels of a pyramid's levels firstLevel..., each one
+// tagged with its path hash, level, and position.
+static
+std::vector<uint32_t>
+MakePixels(
+    uint64_t pathHash,
+    int firstLevel
+)
+{
+    std::vector<uint32_t> pixels;
+
+    for (int level = firstLevel; level < CThumbnailPyramid::LevelCount; level++)
+    {
+        size_t levelPixelCount = CThumbnailPyramid::GetPixelCount(TestBaseSize, level, level + 1);
+
+        for (size_t idx = 0; idx < levelPixelCount; idx++)
+            pixels.push_back((uint32_t) ((pathHash & 0xFF) << 24 | (uint32_t) level << 16 | idx));
+    }
+
+    return pixels;
+}
+
+// Builds a pack file in memory.
+class CPackBuilder
+{
+    public:
+
+        CPackBuilder()
+            :
+            m_Data(sizeof(PackHeader), 0),
+            m_RecordOffsets()
+        {
+            PackHeader header = {};
+            header.m_Magic = PackMagic;
+            header.m_Version = PackVersion;
+            memcpy(m_Data.data(), &header, sizeof(header));
+        }
+
+        // Append a record. Returns its size.
+        size_t
+        Add(
+            const CThumbnailKey& key,
+            int firstLevel = 0,
+            WallpaperResizeMode resizeMode = RESIZE_Fill,
+            bool linearLight = false
+        )
+        {
+            std::vector<uint32_t> pixels = MakePixels(key.m_PathHash, firstLevel);
+            std::vector<BYTE> recordData;
+
+            CHECK(MakePackRecord(key,
+                                 TestBaseSize,
+                                 firstLevel,
+                                 resizeMode,
+                                 linearLight,
+                                 TestBackground,
+                                 pixels.data(),
+                                 pixels.size() * sizeof(uint32_t),
+                                 recordData));
+
+            m_RecordOffsets.push_back(m_Data.size());
+            m_Data.insert(m_Data.end(), recordData.begin(), recordData.end());
+            return recordData.size();
+        }
+
+        const PackRecord*
+        GetRecord(
+            size_t idx
+        ) const
+        {
+            return (const PackRecord*) (m_Data.data() + m_RecordOffsets[idx]);
+        }
+
+        std::vector<BYTE> m_Data;
+        std::vector<size_t> m_RecordOffsets;
+};
+
+static
+CThumbnailKey
+GetKey(
+    uint64_t pathHash,
+    int64_t lastWriteTime = 1000
+)
+{
+    return { pathHash, lastWriteTime, 5000 + pathHash };
+}
+
+TEST(ThumbnailPackFormat_RecordLayout)
+{
+    CPackBuilder pack;
+    size_t recordSize = pack.Add(GetKey(1), 1);
+
+    // Header, pixels, padded to 8 bytes.
+    size_t dataSize = CThumbnailPyramid::GetPixelCount(TestBaseSize, 1) * 4;
+    CHECK(recordSize == sizeof(PackRecord) + AlignPackSize(dataSize));
+    CHECK(recordSize % 8 == 0);
+
+    const PackRecord* pRecord = pack.GetRecord(0);
+    CHECK(pRecord->m_Magic == RecordMagic);
+    CHECK(pRecord->m_DataSize == dataSize);
+    CHECK(pRecord->m_FirstLevel == 1);
+    CHECK(pRecord->m_LevelCount == CThumbnailPyramid::LevelCount - 1);
+    CHECK(pRecord->m_Width == TestBaseSize.cx);
+    CHECK(pRecord->m_Height == TestBaseSize.cy);
+    CHECK(pRecord->m_Checksum == ChecksumPackRecord(*pRecord));
+
+    CHECK(AlignPackSize(0) == 0);
+    CHECK(AlignPackSize(1) == 8);
+    CHECK(AlignPackSize(8) == 8);
+    CHECK(AlignPackSize(9) == 16);
+
+    // Too big for the record header.
+    std::vector<BYTE> recordData;
+    uint32_t pixel = 0;
+    CHECK(!MakePackRecord(GetKey(1), { 70000, 16 }, 0, RESIZE_Fill, false, 0, &pixel, 4, recordData));
+    CHECK(!MakePackRecord(GetKey(1), TestBaseSize, CThumbnailPyramid::LevelCount, RESIZE_Fill, false, 0, &pixel, 4, recordData));
+}
+
+TEST(ThumbnailPackFormat_ChecksumCoversHeader)
+{
+    CPackBuilder pack;
+    pack.Add(GetKey(1));
+
+    PackRecord record = *pack.GetRecord(0);
+    uint32_t checksum = ChecksumPackRecord(record);
+
+    // Changing any byte before the checksum changes it.
+    for (size_t idx = 0; idx < offsetof(PackRecord, m_Checksum); idx++)
+    {
+        PackRecord changed = record;
+        ((BYTE*) &changed)[idx] ^= 0x01;
+        CHECK(ChecksumPackRecord(changed) != checksum);
+    }
+}
+
+TEST(ThumbnailPackFormat_GetPixels)
+{
+    CPackBuilder pack;
+    pack.Add(GetKey(7), 1, RESIZE_Fit, true);
+
+    const PackRecord* pRecord = pack.GetRecord(0);
+
+    for (int level = 1; level < CThumbnailPyramid::LevelCount; level++)
+    {
+        const uint32_t* pPixels = GetPackRecordPixels(pRecord, GetKey(7), TestBaseSize, level, RESIZE_Fit, true, TestBackground);
+        REQUIRE(pPixels != nullptr);
+
+        // The level's own pixels, starting from the first.
+        SIZE levelSize = CThumbnailPyramid::GetLevelSize(TestBaseSize, level);
+        size_t lastIdx = (size_t) levelSize.cx * levelSize.cy - 1;
+        CHECK(pPixels[0] == (7U << 24 | (uint32_t) level << 16));
+        CHECK(pPixels[lastIdx] == (7U << 24 | (uint32_t) level << 16 | (uint32_t) lastIdx));
+    }
+
+    // Level 0 isn't in the record.
+    CHECK(GetPackRecordPixels(pRecord, GetKey(7), TestBaseSize, 0, RESIZE_Fit, true, TestBackground) == nullptr);
+    CHECK(GetPackRecordPixels(pRecord, GetKey(7), TestBaseSize, CThumbnailPyramid::LevelCount, RESIZE_Fit, true, TestBackground) == nullptr);
+}
+
+TEST(ThumbnailPackFormat_StaleRecordsDontMatch)
+{
+    CPackBuilder pack;
+    pack.Add(GetKey(7));
+
+    const PackRecord* pRecord = pack.GetRecord(0);
+    CThumbnailKey key = GetKey(7);
+
+    CHECK(GetPackRecordPixels(pRecord, key, TestBaseSize, 0, RESIZE_Fill, false, TestBackground) != nullptr);
+
+    // The file has changed since the thumbnail was made.
+    CThumbnailKey newerKey = key;
+    newerKey.m_LastWriteTime++;
+    CHECK(GetPackRecordPixels(pRecord, newerKey, TestBaseSize, 0, RESIZE_Fill, false, TestBackground) == nullptr);
+
+    CThumbnailKey resizedKey = key;
+    resizedKey.m_FileSize++;
+    CHECK(GetPackRecordPixels(pRecord, resizedKey, TestBaseSize, 0, RESIZE_Fill, false, TestBackground) == nullptr);
+
+    // A different file.
+    CHECK(GetPackRecordPixels(pRecord, GetKey(8), TestBaseSize, 0, RESIZE_Fill, false, TestBackground) == nullptr);
+
+    // Made a different way.
+    CHECK(GetPackRecordPixels(pRecord, key, { 64, 32 }, 0, RESIZE_Fill, false, TestBackground) == nullptr);
+    CHECK(GetPackRecordPixels(pRecord, key, TestBaseSize, 0, RESIZE_Fit, false, TestBackground) == nullptr);
+    CHECK(GetPackRecordPixels(pRecord, key, TestBaseSize, 0, RESIZE_Fill, true, TestBackground) == nullptr);
+    CHECK(GetPackRecordPixels(pRecord, key, TestBaseSize, 0, RESIZE_Fill, false, RGB(0, 0, 0)) == nullptr);
+}
+
+TEST(ThumbnailPackFormat_LoadIndex)
+{
+    CPackBuilder pack;
+    size_t size1 = pack.Add(GetKey(1));
+    size_t size2 = pack.Add(GetKey(2), 2);
+    size_t size3 = pack.Add(GetKey(3), 3);
+
+    CThumbnailPackIndex index;
+    REQUIRE(index.Load(pack.m_Data.data(), pack.m_Data.size()));
+
+    CHECK(index.size() == 3);
+    CHECK(index.GetFileSize() == pack.m_Data.size());
+    CHECK(index.GetLiveSize() == size1 + size2 + size3);
+
+    const CThumbnailPackIndex::Entry* pEntry = index.Find(2);
+    REQUIRE(pEntry != nullptr);
+    CHECK(pEntry->m_Offset == pack.m_RecordOffsets[1]);
+    CHECK(pEntry->m_RecordSize == size2);
+
+    CHECK(index.Find(4) == nullptr);
+
+    // An empty pack.
+    CPackBuilder emptyPack;
+    REQUIRE(index.Load(emptyPack.m_Data.data(), emptyPack.m_Data.size()));
+    CHECK(index.size() == 0);
+    CHECK(index.GetFileSize() == sizeof(PackHeader));
+}
+
+TEST(ThumbnailPackFormat_NewerRecordReplacesOlder)
+{
+    CPackBuilder pack;
+    size_t size1 = pack.Add(GetKey(1, 1000));
+    size_t size2 = pack.Add(GetKey(2));
+    size_t newSize1 = pack.Add(GetKey(1, 2000), 1);
+
+    CThumbnailPackIndex index;
+    REQUIRE(index.Load(pack.m_Data.data(), pack.m_Data.size()));
+
+    CHECK(index.size() == 2);
+    CHECK(index.GetFileSize() == sizeof(PackHeader) + size1 + size2 + newSize1);
+    CHECK(index.GetLiveSize() == size2 + newSize1);
+
+    const CThumbnailPackIndex::Entry* pEntry = index.Find(1);
+    REQUIRE(pEntry != nullptr);
+    CHECK(pEntry->m_Offset == pack.m_RecordOffsets[2]);
+
+    // Same with records added after loading.
+    index.Append(2, 64);
+    CHECK(index.GetLiveSize() == newSize1 + 64);
+    CHECK(index.Find(2)->m_Offset == pack.m_Data.size());
+    CHECK(index.GetFileSize() == pack.m_Data.size() + 64);
+}
+
+TEST(ThumbnailPackFormat_TornRecordIsIgnored)
+{
+    CPackBuilder pack;
+    size_t size1 = pack.Add(GetKey(1));
+    size_t size2 = pack.Add(GetKey(2));
+
+    CThumbnailPackIndex index;
+
+    // Cut off anywhere in the second record: the first is still there,
+    // and the next record goes where the second one started.
+    for (size_t cut = 1; cut < size2; cut += 7)
+    {
+        REQUIRE(index.Load(pack.m_Data.data(), pack.m_Data.size() - cut));
+        CHECK(index.size() == 1);
+        CHECK(index.Find(1) != nullptr);
+        CHECK(index.Find(2) == nullptr);
+        CHECK(index.GetFileSize() == sizeof(PackHeader) + size1);
+    }
+
+    // Just the header.
+    REQUIRE(index.Load(pack.m_Data.data(), sizeof(PackHeader) + sizeof(PackRecord) - 1));
+    CHECK(index.size() == 0);
+    CHECK(index.GetFileSize() == sizeof(PackHeader));
+}
+
+TEST(ThumbnailPackFormat_StopsAtFirstBadRecord)
+{
+    CPackBuilder pack;
+    size_t size1 = pack.Add(GetKey(1));
+    pack.Add(GetKey(2));
+    pack.Add(GetKey(3));
+
+    // Garbage in the second record's header. The third record can't be
+    // trusted either, since the second one's size can't be.
+    std::vector<BYTE> corrupt(pack.m_Data);
+    corrupt[pack.m_RecordOffsets[1] + offsetof(PackRecord, m_DataSize)] ^= 0x40;
+
+    CThumbnailPackIndex index;
+    REQUIRE(index.Load(corrupt.data(), corrupt.size()));
+    CHECK(index.size() == 1);
+    CHECK(index.GetFileSize() == sizeof(PackHeader) + size1);
+
+    // Not a record at all.
+    corrupt = pack.m_Data;
+    corrupt[pack.m_RecordOffsets[1]] = 0;
+
+    REQUIRE(index.Load(corrupt.data(), corrupt.size()));
+    CHECK(index.size() == 1);
+    CHECK(index.GetFileSize() == sizeof(PackHeader) + size1);
+}
+
+TEST(ThumbnailPackFormat_RejectsOtherFiles)
+{
+    CPackBuilder pack;
+    pack.Add(GetKey(1));
+
+    CThumbnailPackIndex index;
+
+    // Too short for a header.
+    CHECK(!index.Load(pack.m_Data.data(), sizeof(PackHeader) - 1));
+    CHECK(index.GetFileSize() == 0);
+
+    // Not a pack.
+    std::vector<BYTE> other(pack.m_Data);
+    other[0] = 'X';
+    CHECK(!index.Load(other.data(), other.size()));
+    CHECK(index.size() == 0);
+    CHECK(index.GetFileSize() == 0);
+
+    // A different version.
+    other = pack.m_Data;
+    ((PackHeader*) other.data())->m_Version = PackVersion + 1;
+    CHECK(!index.Load(other.data(), other.size()));
+    CHECK(index.GetFileSize() == 0);
+
+    index.Reset();
+    CHECK(index.GetFileSize() == sizeof(PackHeader));
+    CHECK(index.GetLiveSize() == 0);
+}
+
+TEST(ThumbnailPackFormat_NeedsCompaction)
+{
+    const uint64_t maximumSize = 64 * 1024 * 1024;
+
+    CThumbnailPackIndex index;
+    index.Reset();
+
+    // Small packs aren't compacted just for dead space.
+    index.Append(1, 1024);
+    index.Append(1, 1024);
+    index.Append(1, 1024);
+    CHECK(!index.NeedsCompaction(maximumSize));
+
+    // Mostly dead space.
+    const uint64_t recordSize = CThumbnailPackIndex::MinCompactionSize / 4;
+
+    index.Reset();
+    for (int idx = 0; idx < 4; idx++)
+        index.Append(1, recordSize);
+
+    CHECK(index.GetLiveSize() == recordSize);
+    CHECK(index.NeedsCompaction(maximumSize));
+
+    // Half live isn't enough.
+    index.Reset();
+    index.Append(1, recordSize);
+    index.Append(2, recordSize);
+    index.Append(3, recordSize);
+    index.Append(3, recordSize);
+    CHECK(!index.NeedsCompaction(maximumSize));
+
+    // Nearly full (all live).
+    index.Reset();
+    while (index.GetFileSize() <= maximumSize / 100 * CThumbnailPackIndex::FullPercent)
+    {
+        CHECK(!index.NeedsCompaction(maximumSize));
+        index.Append(index.size() + 1, recordSize);
+    }
+
+    CHECK(index.NeedsCompaction(maximumSize));
+}
+
+TEST(ThumbnailPackFormat_CompactedRecords)
+{
+    const uint64_t maximumSize = 100 * 1000;
+    const uint64_t recordSize = 1000;
+
+    CThumbnailPackIndex index;
+    index.Reset();
+
+    // 95 files, and 10 of them written again (the old records are dead).
+    for (uint64_t pathHash = 0; pathHash < 95; pathHash++)
+        index.Append(pathHash, recordSize);
+
+    for (uint64_t pathHash = 0; pathHash < 10; pathHash++)
+        index.Append(pathHash * 2, recordSize);
+
+    std::vector<CThumbnailPackIndex::Entry> records = index.GetCompactedRecords(maximumSize);
+
+    // Down to the target size, keeping the newest.
+    uint64_t newFileSize = sizeof(PackHeader) + records.size() * recordSize;
+    CHECK(newFileSize <= maximumSize / 100 * CThumbnailPackIndex::CompactionTargetPercent);
+    CHECK(newFileSize + recordSize > maximumSize / 100 * CThumbnailPackIndex::CompactionTargetPercent);
+
+    // In file order, ending with the newest.
+    for (size_t idx = 1; idx < records.size(); idx++)
+        CHECK(records[idx - 1].m_Offset < records[idx].m_Offset);
+
+    CHECK(records.back().m_Offset == index.Find(18)->m_Offset);
+
+    // Everything fits: only the dead records go.
+    records = index.GetCompactedRecords(maximumSize * 10);
+    CHECK(records.size() == 95);
+}
@@ -0,0 +1,167 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperCacheBench.cpp
+//
+//  CWallpaperCache benchmarks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include <fstream>
+
+#include "WallpaperCache.h"
+
+// Source image and screen sizes.
+struct RenderSizes
+{
+    SIZE m_SrcSize;
+    SIZE m_ScreenSize;
+};
+
+// Make source files (the contents don't matter; the cache only looks at
+// their size and last write time).
+static
+std::vector<fs::path>
+MakeSourceFiles(
+    const fs::path& directory,
+    size_t count
+)
+{
+    std::vector<fs::path> sourcePaths;
+
+    for (size_t fileNum = 0; fileNum < count; fileNum++)
+    {
+        fs::path sourcePath = directory / ("image" + std::to_string(fileNum) + ".jpg");
+        std::ofstream(sourcePath) << fileNum;
+        sourcePaths.push_back(sourcePath);
+    }
+
+    return sourcePaths;
+}
+
+// Times a wallpaper change with the cache, each way it can go: the file
+// isn't rendered yet (decode, resize, and write it on the spot), it was
+// rendered ahead (just look it up), or it was prepared in the background
+// (ask for it and wait).
+//
+// WIC isn't available here, so the decode function makes noise. Real
+// decodes take longer, so these are the low end of what a change costs.
+BENCHMARK(WallpaperCacheChange)
+{
+    for (const RenderSizes& sizes: GetBenchSizes<RenderSizes>({ { { 1200, 800 }, { 1920, 1080 } },
+                                                               { { 4000, 3000 }, { 1920, 1080 } },
+                                                               { { 6000, 4000 }, { 3840, 2160 } } }))
+    {
+        printf(" %dx%d -> %dx%d\n", sizes.m_SrcSize.cx, sizes.m_SrcSize.cy, sizes.m_ScreenSize.cx, sizes.m_ScreenSize.cy);
+
+        fs::path benchDirectory = GetBenchDirectory("WallpaperCache");
+
+        auto decode = /*LAMBDA*/ [&sizes] (const fs::path& path, std::vector<uint32_t>* pPixels, SIZE* pSize)
+        {
+            std::mt19937 random((uint32_t) std::hash<std::string>()(path.filename().string()));
+
+            *pSize = sizes.m_SrcSize;
+            pPixels->resize((size_t) sizes.m_SrcSize.cx * sizes.m_SrcSize.cy);
+
+            for (uint32_t& pixel: *pPixels)
+                pixel = (uint32_t) random() | 0xFF000000;
+
+            return true;
+        };
+
+        CWallpaperRenderSettings settings = {};
+        settings.m_Size = sizes.m_ScreenSize;
+        settings.m_ResizeMode = RESIZE_Fill;
+
+        {
+            CWallpaperCache cache(decode);
+            cache.Initialize(benchDirectory / "Cache", (uint64_t) 4 * 1024 * 1024 * 1024);
+            cache.SetRenderSettings(settings);
+
+            size_t changeCount = GetBenchRepeatCount(5);
+
+            // Not rendered yet.
+            {
+                std::vector<fs::path> sourcePaths = MakeSourceFiles(benchDirectory, changeCount);
+                CLatencyStats stats;
+
+                for (const fs::path& sourcePath: sourcePaths)
+                {
+                    CStopwatch stopwatch;
+                    cache.Render(sourcePath);
+                    stats.Add(stopwatch.GetElapsedMs());
+                }
+
+                stats.Report("render on demand");
+            }
+
+            // Rendered ahead.
+            {
+                fs::path sourceDirectory = benchDirectory / "Ahead";
+                fs::create_directories(sourceDirectory);
+
+                std::vector<fs::path> sourcePaths = MakeSourceFiles(sourceDirectory, changeCount);
+
+                CStopwatch renderStopwatch;
+                cache.RenderAhead(sourcePaths);
+                cache.WaitForRenders();
+                double renderMs = renderStopwatch.GetElapsedMs();
+
+                CLatencyStats stats;
+
+                for (size_t repeat = 0; repeat < GetBenchRepeatCount(100); repeat++)
+                {
+                    CStopwatch stopwatch;
+                    cache.Lookup(sourcePaths[repeat % sourcePaths.size()]);
+                    stats.Add(stopwatch.GetElapsedMs());
+                }
+
+                printf("  render ahead: %.1f ms per image, in the background\n", renderMs / (double) sourcePaths.size());
+                stats.Report("rendered ahead, lookup");
+            }
+
+            // Prepared in the background. (Timed from the request, so this is
+            // what a change costs when the prepare was asked for too late.)
+            {
+                fs::path sourceDirectory = benchDirectory / "Prepare";
+                fs::create_directories(sourceDirectory);
+
+                std::vector<fs::path> sourcePaths = MakeSourceFiles(sourceDirectory, changeCount);
+                CLatencyStats stats;
+
+                for (const fs::path& sourcePath: sourcePaths)
+                {
+                    CStopwatch stopwatch;
+
+                    // The first two candidates are missing, and are skipped.
+                    cache.Prepare({ sourceDirectory / "missing1.jpg", sourceDirectory / "missing2.jpg", sourcePath });
+
+                    fs::path preparedPath;
+                    while (cache.GetPrepared(&preparedPath) == CWallpaperCache::PREPARE_Pending)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+                    stats.Add(stopwatch.GetElapsedMs());
+
+                    cache.CancelPrepare();
+                }
+
+                stats.Report("prepare and wait");
+            }
+        }
+
+        // The rendered files are big.
+        std::error_code ec;
+        fs::remove_all(benchDirectory, ec);
+    }
+}
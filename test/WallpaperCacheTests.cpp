@@ -0,0 +1,145 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperCacheTests.cpp
+//
+//  CWallpaperCache tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include <fstream>
+
+#include "WallpaperCache.h"
+
+// Source files are small text files, "decoded" to a solid image. Files
+// that don't end in .img can't be decoded.
+static
+bool
+DecodeTestImage(
+    const fs::path& path,
+    std::vector<uint32_t>* pPixels,
+    SIZE* pSize
+)
+{
+    if (path.extension() != ".img" || !fs::is_regular_file(path))
+        return false;
+
+    *pSize = { 64, 48 };
+    pPixels->assign(64 * 48, 0xFF336699);
+
+    return true;
+}
+
+static
+fs::path
+MakeSourceFile(
+    const fs::path& directory,
+    const char* filename
+)
+{
+    fs::path sourcePath = directory / filename;
+    std::ofstream(sourcePath) << filename;
+    return sourcePath;
+}
+
+static
+void
+InitializeTestCache(
+    CWallpaperCache& cache,
+    const fs::path& directory
+)
+{
+    CWallpaperRenderSettings settings = {};
+    settings.m_Size = { 32, 24 };
+    settings.m_ResizeMode = RESIZE_Fill;
+
+    cache.Initialize(directory / "Cache", 1024 * 1024);
+    cache.SetRenderSettings(settings);
+}
+
+TEST(WallpaperCache_WaitForPrepared)
+{
+    fs::path directory = GetTestDirectory("WallpaperCache_WaitForPrepared");
+
+    fs::path firstPath = MakeSourceFile(directory, "first.img");
+    fs::path secondPath = MakeSourceFile(directory, "second.img");
+    fs::path otherPath = MakeSourceFile(directory, "other.img");
+    fs::path brokenPath = MakeSourceFile(directory, "broken.txt");
+
+    CWallpaperCache cache(DecodeTestImage);
+    InitializeTestCache(cache, directory);
+
+    // The broken one is skipped, and the first good one is prepared (and
+    // rendered).
+    cache.Prepare({ directory / "missing.img", brokenPath, firstPath, secondPath });
+
+    CHECK(cache.WaitForPrepared(firstPath));
+    CHECK(!cache.Lookup(firstPath).empty());
+
+    // Candidates that weren't picked, or weren't candidates.
+    CHECK(!cache.WaitForPrepared(secondPath));
+    CHECK(!cache.WaitForPrepared(otherPath));
+    CHECK(cache.Lookup(secondPath).empty());
+
+    // None of them can be decoded.
+    cache.Prepare({ brokenPath });
+    CHECK(!cache.WaitForPrepared(brokenPath));
+
+    fs::path preparedPath;
+    CHECK(cache.GetPrepared(&preparedPath) == CWallpaperCache::PREPARE_Failed);
+
+    // Forgotten.
+    cache.Prepare({ secondPath });
+    cache.CancelPrepare();
+    CHECK(!cache.WaitForPrepared(secondPath));
+}
+
+TEST(WallpaperCache_IsIdle)
+{
+    fs::path directory = GetTestDirectory("WallpaperCache_IsIdle");
+
+    fs::path sourcePath = MakeSourceFile(directory, "source.img");
+
+    std::mutex mutex;
+    std::condition_variable released;
+    bool isReleased = false;
+
+    // Holds up the render until it's released.
+    auto decode = /*LAMBDA*/ [&] (const fs::path& path, std::vector<uint32_t>* pPixels, SIZE* pSize)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&] () { return isReleased; });
+
+        return DecodeTestImage(path, pPixels, pSize);
+    };
+
+    CWallpaperCache cache(decode);
+    InitializeTestCache(cache, directory);
+
+    CHECK(cache.IsIdle());
+
+    cache.RenderAhead({ sourcePath });
+    CHECK(!cache.IsIdle());
+    CHECK(cache.Lookup(sourcePath).empty());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isReleased = true;
+    }
+    released.notify_all();
+
+    cache.WaitForRenders();
+    CHECK(cache.IsIdle());
+    CHECK(!cache.Lookup(sourcePath).empty());
+}
@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperSessionBench.cpp
+//
+//  CWallpaperSession benchmarks.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Bench.h"
+
+#include "MockWallpaperBackend.h"
+
+// Backend latencies: how long a call and a connect take.
+struct BackendLatency
+{
+    std::chrono::microseconds m_CallLatency;
+    std::chrono::microseconds m_ConnectLatency;
+};
+
+// Wallpaper changes through a session, against connecting and setting
+// everything for each change (what a change cost without one). The mock
+// backend's latencies stand in for round trips to explorer; the first
+// are zero, to time the session itself.
+//
+// Most changes are a new image with the same position and background
+// color; every tenth also changes the position, and every hundredth
+// loses the connection (explorer restarted).
+BENCHMARK(WallpaperSessionChange)
+{
+    for (const BackendLatency& latency: GetBenchSizes<BackendLatency>({ { std::chrono::microseconds(0), std::chrono::microseconds(0) },
+                                                                        { std::chrono::microseconds(200), std::chrono::microseconds(5000) } }))
+    {
+        printf(" call %lldus, connect %lldus\n", (long long) latency.m_CallLatency.count(), (long long) latency.m_ConnectLatency.count());
+
+        size_t changeCount = IsQuickRun() ? 100 : (latency.m_CallLatency.count() == 0) ? 100000 : 1000;
+
+        auto getPosition = /*LAMBDA*/ [] (size_t change)
+        {
+            return (change / 10 % 2 == 0) ? RESIZE_Fill : RESIZE_Fit;
+        };
+
+        // With a session.
+        {
+            CMockWallpaperBackend* pBackend = new CMockWallpaperBackend(latency.m_CallLatency, latency.m_ConnectLatency);
+            CWallpaperSession session((std::unique_ptr<CWallpaperBackend>(pBackend)));
+
+            CLatencyStats stats;
+
+            for (size_t change = 0; change < changeCount; change++)
+            {
+                if (change % 100 == 99)
+                    pBackend->DropConnection();
+
+                std::wstring wallpaperFile = L"image" + std::to_wstring(change) + L".jpg";
+
+                CStopwatch stopwatch;
+                session.SetWallpaper(wallpaperFile, getPosition(change), RGB(0, 0, 0));
+                stats.Add(stopwatch.GetElapsedMs());
+            }
+
+            stats.Report("session");
+            printf("  %.2f calls, %.3f connects, %.0f ns per change\n",
+                   (double) (pBackend->m_GetCount + pBackend->m_SetCount) / (double) changeCount,
+                   (double) pBackend->m_ConnectCount / (double) changeCount,
+                   stats.GetMean() * 1e6);
+        }
+
+        // Without.
+        {
+            CMockWallpaperBackend backend(latency.m_CallLatency, latency.m_ConnectLatency);
+
+            CLatencyStats stats;
+
+            for (size_t change = 0; change < changeCount; change++)
+            {
+                std::wstring wallpaperFile = L"image" + std::to_wstring(change) + L".jpg";
+
+                CStopwatch stopwatch;
+
+                backend.Connect();
+                backend.SetBackgroundColor(RGB(0, 0, 0));
+                backend.SetWallpaper(wallpaperFile);
+                backend.SetPosition(getPosition(change));
+                backend.Disconnect();
+
+                stats.Add(stopwatch.GetElapsedMs());
+            }
+
+            stats.Report("connect and set all");
+            printf("  %.2f calls, %.3f connects, %.0f ns per change\n",
+                   (double) (backend.m_GetCount + backend.m_SetCount) / (double) changeCount,
+                   (double) backend.m_ConnectCount / (double) changeCount,
+                   stats.GetMean() * 1e6);
+        }
+    }
+}
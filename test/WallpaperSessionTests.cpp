@@ -0,0 +1,248 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  WallpaperSessionTests.cpp
+//
+//  CWallpaperSession tests.
+//
+//----------------------------------------------------------------------------
+//
+//  Copyright 2020 by State University of Catatonia and other Contributors
+//
+//  This file is provided under a "BSD 3-Clause" open source license.
+//  The full text of the license is provided in the "LICENSE.txt" file.
+//
+//  SPDX-License-Identifier: BSD-3-Clause
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "precomp.h"
+#include "Test.h"
+
+#include "MockWallpaperBackend.h"
+
+// A session with a mock backend. The session owns the backend; m_pBackend
+// is for looking at it.
+struct MockSession
+{
+    CMockWallpaperBackend* m_pBackend;
+    CWallpaperSession m_Session;
+
+    MockSession()
+        :
+        m_pBackend(new CMockWallpaperBackend()),
+        m_Session(std::unique_ptr<CWallpaperBackend>(m_pBackend))
+    {
+    }
+
+    // Give the mock two monitors.
+    void
+    AddSecondMonitor()
+    {
+        m_pBackend->m_Monitors.push_back(CWallpaperMonitor{ L"MOCK#1", { 1920, 0, 3840, 1080 } });
+    }
+};
+
+TEST(WallpaperSession_FirstChangeSetsEverything)
+{
+    MockSession mock;
+
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+
+    CHECK(mock.m_pBackend->m_ConnectCount == 1);
+    CHECK(mock.m_pBackend->m_GetCount == 0);
+    CHECK(mock.m_pBackend->m_SetCount == 3);
+
+    CHECK(mock.m_pBackend->m_WallpaperFile == L"a.jpg");
+    CHECK(mock.m_pBackend->m_Position == RESIZE_Fit);
+    CHECK(mock.m_pBackend->m_BackgroundColor == RGB(1, 2, 3));
+    CHECK(mock.m_pBackend->m_Enabled);
+}
+
+TEST(WallpaperSession_OnlyChangesAreSet)
+{
+    MockSession mock;
+
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    int setCount = mock.m_pBackend->m_SetCount;
+
+    // Nothing changed.
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_SetCount == setCount);
+
+    // Just the image.
+    CHECK(mock.m_Session.SetWallpaper(L"b.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 1);
+    CHECK(mock.m_pBackend->m_WallpaperFile == L"b.jpg");
+
+    // Just the position.
+    CHECK(mock.m_Session.SetWallpaper(L"b.jpg", RESIZE_Fill, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 2);
+    CHECK(mock.m_pBackend->m_Position == RESIZE_Fill);
+
+    // Just the background color.
+    CHECK(mock.m_Session.SetWallpaper(L"b.jpg", RESIZE_Fill, RGB(4, 5, 6)));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 3);
+    CHECK(mock.m_pBackend->m_BackgroundColor == RGB(4, 5, 6));
+
+    CHECK(mock.m_pBackend->m_ConnectCount == 1);
+    CHECK(mock.m_pBackend->m_GetCount == 0);
+}
+
+TEST(WallpaperSession_GetsAskOnce)
+{
+    MockSession mock;
+    mock.m_pBackend->m_WallpaperFile = L"old.jpg";
+    mock.m_pBackend->m_Position = RESIZE_Tile;
+    mock.m_pBackend->m_BackgroundColor = RGB(7, 8, 9);
+
+    std::wstring wallpaperFile;
+    WallpaperResizeMode position;
+    COLORREF color;
+
+    for (int repeat = 0; repeat < 2; repeat++)
+    {
+        CHECK(mock.m_Session.GetWallpaper(&wallpaperFile));
+        CHECK(mock.m_Session.GetPosition(&position));
+        CHECK(mock.m_Session.GetBackgroundColor(&color));
+    }
+
+    CHECK(wallpaperFile == L"old.jpg");
+    CHECK(position == RESIZE_Tile);
+    CHECK(color == RGB(7, 8, 9));
+    CHECK(mock.m_pBackend->m_GetCount == 3);
+
+    // What was read doesn't need setting.
+    CHECK(mock.m_Session.SetWallpaper(L"new.jpg", RESIZE_Tile, RGB(7, 8, 9)));
+    CHECK(mock.m_pBackend->m_SetCount == 1);
+
+    // And what was set doesn't need reading.
+    CHECK(mock.m_Session.GetWallpaper(&wallpaperFile));
+    CHECK(wallpaperFile == L"new.jpg");
+    CHECK(mock.m_pBackend->m_GetCount == 3);
+}
+
+TEST(WallpaperSession_Reconnect)
+{
+    MockSession mock;
+
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+
+    // Explorer restarted, and came back with its own idea of the wallpaper.
+    mock.m_pBackend->DropConnection();
+    mock.m_pBackend->m_WallpaperFile = L"default.jpg";
+    mock.m_pBackend->m_Position = RESIZE_Fill;
+    mock.m_pBackend->m_BackgroundColor = 0;
+
+    int setCount = mock.m_pBackend->m_SetCount;
+
+    // Setting the image fails. The session reconnects and, not knowing
+    // the state any more, sets everything -- even what it set before.
+    CHECK(mock.m_Session.SetWallpaper(L"b.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_ConnectCount == 2);
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 3);
+
+    CHECK(mock.m_pBackend->m_WallpaperFile == L"b.jpg");
+    CHECK(mock.m_pBackend->m_Position == RESIZE_Fit);
+    CHECK(mock.m_pBackend->m_BackgroundColor == RGB(1, 2, 3));
+
+    // Gets reconnect too.
+    mock.m_pBackend->DropConnection();
+    mock.m_Session.Invalidate();
+
+    std::wstring wallpaperFile;
+    CHECK(mock.m_Session.GetWallpaper(&wallpaperFile));
+    CHECK(wallpaperFile == L"b.jpg");
+    CHECK(mock.m_pBackend->m_ConnectCount == 3);
+}
+
+TEST(WallpaperSession_NotifyChanged)
+{
+    MockSession mock;
+
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    int setCount = mock.m_pBackend->m_SetCount;
+
+    // The shell notifies us of our own change, which doesn't forget what
+    // we set.
+    mock.m_Session.NotifyChanged();
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_SetCount == setCount);
+
+    // Somebody else changed it. (NotifyChanged() can't tell it from our
+    // own this soon, which is what Invalidate() is for.)
+    mock.m_pBackend->m_WallpaperFile = L"theirs.jpg";
+    mock.m_Session.Invalidate();
+
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_WallpaperFile == L"a.jpg");
+    CHECK(mock.m_pBackend->m_ConnectCount == 1);
+}
+
+TEST(WallpaperSession_SolidColor)
+{
+    MockSession mock;
+
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+
+    int setCount = mock.m_pBackend->m_SetCount;
+
+    CHECK(mock.m_Session.SetSolidColor(RGB(1, 2, 3)));
+    CHECK(!mock.m_pBackend->m_Enabled);
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 1);
+
+    CHECK(mock.m_Session.SetSolidColor(RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 1);
+
+    // The same image again enables the wallpaper.
+    CHECK(mock.m_Session.SetWallpaper(L"a.jpg", RESIZE_Fit, RGB(1, 2, 3)));
+    CHECK(mock.m_pBackend->m_Enabled);
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 2);
+}
+
+TEST(WallpaperSession_MonitorWallpapers)
+{
+    MockSession mock;
+    mock.AddSecondMonitor();
+
+    std::vector<CWallpaperMonitor> monitors;
+    CHECK(mock.m_Session.GetMonitors(&monitors));
+    CHECK(mock.m_Session.GetMonitors(&monitors));
+    CHECK(monitors.size() == 2);
+    CHECK(mock.m_pBackend->m_GetCount == 1);
+
+    std::map<std::wstring, std::wstring> wallpaperFiles = { { L"MOCK#0", L"a.jpg" }, { L"MOCK#1", L"b.jpg" } };
+
+    CHECK(mock.m_Session.SetMonitorWallpapers(wallpaperFiles, RESIZE_Fill, 0));
+    CHECK(mock.m_pBackend->m_MonitorWallpaperFiles[L"MOCK#0"] == L"a.jpg");
+    CHECK(mock.m_pBackend->m_MonitorWallpaperFiles[L"MOCK#1"] == L"b.jpg");
+
+    int setCount = mock.m_pBackend->m_SetCount;
+
+    // Nothing changed.
+    CHECK(mock.m_Session.SetMonitorWallpapers(wallpaperFiles, RESIZE_Fill, 0));
+    CHECK(mock.m_pBackend->m_SetCount == setCount);
+
+    // One monitor changed.
+    wallpaperFiles[L"MOCK#1"] = L"c.jpg";
+    CHECK(mock.m_Session.SetMonitorWallpapers(wallpaperFiles, RESIZE_Fill, 0));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 1);
+    CHECK(mock.m_pBackend->m_MonitorWallpaperFiles[L"MOCK#1"] == L"c.jpg");
+
+    // After a solid color, every monitor is set again.
+    CHECK(mock.m_Session.SetSolidColor(0));
+    setCount = mock.m_pBackend->m_SetCount;
+
+    CHECK(mock.m_Session.SetMonitorWallpapers(wallpaperFiles, RESIZE_Fill, 0));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 2);
+    CHECK(mock.m_pBackend->m_Enabled);
+
+    // One wallpaper on every monitor replaces the per-monitor ones.
+    CHECK(mock.m_Session.SetWallpaper(L"d.jpg", RESIZE_Fill, 0));
+    CHECK(mock.m_pBackend->m_MonitorWallpaperFiles[L"MOCK#0"] == L"d.jpg");
+    CHECK(mock.m_pBackend->m_MonitorWallpaperFiles[L"MOCK#1"] == L"d.jpg");
+
+    setCount = mock.m_pBackend->m_SetCount;
+
+    CHECK(mock.m_Session.SetMonitorWallpapers(wallpaperFiles, RESIZE_Fill, 0));
+    CHECK(mock.m_pBackend->m_SetCount == setCount + 2);
+}